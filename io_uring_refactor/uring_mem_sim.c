@@ -1,20 +1,33 @@
 // uring_mem_sim.c
 #define _GNU_SOURCE
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <linux/perf_event.h>
 #include <liburing.h>
 #include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/prctl.h>
 #include <sys/resource.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/utsname.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "../ring_model/ring_model.h"
+
 /*
  * MULTI-SERVICE IO_URING MEMLOCK + VMA SIMULATOR
  *
@@ -29,6 +42,54 @@
  *  - allocate buffers (either pooled or mmap-per-buffer)
  *  - optional mlock() (VmLck)
  *  - io_uring_register_buffers (VmPin on many kernels)
+ *  - optional IORING_SETUP_* flags (-F), CQ size (-c)
+ *
+ * Buffer sharing (-B):
+ *  - private:    every ring allocates and registers its own pool (pinned grows with rings)
+ *  - clone:      the first ring of a service registers the pool, siblings take it with
+ *                io_uring_clone_buffers() (liburing >= 2.8, kernel >= 6.12); falls back to same-pages
+ *  - same-pages: siblings register the first ring's iovecs again (one physical pool in RSS,
+ *                but each ring pins it again: VmPin and RLIMIT_MEMLOCK grow per ring)
+ *
+ * io-wq (-A, -w, -W):
+ *  - -A: rings after the first set IORING_SETUP_ATTACH_WQ with the first ring's fd
+ *        (shares workers only before 5.12; since then io-wq is per task and the flag just
+ *        validates the fd)
+ *  - -w: io_uring_register_iowq_max_workers(bounded, unbounded) on every ring
+ *  - -W: blocking workload, buffered writes forced to io-wq with IOSQE_ASYNC,
+ *        spread over -y log files; all rings are kept busy at once
+ *  - reports peak iou-wrk threads, their kernel stacks and write throughput
+ *
+ * Registration mode (-R, -r):
+ *  - full:   io_uring_register_buffers() of the whole pool before the ring is used
+ *  - sparse: io_uring_register_buffers_sparse() first, then the pool is faulted, locked and
+ *            registered -r buffers at a time with io_uring_register_buffers_update_tag()
+ *            between READ_FIXED batches
+ *  - either mode reads /dev/zero into every buffer with READ_FIXED and reports time to the
+ *    first completed I/O and to the whole pool registered and used
+ *
+ * Memory pressure (-H, -Z):
+ *  - a hog process maps SIZE, faults it in as 4 KiB pages and frees all but 1 in STRIDE,
+ *    leaving free memory scattered so long-term pins and THP faults need compaction
+ *  - reports io_uring_register_buffers() latency per ring and host /proc/vmstat deltas
+ *    (compact_stall, pgmigrate_success, ...) over the service run
+ *
+ * io-wq affinity (-a, -V):
+ *  - -a: io_uring_register_iowq_aff(CPULIST) on every ring (also moves SQPOLL threads on >= 6.6)
+ *  - -V: a sampler thread reads /proc/<pid>/task/<tid>/stat every millisecond while the service
+ *        runs and reports any iou-wrk / iou-sqp task whose last CPU is outside CPULIST
+ *  - keeps blocking ops off the latency-critical cores of a cpuset such as edp.slice
+ *
+ * Setup-flag matrix (-X):
+ *  - creates the ring set under every valid combination of
+ *    SQE128, CQE32, CQSIZE, SINGLE_ISSUER, DEFER_TASKRUN, COOP_TASKRUN, SUBMIT_ALL
+ *  - per cell: estimated vs actual ring bytes, VmPin/VmLck deltas, setup time, NOP throughput
+ *
+ * Counters (-E):
+ *  - per-thread perf_event_open group around each ring's setup and its NOP workload (-N):
+ *    cycles, instructions, dTLB-load-misses, page-faults, context-switches
+ *  - without a hardware PMU (common in VMs) cycles falls back to task-clock ns
+ *  - reported per ring (and per matrix cell with -X)
  *
  * Realtime:
  *  - child processes stream progress/final stats to parent via one pipe
@@ -43,12 +104,98 @@
  *  - setrlimit() result/errno if -k used (very common root cause of “Cannot allocate memory”)
  *
  * Build:
- *   gcc -O2 -Wall -Wextra -std=gnu11 uring_mem_sim.c -luring -o uring_mem_sim
+ *   gcc -O2 -Wall -Wextra -std=gnu11 uring_mem_sim.c ../ring_model/ring_model.c -luring -pthread -o uring_mem_sim
+ *
+ * Ring estimates come from ../ring_model (RING_MODEL_PARAMS=<file> for calibrated constants).
  */
 
 #define MAX_RINGS_PER_SERVICE 1000
 #define SIMMSG_MAGIC 0x53494D55u /* 'SIMU' */
 
+#define KERNEL_STACK_BYTES (16 * 1024)  // THREAD_SIZE on x86_64 / arm64
+#define WQ_WRITE_BYTES     4096         // one -W write
+#define WQ_FILE_BLOCKS     1024         // -W offsets wrap so each log file stays at 4 MiB
+#define MAX_REG_CHUNK      64           // -r upper bound (tag array on the stack)
+
+// io_uring_clone_buffers() arrived in liburing 2.8; older builds fall back to registering the same pages.
+#if defined(IO_URING_CHECK_VERSION)
+#if !IO_URING_CHECK_VERSION(2, 8)
+#define HAVE_CLONE_BUFFERS 1
+#endif
+#endif
+
+// Setup flags may be newer than the liburing headers; the kernel rejects unknown ones with EINVAL.
+#ifndef IORING_SETUP_CQSIZE
+#define IORING_SETUP_CQSIZE        (1U << 3)
+#endif
+#ifndef IORING_SETUP_SQPOLL
+#define IORING_SETUP_SQPOLL        (1U << 1)
+#endif
+#ifndef IORING_SETUP_ATTACH_WQ
+#define IORING_SETUP_ATTACH_WQ     (1U << 5)
+#endif
+#ifndef IORING_SETUP_SUBMIT_ALL
+#define IORING_SETUP_SUBMIT_ALL    (1U << 7)
+#endif
+#ifndef IORING_SETUP_COOP_TASKRUN
+#define IORING_SETUP_COOP_TASKRUN  (1U << 8)
+#endif
+#ifndef IORING_SETUP_SQE128
+#define IORING_SETUP_SQE128        (1U << 10)
+#endif
+#ifndef IORING_SETUP_CQE32
+#define IORING_SETUP_CQE32         (1U << 11)
+#endif
+#ifndef IORING_SETUP_SINGLE_ISSUER
+#define IORING_SETUP_SINGLE_ISSUER (1U << 12)
+#endif
+#ifndef IORING_SETUP_DEFER_TASKRUN
+#define IORING_SETUP_DEFER_TASKRUN (1U << 13)
+#endif
+#ifndef IORING_FEAT_SINGLE_MMAP
+#define IORING_FEAT_SINGLE_MMAP    (1U << 0)
+#endif
+
+typedef struct {
+    const char *name;
+    unsigned flag;
+} SetupFlagName;
+
+// order is also the bit order used by the -X matrix
+static const SetupFlagName setup_flag_names[] = {
+    {"sqe128",        IORING_SETUP_SQE128},
+    {"cqe32",         IORING_SETUP_CQE32},
+    {"cqsize",        IORING_SETUP_CQSIZE},
+    {"single_issuer", IORING_SETUP_SINGLE_ISSUER},
+    {"defer_taskrun", IORING_SETUP_DEFER_TASKRUN},
+    {"coop_taskrun",  IORING_SETUP_COOP_TASKRUN},
+    {"submit_all",    IORING_SETUP_SUBMIT_ALL},
+    // -F only: one kernel thread per ring would swamp the matrix
+    {"sqpoll",        IORING_SETUP_SQPOLL},
+};
+#define NUM_SETUP_FLAGS ((int)(sizeof(setup_flag_names)/sizeof(setup_flag_names[0])))
+#define NUM_MATRIX_FLAGS 7
+
+// perf counter slots; PC_CYCLES carries task-clock ns when the PMU is unavailable
+enum { PC_CYCLES, PC_INSTR, PC_DTLB, PC_FAULTS, PC_CSW, PC_NUM };
+static const char *perf_counter_names[PC_NUM] = {
+    "cycles", "instructions", "dTLB-load-misses", "page-faults", "context-switches"
+};
+
+typedef struct {
+    int leader;
+    int fds[PC_NUM];
+    int slot_pos[PC_NUM];     // position of each slot in the PERF_FORMAT_GROUP read
+    int nr;
+    int sw_fallback;          // cycles slot is task-clock
+    int user_only;            // perf_event_paranoid forced exclude_kernel
+} PerfGroup;
+
+typedef struct {
+    uint64_t v[PC_NUM];
+    uint32_t mask;            // slots that were counted
+} PerfSample;
+
 typedef struct {
     long vmlck_kb; // VmLck
     long vmpin_kb; // VmPin (if present)
@@ -58,6 +205,22 @@ typedef struct {
     long rlim_max_kb;
 } ProcStats;
 
+// -W blocking-write workload of one service
+typedef struct {
+    long ops;                 // completed writes
+    double usec;
+    int workers_peak;         // iou-wrk threads
+    int threads_peak;         // all threads of the process
+    long kstack_kb;           // host KernelStack growth at the peak
+    int err;                  // first submit / completion errno
+} WqStats;
+
+typedef enum { REG_FULL = 0, REG_SPARSE = 1 } RegMode;
+static const char *reg_mode_names[] = { "full", "sparse" };
+
+typedef enum { BUF_PRIVATE = 0, BUF_CLONE = 1, BUF_SAME_PAGES = 2 } BufShareMode;
+static const char *buf_share_names[] = { "private", "clone", "same-pages" };
+
 typedef struct {
     struct io_uring ring;
     int ring_fd;
@@ -79,6 +242,13 @@ typedef struct {
 
     int buffers_registered;
     int buffers_locked;
+    int bufs_populated;       // leading table slots holding a buffer (all of them unless -R sparse)
+    int reg_updates;          // io_uring_register_buffers_update_tag() calls
+    int buf_share;            // how this ring got its buffer table (BufShareMode)
+    int clone_errno;          // io_uring_clone_buffers() failure that forced same-pages
+    int wq_attached;          // created with IORING_SETUP_ATTACH_WQ (-A)
+    int iowq_limit_errno;     // io_uring_register_iowq_max_workers() failure (-w)
+    int iowq_aff_errno;       // io_uring_register_iowq_aff() failure (-a)
 
     int *registered_fds;
     int num_registered_fds;
@@ -89,7 +259,12 @@ typedef struct {
     int failure_errno;
     char failure_reason[256];
 
-    size_t ring_mem;
+    unsigned setup_flags;
+    double setup_usec;        // init + buffer registration wall time
+    double register_usec;     // io_uring_register_buffers / clone alone
+
+    size_t ring_mem;          // estimate
+    size_t ring_mem_actual;   // from sq/cq ring_sz + SQE array
     size_t buffer_mem;
     size_t total_mem;
 } BigUringInstance;
@@ -103,6 +278,8 @@ typedef struct {
     int nic_queues;           // -Q
 
     int queue_depth;          // -q
+    int cq_entries;           // -c (implies IORING_SETUP_CQSIZE)
+    unsigned setup_flags;     // -F IORING_SETUP_* for every ring
     int num_buffers;          // -b
     size_t buffer_size;       // -s
     int num_registered_fds;   // -f
@@ -118,11 +295,37 @@ typedef struct {
     int progress_every;       // -p N (per child)
     int interactive;          // -I (parent redraw)
     int verbose;              // -v
+
+    int flag_matrix;          // -X setup-flag matrix
+    int nop_ops;              // -N NOPs per ring (-1: 65536 in the matrix, off otherwise)
+    int perf_counters;        // -E perf_event_open groups per ring
+    int bench_lines;          // -J machine-readable BENCH lines (bench_suite.sh)
+    int buf_share;            // -B BufShareMode for rings after the first in a service
+
+    int iowq_attach;          // -A siblings attach to the first ring's io-wq
+    int iowq_limit;           // -w given
+    unsigned iowq_max[2];     // -w bounded,unbounded worker caps (0 = leave as is)
+    long wq_ops;              // -W blocking writes per ring (0 = off)
+    int wq_files;             // -y log files per service for -W
+
+    int iowq_aff;             // -a given
+    cpu_set_t iowq_aff_set;   // -a CPUs for io-wq (and SQPOLL) workers
+    int verify_aff;           // -V given
+    cpu_set_t verify_set;     // -V CPUs workers may run on
+
+    size_t hog_bytes;         // -H fragmenting memory hog (0 = off)
+    int hog_stride;           // -Z keep 1 of every STRIDE hog pages
+
+    int fixed_reads;          // -R given: READ_FIXED sweep with time-to-first-I/O
+    int reg_mode;             // -R RegMode
+    int reg_chunk;            // -r buffers per sparse update
+
+    const char *prom_file;    // -O node_exporter textfile (NULL = off)
 } SimConfig;
 
 static SimConfig config;
 
-typedef enum { MSG_PROGRESS = 1, MSG_FINAL = 2 } MsgType;
+typedef enum { MSG_PROGRESS = 1, MSG_FINAL = 2, MSG_RING_STATS = 3 } MsgType;
 
 typedef struct {
     uint32_t magic;
@@ -146,8 +349,80 @@ typedef struct {
 
     int first_errno;
     char first_failure[160];
+
+    // MSG_FINAL: buffer sharing (-B)
+    int bufs_cloned;          // rings that cloned the first ring's buffer table
+    int bufs_same_pages;      // rings that registered the first ring's pages again
+    int clone_errno;          // why clone fell back, 0 if it never did
+    double setup_usec_owner;  // ring that allocated + registered the pool
+    double setup_usec_sib;    // sum over sibling rings
+    int n_sib;
+
+    // MSG_FINAL: io-wq (-A / -w / -W)
+    int wq_attached;          // rings created with IORING_SETUP_ATTACH_WQ
+    int iowq_limit_errno;     // first io_uring_register_iowq_max_workers() failure
+    long wq_ops;              // completed blocking writes
+    double wq_usec;
+    int wq_workers_peak;      // iou-wrk threads of this service
+    int wq_threads_peak;      // all threads of this service
+    long wq_kstack_kb;        // host KernelStack growth at the peak
+    int wq_errno;
+
+    // MSG_FINAL: io-wq affinity (-a / -V)
+    int aff_errno;            // first io_uring_register_iowq_aff() failure
+    long aff_samples;         // sampler passes over /proc/<pid>/task
+    long aff_violations;      // worker observations on a CPU outside -V
+    cpu_set_t aff_cpus_seen;  // CPUs io-wq / SQPOLL workers were seen on
+    char aff_violation[96];   // first offending task
+
+    // MSG_FINAL: buffer registration latency (-H)
+    int n_reg;
+    double reg_usec_sum;
+    double reg_usec_max;
+
+    // MSG_FINAL: time to first I/O (-R)
+    int n_ttfio;
+    double ttfio_usec_sum;    // ring init until the first READ_FIXED completes
+    double ttfio_usec_max;
+    double all_usec_sum;      // ring init until every buffer is registered and read once
+    long reg_updates;
+    int ttfio_errno;
+
+    // MSG_RING_STATS: one ring's setup + workload measurements (-E / -N)
+    int ring_id;
+    int ring_ok;
+    int ring_errno;           // why setup failed, 0 when ring_ok
+    long ring_bytes;          // ring mappings + the buffer pool this ring registered itself
+    double setup_usec;
+    double work_usec;
+    long work_ops;
+    int perf_sw_fallback;
+    int perf_user_only;
+    PerfSample perf_setup;
+    PerfSample perf_work;
 } SimMsg;
 
+// services share one pipe; writes up to PIPE_BUF are atomic, so messages never interleave
+_Static_assert(sizeof(SimMsg) <= PIPE_BUF, "SimMsg must fit in one atomic pipe write");
+
+// host-wide /proc/vmstat counters touched by long-term pinning (-H)
+enum { VS_COMPACT_STALL, VS_COMPACT_FAIL, VS_COMPACT_SUCCESS, VS_PGMIGRATE_SUCCESS,
+       VS_PGMIGRATE_FAIL, VS_THP_FAULT_FALLBACK, VS_NUM };
+static const char *vmstat_names[VS_NUM] = {
+    "compact_stall", "compact_fail", "compact_success", "pgmigrate_success",
+    "pgmigrate_fail", "thp_fault_fallback"
+};
+
+// io-wq / SQPOLL worker CPU sampler (-V), one per service process
+typedef struct {
+    pthread_t thread;
+    volatile int stop;
+    long samples;
+    long violations;
+    cpu_set_t seen;
+    char first[96];
+} AffVerifier;
+
 // ---------------- helpers ----------------
 static size_t round_up(size_t x, size_t a) { return (x + a - 1) / a * a; }
 
@@ -170,6 +445,107 @@ static size_t parse_size(const char *s) {
     return (size_t)(v * mult);
 }
 
+static double now_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// "BENCH <metric> <value> <unit> <lower|higher>" -- one sample per run, collected by bench_suite.sh
+static void bench_line(const char *metric, double value, const char *unit, const char *better) {
+    if (!config.bench_lines) return;
+    printf("BENCH uring_mem_sim.%s %.3f %s %s\n", metric, value, unit, better);
+}
+
+// "0-3,8,10-11" -> set; -1 when empty or malformed
+static int parse_cpulist(const char *s, cpu_set_t *set) {
+    char tmp[256];
+    snprintf(tmp, sizeof(tmp), "%s", s);
+    CPU_ZERO(set);
+    int n = 0;
+    for (char *tok = strtok(tmp, ","); tok; tok = strtok(NULL, ",")) {
+        int a, b;
+        int k = sscanf(tok, "%d-%d", &a, &b);
+        if (k == 1) b = a;
+        else if (k != 2) return -1;
+        if (a < 0 || b < a || b >= CPU_SETSIZE) return -1;
+        for (int c = a; c <= b; c++) { CPU_SET(c, set); n++; }
+    }
+    return n > 0 ? 0 : -1;
+}
+
+static void format_cpulist(const cpu_set_t *set, char *buf, size_t len) {
+    size_t off = 0;
+    buf[0] = '\0';
+    for (int c = 0; c < CPU_SETSIZE && off < len; c++) {
+        if (!CPU_ISSET(c, set)) continue;
+        int e = c;
+        while (e + 1 < CPU_SETSIZE && CPU_ISSET(e + 1, set)) e++;
+        if (e > c) off += (size_t)snprintf(buf + off, len - off, "%s%d-%d", off ? "," : "", c, e);
+        else off += (size_t)snprintf(buf + off, len - off, "%s%d", off ? "," : "", c);
+        c = e;
+    }
+    if (!buf[0]) snprintf(buf, len, "none");
+}
+
+static int parse_setup_flags(const char *s, unsigned *out) {
+    // comma list of setup_flag_names, e.g. "sqe128,cqe32,single_issuer"
+    char tmp[256];
+    snprintf(tmp, sizeof(tmp), "%s", s);
+    unsigned flags = 0;
+    for (char *tok = strtok(tmp, ","); tok; tok = strtok(NULL, ",")) {
+        int found = 0;
+        for (int i = 0; i < NUM_SETUP_FLAGS; i++) {
+            if (strcasecmp(tok, setup_flag_names[i].name) == 0) {
+                flags |= setup_flag_names[i].flag;
+                found = 1;
+                break;
+            }
+        }
+        if (!found) return -1;
+    }
+    *out = flags;
+    return 0;
+}
+
+static const char *format_setup_flags(unsigned flags) {
+    static char buf[128];
+    buf[0] = '\0';
+    for (int i = 0; i < NUM_SETUP_FLAGS; i++) {
+        if (!(flags & setup_flag_names[i].flag)) continue;
+        if (buf[0]) strncat(buf, ",", sizeof(buf) - strlen(buf) - 1);
+        strncat(buf, setup_flag_names[i].name, sizeof(buf) - strlen(buf) - 1);
+    }
+    if (!buf[0]) snprintf(buf, sizeof(buf), "default");
+    return buf;
+}
+
+// Running kernel is at least major.minor; unparsable releases count as new.
+static int kernel_at_least(int major, int minor) {
+    struct utsname u;
+    int ma = 0, mi = 0;
+    if (uname(&u) != 0 || sscanf(u.release, "%d.%d", &ma, &mi) != 2) return 1;
+    return ma > major || (ma == major && mi >= minor);
+}
+
+static int cq_entries_for(unsigned flags) {
+    if ((flags & IORING_SETUP_CQSIZE) && config.cq_entries > 0) return config.cq_entries;
+    return config.queue_depth * 2;
+}
+
+static size_t ring_overhead_for(unsigned flags) {
+    // SQ/CQ ring mapping + SQE array, from the shared ring model
+    rm_ring_config_t cfg = {
+        .sq_entries = (uint32_t)config.queue_depth,
+        .cq_entries = (uint32_t)cq_entries_for(flags),
+        .sqe128 = !!(flags & IORING_SETUP_SQE128),
+        .cqe32 = !!(flags & IORING_SETUP_CQE32),
+    };
+    rm_ring_memory_t m;
+    rm_calc(rm_params(), &cfg, &m);
+    return (size_t)m.ring_bytes;
+}
+
 static const char *tier_memlock(size_t bytes) {
     static char buf[32];
     const size_t M = 1024ULL * 1024ULL;
@@ -239,6 +615,305 @@ static void get_proc_stats(ProcStats *st) {
     }
 }
 
+static long read_meminfo_kb(const char *key) {
+    FILE *f = fopen("/proc/meminfo", "r");
+    if (!f) return -1;
+    char line[256];
+    const size_t klen = strlen(key);
+    long val = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, key, klen) == 0 && line[klen] == ':') {
+            sscanf(line + klen + 1, "%ld", &val);
+            break;
+        }
+    }
+    fclose(f);
+    return val;
+}
+
+// Threads of this process; io-wq workers show up as "iou-wrk-<tid>" tasks.
+static void count_threads(int *total, int *iowq) {
+    *total = 0;
+    *iowq = 0;
+    DIR *d = opendir("/proc/self/task");
+    if (!d) return;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.') continue;
+        (*total)++;
+        char path[64], comm[32] = "";
+        snprintf(path, sizeof(path), "/proc/self/task/%.20s/comm", de->d_name);
+        FILE *f = fopen(path, "r");
+        if (!f) continue;
+        if (fgets(comm, sizeof(comm), f)) {
+            if (strncmp(comm, "iou-wrk", 7) == 0) (*iowq)++;
+            else if (strncmp(comm, "aff-verify", 10) == 0) (*total)--;   // our -V sampler
+        }
+        fclose(f);
+    }
+    closedir(d);
+}
+
+static void read_vmstat(long v[VS_NUM]) {
+    for (int i = 0; i < VS_NUM; i++) v[i] = 0;
+    FILE *f = fopen("/proc/vmstat", "r");
+    if (!f) return;
+    char name[64];
+    long val;
+    while (fscanf(f, "%63s %ld", name, &val) == 2) {
+        for (int i = 0; i < VS_NUM; i++) {
+            if (strcmp(name, vmstat_names[i]) == 0) v[i] = val;
+        }
+    }
+    fclose(f);
+}
+
+// Free memory held in buddy blocks of at least `min_order` pages, all zones (/proc/buddyinfo).
+static long free_kb_at_order(int min_order) {
+    FILE *f = fopen("/proc/buddyinfo", "r");
+    if (!f) return -1;
+    const long page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    char line[512];
+    long kb = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char *p = strstr(line, "zone");
+        if (!p) continue;
+        p += 4;
+        while (*p == ' ') p++;
+        while (*p && *p != ' ') p++;   // zone name
+        char *end;
+        for (int order = 0; ; order++) {
+            long n = strtol(p, &end, 10);
+            if (end == p) break;
+            if (order >= min_order) kb += n * (page_kb << order);
+            p = end;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+// ------------- memory hog -------------
+// Child process that faults in `bytes` as small pages and frees all but one page in every `stride`,
+// so the buddy allocator is left with scattered order-0 holes. Returns once the child has done so;
+// the child then sleeps until killed and volunteers as the first OOM victim.
+static pid_t start_memory_hog(size_t bytes, int stride) {
+    int pfd[2];
+    if (pipe(pfd) != 0) return -1;
+    pid_t pid = fork();
+    if (pid < 0) { close(pfd[0]); close(pfd[1]); return -1; }
+    if (pid == 0) {
+        close(pfd[0]);
+        prctl(PR_SET_PDEATHSIG, SIGKILL);   // never outlive the simulator
+        FILE *oom = fopen("/proc/self/oom_score_adj", "w");
+        if (oom) { fputs("1000", oom); fclose(oom); }
+
+        const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        char *p = mmap(NULL, bytes, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+        char ok = 1;
+        if (p == MAP_FAILED) {
+            ok = 0;
+        } else {
+            madvise(p, bytes, MADV_NOHUGEPAGE);   // 2 MiB pages would free whole blocks back
+            for (size_t off = 0; off < bytes; off += page) p[off] = 1;
+            size_t i = 0;
+            for (size_t off = 0; off < bytes; off += page, i++) {
+                if (i % (size_t)stride) madvise(p + off, page, MADV_DONTNEED);
+            }
+        }
+        (void)write(pfd[1], &ok, 1);
+        close(pfd[1]);
+        for (;;) pause();
+    }
+    close(pfd[1]);
+    char ok = 0;
+    ssize_t r = read(pfd[0], &ok, 1);
+    close(pfd[0]);
+    if (r != 1 || !ok) {
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        return -1;
+    }
+    return pid;
+}
+
+static void stop_memory_hog(pid_t pid) {
+    if (pid <= 0) return;
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+}
+
+// ------------- io-wq affinity verifier -------------
+// One pass over /proc/<pid>/task: field 39 of stat is the CPU the task last ran on.
+static void aff_sample_once(AffVerifier *v) {
+    char dir[64];
+    snprintf(dir, sizeof(dir), "/proc/%d/task", (int)getpid());
+    DIR *d = opendir(dir);
+    if (!d) return;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.') continue;
+        char path[96], line[512];
+        snprintf(path, sizeof(path), "%s/%.20s/stat", dir, de->d_name);
+        FILE *f = fopen(path, "r");
+        if (!f) continue;   // worker exited between readdir and open
+        char *ok = fgets(line, sizeof(line), f);
+        fclose(f);
+        if (!ok) continue;
+
+        // "tid (comm) state ..." -- comm may contain spaces, so split at the last ')'
+        char *lp = strchr(line, '('), *rp = strrchr(line, ')');
+        if (!lp || !rp || rp < lp) continue;
+        const size_t clen = (size_t)(rp - lp - 1);
+        if (clen < 7 || (strncmp(lp + 1, "iou-wrk", 7) != 0 && strncmp(lp + 1, "iou-sqp", 7) != 0)) continue;
+
+        int field = 3, cpu = -1;
+        char *save = NULL;
+        for (char *tok = strtok_r(rp + 2, " ", &save); tok; tok = strtok_r(NULL, " ", &save), field++) {
+            if (field == 39) { cpu = atoi(tok); break; }
+        }
+        if (cpu < 0 || cpu >= CPU_SETSIZE) continue;
+
+        CPU_SET(cpu, &v->seen);
+        if (CPU_ISSET(cpu, &config.verify_set)) continue;
+        v->violations++;
+        if (!v->first[0])
+            snprintf(v->first, sizeof(v->first), "%.*s (tid %.20s) on CPU %d", (int)(clen < 32 ? clen : 32),
+                     lp + 1, de->d_name, cpu);
+    }
+    closedir(d);
+    v->samples++;
+}
+
+static void *aff_sampler_main(void *arg) {
+    AffVerifier *v = arg;
+    while (!v->stop) {
+        aff_sample_once(v);
+        usleep(1000);
+    }
+    aff_sample_once(v);
+    return NULL;
+}
+
+static int aff_verifier_start(AffVerifier *v) {
+    memset(v, 0, sizeof(*v));
+    CPU_ZERO(&v->seen);
+    if (pthread_create(&v->thread, NULL, aff_sampler_main, v) != 0) return -1;
+    pthread_setname_np(v->thread, "aff-verify");
+    return 0;
+}
+
+static void aff_verifier_stop(AffVerifier *v) {
+    v->stop = 1;
+    pthread_join(v->thread, NULL);
+}
+
+// ------------- perf counters -------------
+static int perf_open_one(uint32_t type, uint64_t cfg, int group_fd, int user_only) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = cfg;
+    attr.disabled = (group_fd == -1);
+    attr.exclude_hv = 1;
+    attr.exclude_kernel = user_only ? 1 : 0;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // pid=0, cpu=-1: the calling thread on any CPU
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+static int perf_group_open(PerfGroup *g) {
+    static const struct { uint32_t type; uint64_t config; } ev[PC_NUM] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+                             (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    };
+
+    memset(g, 0, sizeof(*g));
+    g->leader = -1;
+    for (int i = 0; i < PC_NUM; i++) { g->fds[i] = -1; g->slot_pos[i] = -1; }
+
+    for (int i = 0; i < PC_NUM; i++) {
+        int fd = perf_open_one(ev[i].type, ev[i].config, g->leader, g->user_only);
+        if (fd < 0 && g->leader < 0 && (errno == EACCES || errno == EPERM) && !g->user_only) {
+            // perf_event_paranoid >= 2: count user space only rather than nothing
+            g->user_only = 1;
+            fd = perf_open_one(ev[i].type, ev[i].config, g->leader, g->user_only);
+        }
+        if (fd < 0 && i == PC_CYCLES) {
+            // no hardware PMU (VM without vPMU): keep a time base in the cycles slot
+            fd = perf_open_one(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, g->leader, g->user_only);
+            if (fd >= 0) g->sw_fallback = 1;
+        }
+        if (fd < 0) continue;
+        if (g->leader < 0) g->leader = fd;
+        g->fds[i] = fd;
+        g->slot_pos[i] = g->nr++;
+    }
+    return (g->leader >= 0) ? 0 : -1;
+}
+
+static void perf_group_start(PerfGroup *g) {
+    if (g->leader < 0) return;
+    ioctl(g->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(g->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+static void perf_group_stop(PerfGroup *g, PerfSample *out) {
+    memset(out, 0, sizeof(*out));
+    if (g->leader < 0) return;
+    ioctl(g->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // PERF_FORMAT_GROUP layout: nr, time_enabled, time_running, value[nr]
+    uint64_t buf[3 + PC_NUM];
+    ssize_t r = read(g->leader, buf, sizeof(buf));
+    if (r < (ssize_t)(3 * sizeof(uint64_t)) || buf[0] != (uint64_t)g->nr) return;
+
+    // scale for multiplexing when the group did not get the PMU the whole time
+    const double scale = (buf[2] > 0 && buf[2] < buf[1]) ? (double)buf[1] / (double)buf[2] : 1.0;
+    for (int i = 0; i < PC_NUM; i++) {
+        if (g->slot_pos[i] < 0) continue;
+        out->v[i] = (uint64_t)(buf[3 + g->slot_pos[i]] * scale);
+        out->mask |= 1u << i;
+    }
+}
+
+static void perf_group_close(PerfGroup *g) {
+    for (int i = 0; i < PC_NUM; i++) {
+        if (g->fds[i] >= 0) close(g->fds[i]);
+        g->fds[i] = -1;
+    }
+    g->leader = -1;
+}
+
+static void perf_sample_add(PerfSample *acc, const PerfSample *s) {
+    for (int i = 0; i < PC_NUM; i++) acc->v[i] += s->v[i];
+    acc->mask |= s->mask;
+}
+
+static void format_perf_sample(char *buf, size_t len, const PerfSample *s, int sw_fallback, long ops) {
+    char cell[PC_NUM][24];
+    for (int i = 0; i < PC_NUM; i++) {
+        if (s->mask & (1u << i)) snprintf(cell[i], sizeof(cell[i]), "%llu", (unsigned long long)s->v[i]);
+        else snprintf(cell[i], sizeof(cell[i]), "-");
+    }
+    char ipc[16] = "-", per_op[24] = "";
+    if (!sw_fallback && (s->mask & (1u << PC_CYCLES)) && (s->mask & (1u << PC_INSTR)) && s->v[PC_CYCLES] > 0) {
+        snprintf(ipc, sizeof(ipc), "%.2f", (double)s->v[PC_INSTR] / (double)s->v[PC_CYCLES]);
+    }
+    if (ops > 0 && (s->mask & (1u << PC_CYCLES))) {
+        snprintf(per_op, sizeof(per_op), " %s/op=%.1f", sw_fallback ? "ns" : "cyc", (double)s->v[PC_CYCLES] / ops);
+    }
+    snprintf(buf, len, "%s=%s ins=%s ipc=%s dtlb=%s pf=%s cs=%s%s",
+             sw_fallback ? "task-clock-ns" : "cycles",
+             cell[PC_CYCLES], cell[PC_INSTR], ipc, cell[PC_DTLB], cell[PC_FAULTS], cell[PC_CSW], per_op);
+}
+
 // ------------- centralized cleanup (prevents double free) -------------
 static void destroy_instance(BigUringInstance *inst) {
     if (!inst) return;
@@ -312,37 +987,17 @@ static void destroy_instance(BigUringInstance *inst) {
     }
 }
 
-// ------------- create ring instance -------------
-static int create_big_instance(BigUringInstance *inst, int ring_id) {
-    memset(inst, 0, sizeof(*inst));
-    inst->ring_id = ring_id;
-    inst->ring_fd = -1;
-    inst->num_buffers = config.num_buffers;
-
-    struct io_uring_params params = {0};
-    int ret = io_uring_queue_init_params(config.queue_depth, &inst->ring, &params);
-    if (ret < 0) {
-        inst->creation_failed = 1;
-        inst->failure_errno = -ret;
-        snprintf(inst->failure_reason, sizeof(inst->failure_reason),
-                 "io_uring_queue_init failed: %s", strerror(-ret));
-        goto fail;
-    }
-    inst->ring_fd = inst->ring.ring_fd;
-
-    inst->ring_mem =
-        (config.queue_depth * 4) +
-        (config.queue_depth * 2 * 16) +
-        (config.queue_depth * 64) +
-        (4096 * 3);
-
+// ------------- buffer registration -------------
+// Allocates this ring's own pool (pooled or mmap-per-buffer), optionally mlocks it and registers it.
+static int setup_private_buffers(BigUringInstance *inst) {
+    int ret;
     inst->iovecs = calloc((size_t)config.num_buffers, sizeof(struct iovec));
     if (!inst->iovecs) {
         inst->creation_failed = 1;
         inst->failure_errno = errno;
         snprintf(inst->failure_reason, sizeof(inst->failure_reason),
                  "calloc iovecs failed: %s", strerror(errno));
-        goto fail;
+        return -1;
     }
 
     const size_t page = 4096;
@@ -356,7 +1011,7 @@ static int create_big_instance(BigUringInstance *inst, int ring_id) {
             inst->failure_errno = errno;
             snprintf(inst->failure_reason, sizeof(inst->failure_reason),
                      "calloc guard arrays failed: %s", strerror(errno));
-            goto fail;
+            return -1;
         }
     }
 
@@ -372,7 +1027,7 @@ static int create_big_instance(BigUringInstance *inst, int ring_id) {
             inst->failure_errno = errno;
             snprintf(inst->failure_reason, sizeof(inst->failure_reason),
                      "posix_memalign failed for %zu bytes", inst->buffer_pool_size);
-            goto fail;
+            return -1;
         }
         memset(inst->buffer_pool, 0xAA, inst->buffer_pool_size);
 
@@ -382,7 +1037,7 @@ static int create_big_instance(BigUringInstance *inst, int ring_id) {
                 inst->failure_errno = errno;
                 snprintf(inst->failure_reason, sizeof(inst->failure_reason),
                          "mlock(pool %zu) failed: %s", inst->buffer_pool_size, strerror(errno));
-                goto fail;
+                return -1;
             }
             inst->buffers_locked = 1;
         }
@@ -402,7 +1057,7 @@ static int create_big_instance(BigUringInstance *inst, int ring_id) {
             inst->failure_errno = errno;
             snprintf(inst->failure_reason, sizeof(inst->failure_reason),
                      "calloc buffer arrays failed: %s", strerror(errno));
-            goto fail;
+            return -1;
         }
 
         for (int i = 0; i < config.num_buffers; i++) {
@@ -412,7 +1067,7 @@ static int create_big_instance(BigUringInstance *inst, int ring_id) {
                 inst->failure_errno = errno;
                 snprintf(inst->failure_reason, sizeof(inst->failure_reason),
                          "mmap buffer %d (%zu) failed: %s", i, buf_len, strerror(errno));
-                goto fail;
+                return -1;
             }
             memset(b, 0xAA, buf_len);
 
@@ -423,7 +1078,7 @@ static int create_big_instance(BigUringInstance *inst, int ring_id) {
                     inst->failure_errno = errno;
                     snprintf(inst->failure_reason, sizeof(inst->failure_reason),
                              "mlock buffer %d (%zu) failed: %s", i, buf_len, strerror(errno));
-                    goto fail;
+                    return -1;
                 }
                 inst->buffers_locked = 1;
             }
@@ -448,15 +1103,194 @@ static int create_big_instance(BigUringInstance *inst, int ring_id) {
     }
 
     // register buffers (can fail due to MEMLOCK/pin accounting)
+    const double t0 = now_usec();
     ret = io_uring_register_buffers(&inst->ring, inst->iovecs, config.num_buffers);
+    inst->register_usec = now_usec() - t0;
     if (ret < 0) {
         inst->creation_failed = 1;
         inst->failure_errno = -ret;
         snprintf(inst->failure_reason, sizeof(inst->failure_reason),
                  "io_uring_register_buffers failed: %s", strerror(-ret));
-        goto fail;
+        return -1;
+    }
+    inst->buffers_registered = 1;
+    inst->bufs_populated = config.num_buffers;
+    inst->buf_share = BUF_PRIVATE;
+    return 0;
+}
+
+// Faults, locks and registers the next `count` buffers of a sparse table (-R sparse).
+static int populate_buffers(BigUringInstance *inst, int count) {
+    const int off = inst->bufs_populated;
+    int n = inst->num_buffers - off;
+    if (n > count) n = count;
+    if (n > MAX_REG_CHUNK) n = MAX_REG_CHUNK;
+    if (n <= 0) return 0;
+
+    const size_t buf_len = inst->iovecs[0].iov_len;
+    char *base = inst->iovecs[off].iov_base;
+    memset(base, 0xAA, (size_t)n * buf_len);
+    if (config.lock_memory) {
+        if (mlock(base, (size_t)n * buf_len) < 0) {
+            inst->creation_failed = 1;
+            inst->failure_errno = errno;
+            snprintf(inst->failure_reason, sizeof(inst->failure_reason),
+                     "mlock(buffers %d+%d) failed: %s", off, n, strerror(errno));
+            return -1;
+        }
+        inst->buffers_locked = 1;
+    }
+
+    // nonzero tags: the kernel posts a CQE when a slot is released (replaced or unregistered)
+    uint64_t tags[MAX_REG_CHUNK];
+    for (int i = 0; i < n; i++) tags[i] = (uint64_t)(off + i + 1);
+
+    const double t0 = now_usec();
+    int ret = io_uring_register_buffers_update_tag(&inst->ring, (unsigned)off, &inst->iovecs[off],
+                                                   (const __u64 *)tags, (unsigned)n);
+    inst->register_usec += now_usec() - t0;
+    if (ret < 0) {
+        inst->creation_failed = 1;
+        inst->failure_errno = -ret;
+        snprintf(inst->failure_reason, sizeof(inst->failure_reason),
+                 "io_uring_register_buffers_update_tag(%d+%d) failed: %s", off, n, strerror(-ret));
+        return -1;
+    }
+    inst->bufs_populated += ret;
+    inst->reg_updates++;
+    return 0;
+}
+
+// -R sparse: registers an empty table sized for the pool and fills only the first chunk;
+// the pool stays untouched virtual memory until populate_buffers() reaches it.
+static int setup_sparse_buffers(BigUringInstance *inst) {
+    const size_t buf_len = round_up(config.buffer_size, 4096);
+    inst->iovecs = calloc((size_t)config.num_buffers, sizeof(struct iovec));
+    inst->buffer_pool_size = (size_t)config.num_buffers * buf_len;
+    void *p = NULL;
+    if (!inst->iovecs || posix_memalign(&p, 4096, inst->buffer_pool_size) != 0) {
+        inst->creation_failed = 1;
+        inst->failure_errno = ENOMEM;
+        snprintf(inst->failure_reason, sizeof(inst->failure_reason),
+                 "sparse pool allocation failed for %zu bytes", inst->buffer_pool_size);
+        return -1;
+    }
+    inst->buffer_pool = p;
+    for (int i = 0; i < config.num_buffers; i++) {
+        inst->iovecs[i].iov_base = (char*)inst->buffer_pool + ((size_t)i * buf_len);
+        inst->iovecs[i].iov_len  = buf_len;
+    }
+    inst->buffer_mem = inst->buffer_pool_size;
+
+    const double t0 = now_usec();
+    int ret = io_uring_register_buffers_sparse(&inst->ring, (unsigned)config.num_buffers);
+    inst->register_usec = now_usec() - t0;
+    if (ret < 0) {
+        inst->creation_failed = 1;
+        inst->failure_errno = -ret;
+        snprintf(inst->failure_reason, sizeof(inst->failure_reason),
+                 "io_uring_register_buffers_sparse failed: %s", strerror(-ret));
+        return -1;
+    }
+    inst->buffers_registered = 1;
+    inst->buf_share = BUF_PRIVATE;
+    return populate_buffers(inst, config.reg_chunk);
+}
+
+// Gives `inst` the buffer table of `owner` without allocating a new pool (-B clone / same-pages).
+static int share_buffers(BigUringInstance *inst, BigUringInstance *owner) {
+    int ret;
+    const double t0 = now_usec();
+#ifdef HAVE_CLONE_BUFFERS
+    if (config.buf_share == BUF_CLONE) {
+        ret = io_uring_clone_buffers(&inst->ring, &owner->ring);
+        inst->register_usec = now_usec() - t0;
+        if (ret == 0) {
+            inst->buffers_registered = 1;
+            inst->bufs_populated = owner->bufs_populated;
+            inst->buf_share = BUF_CLONE;
+            return 0;
+        }
+        inst->clone_errno = -ret;   // pre-6.12 kernels reject the opcode with EINVAL
+    }
+#else
+    if (config.buf_share == BUF_CLONE) inst->clone_errno = ENOSYS;
+#endif
+    ret = io_uring_register_buffers(&inst->ring, owner->iovecs, owner->num_buffers);
+    inst->register_usec = now_usec() - t0;
+    if (ret < 0) {
+        inst->creation_failed = 1;
+        inst->failure_errno = -ret;
+        snprintf(inst->failure_reason, sizeof(inst->failure_reason),
+                 "io_uring_register_buffers(shared) failed: %s", strerror(-ret));
+        return -1;
     }
     inst->buffers_registered = 1;
+    inst->bufs_populated = owner->num_buffers;
+    inst->buf_share = BUF_SAME_PAGES;
+    return 0;
+}
+
+// ------------- create ring instance -------------
+// `first`: first ring of the service, NULL when creating it. Later rings share its buffer
+// table with -B and attach to its io-wq with -A.
+static int create_big_instance(BigUringInstance *inst, int ring_id, unsigned flags, BigUringInstance *first) {
+    memset(inst, 0, sizeof(*inst));
+    inst->ring_id = ring_id;
+    inst->ring_fd = -1;
+    inst->num_buffers = config.num_buffers;
+    inst->setup_flags = flags;
+
+    const double t0 = now_usec();
+    struct io_uring_params params = {0};
+    params.flags = flags;
+    if (flags & IORING_SETUP_CQSIZE) params.cq_entries = (unsigned)cq_entries_for(flags);
+    if (config.iowq_attach && first) {
+        params.flags |= IORING_SETUP_ATTACH_WQ;
+        params.wq_fd = (unsigned)first->ring_fd;
+    }
+    int ret = io_uring_queue_init_params(config.queue_depth, &inst->ring, &params);
+    if (ret < 0) {
+        inst->creation_failed = 1;
+        inst->failure_errno = -ret;
+        snprintf(inst->failure_reason, sizeof(inst->failure_reason),
+                 "io_uring_queue_init(%s%s) failed: %s", format_setup_flags(flags),
+                 (params.flags & IORING_SETUP_ATTACH_WQ) ? "+attach_wq" : "", strerror(-ret));
+        goto fail;
+    }
+    inst->ring_fd = inst->ring.ring_fd;
+    inst->wq_attached = !!(params.flags & IORING_SETUP_ATTACH_WQ);
+
+    // caps the calling task's io-wq; not fatal, pre-5.15 kernels return EINVAL
+    if (config.iowq_limit) {
+        unsigned vals[2] = { config.iowq_max[0], config.iowq_max[1] };
+        ret = io_uring_register_iowq_max_workers(&inst->ring, vals);
+        if (ret < 0) inst->iowq_limit_errno = -ret;
+    }
+    if (config.iowq_aff) {
+        ret = io_uring_register_iowq_aff(&inst->ring, sizeof(config.iowq_aff_set), &config.iowq_aff_set);
+        if (ret < 0) inst->iowq_aff_errno = -ret;
+    }
+
+    inst->ring_mem = ring_overhead_for(flags);
+    {
+        // with FEAT_SINGLE_MMAP the SQ and CQ rings share one mapping and liburing reports it twice;
+        // page-align each mapping so the figure is comparable with the model
+        const rm_params_t *rp = rm_params();
+        const size_t sqe_sz = (flags & IORING_SETUP_SQE128) ? RM_SQE128_SIZE : RM_SQE_SIZE;
+        const size_t rings = (params.features & IORING_FEAT_SINGLE_MMAP)
+            ? rm_page_align(rp, inst->ring.sq.ring_sz > inst->ring.cq.ring_sz ? inst->ring.sq.ring_sz : inst->ring.cq.ring_sz)
+            : rm_page_align(rp, inst->ring.sq.ring_sz) + rm_page_align(rp, inst->ring.cq.ring_sz);
+        inst->ring_mem_actual = rings + rm_page_align(rp, (size_t)params.sq_entries * sqe_sz);
+    }
+
+    // register buffers (can fail due to MEMLOCK/pin accounting)
+    const int share = first && config.buf_share != BUF_PRIVATE;
+    if (share) ret = share_buffers(inst, first);
+    else if (config.reg_mode == REG_SPARSE) ret = setup_sparse_buffers(inst);
+    else ret = setup_private_buffers(inst);
+    if (ret != 0) goto fail;
+    inst->setup_usec = now_usec() - t0;
 
     // optional fixed FDs
     if (config.num_registered_fds > 0) {
@@ -481,25 +1315,35 @@ fail:
 }
 
 // ------------- recommendations -------------
+// Pinned bytes (VmPin, and the RLIMIT_MEMLOCK charge) for one service running `rings` rings.
+// Only clone shares the pin; io_buffer_account_pin() de-duplicates pages within one ring, so
+// same-pages pins and charges the pool again for every ring even though RSS holds it once.
+static size_t pinned_for_rings(int rings) {
+    const size_t pool = (size_t)config.num_buffers * round_up(config.buffer_size, 4096);
+    const size_t ring = ring_overhead_for(config.setup_flags);
+    if (rings <= 0) return 0;
+    if (config.buf_share == BUF_CLONE)
+        return pool + (size_t)rings * ring;
+    return (size_t)rings * (pool + ring);
+}
+
 static void print_recommendations_tables(void) {
     const int rings_base = compute_rings_per_service();
-    const size_t page = 4096;
-    const size_t buf_len = round_up(config.buffer_size, page);
-
-    const size_t pinned_per_ring_buffers = (size_t)config.num_buffers * buf_len;
-    const size_t ring_overhead =
-        (config.queue_depth * 4) +
-        (config.queue_depth * 2 * 16) +
-        (config.queue_depth * 64) +
-        (4096 * 3);
-    const size_t pinned_per_ring_total = pinned_per_ring_buffers + ring_overhead;
 
     // VMA estimate is only a planning number; kernel may merge VMAs.
-    const int vmas_per_ring_est =
-        4 + (config.vma_per_buffer ? config.num_buffers : 1) + (config.guard_pages ? config.num_buffers : 0);
+    // Ring mappings are per ring; the buffer pool's VMAs exist once per service with -B.
+    const int vmas_per_ring_est = 4;
+    const int vmas_per_pool_est =
+        (config.vma_per_buffer ? config.num_buffers : 1) + (config.guard_pages ? config.num_buffers : 0);
     const long base_vmas = 65536;
+#define NEED_VMAS(r) (base_vmas + (long)(r) * vmas_per_ring_est + \
+                      (long)(config.buf_share == BUF_PRIVATE ? (r) : 1) * vmas_per_pool_est)
 
     printf("\nRECOMMENDATIONS (TABULATED)\n");
+    if (config.buf_share == BUF_CLONE)
+        printf("buffer sharing: clone -- pool pinned and charged once per service (needs kernel >= 6.12)\n");
+    else if (config.buf_share == BUF_SAME_PAGES)
+        printf("buffer sharing: same-pages -- pool resident once per service, pinned and charged per ring\n");
 
     // A) scaling rings/service
     printf("\nA) Scale rings per service (services fixed at %d)\n", config.num_services);
@@ -510,11 +1354,11 @@ static void print_recommendations_tables(void) {
     const int ring_targets[] = {1, 2, 4, 8, 16, 32};
     for (int i = 0; i < (int)(sizeof(ring_targets)/sizeof(ring_targets[0])); i++) {
         const int r = ring_targets[i];
-        const size_t pinned_service = (size_t)r * pinned_per_ring_total;
+        const size_t pinned_service = pinned_for_rings(r);
         const size_t pinned_service_margin = (size_t)(pinned_service * config.safety_factor);
         const size_t pinned_host = (size_t)config.num_services * pinned_service;
 
-        const long need_vmas = base_vmas + (long)r * (long)vmas_per_ring_est;
+        const long need_vmas = NEED_VMAS(r);
         const long rec_map = tier_mapcount((long)(need_vmas * 1.25));
 
         printf("│ %12d  │ %12.1f MiB │ %11.2f GiB │ %-15s │ %16ld │\n",
@@ -532,9 +1376,9 @@ static void print_recommendations_tables(void) {
     printf("│ Services  │ Host pinned    │ LimitMEMLOCK     │ vm.max_map_count │\n");
     printf("├───────────┼───────────────┼─────────────────┼──────────────────┤\n");
 
-    const size_t pinned_service = (size_t)rings_base * pinned_per_ring_total;
+    const size_t pinned_service = pinned_for_rings(rings_base);
     const size_t pinned_service_margin = (size_t)(pinned_service * config.safety_factor);
-    const long need_vmas = base_vmas + (long)rings_base * (long)vmas_per_ring_est;
+    const long need_vmas = NEED_VMAS(rings_base);
     const long rec_map = tier_mapcount((long)(need_vmas * 1.25));
 
     const int svc_targets[] = {1, 2, 4, 6, 8, 12, 16, 24};
@@ -549,6 +1393,307 @@ static void print_recommendations_tables(void) {
                rec_map);
     }
     printf("└───────────┴───────────────┴─────────────────┴──────────────────┘\n");
+#undef NEED_VMAS
+}
+
+// ------------- NOP workload -------------
+// Submits `ops` NOPs in SQ-sized batches and reaps them; returns completed ops or -errno.
+static long run_nop_workload(BigUringInstance *inst, long ops) {
+    struct io_uring *ring = &inst->ring;
+    const unsigned batch = ring->sq.ring_entries;
+    long done = 0;
+
+    while (done < ops) {
+        unsigned n = 0;
+        while (n < batch && done + n < ops) {
+            struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+            if (!sqe) break;
+            io_uring_prep_nop(sqe);
+            n++;
+        }
+        int ret = io_uring_submit_and_wait(ring, n);
+        if (ret < 0) return ret;
+
+        unsigned head, seen = 0;
+        struct io_uring_cqe *cqe;
+        io_uring_for_each_cqe(ring, head, cqe) seen++;
+        io_uring_cq_advance(ring, seen);
+        done += seen;
+    }
+    return done;
+}
+
+// ------------- fixed-buffer reads (-R) -------------
+// READ_FIXED from /dev/zero into every buffer once. A sparse table is filled -r buffers at a time
+// as the reads reach its end. The first read goes alone so its completion time is exact.
+// Times are measured from `t_base` (end of ring setup). Returns 0 or -errno.
+static int run_fixed_reads(BigUringInstance *inst, int zero_fd, double t_base,
+                           double *first_usec, double *all_usec) {
+    struct io_uring *ring = &inst->ring;
+    const unsigned len = (unsigned)inst->iovecs[0].iov_len;
+    int next = 0;
+    *first_usec = -1;
+
+    while (next < inst->num_buffers) {
+        if (next >= inst->bufs_populated && populate_buffers(inst, config.reg_chunk) != 0)
+            return -inst->failure_errno;
+        const int end = inst->bufs_populated;
+        if (next >= end) return -EINVAL;
+
+        while (next < end) {
+            const unsigned batch = (*first_usec < 0) ? 1 : ring->sq.ring_entries;
+            unsigned n = 0;
+            while (next < end && n < batch) {
+                struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+                if (!sqe) break;
+                io_uring_prep_read_fixed(sqe, zero_fd, inst->iovecs[next].iov_base, len, 0, next);
+                next++;
+                n++;
+            }
+            int ret = io_uring_submit_and_wait(ring, n);
+            if (ret < 0) return ret;
+            for (unsigned i = 0; i < n; i++) {
+                struct io_uring_cqe *cqe;
+                ret = io_uring_wait_cqe(ring, &cqe);
+                if (ret < 0) return ret;
+                const int res = cqe->res;
+                io_uring_cqe_seen(ring, cqe);
+                if (res < 0) return res;
+                if (*first_usec < 0) *first_usec = now_usec() - t_base;
+            }
+        }
+    }
+    *all_usec = now_usec() - t_base;
+    return 0;
+}
+
+// ------------- io-wq workload -------------
+static void sample_wq(WqStats *st, long kstack0) {
+    int threads, workers;
+    count_threads(&threads, &workers);
+    if (threads > st->threads_peak) st->threads_peak = threads;
+    if (workers > st->workers_peak) st->workers_peak = workers;
+    const long kstack = read_meminfo_kb("KernelStack");
+    if (kstack0 >= 0 && kstack - kstack0 > st->kstack_kb) st->kstack_kb = kstack - kstack0;
+}
+
+// Buffered writes punted to io-wq with IOSQE_ASYNC, round-robin over -y unlinked log files.
+// Every ring gets a full SQ before any ring is reaped, so the rings' work overlaps.
+// io-wq hashes writes by inode: at most one worker per file is busy at a time.
+static void run_blocking_writes(BigUringInstance *arr, int rings, WqStats *st) {
+    // static: writes still queued after an error keep a valid source until the rings exit
+    static char buf[WQ_WRITE_BYTES] __attribute__((aligned(4096)));
+    memset(st, 0, sizeof(*st));
+    memset(buf, 0x55, sizeof(buf));
+
+    const int nfiles = config.wq_files;
+    int *fds = calloc((size_t)nfiles, sizeof(int));
+    long *left = calloc((size_t)rings, sizeof(long));
+    unsigned *pending = calloc((size_t)rings, sizeof(unsigned));
+    if (fds) {
+        for (int f = 0; f < nfiles; f++) fds[f] = -1;
+    }
+    if (!fds || !left || !pending) {
+        st->err = ENOMEM;
+        goto out;
+    }
+
+    const char *dir = getenv("TMPDIR");
+    if (!dir || !*dir) dir = "/tmp";
+    for (int f = 0; f < nfiles; f++) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/uring_mem_sim.XXXXXX", dir);
+        fds[f] = mkstemp(path);
+        if (fds[f] < 0) { st->err = errno; goto out; }
+        unlink(path);
+    }
+
+    for (int i = 0; i < rings; i++) {
+        if (arr[i].ring_fd >= 0 && !arr[i].creation_failed) left[i] = config.wq_ops;
+    }
+
+    const long kstack0 = read_meminfo_kb("KernelStack");
+    unsigned long seq = 0;
+    const double t0 = now_usec();
+
+    for (;;) {
+        int busy = 0;
+        for (int i = 0; i < rings; i++) {
+            if (left[i] <= 0) continue;
+            struct io_uring *ring = &arr[i].ring;
+            unsigned n = 0;
+            while (n < ring->sq.ring_entries && (long)n < left[i]) {
+                struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+                if (!sqe) break;
+                const int f = (int)(seq % (unsigned long)nfiles);
+                const off_t off = (off_t)((seq / (unsigned long)nfiles) % WQ_FILE_BLOCKS) * WQ_WRITE_BYTES;
+                io_uring_prep_write(sqe, fds[f], buf, WQ_WRITE_BYTES, (uint64_t)off);
+                io_uring_sqe_set_flags(sqe, IOSQE_ASYNC);
+                seq++;
+                n++;
+            }
+            int ret = io_uring_submit(ring);
+            if (ret < 0) {
+                if (!st->err) st->err = -ret;
+                left[i] = 0;
+                continue;
+            }
+            pending[i] = (unsigned)ret;
+            busy = 1;
+        }
+        if (!busy) break;
+        sample_wq(st, kstack0);
+
+        for (int i = 0; i < rings; i++) {
+            while (pending[i] > 0) {
+                struct io_uring_cqe *cqe;
+                int ret = io_uring_wait_cqe(&arr[i].ring, &cqe);
+                if (ret < 0) { st->err = -ret; goto done; }
+                if (cqe->res >= 0) st->ops++;
+                else if (!st->err) st->err = -cqe->res;
+                io_uring_cqe_seen(&arr[i].ring, cqe);
+                pending[i]--;
+                left[i]--;
+            }
+        }
+        // idle workers linger for a few seconds, so this still sees the ones just used
+        sample_wq(st, kstack0);
+        if (st->err) break;
+    }
+done:
+    st->usec = now_usec() - t0;
+out:
+    if (fds) {
+        for (int f = 0; f < nfiles; f++) if (fds[f] >= 0) close(fds[f]);
+    }
+    free(fds);
+    free(left);
+    free(pending);
+}
+
+// ------------- setup-flag matrix -------------
+static int flag_combo_valid(unsigned flags) {
+    if ((flags & IORING_SETUP_DEFER_TASKRUN) && !(flags & IORING_SETUP_SINGLE_ISSUER)) return 0;
+    return 1;
+}
+
+static void run_flag_matrix(void) {
+    const int rings = compute_rings_per_service();
+    BigUringInstance *arr = calloc((size_t)rings, sizeof(BigUringInstance));
+    if (!arr) { perror("calloc"); return; }
+
+    PerfGroup pg = { .leader = -1 };
+    if (config.perf_counters && perf_group_open(&pg) != 0) {
+        fprintf(stderr, "perf_event_open failed: %s (counters disabled)\n", strerror(errno));
+    }
+
+    printf("\n=== SETUP FLAG MATRIX (rings/cell=%d, depth=%d, cq=%d when cqsize, NOPs/ring=%d) ===\n",
+           rings, config.queue_depth, cq_entries_for(IORING_SETUP_CQSIZE), config.nop_ops);
+    printf("%-52s %7s %6s %10s %10s %10s %10s %11s %10s\n",
+           "flags", "created", "failed", "estKiB/rg", "actKiB/rg", "dVmPinMiB", "dVmLckMiB", "setup_us/rg", "NOP Mops/s");
+    printf("%-52s %7s %6s %10s %10s %10s %10s %11s %10s\n",
+           "-----", "-------", "------", "---------", "---------", "---------", "---------", "-----------", "----------");
+
+    for (unsigned combo = 0; combo < (1u << NUM_MATRIX_FLAGS); combo++) {
+        unsigned flags = 0;
+        for (int b = 0; b < NUM_MATRIX_FLAGS; b++) {
+            if (combo & (1u << b)) flags |= setup_flag_names[b].flag;
+        }
+        if (!flag_combo_valid(flags)) continue;
+
+        memset(arr, 0, (size_t)rings * sizeof(BigUringInstance));
+        for (int i = 0; i < rings; i++) arr[i].ring_fd = -1;
+
+        ProcStats before, after;
+        get_proc_stats(&before);
+
+        int created = 0, failed = 0;
+        double setup_usec = 0;
+        size_t act_ring = 0;
+        char first_failure[256] = {0};
+        PerfSample cell_setup = {0}, cell_work = {0}, ps;
+        BigUringInstance *first = NULL;
+
+        for (int i = 0; i < rings; i++) {
+            perf_group_start(&pg);
+            int rc = create_big_instance(&arr[i], i, flags, first);
+            perf_group_stop(&pg, &ps);
+            perf_sample_add(&cell_setup, &ps);
+            if (rc == 0) {
+                if (!first) first = &arr[i];
+                created++;
+                setup_usec += arr[i].setup_usec;
+                act_ring = arr[i].ring_mem_actual;
+            } else {
+                failed++;
+                if (!first_failure[0]) snprintf(first_failure, sizeof(first_failure), "%s", arr[i].failure_reason);
+                if (failed >= 3 && created < failed) break;
+            }
+        }
+        get_proc_stats(&after);
+
+        long nops = 0;
+        double nop_usec = 0;
+        if (config.nop_ops > 0) {
+            for (int i = 0; i < rings; i++) {
+                if (arr[i].creation_failed || arr[i].ring_fd < 0) continue;
+                perf_group_start(&pg);
+                const double t0 = now_usec();
+                long r = run_nop_workload(&arr[i], config.nop_ops);
+                nop_usec += now_usec() - t0;
+                perf_group_stop(&pg, &ps);
+                perf_sample_add(&cell_work, &ps);
+                if (r < 0) {
+                    if (!first_failure[0]) snprintf(first_failure, sizeof(first_failure), "NOP workload: %s", strerror((int)-r));
+                    break;
+                }
+                nops += r;
+            }
+        }
+
+        // siblings first: they may hold the first ring's buffer table
+        for (int i = rings - 1; i >= 0; i--) destroy_instance(&arr[i]);
+
+        char act[16] = "-", setup[16] = "-", mops[16] = "-";
+        if (created > 0) {
+            snprintf(act, sizeof(act), "%.1f", act_ring / 1024.0);
+            snprintf(setup, sizeof(setup), "%.1f", setup_usec / created);
+        }
+        if (nops > 0 && nop_usec > 0) snprintf(mops, sizeof(mops), "%.2f", nops / nop_usec);
+
+        printf("%-52s %7d %6d %10.1f %10s %10.1f %10.1f %11s %10s\n",
+               format_setup_flags(flags), created, failed,
+               ring_overhead_for(flags) / 1024.0, act,
+               (after.vmpin_kb - before.vmpin_kb) / 1024.0,
+               (after.vmlck_kb - before.vmlck_kb) / 1024.0,
+               setup, mops);
+        if (first_failure[0]) printf("  └─ %s\n", first_failure);
+        if (created > 0) {
+            char metric[128];
+            const char *fs = format_setup_flags(flags);
+            snprintf(metric, sizeof(metric), "matrix.%s.setup_us", fs);
+            bench_line(metric, setup_usec / created, "us", "lower");
+            snprintf(metric, sizeof(metric), "matrix.%s.ring_kib", fs);
+            bench_line(metric, act_ring / 1024.0, "KiB", "lower");
+            snprintf(metric, sizeof(metric), "matrix.%s.vmpin_kib_per_ring", fs);
+            bench_line(metric, (double)(after.vmpin_kb - before.vmpin_kb) / created, "KiB", "lower");
+            if (nops > 0 && nop_usec > 0) {
+                snprintf(metric, sizeof(metric), "matrix.%s.nop_mops", fs);
+                bench_line(metric, nops / nop_usec, "Mops/s", "higher");
+            }
+        }
+        if (pg.leader >= 0) {
+            char pbuf[256];
+            format_perf_sample(pbuf, sizeof(pbuf), &cell_setup, pg.sw_fallback, 0);
+            printf("  ├─ perf setup: %s\n", pbuf);
+            format_perf_sample(pbuf, sizeof(pbuf), &cell_work, pg.sw_fallback, nops);
+            printf("  └─ perf NOPs:  %s\n", pbuf);
+        }
+        fflush(stdout);
+    }
+
+    perf_group_close(&pg);
+    free(arr);
 }
 
 // ------------- child: run one service -------------
@@ -589,14 +1734,92 @@ static int run_one_service(int service_id, int write_fd) {
         return 1;
     }
 
+    for (int i = 0; i < rings; i++) arr[i].ring_fd = -1; // rings never attempted are skipped by destroy_instance
+
     int created = 0, failed = 0;
     int first_errno = 0;
     char first_failure[160] = {0};
 
+    // per-thread counter group; this service creates and drives its rings from one thread
+    PerfGroup pg = { .leader = -1 };
+    if (config.perf_counters) perf_group_open(&pg);
+    const long work_ops = (config.nop_ops > 0) ? config.nop_ops : 0;
+    BigUringInstance *first = NULL;   // first ring created; shared with -B / -A
+    int bufs_cloned = 0, bufs_same_pages = 0, clone_errno = 0, n_sib = 0;
+    double setup_usec_owner = 0, setup_usec_sib = 0;
+    int wq_attached = 0, iowq_limit_errno = 0, aff_errno = 0;
+    int n_reg = 0;
+    double reg_usec_sum = 0, reg_usec_max = 0;
+    int n_ttfio = 0, ttfio_errno = 0;
+    double ttfio_usec_sum = 0, ttfio_usec_max = 0, all_usec_sum = 0;
+    long reg_updates = 0;
+    const int zero_fd = config.fixed_reads ? open("/dev/zero", O_RDONLY | O_CLOEXEC) : -1;
+
+    // samples from before the first ring so SQPOLL threads are seen from birth
+    AffVerifier av;
+    const int verifying = config.verify_aff && aff_verifier_start(&av) == 0;
+
     for (int i = 0; i < rings; i++) {
-        int rc = create_big_instance(&arr[i], i);
+        SimMsg rmsg = {0};
+        rmsg.magic = SIMMSG_MAGIC;
+        rmsg.type = MSG_RING_STATS;
+        rmsg.service_id = (uint16_t)service_id;
+        rmsg.ring_id = i;
+        rmsg.perf_sw_fallback = pg.sw_fallback;
+        rmsg.perf_user_only = pg.user_only;
+
+        perf_group_start(&pg);
+        int rc = create_big_instance(&arr[i], i, config.setup_flags, first);
+        perf_group_stop(&pg, &rmsg.perf_setup);
+        rmsg.setup_usec = arr[i].setup_usec;
+        rmsg.ring_ok = (rc == 0);
+        if (rc == 0) rmsg.ring_bytes = (long)(arr[i].ring_mem_actual + arr[i].buffer_mem);
+        else rmsg.ring_errno = arr[i].failure_errno ? arr[i].failure_errno : errno;
+
+        if (rc == 0 && config.fixed_reads) {
+            double first_usec = 0, all_usec = 0;
+            int ret = zero_fd >= 0 ? run_fixed_reads(&arr[i], zero_fd, now_usec(), &first_usec, &all_usec) : -errno;
+            if (ret == 0) {
+                // setup already includes the first sparse chunk (or the whole pool)
+                first_usec += arr[i].setup_usec;
+                n_ttfio++;
+                ttfio_usec_sum += first_usec;
+                if (first_usec > ttfio_usec_max) ttfio_usec_max = first_usec;
+                all_usec_sum += all_usec + arr[i].setup_usec;
+            } else if (!ttfio_errno) {
+                ttfio_errno = -ret;
+            }
+            reg_updates += arr[i].reg_updates;
+        }
+
+        if (rc == 0 && work_ops > 0) {
+            perf_group_start(&pg);
+            const double t0 = now_usec();
+            rmsg.work_ops = run_nop_workload(&arr[i], work_ops);
+            rmsg.work_usec = now_usec() - t0;
+            perf_group_stop(&pg, &rmsg.perf_work);
+        }
+        if (config.perf_counters || work_ops > 0 || config.bench_lines || config.prom_file)
+            (void)write(write_fd, &rmsg, sizeof(rmsg));
+
         if (rc == 0) {
             created++;
+            if (arr[i].wq_attached) wq_attached++;
+            if (arr[i].iowq_limit_errno && !iowq_limit_errno) iowq_limit_errno = arr[i].iowq_limit_errno;
+            if (arr[i].iowq_aff_errno && !aff_errno) aff_errno = arr[i].iowq_aff_errno;
+            n_reg++;
+            reg_usec_sum += arr[i].register_usec;
+            if (arr[i].register_usec > reg_usec_max) reg_usec_max = arr[i].register_usec;
+            if (created == 1) {
+                first = &arr[i];
+                setup_usec_owner = arr[i].setup_usec;
+            } else {
+                n_sib++;
+                setup_usec_sib += arr[i].setup_usec;
+                if (arr[i].buf_share == BUF_CLONE) bufs_cloned++;
+                if (arr[i].buf_share == BUF_SAME_PAGES) bufs_same_pages++;
+                if (arr[i].clone_errno && !clone_errno) clone_errno = arr[i].clone_errno;
+            }
         } else {
             failed++;
             if (first_failure[0] == '\0') {
@@ -630,6 +1853,10 @@ static int run_one_service(int service_id, int write_fd) {
         }
     }
 
+    WqStats wq = {0};
+    if (config.wq_ops > 0 && created > 0) run_blocking_writes(arr, rings, &wq);
+    if (verifying) aff_verifier_stop(&av);
+
     ProcStats st; get_proc_stats(&st);
     SimMsg final = {0};
     final.magic = SIMMSG_MAGIC;
@@ -649,9 +1876,42 @@ static int run_one_service(int service_id, int write_fd) {
     final.setrlimit_errno = seterr;
     final.first_errno = first_errno;
     if (first_failure[0]) snprintf(final.first_failure, sizeof(final.first_failure), "%s", first_failure);
+    final.bufs_cloned = bufs_cloned;
+    final.bufs_same_pages = bufs_same_pages;
+    final.clone_errno = clone_errno;
+    final.setup_usec_owner = setup_usec_owner;
+    final.setup_usec_sib = setup_usec_sib;
+    final.n_sib = n_sib;
+    final.wq_attached = wq_attached;
+    final.iowq_limit_errno = iowq_limit_errno;
+    final.wq_ops = wq.ops;
+    final.wq_usec = wq.usec;
+    final.wq_workers_peak = wq.workers_peak;
+    final.wq_threads_peak = wq.threads_peak;
+    final.wq_kstack_kb = wq.kstack_kb;
+    final.wq_errno = wq.err;
+    final.aff_errno = aff_errno;
+    final.n_ttfio = n_ttfio;
+    final.ttfio_usec_sum = ttfio_usec_sum;
+    final.ttfio_usec_max = ttfio_usec_max;
+    final.all_usec_sum = all_usec_sum;
+    final.reg_updates = reg_updates;
+    final.ttfio_errno = ttfio_errno;
+    if (zero_fd >= 0) close(zero_fd);
+    final.n_reg = n_reg;
+    final.reg_usec_sum = reg_usec_sum;
+    final.reg_usec_max = reg_usec_max;
+    if (verifying) {
+        final.aff_samples = av.samples;
+        final.aff_violations = av.violations;
+        final.aff_cpus_seen = av.seen;
+        snprintf(final.aff_violation, sizeof(final.aff_violation), "%s", av.first);
+    }
     (void)write(write_fd, &final, sizeof(final));
 
-    for (int i = 0; i < rings; i++) destroy_instance(&arr[i]);
+    perf_group_close(&pg);
+    // siblings first: they may hold the first ring's buffer table
+    for (int i = rings - 1; i >= 0; i--) destroy_instance(&arr[i]);
     free(arr);
 
     return (failed > 0) ? 1 : 0;
@@ -711,6 +1971,231 @@ static void print_log_row(char type, int svc, const SimMsg *m) {
     }
 }
 
+static void print_ring_counters_table(const SimMsg *rows, int n) {
+    if (n <= 0) return;
+    const int sw = rows[0].perf_sw_fallback;
+    printf("\n=== PER-RING SETUP / WORKLOAD COUNTERS ===\n");
+    if (config.perf_counters) {
+        printf("counters: %s%s\n",
+               sw ? "software fallback (no PMU): first column is task-clock ns" : "hardware PMU",
+               rows[0].perf_user_only ? ", user space only (perf_event_paranoid)" : "");
+    }
+    printf("svc  ring phase   usec        %-14s %-14s %6s %-12s %-11s %-8s %-9s %-8s\n",
+           sw ? "task-clock-ns" : perf_counter_names[PC_CYCLES], perf_counter_names[PC_INSTR], "IPC",
+           "dTLB-miss", "page-faults", "ctx-sw", "ops", sw ? "ns/op" : "cyc/op");
+    printf("---- ---- ------- ----------- -------------- -------------- ------ ------------ ----------- -------- --------- --------\n");
+
+    for (int i = 0; i < n; i++) {
+        const SimMsg *m = &rows[i];
+        for (int phase = 0; phase < 2; phase++) {
+            const PerfSample *ps = phase ? &m->perf_work : &m->perf_setup;
+            if (phase == 1 && m->work_ops <= 0) continue;
+            char c[PC_NUM][24], ipc[12] = "-", per_op[16] = "-";
+            for (int k = 0; k < PC_NUM; k++) {
+                if (ps->mask & (1u << k)) snprintf(c[k], sizeof(c[k]), "%llu", (unsigned long long)ps->v[k]);
+                else snprintf(c[k], sizeof(c[k]), "-");
+            }
+            if (!sw && (ps->mask & (1u << PC_CYCLES)) && (ps->mask & (1u << PC_INSTR)) && ps->v[PC_CYCLES] > 0)
+                snprintf(ipc, sizeof(ipc), "%.2f", (double)ps->v[PC_INSTR] / (double)ps->v[PC_CYCLES]);
+            if (phase == 1 && (ps->mask & (1u << PC_CYCLES)))
+                snprintf(per_op, sizeof(per_op), "%.1f", (double)ps->v[PC_CYCLES] / (double)m->work_ops);
+
+            printf("%4d %4d %-7s %11.1f %-14s %-14s %6s %-12s %-11s %-8s %9ld %-8s\n",
+                   m->service_id, m->ring_id, phase ? "nop" : (m->ring_ok ? "setup" : "FAILED"),
+                   phase ? m->work_usec : m->setup_usec,
+                   c[PC_CYCLES], c[PC_INSTR], ipc, c[PC_DTLB], c[PC_FAULTS], c[PC_CSW],
+                   phase ? m->work_ops : 0L, per_op);
+        }
+    }
+}
+
+// ------------- node_exporter textfile (-O) -------------
+
+// One scrape per run: gauges for every ring, every service and the host, plus a per-service
+// histogram of ring setup time. Written to FILE.<pid>.tmp and renamed, so the textfile
+// collector never reads a partial file; run from a timer to keep a dashboard current.
+
+#define PROM "uring_mem_sim_"
+#define MAX_ERRNOS 16
+
+static const double setup_buckets_usec[] = { 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 100000 };
+#define NUM_SETUP_BUCKETS (sizeof(setup_buckets_usec) / sizeof(setup_buckets_usec[0]))
+
+static const char *errno_name(int e, char *buf, size_t len) {
+    switch (e) {
+        case EPERM:      return "EPERM";
+        case ENOMEM:     return "ENOMEM";
+        case EFAULT:     return "EFAULT";
+        case EBUSY:      return "EBUSY";
+        case EINVAL:     return "EINVAL";
+        case ENFILE:     return "ENFILE";
+        case EMFILE:     return "EMFILE";
+        case EAGAIN:     return "EAGAIN";
+        case ENOSYS:     return "ENOSYS";
+        case EOPNOTSUPP: return "EOPNOTSUPP";
+    }
+    snprintf(buf, len, "%d", e);
+    return buf;
+}
+
+static void prom_family(FILE *f, const char *name, const char *type, const char *help) {
+    fprintf(f, "# HELP " PROM "%s %s\n# TYPE " PROM "%s %s\n", name, help, name, type);
+}
+
+static int tally_add(int *err, int *cnt, int k, int e, int c) {
+    if (c <= 0) return k;
+    int j = 0;
+    while (j < k && err[j] != e) j++;
+    if (j == k) {
+        if (k == MAX_ERRNOS) return k;
+        err[k] = e;
+        cnt[k++] = 0;
+    }
+    cnt[j] += c;
+    return k;
+}
+
+// failed rings of service s (-1: all) by errno; services that failed before any ring
+// (calloc) report their failures under their first errno
+static int tally_failures(int s, int N, const int *failed, const int *ferr,
+                          const SimMsg *rows, int n, int *err, int *cnt) {
+    int k = 0;
+    for (int svc = 0; svc < N; svc++) {
+        if (s >= 0 && svc != s) continue;
+        int seen = 0;
+        for (int i = 0; i < n; i++) {
+            if (rows[i].service_id != svc || rows[i].ring_ok) continue;
+            k = tally_add(err, cnt, k, rows[i].ring_errno, 1);
+            seen++;
+        }
+        k = tally_add(err, cnt, k, ferr[svc], failed[svc] - seen);
+    }
+    return k;
+}
+
+static void write_prom_file(int N, const int *req, const int *created, const int *failed,
+                            const long *vmlck, const long *vmpin, const long *rss, const long *vmas,
+                            const long *rlim_cur, const int *ferr, const SimMsg *rows, int n) {
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", config.prom_file, (int)getpid());
+    FILE *f = fopen(tmp, "w");
+    if (!f) {
+        fprintf(stderr, "-O %s: %s\n", tmp, strerror(errno));
+        return;
+    }
+
+    prom_family(f, "last_run_timestamp_seconds", "gauge", "When this file was written");
+    fprintf(f, PROM "last_run_timestamp_seconds %ld\n", (long)time(NULL));
+    prom_family(f, "config_info", "gauge", "Per-ring config of the run");
+    fprintf(f, PROM "config_info{setup_flags=\"%s\",buf_share=\"%s\",reg_mode=\"%s\",mlock=\"%s\"} 1\n",
+            format_setup_flags(config.setup_flags), buf_share_names[config.buf_share],
+            reg_mode_names[config.reg_mode], config.lock_memory ? "on" : "off");
+    prom_family(f, "config_queue_depth", "gauge", "SQ entries requested per ring (-q)");
+    fprintf(f, PROM "config_queue_depth %d\n", config.queue_depth);
+    prom_family(f, "config_buffer_pool_bytes", "gauge", "Registered buffers per ring (-b x -s)");
+    fprintf(f, PROM "config_buffer_pool_bytes %zu\n", (size_t)config.num_buffers * config.buffer_size);
+
+    // per ring
+    prom_family(f, "ring_created", "gauge", "1 when the ring and its buffers were set up");
+    for (int i = 0; i < n; i++)
+        fprintf(f, PROM "ring_created{service=\"%d\",ring=\"%d\"} %d\n", rows[i].service_id, rows[i].ring_id, rows[i].ring_ok);
+    prom_family(f, "ring_pinned_bytes", "gauge", "Ring mappings plus the buffer pool the ring registered itself");
+    for (int i = 0; i < n; i++)
+        if (rows[i].ring_ok)
+            fprintf(f, PROM "ring_pinned_bytes{service=\"%d\",ring=\"%d\"} %ld\n", rows[i].service_id, rows[i].ring_id, rows[i].ring_bytes);
+    prom_family(f, "ring_setup_seconds", "gauge", "io_uring_queue_init_params plus buffer registration");
+    for (int i = 0; i < n; i++)
+        if (rows[i].ring_ok)
+            fprintf(f, PROM "ring_setup_seconds{service=\"%d\",ring=\"%d\"} %.9f\n", rows[i].service_id, rows[i].ring_id, rows[i].setup_usec / 1e6);
+
+    // per service
+    static const struct { const char *name, *help; } svc_gauges[] = {
+        { "service_rings_requested",     "Rings the service tried to create" },
+        { "service_rings_created",       "Rings set up" },
+        { "service_rings_failed",        "Rings that failed setup" },
+        { "service_vmlck_bytes",         "VmLck after setup" },
+        { "service_vmpin_bytes",         "VmPin after setup" },
+        { "service_vmpin_predicted_bytes", "Pinned bytes the model predicts for the created rings" },
+        { "service_vmrss_bytes",         "VmRSS after setup" },
+        { "service_vmas",                "Lines in /proc/<pid>/maps after setup" },
+        { "service_memlock_limit_bytes", "Soft RLIMIT_MEMLOCK of the service" },
+    };
+    for (size_t g = 0; g < sizeof(svc_gauges) / sizeof(svc_gauges[0]); g++) {
+        prom_family(f, svc_gauges[g].name, "gauge", svc_gauges[g].help);
+        for (int s = 0; s < N; s++) {
+            const double v[] = { req[s], created[s], failed[s], vmlck[s] * 1024.0, vmpin[s] * 1024.0,
+                                 (double)pinned_for_rings(created[s]), rss[s] * 1024.0, vmas[s],
+                                 rlim_cur[s] * 1024.0 };
+            if (g == 8 && rlim_cur[s] < 0) fprintf(f, PROM "%s{service=\"%d\"} +Inf\n", svc_gauges[g].name, s);
+            else fprintf(f, PROM "%s{service=\"%d\"} %.0f\n", svc_gauges[g].name, s, v[g]);
+        }
+    }
+
+    int err[MAX_ERRNOS], cnt[MAX_ERRNOS];
+    char eb[16];
+    prom_family(f, "service_ring_failures", "gauge", "Rings that failed setup, by errno");
+    for (int s = 0; s < N; s++) {
+        const int k = tally_failures(s, N, failed, ferr, rows, n, err, cnt);
+        for (int j = 0; j < k; j++)
+            fprintf(f, PROM "service_ring_failures{service=\"%d\",errno=\"%s\"} %d\n", s, errno_name(err[j], eb, sizeof(eb)), cnt[j]);
+    }
+
+    prom_family(f, "service_ring_setup_seconds", "histogram", "Setup time of the rings that were created");
+    for (int s = 0; s < N; s++) {
+        long count = 0;
+        double sum = 0;
+        long in_bucket[NUM_SETUP_BUCKETS] = {0};
+        for (int i = 0; i < n; i++) {
+            if (rows[i].service_id != s || !rows[i].ring_ok) continue;
+            count++;
+            sum += rows[i].setup_usec;
+            for (size_t b = 0; b < NUM_SETUP_BUCKETS; b++)
+                if (rows[i].setup_usec <= setup_buckets_usec[b]) in_bucket[b]++;
+        }
+        for (size_t b = 0; b < NUM_SETUP_BUCKETS; b++)
+            fprintf(f, PROM "service_ring_setup_seconds_bucket{service=\"%d\",le=\"%g\"} %ld\n", s, setup_buckets_usec[b] / 1e6, in_bucket[b]);
+        fprintf(f, PROM "service_ring_setup_seconds_bucket{service=\"%d\",le=\"+Inf\"} %ld\n", s, count);
+        fprintf(f, PROM "service_ring_setup_seconds_sum{service=\"%d\"} %.9f\n", s, sum / 1e6);
+        fprintf(f, PROM "service_ring_setup_seconds_count{service=\"%d\"} %ld\n", s, count);
+    }
+
+    // host totals
+    long h_created = 0, h_failed = 0, h_vmas = 0;
+    double h_vmlck = 0, h_vmpin = 0, h_pred = 0;
+    for (int s = 0; s < N; s++) {
+        h_created += created[s];
+        h_failed += failed[s];
+        h_vmas += vmas[s];
+        h_vmlck += vmlck[s] * 1024.0;
+        h_vmpin += vmpin[s] * 1024.0;
+        h_pred += (double)pinned_for_rings(created[s]);
+    }
+    prom_family(f, "host_services", "gauge", "Services (processes) in the run");
+    fprintf(f, PROM "host_services %d\n", N);
+    prom_family(f, "host_rings_created", "gauge", "Rings set up across all services");
+    fprintf(f, PROM "host_rings_created %ld\n", h_created);
+    prom_family(f, "host_rings_failed", "gauge", "Rings that failed setup across all services");
+    fprintf(f, PROM "host_rings_failed %ld\n", h_failed);
+    prom_family(f, "host_vmlck_bytes", "gauge", "VmLck summed over the services");
+    fprintf(f, PROM "host_vmlck_bytes %.0f\n", h_vmlck);
+    prom_family(f, "host_vmpin_bytes", "gauge", "VmPin summed over the services");
+    fprintf(f, PROM "host_vmpin_bytes %.0f\n", h_vmpin);
+    prom_family(f, "host_vmpin_predicted_bytes", "gauge", "Pinned bytes the model predicts for all created rings");
+    fprintf(f, PROM "host_vmpin_predicted_bytes %.0f\n", h_pred);
+    prom_family(f, "host_vmas", "gauge", "Mappings summed over the services");
+    fprintf(f, PROM "host_vmas %ld\n", h_vmas);
+    prom_family(f, "host_ring_failures", "gauge", "Rings that failed setup across all services, by errno");
+    const int k = tally_failures(-1, N, failed, ferr, rows, n, err, cnt);
+    for (int j = 0; j < k; j++)
+        fprintf(f, PROM "host_ring_failures{errno=\"%s\"} %d\n", errno_name(err[j], eb, sizeof(eb)), cnt[j]);
+
+    const int bad = ferror(f) | (fclose(f) != 0);
+    if (bad || rename(tmp, config.prom_file) != 0) {
+        fprintf(stderr, "-O %s: %s\n", config.prom_file, strerror(errno));
+        unlink(tmp);
+    }
+}
+
 // ------------- usage -------------
 static void usage(const char *p) {
     printf("Usage: %s [options]\n\n", p);
@@ -723,18 +2208,51 @@ static void usage(const char *p) {
     printf("  -Q NUM      NIC queues (model 2/3)\n\n");
     printf("Per-ring config:\n");
     printf("  -q DEPTH    queue depth (default 512)\n");
+    printf("  -c NUM      CQ entries (implies -F cqsize; default 4 x depth when cqsize)\n");
+    printf("  -F LIST     IORING_SETUP_* flags, comma list of:\n");
+    printf("              sqe128,cqe32,cqsize,single_issuer,defer_taskrun,coop_taskrun,submit_all,\n");
+    printf("              sqpoll (not part of -X)\n");
     printf("  -b NUM      buffers per ring (default 128)\n");
     printf("  -s BYTES    buffer size bytes (default 16384)\n");
     printf("  -f NUM      fixed fds per ring (default 64)\n");
     printf("  -L          disable mlock (VmLck likely 0; VmPin shows pinned)\n");
     printf("  -M          mmap-per-buffer mode (more VMAs)\n");
-    printf("  -G          add guard page VMA per buffer (stronger VMA pressure)\n\n");
+    printf("  -G          add guard page VMA per buffer (stronger VMA pressure)\n");
+    printf("  -B MODE     buffer sharing between rings of a service: private (default), clone, same-pages\n");
+    printf("              clone uses io_uring_clone_buffers (kernel >= 6.12) and falls back to same-pages\n\n");
+    printf("io-wq:\n");
+    printf("  -A          rings after the first attach to its io-wq (IORING_SETUP_ATTACH_WQ)\n");
+    printf("              kernels >= 5.12 keep io-wq per task, so the flag no longer shares workers\n");
+    printf("  -w B[,U]    io_uring_register_iowq_max_workers: bounded[,unbounded] cap per ring (0=keep)\n");
+    printf("  -W OPS      blocking workload: OPS buffered 4 KiB writes per ring via io-wq (IOSQE_ASYNC)\n");
+    printf("  -y NUM      log files per service for -W (default 16; one busy worker per file at most)\n");
+    printf("  -a CPULIST  io_uring_register_iowq_aff on every ring, e.g. 10-11 (SQPOLL too on >= 6.6)\n");
+    printf("  -V CPULIST  sample /proc/<pid>/task/*/stat each ms; fail if an iou-wrk / iou-sqp task\n");
+    printf("              runs on a CPU outside CPULIST (exit status 1)\n\n");
+    printf("Registration mode:\n");
+    printf("  -R MODE     full | sparse; runs a READ_FIXED pass over every buffer and reports time to\n");
+    printf("              first I/O. sparse registers an empty table and fills it while reading\n");
+    printf("  -r NUM      buffers per io_uring_register_buffers_update_tag call (default 16, max %d)\n\n", MAX_REG_CHUNK);
+    printf("Memory pressure:\n");
+    printf("  -H SIZE     fragmenting hog process before the services start (e.g. 8G)\n");
+    printf("  -Z STRIDE   hog keeps 1 of every STRIDE 4 KiB pages (default 2)\n");
+    printf("              reports register_buffers latency and compact_stall / pgmigrate_success deltas\n\n");
     printf("Memlock emulation:\n");
     printf("  -k SIZE     setrlimit MEMLOCK per service (e.g. 512M, 1G). May fail if hard limit smaller.\n\n");
+    printf("Setup-flag matrix:\n");
+    printf("  -X          create the rings under every valid -F combination (single process)\n");
+    printf("  -N OPS      NOPs per ring after setup (matrix default 65536, otherwise 0=skip)\n\n");
+    printf("Counters:\n");
+    printf("  -E          perf_event_open group around each ring's setup and NOP workload\n");
+    printf("              (cycles, instructions, dTLB-load-misses, page-faults, context-switches;\n");
+    printf("               task-clock replaces cycles when no hardware PMU is available)\n\n");
     printf("Reporting:\n");
     printf("  -S FACTOR   safety factor (default 1.50)\n");
     printf("  -p N        progress update every N rings (default 1)\n");
     printf("  -I          interactive redraw table\n");
+    printf("  -J          machine-readable BENCH lines (for io_uring_testing/bench_suite.sh)\n");
+    printf("  -O FILE     node_exporter textfile: per-ring, per-service and host gauges, failures\n");
+    printf("              by errno, setup-time histograms (written atomically; not with -X)\n");
     printf("  -v          verbose\n");
     printf("  -h          help\n");
 }
@@ -759,9 +2277,25 @@ int main(int argc, char **argv) {
     config.progress_every = 1;
     config.interactive = 0;
     config.verbose = 0;
+    config.cq_entries = 0;
+    config.setup_flags = 0;
+    config.flag_matrix = 0;
+    config.nop_ops = -1;
+    config.perf_counters = 0;
+    config.bench_lines = 0;
+    config.buf_share = BUF_PRIVATE;
+    config.iowq_attach = 0;
+    config.iowq_limit = 0;
+    config.wq_ops = 0;
+    config.wq_files = 16;
+    config.hog_bytes = 0;
+    config.hog_stride = 2;
+    config.fixed_reads = 0;
+    config.reg_mode = REG_FULL;
+    config.reg_chunk = 16;
 
     int opt;
-    while ((opt = getopt(argc, argv, "P:m:n:T:Q:q:b:s:f:k:S:p:LMIvGh")) != -1) {
+    while ((opt = getopt(argc, argv, "P:m:n:T:Q:q:c:F:N:B:w:W:y:a:V:H:Z:R:r:b:s:f:k:S:p:O:LMIvGXEJAh")) != -1) {
         switch (opt) {
             case 'P': config.num_services = atoi(optarg); if (config.num_services < 1) config.num_services = 1; break;
             case 'm': config.ring_model = atoi(optarg); if (config.ring_model < 0 || config.ring_model > 3) config.ring_model = 0; break;
@@ -769,6 +2303,63 @@ int main(int argc, char **argv) {
             case 'T': config.threads_per_service = atoi(optarg); if (config.threads_per_service < 1) config.threads_per_service = 1; break;
             case 'Q': config.nic_queues = atoi(optarg); if (config.nic_queues < 1) config.nic_queues = 1; break;
             case 'q': config.queue_depth = atoi(optarg); if (config.queue_depth < 16) config.queue_depth = 16; if (config.queue_depth > 4096) config.queue_depth = 4096; break;
+            case 'c': config.cq_entries = atoi(optarg); if (config.cq_entries < 1) config.cq_entries = 1; config.setup_flags |= IORING_SETUP_CQSIZE; break;
+            case 'F': {
+                unsigned f = 0;
+                if (parse_setup_flags(optarg, &f) != 0) { fprintf(stderr, "Invalid -F flag list: %s\n", optarg); return 2; }
+                config.setup_flags |= f;
+            } break;
+            case 'N': config.nop_ops = atoi(optarg); if (config.nop_ops < 0) config.nop_ops = 0; break;
+            case 'E': config.perf_counters = 1; break;
+            case 'X': config.flag_matrix = 1; break;
+            case 'J': config.bench_lines = 1; break;
+            case 'O': config.prom_file = optarg; break;
+            case 'B': {
+                int found = 0;
+                for (int i = 0; i < (int)(sizeof(buf_share_names) / sizeof(buf_share_names[0])); i++) {
+                    if (strcmp(optarg, buf_share_names[i]) == 0) { config.buf_share = i; found = 1; }
+                }
+                if (!found) { fprintf(stderr, "unknown -B mode '%s' (private, clone, same-pages)\n", optarg); return 2; }
+                break;
+            }
+            case 'A': config.iowq_attach = 1; break;
+            case 'w': {
+                unsigned b = 0, u = 0;
+                if (sscanf(optarg, "%u,%u", &b, &u) < 1) { fprintf(stderr, "Invalid -w limits: %s\n", optarg); return 2; }
+                config.iowq_limit = 1;
+                config.iowq_max[0] = b;
+                config.iowq_max[1] = u;
+            } break;
+            case 'W': config.wq_ops = atol(optarg); if (config.wq_ops < 0) config.wq_ops = 0; break;
+            case 'a':
+                if (parse_cpulist(optarg, &config.iowq_aff_set) != 0) { fprintf(stderr, "Invalid -a CPU list: %s\n", optarg); return 2; }
+                config.iowq_aff = 1;
+                break;
+            case 'V':
+                if (parse_cpulist(optarg, &config.verify_set) != 0) { fprintf(stderr, "Invalid -V CPU list: %s\n", optarg); return 2; }
+                config.verify_aff = 1;
+                break;
+            case 'R': {
+                int found = 0;
+                for (int i = 0; i < (int)(sizeof(reg_mode_names) / sizeof(reg_mode_names[0])); i++) {
+                    if (strcmp(optarg, reg_mode_names[i]) == 0) { config.reg_mode = i; found = 1; }
+                }
+                if (!found) { fprintf(stderr, "unknown -R mode '%s' (full, sparse)\n", optarg); return 2; }
+                config.fixed_reads = 1;
+                break;
+            }
+            case 'r':
+                config.reg_chunk = atoi(optarg);
+                if (config.reg_chunk < 1) config.reg_chunk = 1;
+                if (config.reg_chunk > MAX_REG_CHUNK) config.reg_chunk = MAX_REG_CHUNK;
+                break;
+            case 'H': {
+                size_t v = parse_size(optarg);
+                if (!v) { fprintf(stderr, "Invalid -H size: %s\n", optarg); return 2; }
+                config.hog_bytes = v;
+            } break;
+            case 'Z': config.hog_stride = atoi(optarg); if (config.hog_stride < 1) config.hog_stride = 1; break;
+            case 'y': config.wq_files = atoi(optarg); if (config.wq_files < 1) config.wq_files = 1; break;
             case 'b': config.num_buffers = atoi(optarg); if (config.num_buffers < 1) config.num_buffers = 1; break;
             case 's': config.buffer_size = (size_t)atoll(optarg); if (config.buffer_size < 4096) config.buffer_size = 4096; break;
             case 'f': config.num_registered_fds = atoi(optarg); if (config.num_registered_fds < 0) config.num_registered_fds = 0; break;
@@ -795,6 +2386,21 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (config.reg_mode == REG_SPARSE && (config.vma_per_buffer || config.buf_share != BUF_PRIVATE)) {
+        fprintf(stderr, "-R sparse needs the pooled layout and -B private\n");
+        return 2;
+    }
+    if (config.fixed_reads && config.buf_share != BUF_PRIVATE) {
+        fprintf(stderr, "-R reads through each ring's own iovecs; use it with -B private\n");
+        return 2;
+    }
+
+    if (config.iowq_attach && kernel_at_least(5, 12))
+        fprintf(stderr, "warning: -A: io-wq is per task since 5.12; IORING_SETUP_ATTACH_WQ no longer shares workers\n");
+
+    // only used for rings with IORING_SETUP_CQSIZE (-F cqsize or the -X cqsize cells)
+    if (config.cq_entries == 0) config.cq_entries = config.queue_depth * 4;
+
     printf("\n=== CONFIG ===\n");
     printf("services=%d | ring_model=%d | rings/service=%d\n", config.num_services, config.ring_model, compute_rings_per_service());
     printf("queue_depth=%d | buffers=%d | buffer_size=%zu | mlock=%s | vma_mode=%s | guard=%s\n",
@@ -802,12 +2408,56 @@ int main(int argc, char **argv) {
            config.lock_memory ? "on" : "off",
            config.vma_per_buffer ? "mmap-per-buffer" : "pooled",
            config.guard_pages ? "on" : "off");
+    printf("setup_flags=%s | cq_entries=%d | buf_share=%s | reg_mode=%s\n", format_setup_flags(config.setup_flags),
+           cq_entries_for(config.setup_flags), buf_share_names[config.buf_share], reg_mode_names[config.reg_mode]);
+    if (config.iowq_attach || config.iowq_limit || config.wq_ops > 0) {
+        printf("io-wq: attach=%s | max_workers=", config.iowq_attach ? "on" : "off");
+        if (config.iowq_limit) printf("%u,%u", config.iowq_max[0], config.iowq_max[1]);
+        else printf("kernel default");
+        printf(" | blocking writes/ring=%ld over %d files\n", config.wq_ops, config.wq_files);
+    }
+    if (config.iowq_aff || config.verify_aff) {
+        char a[256] = "-", v[256] = "-";
+        if (config.iowq_aff) format_cpulist(&config.iowq_aff_set, a, sizeof(a));
+        if (config.verify_aff) format_cpulist(&config.verify_set, v, sizeof(v));
+        printf("io-wq affinity=%s | verify allowed=%s\n", a, v);
+    }
     if (config.set_memlock_limit) {
         printf("requested setrlimit MEMLOCK: %zu bytes (%s)\n",
                config.memlock_limit_bytes, tier_memlock(config.memlock_limit_bytes));
     }
     printf("\n");
 
+    pid_t hog = 0;
+    if (config.hog_bytes > 0) {
+        const long free_before = free_kb_at_order(9);
+        const double t0 = now_usec();
+        hog = start_memory_hog(config.hog_bytes, config.hog_stride);
+        if (hog < 0) {
+            fprintf(stderr, "memory hog of %zu bytes failed to start\n", config.hog_bytes);
+            return 2;
+        }
+        const long free_after = free_kb_at_order(9);
+        printf("memory hog (-H %.2f GiB, keep 1/%d pages): holds %.1f MiB, built in %.1f s\n",
+               config.hog_bytes / (1024.0 * 1024.0 * 1024.0), config.hog_stride,
+               config.hog_bytes / (double)config.hog_stride / (1024.0 * 1024.0), (now_usec() - t0) / 1e6);
+        printf("free memory in >= 2 MiB blocks: %.1f MiB before hog, %.1f MiB after\n\n",
+               free_before / 1024.0, free_after / 1024.0);
+    }
+
+    if (config.flag_matrix) {
+        if (config.set_memlock_limit) {
+            struct rlimit r = { config.memlock_limit_bytes, config.memlock_limit_bytes };
+            if (setrlimit(RLIMIT_MEMLOCK, &r) != 0) perror("setrlimit(RLIMIT_MEMLOCK)");
+        }
+        if (config.nop_ops < 0) config.nop_ops = 65536;
+        run_flag_matrix();
+        stop_memory_hog(hog);
+        return 0;
+    }
+
+    if (config.nop_ops < 0) config.nop_ops = 0;
+
     print_recommendations_tables();
     if (config.interactive) {
         printf("\n[NOTE] -I clears the screen while running.\n\n");
@@ -818,6 +2468,9 @@ int main(int argc, char **argv) {
     int pipefd[2];
     if (pipe(pipefd) != 0) { perror("pipe"); return 2; }
 
+    long vs_before[VS_NUM];
+    read_vmstat(vs_before);
+
     for (int s = 0; s < config.num_services; s++) {
         pid_t pid = fork();
         if (pid < 0) { perror("fork"); return 2; }
@@ -842,9 +2495,10 @@ int main(int argc, char **argv) {
     long *rlim_max = calloc((size_t)N, sizeof(long));
     int  *setrc    = calloc((size_t)N, sizeof(int));
     int  *seterr   = calloc((size_t)N, sizeof(int));
+    int  *ferr     = calloc((size_t)N, sizeof(int));
     char (*first_fail)[160] = calloc((size_t)N, 160);
 
-    if (!req||!created||!failed||!vmlck||!vmpin||!rss||!vmas||!rlim_cur||!rlim_max||!setrc||!seterr||!first_fail) {
+    if (!req||!created||!failed||!vmlck||!vmpin||!rss||!vmas||!rlim_cur||!rlim_max||!setrc||!seterr||!ferr||!first_fail) {
         perror("calloc");
         return 2;
     }
@@ -852,6 +2506,26 @@ int main(int argc, char **argv) {
     int finals = 0;
     int printed_log_header = 0;
 
+    int bufs_cloned = 0, bufs_same_pages = 0, clone_errno = 0, n_owner = 0, n_sib = 0;
+    double setup_owner = 0, setup_sib = 0;
+    int wq_attached = 0, iowq_limit_errno = 0, wq_errno = 0;
+    int wq_workers_max = 0, wq_workers_sum = 0, wq_threads_max = 0;
+    long wq_ops = 0, wq_kstack_kb = 0;
+    double wq_usec_max = 0;
+    int aff_errno = 0;
+    long aff_samples = 0, aff_violations = 0;
+    cpu_set_t aff_seen;
+    char aff_first[128] = "";
+    CPU_ZERO(&aff_seen);
+    int n_reg = 0;
+    double reg_usec_sum = 0, reg_usec_max = 0;
+    int n_ttfio = 0, ttfio_errno = 0;
+    double ttfio_usec_sum = 0, ttfio_usec_max = 0, all_usec_sum = 0;
+    long reg_updates = 0;
+
+    SimMsg *ring_rows = NULL;   // MSG_RING_STATS rows (-E / -N)
+    int n_ring_rows = 0, cap_ring_rows = 0;
+
     while (finals < N) {
         SimMsg msg;
         ssize_t r = read(pipefd[0], &msg, sizeof(msg));
@@ -863,6 +2537,18 @@ int main(int argc, char **argv) {
         int s = (int)msg.service_id;
         if (s < 0 || s >= N) continue;
 
+        if (msg.type == MSG_RING_STATS) {
+            if (n_ring_rows == cap_ring_rows) {
+                int ncap = cap_ring_rows ? cap_ring_rows * 2 : 64;
+                SimMsg *nr = realloc(ring_rows, (size_t)ncap * sizeof(SimMsg));
+                if (!nr) continue;
+                ring_rows = nr;
+                cap_ring_rows = ncap;
+            }
+            ring_rows[n_ring_rows++] = msg;
+            continue;
+        }
+
         req[s]     = msg.rings_requested;
         created[s] = msg.created;
         failed[s]  = msg.failed;
@@ -875,12 +2561,45 @@ int main(int argc, char **argv) {
         rlim_max[s] = msg.rlim_max_kb;
         setrc[s]    = msg.setrlimit_rc;
         seterr[s]   = msg.setrlimit_errno;
+        ferr[s]     = msg.first_errno;
 
         if (msg.first_failure[0] && first_fail[s][0] == '\0') {
             snprintf(first_fail[s], 160, "%s", msg.first_failure);
         }
 
-        if (msg.type == MSG_FINAL) finals++;
+        if (msg.type == MSG_FINAL) {
+            finals++;
+            bufs_cloned += msg.bufs_cloned;
+            bufs_same_pages += msg.bufs_same_pages;
+            if (msg.clone_errno && !clone_errno) clone_errno = msg.clone_errno;
+            if (msg.created > 0) { n_owner++; setup_owner += msg.setup_usec_owner; }
+            n_sib += msg.n_sib;
+            setup_sib += msg.setup_usec_sib;
+            wq_attached += msg.wq_attached;
+            if (msg.iowq_limit_errno && !iowq_limit_errno) iowq_limit_errno = msg.iowq_limit_errno;
+            if (msg.wq_errno && !wq_errno) wq_errno = msg.wq_errno;
+            wq_ops += msg.wq_ops;
+            wq_workers_sum += msg.wq_workers_peak;
+            if (msg.wq_workers_peak > wq_workers_max) wq_workers_max = msg.wq_workers_peak;
+            if (msg.wq_threads_peak > wq_threads_max) wq_threads_max = msg.wq_threads_peak;
+            if (msg.wq_kstack_kb > wq_kstack_kb) wq_kstack_kb = msg.wq_kstack_kb;
+            if (msg.wq_usec > wq_usec_max) wq_usec_max = msg.wq_usec;
+            if (msg.aff_errno && !aff_errno) aff_errno = msg.aff_errno;
+            n_ttfio += msg.n_ttfio;
+            ttfio_usec_sum += msg.ttfio_usec_sum;
+            if (msg.ttfio_usec_max > ttfio_usec_max) ttfio_usec_max = msg.ttfio_usec_max;
+            all_usec_sum += msg.all_usec_sum;
+            reg_updates += msg.reg_updates;
+            if (msg.ttfio_errno && !ttfio_errno) ttfio_errno = msg.ttfio_errno;
+            n_reg += msg.n_reg;
+            reg_usec_sum += msg.reg_usec_sum;
+            if (msg.reg_usec_max > reg_usec_max) reg_usec_max = msg.reg_usec_max;
+            aff_samples += msg.aff_samples;
+            aff_violations += msg.aff_violations;
+            CPU_OR(&aff_seen, &aff_seen, &msg.aff_cpus_seen);
+            if (msg.aff_violation[0] && !aff_first[0])
+                snprintf(aff_first, sizeof(aff_first), "svc %d: %s", s, msg.aff_violation);
+        }
 
         if (config.interactive) {
             print_interactive_table(finals, N, req, created, failed, vmlck, vmpin, rss, vmas, rlim_cur, rlim_max, setrc, seterr, first_fail);
@@ -892,18 +2611,11 @@ int main(int argc, char **argv) {
 
     close(pipefd[0]);
     for (int i = 0; i < N; i++) { int st=0; (void)wait(&st); }
+    long vs_after[VS_NUM];
+    read_vmstat(vs_after);
+    stop_memory_hog(hog);
 
     // Final summary
-    const size_t page = 4096;
-    const size_t buf_len = round_up(config.buffer_size, page);
-    const size_t pinned_per_ring_buffers = (size_t)config.num_buffers * buf_len;
-    const size_t ring_overhead =
-        (config.queue_depth * 4) +
-        (config.queue_depth * 2 * 16) +
-        (config.queue_depth * 64) +
-        (4096 * 3);
-    const size_t pinned_per_ring_total = pinned_per_ring_buffers + ring_overhead;
-
     int total_created = 0, total_failed = 0;
     size_t est_pinned_total = 0;
     long sum_vmlck = 0, sum_vmpin = 0, sum_rss = 0, max_vmas = 0;
@@ -911,7 +2623,7 @@ int main(int argc, char **argv) {
     for (int i = 0; i < N; i++) {
         total_created += created[i];
         total_failed  += failed[i];
-        est_pinned_total += (size_t)created[i] * pinned_per_ring_total;
+        est_pinned_total += pinned_for_rings(created[i]);
         sum_vmlck += vmlck[i];
         sum_vmpin += vmpin[i];
         sum_rss   += rss[i];
@@ -945,6 +2657,118 @@ int main(int argc, char **argv) {
     if (sum_vmpin > 0) printf("kernel VmPin sum (all svcs):       %.2f GiB\n", sum_vmpin / (1024.0*1024.0));
     printf("kernel VmRSS sum (all svcs):       %.2f GiB\n", sum_rss / (1024.0*1024.0));
     printf("max VMAs in a single svc:          %ld\n", max_vmas);
+    printf("buffer registration (-B %s):%*scloned=%d same-pages=%d private=%d\n",
+           buf_share_names[config.buf_share], (int)(10 - strlen(buf_share_names[config.buf_share])), "",
+           bufs_cloned, bufs_same_pages, total_created - bufs_cloned - bufs_same_pages);
+    if (clone_errno)
+        printf("  clone fell back to same-pages: %s\n", strerror(clone_errno));
+    if (n_owner > 0)
+        printf("setup per ring: first %.1f us%s", setup_owner / n_owner, n_sib > 0 ? "" : "\n");
+    if (n_owner > 0 && n_sib > 0)
+        printf(", siblings %.1f us avg\n", setup_sib / n_sib);
+    if (n_reg > 0)
+        printf("buffer registration latency:       avg %.2f ms, max %.2f ms over %d rings\n",
+               reg_usec_sum / n_reg / 1e3, reg_usec_max / 1e3, n_reg);
+    if (config.fixed_reads) {
+        if (config.reg_mode == REG_SPARSE)
+            printf("time to first I/O (-R sparse, %d bufs/update, %ld updates):\n", config.reg_chunk, reg_updates);
+        else
+            printf("time to first I/O (-R full):\n");
+        if (n_ttfio > 0) {
+            printf("  first READ_FIXED done:           avg %.2f ms, max %.2f ms over %d rings\n",
+                   ttfio_usec_sum / n_ttfio / 1e3, ttfio_usec_max / 1e3, n_ttfio);
+            printf("  all %d buffers registered+read:  avg %.2f ms\n", config.num_buffers, all_usec_sum / n_ttfio / 1e3);
+        }
+        if (ttfio_errno) printf("  first fixed-read error: %s\n", strerror(ttfio_errno));
+    }
+    printf("vmstat during run (host-wide):    ");
+    for (int i = 0; i < VS_NUM; i++) printf(" %s=+%ld", vmstat_names[i], vs_after[i] - vs_before[i]);
+    printf("\n");
+    if (config.iowq_attach || config.iowq_limit || config.wq_ops > 0) {
+        printf("io-wq: attached=%d rings", wq_attached);
+        if (config.iowq_limit)
+            printf(" | max_workers bounded=%u unbounded=%u (%s)", config.iowq_max[0], config.iowq_max[1],
+                   iowq_limit_errno ? strerror(iowq_limit_errno) : "ok");
+        printf("\n");
+    }
+    if (config.wq_ops > 0) {
+        // services run concurrently: throughput is over the slowest one's wall time
+        const double mib = (double)wq_ops * WQ_WRITE_BYTES / (1024.0 * 1024.0);
+        printf("blocking writes (-W):              %ld x %d KiB over %d files/svc, %.1f MiB/s, %.1f kops/s\n",
+               wq_ops, WQ_WRITE_BYTES / 1024, config.wq_files,
+               wq_usec_max > 0 ? mib / (wq_usec_max / 1e6) : 0.0,
+               wq_usec_max > 0 ? wq_ops / (wq_usec_max / 1e3) : 0.0);
+        printf("  iou-wrk threads peak:            %d in one svc, %d all svcs (threads/svc peak %d)\n",
+               wq_workers_max, wq_workers_sum, wq_threads_max);
+        printf("  worker kernel stacks:            %.1f MiB (%d x %d KiB), KernelStack host growth %.1f MiB\n",
+               (double)wq_workers_sum * KERNEL_STACK_BYTES / (1024.0 * 1024.0), wq_workers_sum,
+               KERNEL_STACK_BYTES / 1024, wq_kstack_kb / 1024.0);
+        if (wq_errno) printf("  first write error: %s\n", strerror(wq_errno));
+    }
+    if (config.iowq_aff) {
+        char cl[256];
+        format_cpulist(&config.iowq_aff_set, cl, sizeof(cl));
+        printf("io-wq affinity (-a %s):%*s%s\n", cl, (int)(18 - (strlen(cl) < 18 ? strlen(cl) : 18)), "",
+               aff_errno ? strerror(aff_errno) : total_created > 0 ? "registered on every ring" : "no rings");
+    }
+    if (config.verify_aff) {
+        char allowed[256], seen[256];
+        format_cpulist(&config.verify_set, allowed, sizeof(allowed));
+        format_cpulist(&aff_seen, seen, sizeof(seen));
+        printf("affinity verify (-V %s): %ld samples, workers seen on CPUs %s\n", allowed, aff_samples, seen);
+        if (CPU_COUNT(&aff_seen) == 0)
+            printf("  no io-wq / SQPOLL workers seen (add -W for blocking writes or -F sqpoll)\n");
+        else if (aff_violations > 0)
+            printf("  FAIL: %ld worker samples outside %s, first %s\n", aff_violations, allowed, aff_first);
+        else
+            printf("  PASS: every io-wq / SQPOLL worker sample was inside %s\n", allowed);
+    }
+
+    print_ring_counters_table(ring_rows, n_ring_rows);
+
+    if (config.bench_lines && total_created > 0) {
+        double setup_sum = 0, work_usec = 0, cyc = 0;
+        long ok = 0, ops = 0;
+        for (int i = 0; i < n_ring_rows; i++) {
+            if (!ring_rows[i].ring_ok) continue;
+            ok++;
+            setup_sum += ring_rows[i].setup_usec;
+            if (ring_rows[i].work_ops <= 0) continue;
+            work_usec += ring_rows[i].work_usec;
+            ops += ring_rows[i].work_ops;
+            if (ring_rows[i].perf_work.mask & (1u << PC_CYCLES)) cyc += (double)ring_rows[i].perf_work.v[PC_CYCLES];
+        }
+        printf("\n");
+        bench_line("vmpin_kib_per_ring", (double)sum_vmpin / total_created, "KiB", "lower");
+        bench_line("vmlck_kib_per_ring", (double)sum_vmlck / total_created, "KiB", "lower");
+        if (n_sib > 0) bench_line("sibling_setup_us", setup_sib / n_sib, "us", "lower");
+        if (n_ttfio > 0) {
+            bench_line("ttfio_ms", ttfio_usec_sum / n_ttfio / 1e3, "ms", "lower");
+            bench_line("all_registered_ms", all_usec_sum / n_ttfio / 1e3, "ms", "lower");
+        }
+        if (n_reg > 0) {
+            bench_line("register_ms", reg_usec_sum / n_reg / 1e3, "ms", "lower");
+            bench_line("register_ms_max", reg_usec_max / 1e3, "ms", "lower");
+        }
+        if (config.hog_bytes > 0) {
+            bench_line("hog.compact_stall", (double)(vs_after[VS_COMPACT_STALL] - vs_before[VS_COMPACT_STALL]), "events", "lower");
+            bench_line("hog.pgmigrate_success", (double)(vs_after[VS_PGMIGRATE_SUCCESS] - vs_before[VS_PGMIGRATE_SUCCESS]), "pages", "lower");
+        }
+        if (config.wq_ops > 0 && wq_usec_max > 0) {
+            bench_line("iowq_write_mibs", (double)wq_ops * WQ_WRITE_BYTES / (1024.0 * 1024.0) / (wq_usec_max / 1e6),
+                       "MiB/s", "higher");
+            bench_line("iowq_workers_peak", wq_workers_max, "threads", "lower");
+        }
+        if (config.verify_aff) bench_line("iowq_aff_violations", (double)aff_violations, "samples", "lower");
+        if (ok > 0) bench_line("setup_us", setup_sum / ok, "us", "lower");
+        if (ops > 0 && work_usec > 0) bench_line("nop_mops", ops / work_usec, "Mops/s", "higher");
+        if (ops > 0 && cyc > 0)
+            bench_line(ring_rows[0].perf_sw_fallback ? "nop_ns_per_op" : "nop_cycles_per_op", cyc / ops,
+                       ring_rows[0].perf_sw_fallback ? "ns" : "cycles", "lower");
+    }
+    if (config.prom_file)
+        write_prom_file(N, req, created, failed, vmlck, vmpin, rss, vmas, rlim_cur, ferr, ring_rows, n_ring_rows);
+    free(ring_rows);
 
     printf("\n=== RECOMMENDATIONS (REPRINT) ===\n");
     print_recommendations_tables();
@@ -952,8 +2776,8 @@ int main(int argc, char **argv) {
     free(req); free(created); free(failed);
     free(vmlck); free(vmpin); free(rss); free(vmas);
     free(rlim_cur); free(rlim_max);
-    free(setrc); free(seterr);
+    free(setrc); free(seterr); free(ferr);
     free(first_fail);
 
-    return (total_failed > 0) ? 1 : 0;
+    return (total_failed > 0 || aff_violations > 0) ? 1 : 0;
 }
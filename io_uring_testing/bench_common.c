@@ -0,0 +1,266 @@
+/*
+ * Shared helpers for the io_uring_testing micro-benchmarks (see bench_common.h)
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "bench_common.h"
+
+double bc_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile on a sorted array */
+static double rank(const double *v, size_t n, double q)
+{
+    size_t i = (size_t)(q * (double)n);
+    return v[i >= n ? n - 1 : i];
+}
+
+void bc_percentiles(double *v, size_t n, bc_pct_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (n == 0) return;
+    qsort(v, n, sizeof(double), cmp_double);
+
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) sum += v[i];
+    out->n = n;
+    out->min = v[0];
+    out->max = v[n - 1];
+    out->mean = sum / (double)n;
+    out->p50 = rank(v, n, 0.50);
+    out->p90 = rank(v, n, 0.90);
+    out->p99 = rank(v, n, 0.99);
+    out->p999 = rank(v, n, 0.999);
+}
+
+int bc_pin_cpu(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return -pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+int bc_nr_cpus(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+int bc_parse_cpulist(const char *s, int *cpus, int max)
+{
+    int n = 0;
+    while (*s) {
+        char *end;
+        long lo = strtol(s, &end, 10), hi = lo;
+        if (end == s || lo < 0) return -1;
+        if (*end == '-') {
+            s = end + 1;
+            hi = strtol(s, &end, 10);
+            if (end == s || hi < lo) return -1;
+        }
+        for (long c = lo; c <= hi && n < max; c++) cpus[n++] = (int)c;
+        if (*end == ',') end++;
+        else if (*end) return -1;
+        s = end;
+    }
+    return n;
+}
+
+static int read_sysfs_int(const char *path, int *out)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    int ok = fscanf(f, "%d", out) == 1;
+    fclose(f);
+    return ok ? 0 : -1;
+}
+
+int bc_cpu_topology(int cpu, int *package, int *core)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    if (read_sysfs_int(path, package) < 0) return -1;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+    return read_sysfs_int(path, core);
+}
+
+/* ── perf counters ─────────────────────────────────────────────────── */
+
+const char *bc_perf_names[BC_PC_NUM] = {
+    "cycles", "instructions", "cache-references", "cache-misses", "L1-dcache-load-misses"
+};
+
+static int perf_open_one(uint32_t type, uint64_t cfg, int group_fd, int user_only)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = cfg;
+    attr.disabled = (group_fd == -1);
+    attr.exclude_hv = 1;
+    attr.exclude_kernel = user_only ? 1 : 0;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    /* pid=0, cpu=-1: the calling thread on any CPU */
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+int bc_perf_open(bc_perf_t *g)
+{
+    static const struct { uint32_t type; uint64_t config; } ev[BC_PC_NUM] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                             (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    };
+
+    memset(g, 0, sizeof(*g));
+    g->leader = -1;
+    for (int i = 0; i < BC_PC_NUM; i++) { g->fds[i] = -1; g->slot_pos[i] = -1; }
+
+    for (int i = 0; i < BC_PC_NUM; i++) {
+        int fd = perf_open_one(ev[i].type, ev[i].config, g->leader, g->user_only);
+        if (fd < 0 && g->leader < 0 && (errno == EACCES || errno == EPERM) && !g->user_only) {
+            /* perf_event_paranoid >= 2: count user space only rather than nothing */
+            g->user_only = 1;
+            fd = perf_open_one(ev[i].type, ev[i].config, g->leader, g->user_only);
+        }
+        if (fd < 0 && i == BC_PC_CYCLES) {
+            /* no hardware PMU (VM without vPMU): keep a time base in the cycles slot */
+            fd = perf_open_one(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, g->leader, g->user_only);
+            if (fd >= 0) g->sw_fallback = 1;
+        }
+        if (fd < 0) continue;
+        if (g->leader < 0) g->leader = fd;
+        g->fds[i] = fd;
+        g->slot_pos[i] = g->nr++;
+    }
+    return (g->leader >= 0) ? 0 : -1;
+}
+
+void bc_perf_start(bc_perf_t *g)
+{
+    if (g->leader < 0) return;
+    ioctl(g->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(g->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void bc_perf_stop(bc_perf_t *g, bc_perf_sample_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (g->leader < 0) return;
+    ioctl(g->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    /* PERF_FORMAT_GROUP layout: nr, time_enabled, time_running, value[nr] */
+    uint64_t buf[3 + BC_PC_NUM];
+    ssize_t r = read(g->leader, buf, sizeof(buf));
+    if (r < (ssize_t)(3 * sizeof(uint64_t)) || buf[0] != (uint64_t)g->nr) return;
+
+    /* scale for multiplexing when the group did not get the PMU the whole time */
+    const double scale = (buf[2] > 0 && buf[2] < buf[1]) ? (double)buf[1] / (double)buf[2] : 1.0;
+    for (int i = 0; i < BC_PC_NUM; i++) {
+        if (g->slot_pos[i] < 0) continue;
+        out->v[i] = (uint64_t)(buf[3 + g->slot_pos[i]] * scale);
+        out->mask |= 1u << i;
+    }
+}
+
+void bc_perf_close(bc_perf_t *g)
+{
+    for (int i = 0; i < BC_PC_NUM; i++) {
+        if (g->fds[i] >= 0) close(g->fds[i]);
+        g->fds[i] = -1;
+    }
+    g->leader = -1;
+}
+
+void bc_perf_add(bc_perf_sample_t *acc, const bc_perf_sample_t *s)
+{
+    for (int i = 0; i < BC_PC_NUM; i++) acc->v[i] += s->v[i];
+    acc->mask |= s->mask;
+}
+
+/* ── Random offsets, files and options ─────────────────────────────── */
+
+uint64_t bc_rand(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+int bc_ensure_file(const char *path, off_t min_size, long create_mb)
+{
+    struct stat st;
+    if (stat(path, &st) == 0 && st.st_size >= min_size) return 0;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -errno;
+    static char chunk[1 << 20];
+    memset(chunk, 0xa5, sizeof(chunk));
+    for (long i = 0; i < create_mb; i++) {
+        errno = 0;
+        if (write(fd, chunk, sizeof(chunk)) != (ssize_t)sizeof(chunk)) {
+            int e = errno ? -errno : -EIO;   /* a short write leaves errno at 0 */
+            close(fd);
+            return e;
+        }
+    }
+    fsync(fd);
+    close(fd);
+    return 0;
+}
+
+unsigned bc_parse_names(const char *list, const char **names, int count)
+{
+    unsigned mask = 0;
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", list);
+    for (char *save, *tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        int found = 0;
+        for (int i = 0; i < count; i++)
+            if (strcmp(tok, names[i]) == 0) { mask |= 1u << i; found = 1; }
+        if (!found) {
+            fprintf(stderr, "unknown name '%s'\n", tok);
+            return 0;
+        }
+    }
+    return mask;
+}
+
+/* ── Output ────────────────────────────────────────────────────────── */
+
+void bc_bench_line(const char *tool, const char *metric, double value,
+                   const char *unit, const char *better)
+{
+    printf("BENCH %s.%s %.3f %s %s\n", tool, metric, value, unit, better);
+}
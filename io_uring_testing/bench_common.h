@@ -0,0 +1,101 @@
+/*
+ * Shared helpers for the io_uring_testing micro-benchmarks
+ *
+ * Timing, percentile summaries, CPU pinning, per-thread perf_event_open
+ * groups, random offsets, test files, name-list options and
+ * "BENCH <metric> <value> <unit> <lower|higher>" output, so every benchmark
+ * reports the same way and bench_suite.sh can collect any of them.
+ *
+ * Build: add bench_common.c to the benchmark's gcc line (no extra libs).
+ */
+
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* ── Time ──────────────────────────────────────────────────────────── */
+
+double bc_now_ns(void);                 /* CLOCK_MONOTONIC in ns */
+
+/* ── Percentiles ───────────────────────────────────────────────────── */
+
+typedef struct {
+    size_t n;
+    double min, mean, p50, p90, p99, p999, max;
+} bc_pct_t;
+
+/* Sorts v in place and fills out; n == 0 gives all zeros */
+void bc_percentiles(double *v, size_t n, bc_pct_t *out);
+
+/* ── CPUs ──────────────────────────────────────────────────────────── */
+
+#define BC_MAX_CPUS 1024
+
+int bc_pin_cpu(int cpu);                /* pin the calling thread; 0 or -errno */
+int bc_nr_cpus(void);                   /* online CPUs */
+
+/* "0-3,8,10-11" -> cpus[], returns the count or -1 on a malformed list */
+int bc_parse_cpulist(const char *s, int *cpus, int max);
+
+/* sysfs topology: physical package and core id; 0 or -1 if unreadable */
+int bc_cpu_topology(int cpu, int *package, int *core);
+
+static inline void bc_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/* ── perf counters (calling thread) ────────────────────────────────── */
+
+/* BC_PC_CYCLES carries task-clock ns when the PMU is unavailable */
+enum { BC_PC_CYCLES, BC_PC_INSTR, BC_PC_CACHE_REFS, BC_PC_CACHE_MISSES, BC_PC_L1D_MISSES, BC_PC_NUM };
+extern const char *bc_perf_names[BC_PC_NUM];
+
+typedef struct {
+    int leader;
+    int fds[BC_PC_NUM];
+    int slot_pos[BC_PC_NUM];            /* position in the PERF_FORMAT_GROUP read */
+    int nr;
+    int sw_fallback;                    /* cycles slot is task-clock */
+    int user_only;                      /* perf_event_paranoid forced exclude_kernel */
+} bc_perf_t;
+
+typedef struct {
+    uint64_t v[BC_PC_NUM];
+    uint32_t mask;                      /* slots that were counted */
+} bc_perf_sample_t;
+
+int  bc_perf_open(bc_perf_t *g);        /* 0, or -1 with no counter at all */
+void bc_perf_start(bc_perf_t *g);
+void bc_perf_stop(bc_perf_t *g, bc_perf_sample_t *out);
+void bc_perf_close(bc_perf_t *g);
+void bc_perf_add(bc_perf_sample_t *acc, const bc_perf_sample_t *s);
+
+/* ── Random offsets, files and options ─────────────────────────────── */
+
+/* xorshift64: cheap and good enough for offsets; *state must be nonzero */
+uint64_t bc_rand(uint64_t *state);
+
+/*
+ * Creates path with create_mb MiB of data (fsync'ed) unless it already holds
+ * at least min_size bytes; 0 or -errno
+ */
+int bc_ensure_file(const char *path, off_t min_size, long create_mb);
+
+/* "a,b" against names[0..count) -> bit mask; 0 after printing the unknown name */
+unsigned bc_parse_names(const char *list, const char **names, int count);
+
+/* ── Output ────────────────────────────────────────────────────────── */
+
+/* "BENCH <tool>.<metric> <value> <unit> <lower|higher>" for bench_suite.sh */
+void bc_bench_line(const char *tool, const char *metric, double value,
+                   const char *unit, const char *better);
+
+#endif /* BENCH_COMMON_H */
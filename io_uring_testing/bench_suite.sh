@@ -0,0 +1,248 @@
+#!/bin/bash
+#
+# io_uring Cross-Kernel Benchmark Suite
+# =====================================
+# Builds the io_uring tools, runs their benchmark modes several times and
+# stores every sample in a JSON baseline keyed by `uname -r`. A second
+# kernel's baseline can then be compared against it; metrics that moved in
+# the bad direction with a significant Welch t-test are flagged.
+#
+# Usage:
+#   ./bench_suite.sh run [-r RUNS] [-o DIR]      write DIR/<uname -r>.json
+#   ./bench_suite.sh compare BASE.json NEW.json [-a ALPHA] [-m MIN_PCT]
+#
+# Sources of samples (each prints "BENCH <metric> <value> <unit> <lower|higher>"):
+#   io_uring_memory_test --bench    ring setup cost per size, NOP round trip,
+#                                   batched NOP throughput, RSS per ring,
+#                                   QD1 p50/p99 and QD32 Mops/s per setup mode
+#   uring_mem_sim -J -N -E          per-ring setup, VmPin/VmLck per ring,
+#                                   NOP throughput and cycles (or ns) per NOP
+#   uring_mem_sim -J -X             setup-flag matrix: setup, ring size,
+#                                   VmPin and NOP throughput per flag set
+#   ring_contention_bench -J        per-thread vs shared vs MSG_RING fan-in:
+#                                   Mops/s, Kops/s per core, cache misses/op
+#   handoff_latency_bench -J        MSG_RING / eventfd / futex / SPSC one-way
+#                                   p50 and p99 per core distance
+#   reap_bench -J                   CQE reaping strategies: Kops/s and p99
+#                                   for page-cache reads and socketpairs
+#   io_compare_bench -J             io_uring (fixed / plain) vs epoll vs
+#                                   preadv2: Kops/s, CPU ns/op, p99
+#   direct_io_bench -J              O_DIRECT READ vs READ_FIXED, plain vs
+#                                   registered fd: cycles per I/O
+#
+# compare exits 1 when any metric regressed, so it can gate a kernel rollout.
+#
+
+set -e
+
+SCRIPT_DIR=$(cd "$(dirname "$0")" && pwd)
+REPO_DIR=$(cd "$SCRIPT_DIR/.." && pwd)
+SCHEMA_VERSION=1
+
+usage() {
+    sed -n '11,13p' "$0" | sed 's/^# \{0,1\}//'
+    exit 2
+}
+
+# ---------------------------------------------------------------------------
+# run
+# ---------------------------------------------------------------------------
+
+build_tools() {
+    local out=$1
+    mkdir -p "$out"
+    gcc -O2 -o "$out/io_uring_memory_test" \
+        "$SCRIPT_DIR/io_uring_memory_test.c" "$REPO_DIR/ring_model/ring_model.c" -luring -lpthread
+    gcc -O2 -std=gnu11 -o "$out/uring_mem_sim" \
+        "$REPO_DIR/io_uring_refactor/uring_mem_sim.c" "$REPO_DIR/ring_model/ring_model.c" -luring -pthread
+    gcc -O2 -o "$out/ring_contention_bench" \
+        "$SCRIPT_DIR/ring_contention_bench.c" "$SCRIPT_DIR/bench_common.c" -luring -lpthread
+    gcc -O2 -o "$out/handoff_latency_bench" \
+        "$SCRIPT_DIR/handoff_latency_bench.c" "$SCRIPT_DIR/bench_common.c" -luring -lpthread
+    gcc -O2 -o "$out/reap_bench" \
+        "$SCRIPT_DIR/reap_bench.c" "$SCRIPT_DIR/bench_common.c" -luring -lpthread
+    gcc -O2 -o "$out/io_compare_bench" \
+        "$SCRIPT_DIR/io_compare_bench.c" "$SCRIPT_DIR/bench_common.c" -luring -lpthread
+    gcc -O2 -o "$out/direct_io_bench" \
+        "$SCRIPT_DIR/direct_io_bench.c" "$SCRIPT_DIR/bench_common.c" -luring -lpthread
+}
+
+# Collects "metric value unit better" rows from all runs into one JSON file.
+# One metric per line keeps the file diffable and lets compare parse it with awk.
+write_json() {
+    local samples=$1 out=$2 runs=$3
+    local rev
+    rev=$(git -C "$REPO_DIR" rev-parse --short HEAD 2>/dev/null || echo unknown)
+    {
+        printf '{\n'
+        printf '  "schema_version": %d,\n' "$SCHEMA_VERSION"
+        printf '  "kernel": "%s",\n' "$(uname -r)"
+        printf '  "machine": "%s",\n' "$(uname -m)"
+        printf '  "hostname": "%s",\n' "$(hostname)"
+        printf '  "date": "%s",\n' "$(date -u +%Y-%m-%dT%H:%M:%SZ)"
+        printf '  "git_rev": "%s",\n' "$rev"
+        printf '  "runs": %d,\n' "$runs"
+        printf '  "metrics": {\n'
+        awk '
+            { if (!($1 in unit)) { order[++n] = $1; unit[$1] = $3; better[$1] = $4 }
+              s[$1] = (s[$1] == "" ? $2 : s[$1] ", " $2) }
+            END {
+                for (i = 1; i <= n; i++) {
+                    m = order[i]
+                    printf "    \"%s\": {\"unit\": \"%s\", \"better\": \"%s\", \"samples\": [%s]}%s\n",
+                           m, unit[m], better[m], s[m], (i < n ? "," : "")
+                }
+            }' "$samples"
+        printf '  }\n'
+        printf '}\n'
+    } > "$out"
+}
+
+cmd_run() {
+    local runs=5 outdir="$SCRIPT_DIR/baselines" opt
+    OPTIND=1
+    while getopts "r:o:h" opt; do
+        case $opt in
+            r) runs=$OPTARG ;;
+            o) outdir=$OPTARG ;;
+            *) usage ;;
+        esac
+    done
+
+    local build samples direct_file
+    build=$(mktemp -d)
+    samples=$(mktemp)
+    # O_DIRECT needs a real filesystem; mktemp's /tmp may be tmpfs
+    direct_file="$SCRIPT_DIR/.direct_io_bench.dat"
+    trap 'rm -rf "$build" "$samples" "$direct_file"' EXIT
+
+    echo "Building tools..."
+    build_tools "$build"
+
+    echo "Kernel: $(uname -r)  runs: $runs"
+    for ((r = 1; r <= runs; r++)); do
+        echo "  run $r/$runs"
+        "$build/io_uring_memory_test" --bench | grep '^BENCH ' | cut -d' ' -f2- >> "$samples" || true
+        "$build/uring_mem_sim" -J -E -n 8 -N 65536 -b 16 -s 4096 -f 0 -p 8 \
+            | grep '^BENCH ' | cut -d' ' -f2- >> "$samples" || true
+        "$build/uring_mem_sim" -J -X -n 4 -N 16384 -b 4 -s 4096 -f 0 \
+            | grep '^BENCH ' | cut -d' ' -f2- >> "$samples" || true
+        "$build/ring_contention_bench" -J -t 2 -n 200000 \
+            | grep '^BENCH ' | cut -d' ' -f2- >> "$samples" || true
+        "$build/handoff_latency_bench" -J -n 20000 \
+            | grep '^BENCH ' | cut -d' ' -f2- >> "$samples" || true
+        "$build/reap_bench" -J -n 100000 -f "$build/reap_bench.dat" \
+            | grep '^BENCH ' | cut -d' ' -f2- >> "$samples" || true
+        "$build/io_compare_bench" -J -n 100000 -f "$build/io_compare_bench.dat" \
+            | grep '^BENCH ' | cut -d' ' -f2- >> "$samples" || true
+        "$build/direct_io_bench" -J -b 4k,64k -q 1,32 -t 100 -S 256 -f "$direct_file" \
+            | grep '^BENCH ' | cut -d' ' -f2- >> "$samples" || true
+    done
+
+    mkdir -p "$outdir"
+    local out="$outdir/$(uname -r).json"
+    write_json "$samples" "$out" "$runs"
+    echo "Wrote $out ($(grep -c '"samples"' "$out") metrics)"
+}
+
+# ---------------------------------------------------------------------------
+# compare
+# ---------------------------------------------------------------------------
+
+cmd_compare() {
+    [ $# -ge 2 ] || usage
+    local base=$1 new=$2 alpha=0.05 min_pct=2 opt
+    shift 2
+    OPTIND=1
+    while getopts "a:m:h" opt; do
+        case $opt in
+            a) alpha=$OPTARG ;;
+            m) min_pct=$OPTARG ;;
+            *) usage ;;
+        esac
+    done
+
+    local v
+    for f in "$base" "$new"; do
+        v=$(sed -n 's/.*"schema_version": \([0-9]*\).*/\1/p' "$f")
+        if [ "$v" != "$SCHEMA_VERSION" ]; then
+            echo "$f: schema_version '$v' is not $SCHEMA_VERSION" >&2
+            exit 2
+        fi
+    done
+
+    echo "Base: $(sed -n 's/.*"kernel": "\(.*\)".*/\1/p' "$base")   New: $(sed -n 's/.*"kernel": "\(.*\)".*/\1/p' "$new")"
+    echo "Welch t-test, alpha=$alpha, ignoring changes under ${min_pct}%"
+    echo ""
+
+    awk -v alpha="$alpha" -v min_pct="$min_pct" '
+        function parse(line, which,    q, name, body, n, v, i, sum, sq) {
+            n = split(line, q, "\"")
+            name = q[2]
+            unit[name] = q[6]; better[name] = q[10]
+            body = line; sub(/.*\[/, "", body); sub(/\].*/, "", body)
+            n = split(body, v, /, */)
+            sum = 0; sq = 0
+            for (i = 1; i <= n; i++) { sum += v[i]; sq += v[i] * v[i] }
+            cnt[which, name] = n
+            mean[which, name] = sum / n
+            var[which, name] = (n > 1) ? (sq - sum * sum / n) / (n - 1) : 0
+            if (var[which, name] < 0) var[which, name] = 0
+            if (!(name in seen)) { seen[name] = 1; order[++nm] = name }
+        }
+        # Two-sided p-value of Welch t via a normal approximation of the t
+        # distribution (adequate for the df >= 4 we get with 5+ runs).
+        function erfc(x,    t, y) {
+            t = 1 / (1 + 0.3275911 * x)
+            y = t * (0.254829592 + t * (-0.284496736 + t * (1.421413741 + t * (-1.453152027 + t * 1.061405429))))
+            return y * exp(-x * x)
+        }
+        function pvalue(t, df,    z) {
+            if (df < 1) df = 1
+            z = t * (1 - 1 / (4 * df)) / sqrt(1 + t * t / (2 * df))
+            if (z < 0) z = -z
+            return erfc(z / sqrt(2))
+        }
+        FNR == 1 { file++ }
+        /"samples": \[/ { parse($0, file) }
+        END {
+            printf "%-58s %-8s %18s %18s %8s %8s  %s\n", "metric", "unit", "base mean±sd", "new mean±sd", "delta", "p", "verdict"
+            reg = 0
+            for (i = 1; i <= nm; i++) {
+                m = order[i]
+                if (!((1, m) in cnt) || !((2, m) in cnt)) {
+                    printf "%-58s %-8s %18s %18s %8s %8s  %s\n", m, unit[m],
+                           ((1, m) in cnt) ? sprintf("%.3g", mean[1, m]) : "-",
+                           ((2, m) in cnt) ? sprintf("%.3g", mean[2, m]) : "-", "", "", "only in one baseline"
+                    continue
+                }
+                ma = mean[1, m]; mb = mean[2, m]
+                va = var[1, m] / cnt[1, m]; vb = var[2, m] / cnt[2, m]
+                se = sqrt(va + vb)
+                if (se > 0) {
+                    t = (mb - ma) / se
+                    df = (va + vb) ^ 2 / ((cnt[1, m] > 1 ? va * va / (cnt[1, m] - 1) : 0) + (cnt[2, m] > 1 ? vb * vb / (cnt[2, m] - 1) : 0) + 1e-300)
+                    p = pvalue(t, df)
+                } else {
+                    p = (ma == mb) ? 1 : 0
+                }
+                pct = (ma != 0) ? (mb - ma) / ma * 100 : 0
+                worse = (better[m] == "lower") ? (mb > ma) : (mb < ma)
+                abs_pct = pct < 0 ? -pct : pct
+                verdict = "~"
+                if (p < alpha && abs_pct >= min_pct) {
+                    if (worse) { verdict = "REGRESSED"; reg++ } else verdict = "improved"
+                }
+                printf "%-58s %-8s %9.3g±%-8.2g %9.3g±%-8.2g %+7.1f%% %8.3g  %s\n", m, unit[m],
+                       ma, sqrt(var[1, m]), mb, sqrt(var[2, m]), pct, p, verdict
+            }
+            printf "\n%d metric(s) regressed\n", reg
+            exit (reg > 0)
+        }' "$base" "$new"
+}
+
+case "${1:-}" in
+    run)     shift; cmd_run "$@" ;;
+    compare) shift; cmd_compare "$@" ;;
+    *)       usage ;;
+esac
@@ -0,0 +1,317 @@
+/*
+ * Fixed vs Unfixed Buffers and Files on O_DIRECT Reads
+ *
+ * What the pinned memory in uring_mem_sim's tables buys per I/O. Random
+ * O_DIRECT reads from a regular file (or a file on a loop-mounted image)
+ * through four variants:
+ *
+ *   read            IORING_OP_READ on a plain fd
+ *   read+regfile    IORING_OP_READ on a registered file (IOSQE_FIXED_FILE)
+ *   fixed           IORING_OP_READ_FIXED on a plain fd
+ *   fixed+regfile   IORING_OP_READ_FIXED on a registered file
+ *
+ * Sweeps block size (512 B .. 1 MiB) and queue depth (1 .. 256) and reports
+ * CPU cycles per I/O of the submitting thread (perf_event_open, user +
+ * kernel; task-clock ns when there is no PMU) plus IOPS. Completion IRQ
+ * work that lands on other CPUs is not attributed, so the numbers are the
+ * submit/reap side cost, which is what buffer and file registration save.
+ *
+ * Fixed variants register QD buffers of the block size, so the largest
+ * cells pin QD x BS bytes (256 MiB at 256 x 1 MiB): raise RLIMIT_MEMLOCK or
+ * trim -b / -q. Cells that cannot register show "-".
+ *
+ * Requires: Linux kernel >= 5.1, a filesystem with O_DIRECT (not tmpfs), liburing
+ *
+ * Usage: ./direct_io_bench [-f FILE] [-S FILE_MB] [-b SIZES] [-q DEPTHS] [-t MS] [-J]
+ * Compile: gcc -O2 -o direct_io_bench direct_io_bench.c bench_common.c -luring -lpthread
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <liburing.h>
+
+#include "bench_common.h"
+
+#define MAX_SWEEP       16
+#define MAX_QD          4096
+#define DEFAULT_FILE    "direct_io_bench.dat"
+
+enum { V_READ, V_READ_REGFILE, V_FIXED, V_FIXED_REGFILE, V_NUM };
+static const char *variant_names[V_NUM] = { "read", "read+regfile", "fixed", "fixed+regfile" };
+
+static struct {
+    const char *file;
+    long file_mb;
+    unsigned sizes[MAX_SWEEP];
+    int nsizes;
+    unsigned qds[MAX_SWEEP];
+    int nqds;
+    double budget_ns;           /* time per cell */
+    int bench;
+} cfg = {
+    .file = DEFAULT_FILE,
+    .file_mb = 512,
+    .sizes = {512, 4096, 16384, 65536, 262144, 1048576},
+    .nsizes = 6,
+    .qds = {1, 4, 16, 64, 256},
+    .nqds = 5,
+    .budget_ns = 200e6,
+};
+
+struct cell {
+    long ios;
+    double elapsed_ns;
+    double cyc_per_io;          /* or task-clock ns per I/O */
+    int sw_fallback;
+    int err;
+};
+
+static void print_usage(const char *prog)
+{
+    printf("Usage: %s [options]\n", prog);
+    printf("  -f FILE     file to read (default ./%s, created if missing)\n", DEFAULT_FILE);
+    printf("  -S MB       size when creating FILE (default 512)\n");
+    printf("  -b SIZES    comma list of block sizes, k/m suffixes (default 512,4k,16k,64k,256k,1m)\n");
+    printf("  -q DEPTHS   comma list of queue depths (default 1,4,16,64,256)\n");
+    printf("  -t MS       time per cell (default 200)\n");
+    printf("  -J          BENCH lines (for bench_suite.sh)\n");
+}
+
+static int parse_list(const char *s, unsigned *out, int max, int allow_suffix)
+{
+    int n = 0;
+    while (*s && n < max) {
+        char *end;
+        unsigned long v = strtoul(s, &end, 10);
+        if (end == s || v == 0) return -1;
+        if (allow_suffix && (*end == 'k' || *end == 'K')) { v <<= 10; end++; }
+        else if (allow_suffix && (*end == 'm' || *end == 'M')) { v <<= 20; end++; }
+        out[n++] = (unsigned)v;
+        if (*end == ',') end++;
+        else if (*end) return -1;
+        s = end;
+    }
+    return n;
+}
+
+/* ── One cell ──────────────────────────────────────────────────────── */
+
+static void run_cell(int fd, off_t file_size, unsigned bs, unsigned qd, int variant, struct cell *out)
+{
+    int fixed = (variant == V_FIXED || variant == V_FIXED_REGFILE);
+    int regfile = (variant == V_READ_REGFILE || variant == V_FIXED_REGFILE);
+    struct io_uring ring;
+    bc_perf_t perf;
+    bc_perf_sample_t ps;
+    char *bufs = NULL;
+    unsigned *free_slots = NULL;
+    unsigned nfree = qd;
+    uint64_t rng = 0x9e3779b97f4a7c15ull ^ ((uint64_t)bs << 20) ^ qd;
+    off_t blocks = file_size / bs;
+    long queued = 0, done = 0;
+    int ret;
+
+    memset(out, 0, sizeof(*out));
+    if (posix_memalign((void **)&bufs, 4096, (size_t)qd * bs) != 0) {
+        out->err = -ENOMEM;
+        return;
+    }
+    memset(bufs, 0, (size_t)qd * bs);
+    free_slots = malloc(qd * sizeof(unsigned));
+    for (unsigned i = 0; i < qd; i++) free_slots[i] = i;
+
+    ret = io_uring_queue_init(qd, &ring, 0);
+    if (ret < 0) {
+        out->err = ret;
+        goto out_free;
+    }
+    if (fixed) {
+        struct iovec *iov = calloc(qd, sizeof(*iov));
+        for (unsigned i = 0; i < qd; i++) {
+            iov[i].iov_base = bufs + (size_t)i * bs;
+            iov[i].iov_len = bs;
+        }
+        ret = io_uring_register_buffers(&ring, iov, qd);
+        free(iov);
+    }
+    if (ret == 0 && regfile) ret = io_uring_register_files(&ring, &fd, 1);
+    if (ret < 0) {
+        out->err = ret;
+        goto out_ring;
+    }
+
+    int perf_ok = (bc_perf_open(&perf) == 0);
+    bc_perf_start(&perf);
+    double t0 = bc_now_ns(), deadline = t0 + cfg.budget_ns;
+    int draining = 0;
+    while (!out->err) {
+        while (!draining && nfree > 0) {
+            unsigned slot = free_slots[--nfree];
+            off_t off = (off_t)(bc_rand(&rng) % (uint64_t)blocks) * bs;
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+            char *buf = bufs + (size_t)slot * bs;
+            int target = regfile ? 0 : fd;
+            if (fixed) io_uring_prep_read_fixed(sqe, target, buf, bs, off, (int)slot);
+            else io_uring_prep_read(sqe, target, buf, bs, off);
+            if (regfile) io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+            io_uring_sqe_set_data64(sqe, slot);
+            queued++;
+        }
+        if (draining && done == queued) break;
+
+        ret = io_uring_submit_and_wait(&ring, 1);
+        if (ret < 0 && ret != -EINTR) { out->err = ret; break; }
+        struct io_uring_cqe *cqe;
+        unsigned head, seen = 0;
+        io_uring_for_each_cqe(&ring, head, cqe) {
+            if (cqe->res != (int)bs && !out->err) out->err = cqe->res < 0 ? cqe->res : -EIO;
+            free_slots[nfree++] = (unsigned)cqe->user_data;
+            seen++;
+        }
+        io_uring_cq_advance(&ring, seen);
+        done += seen;
+        /* Stop queueing at the deadline; the drain still counts */
+        if (!draining && bc_now_ns() >= deadline) draining = 1;
+    }
+    out->elapsed_ns = bc_now_ns() - t0;
+    bc_perf_stop(&perf, &ps);
+    out->sw_fallback = perf.sw_fallback;
+    bc_perf_close(&perf);
+
+    out->ios = done;
+    if (perf_ok && (ps.mask & (1u << BC_PC_CYCLES)) && done > 0)
+        out->cyc_per_io = (double)ps.v[BC_PC_CYCLES] / done;
+
+out_ring:
+    io_uring_queue_exit(&ring);
+out_free:
+    free(free_slots);
+    free(bufs);
+}
+
+/* ── Driver ────────────────────────────────────────────────────────── */
+
+static void format_size(char *buf, size_t len, unsigned bs)
+{
+    if (bs >= (1u << 20) && bs % (1u << 20) == 0) snprintf(buf, len, "%uM", bs >> 20);
+    else if (bs >= 1024 && bs % 1024 == 0) snprintf(buf, len, "%uK", bs >> 10);
+    else snprintf(buf, len, "%u", bs);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:S:b:q:t:Jh")) != -1) {
+        switch (opt) {
+        case 'f': cfg.file = optarg; break;
+        case 'S': cfg.file_mb = atol(optarg); break;
+        case 'b':
+            cfg.nsizes = parse_list(optarg, cfg.sizes, MAX_SWEEP, 1);
+            if (cfg.nsizes <= 0) { fprintf(stderr, "bad size list '%s'\n", optarg); return 2; }
+            break;
+        case 'q':
+            cfg.nqds = parse_list(optarg, cfg.qds, MAX_SWEEP, 0);
+            if (cfg.nqds <= 0) { fprintf(stderr, "bad depth list '%s'\n", optarg); return 2; }
+            break;
+        case 't': cfg.budget_ns = atof(optarg) * 1e6; break;
+        case 'J': cfg.bench = 1; break;
+        default:
+            print_usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    for (int i = 0; i < cfg.nsizes; i++) {
+        if (cfg.sizes[i] % 512) {
+            fprintf(stderr, "block size %u is not a multiple of 512\n", cfg.sizes[i]);
+            return 2;
+        }
+    }
+    for (int i = 0; i < cfg.nqds; i++) {
+        if (cfg.qds[i] > MAX_QD) {
+            fprintf(stderr, "queue depth %u above %d\n", cfg.qds[i], MAX_QD);
+            return 2;
+        }
+    }
+    if (cfg.file_mb < 1 || cfg.budget_ns <= 0) {
+        fprintf(stderr, "need FILE_MB >= 1 and MS > 0\n");
+        return 2;
+    }
+
+    int ret = bc_ensure_file(cfg.file, (off_t)cfg.file_mb << 20, cfg.file_mb);
+    if (ret < 0) {
+        fprintf(stderr, "%s: %s\n", cfg.file, strerror(-ret));
+        return 1;
+    }
+    int fd = open(cfg.file, O_RDONLY | O_DIRECT);
+    if (fd < 0) {
+        fprintf(stderr, "open(%s, O_DIRECT): %s%s\n", cfg.file, strerror(errno),
+                errno == EINVAL ? " (filesystem without O_DIRECT, e.g. tmpfs; use a disk or loop image)" : "");
+        return 1;
+    }
+    struct stat st;
+    fstat(fd, &st);
+
+    printf("O_DIRECT random reads from %s (%lld MiB), %.0f ms per cell\n",
+           cfg.file, (long long)(st.st_size >> 20), cfg.budget_ns / 1e6);
+
+    int sw_fallback = 0;
+    for (int b = 0; b < cfg.nsizes; b++) {
+        unsigned bs = cfg.sizes[b];
+        char bsname[16];
+        format_size(bsname, sizeof(bsname), bs);
+        if ((off_t)bs > st.st_size) continue;
+
+        printf("\nBlock size %s: cycles per I/O (kIOPS)\n", bsname);
+        printf("  %5s", "QD");
+        for (int v = 0; v < V_NUM; v++) printf(" %20s", variant_names[v]);
+        printf(" %8s\n", "saved");
+
+        for (int q = 0; q < cfg.nqds; q++) {
+            unsigned qd = cfg.qds[q];
+            struct cell cells[V_NUM];
+            printf("  %5u", qd);
+            for (int v = 0; v < V_NUM; v++) {
+                run_cell(fd, st.st_size, bs, qd, v, &cells[v]);
+                struct cell *c = &cells[v];
+                char txt[32];
+                if (c->err || c->ios == 0 || c->cyc_per_io == 0) {
+                    snprintf(txt, sizeof(txt), "- (%s)", c->err ? strerror(-c->err) : "no perf");
+                    if (strlen(txt) > 20) txt[20] = '\0';
+                } else {
+                    snprintf(txt, sizeof(txt), "%.0f (%.1f)", c->cyc_per_io,
+                             c->ios / (c->elapsed_ns / 1e9) / 1e3);
+                    sw_fallback |= c->sw_fallback;
+                }
+                printf(" %20s", txt);
+                fflush(stdout);
+            }
+            struct cell *a = &cells[V_READ], *z = &cells[V_FIXED_REGFILE];
+            if (!a->err && !z->err && a->cyc_per_io > 0 && z->cyc_per_io > 0)
+                printf(" %7.1f%%\n", (a->cyc_per_io - z->cyc_per_io) / a->cyc_per_io * 100.0);
+            else
+                printf(" %8s\n", "-");
+
+            for (int v = 0; cfg.bench && v < V_NUM; v++) {
+                if (cells[v].err || cells[v].cyc_per_io <= 0) continue;
+                char metric[96];
+                snprintf(metric, sizeof(metric), "bs%u.qd%u.%s.cyc_per_io", bs, qd, variant_names[v]);
+                bc_bench_line("direct_io", metric, cells[v].cyc_per_io,
+                              cells[v].sw_fallback ? "ns" : "cycles", "lower");
+            }
+        }
+    }
+
+    printf("\nsaved = cycles per I/O fixed+regfile saves over read.%s\n",
+           sw_fallback ? " No PMU: figures are task-clock ns, not cycles." : "");
+    close(fd);
+    return 0;
+}
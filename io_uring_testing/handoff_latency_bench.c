@@ -0,0 +1,434 @@
+/*
+ * Inter-Thread Handoff Latency: MSG_RING vs eventfd vs futex vs SPSC
+ *
+ * One pinned sender passes a timestamp to one pinned receiver, one message
+ * at a time, and the receiver records now - timestamp (CLOCK_MONOTONIC is
+ * coherent across CPUs). Methods:
+ *
+ *   msg-ring        IORING_OP_MSG_RING into the receiver's ring; the sender
+ *                   waits for its own CQE
+ *   msg-ring-nocqe  same with IOSQE_CQE_SKIP_SUCCESS: no sender CQE, so the
+ *                   sender only pays for io_uring_enter (kernel 5.17+)
+ *   eventfd         timestamp in a shared slot, write() to an eventfd; the
+ *                   receiver sleeps in read()
+ *   futex           SPSC ring; an empty receiver sleeps in FUTEX_WAIT and the
+ *                   sender calls FUTEX_WAKE only when it is asleep
+ *   spsc            the same ring, receiver busy-polls
+ *
+ * Each method runs at every core distance found in sysfs topology: SMT
+ * sibling, another core on the same socket, and another socket. The sender
+ * waits for the previous message to be consumed plus a gap (-g) before the
+ * next one, so sleeping receivers really go back to sleep and every sample
+ * is an uncontended handoff. -p makes every receiver spin instead of sleep.
+ *
+ * Requires: Linux kernel >= 5.18 for msg-ring, liburing >= 2.2
+ *
+ * Usage: ./handoff_latency_bench [-n MSGS] [-w WARMUP] [-g GAP_US] [-m METHODS]
+ *                                [-d smt,socket,cross] [-c A,B] [-p] [-J]
+ * Compile: gcc -O2 -o handoff_latency_bench handoff_latency_bench.c bench_common.c -luring -lpthread
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <liburing.h>
+
+#include "bench_common.h"
+
+#define CACHE_LINE      64
+#define QUEUE_SLOTS     64
+
+enum { M_MSG_RING, M_MSG_RING_NOCQE, M_EVENTFD, M_FUTEX, M_SPSC, M_NUM };
+static const char *method_names[M_NUM] = { "msg-ring", "msg-ring-nocqe", "eventfd", "futex", "spsc" };
+
+enum { D_SMT, D_SOCKET, D_CROSS, D_CUSTOM, D_NUM };
+static const char *dist_names[D_NUM] = { "smt", "socket", "cross", "custom" };
+static const char *dist_labels[D_NUM] = { "SMT sibling", "same socket", "cross socket", "custom pair" };
+
+static struct {
+    long msgs;
+    long warmup;
+    double gap_ns;
+    unsigned methods;           /* bitmask of M_* */
+    unsigned dists;             /* bitmask of D_* */
+    int custom_a, custom_b;
+    int spin;                   /* -p: receivers never sleep */
+    int bench;
+} cfg = {
+    .msgs = 100000,
+    .warmup = 1000,
+    .gap_ns = 10000,
+    .methods = (1u << M_NUM) - 1,
+    .dists = (1u << D_SMT) | (1u << D_SOCKET) | (1u << D_CROSS),
+};
+
+/* State shared by sender and receiver; hot fields on their own lines */
+static struct {
+    int method;
+    int same_cpu;               /* both threads on one CPU: yield instead of spinning */
+    struct io_uring tx_ring, rx_ring;
+    int efd;
+    _Alignas(CACHE_LINE) _Atomic uint64_t slot;            /* eventfd payload */
+    _Alignas(CACHE_LINE) _Atomic uint32_t q_tail;          /* futex word */
+    _Alignas(CACHE_LINE) _Atomic uint32_t q_sleeping;
+    _Alignas(CACHE_LINE) uint32_t q_head;                  /* receiver only */
+    _Alignas(CACHE_LINE) uint64_t q_slots[QUEUE_SLOTS];
+    _Alignas(CACHE_LINE) _Atomic long consumed;            /* pacing */
+    _Alignas(CACHE_LINE) int err;
+    pthread_barrier_t start;
+    double *lat;
+} hx;
+
+static void print_usage(const char *prog)
+{
+    printf("Usage: %s [options]\n", prog);
+    printf("  -n MSGS     measured messages per method and distance (default 100000)\n");
+    printf("  -w WARMUP   unmeasured messages first (default 1000)\n");
+    printf("  -g GAP_US   idle time between messages (default 10)\n");
+    printf("  -m METHODS  comma list of msg-ring,msg-ring-nocqe,eventfd,futex,spsc (default all)\n");
+    printf("  -d DISTS    comma list of smt,socket,cross (default all found)\n");
+    printf("  -c A,B      one custom CPU pair instead of -d\n");
+    printf("  -p          receivers busy-poll instead of sleeping\n");
+    printf("  -J          BENCH lines (for bench_suite.sh)\n");
+}
+
+static void wait_relax(void)
+{
+    if (hx.same_cpu) sched_yield();
+    else bc_cpu_relax();
+}
+
+static long futex(_Atomic uint32_t *addr, int op, uint32_t val)
+{
+    return syscall(SYS_futex, (uint32_t *)addr, op, val, NULL, NULL, 0);
+}
+
+/* ── Methods ───────────────────────────────────────────────────────── */
+
+static int method_setup(int m)
+{
+    int ret;
+
+    hx.method = m;
+    hx.err = 0;
+    hx.efd = -1;
+    atomic_store(&hx.consumed, 0);
+    atomic_store(&hx.q_tail, 0);
+    atomic_store(&hx.q_sleeping, 0);
+    hx.q_head = 0;
+
+    if (m == M_EVENTFD) {
+        hx.efd = eventfd(0, cfg.spin ? EFD_NONBLOCK : 0);
+        return hx.efd < 0 ? -errno : 0;
+    }
+    if (m != M_MSG_RING && m != M_MSG_RING_NOCQE) return 0;
+
+    ret = io_uring_queue_init(8, &hx.tx_ring, 0);
+    if (ret < 0) return ret;
+    ret = io_uring_queue_init(256, &hx.rx_ring, 0);
+    if (ret < 0) {
+        io_uring_queue_exit(&hx.tx_ring);
+        return ret;
+    }
+
+    /* Probe MSG_RING (and CQE_SKIP) here so the timed loop never fails */
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&hx.tx_ring);
+    struct io_uring_cqe *cqe;
+    struct __kernel_timespec ts = { .tv_sec = 1, .tv_nsec = 0 };
+    io_uring_prep_msg_ring(sqe, hx.rx_ring.ring_fd, 0, 0, 0);
+    if (m == M_MSG_RING_NOCQE) io_uring_sqe_set_flags(sqe, IOSQE_CQE_SKIP_SUCCESS);
+    io_uring_submit(&hx.tx_ring);
+    ret = io_uring_wait_cqe_timeout(&hx.rx_ring, &cqe, &ts);
+    if (ret == 0) io_uring_cqe_seen(&hx.rx_ring, cqe);
+    if (io_uring_peek_cqe(&hx.tx_ring, &cqe) == 0) {
+        if (cqe->res < 0) ret = cqe->res;
+        io_uring_cqe_seen(&hx.tx_ring, cqe);
+    }
+    if (ret < 0) {
+        io_uring_queue_exit(&hx.rx_ring);
+        io_uring_queue_exit(&hx.tx_ring);
+    }
+    return ret;
+}
+
+static void method_teardown(int m)
+{
+    if (m == M_MSG_RING || m == M_MSG_RING_NOCQE) {
+        io_uring_queue_exit(&hx.rx_ring);
+        io_uring_queue_exit(&hx.tx_ring);
+    }
+    if (hx.efd >= 0) close(hx.efd);
+}
+
+static int queue_push(uint64_t v)
+{
+    uint32_t tail = atomic_load_explicit(&hx.q_tail, memory_order_relaxed);
+    hx.q_slots[tail % QUEUE_SLOTS] = v;
+    atomic_store_explicit(&hx.q_tail, tail + 1, memory_order_seq_cst);
+    /* seq_cst store above pairs with the receiver's sleeping store + recheck */
+    if (hx.method == M_FUTEX && atomic_load_explicit(&hx.q_sleeping, memory_order_seq_cst))
+        futex(&hx.q_tail, FUTEX_WAKE_PRIVATE, 1);
+    return 0;
+}
+
+static uint64_t queue_pop(void)
+{
+    uint32_t head = hx.q_head;
+    while (atomic_load_explicit(&hx.q_tail, memory_order_acquire) == head) {
+        if (hx.method == M_SPSC || cfg.spin) {
+            wait_relax();
+            continue;
+        }
+        atomic_store_explicit(&hx.q_sleeping, 1, memory_order_seq_cst);
+        if (atomic_load_explicit(&hx.q_tail, memory_order_seq_cst) == head)
+            futex(&hx.q_tail, FUTEX_WAIT_PRIVATE, head);
+        atomic_store_explicit(&hx.q_sleeping, 0, memory_order_relaxed);
+    }
+    uint64_t v = hx.q_slots[head % QUEUE_SLOTS];
+    hx.q_head = head + 1;
+    return v;
+}
+
+static int method_send(uint64_t ts)
+{
+    struct io_uring_sqe *sqe;
+    struct io_uring_cqe *cqe;
+    uint64_t one = 1;
+    int ret;
+
+    switch (hx.method) {
+    case M_MSG_RING:
+        io_uring_prep_msg_ring(io_uring_get_sqe(&hx.tx_ring), hx.rx_ring.ring_fd, 0, ts, 0);
+        ret = io_uring_submit_and_wait(&hx.tx_ring, 1);
+        if (ret < 0) return ret;
+        if (io_uring_peek_cqe(&hx.tx_ring, &cqe) == 0) {
+            ret = cqe->res;
+            io_uring_cqe_seen(&hx.tx_ring, cqe);
+        }
+        return ret < 0 ? ret : 0;
+    case M_MSG_RING_NOCQE:
+        sqe = io_uring_get_sqe(&hx.tx_ring);
+        io_uring_prep_msg_ring(sqe, hx.rx_ring.ring_fd, 0, ts, 0);
+        io_uring_sqe_set_flags(sqe, IOSQE_CQE_SKIP_SUCCESS);
+        ret = io_uring_submit(&hx.tx_ring);
+        if (ret < 0) return ret;
+        /* Failures still post a CQE */
+        if (io_uring_peek_cqe(&hx.tx_ring, &cqe) == 0) {
+            ret = cqe->res;
+            io_uring_cqe_seen(&hx.tx_ring, cqe);
+            return ret < 0 ? ret : 0;
+        }
+        return 0;
+    case M_EVENTFD:
+        atomic_store_explicit(&hx.slot, ts, memory_order_release);
+        return write(hx.efd, &one, sizeof(one)) == sizeof(one) ? 0 : -errno;
+    default:
+        return queue_push(ts);
+    }
+}
+
+static uint64_t method_recv(void)
+{
+    struct io_uring_cqe *cqe;
+    uint64_t v;
+
+    switch (hx.method) {
+    case M_MSG_RING:
+    case M_MSG_RING_NOCQE:
+        if (cfg.spin) {
+            while (io_uring_peek_cqe(&hx.rx_ring, &cqe) != 0) wait_relax();
+        } else if (io_uring_wait_cqe(&hx.rx_ring, &cqe) < 0) {
+            return 0;
+        }
+        v = cqe->user_data;
+        io_uring_cqe_seen(&hx.rx_ring, cqe);
+        return v;
+    case M_EVENTFD:
+        while (read(hx.efd, &v, sizeof(v)) != sizeof(v)) {
+            if (errno != EAGAIN && errno != EINTR) return 0;
+            wait_relax();
+        }
+        return atomic_load_explicit(&hx.slot, memory_order_acquire);
+    default:
+        return queue_pop();
+    }
+}
+
+/* ── Threads ───────────────────────────────────────────────────────── */
+
+struct pair { int sender_cpu, receiver_cpu; };
+
+static void *sender_main(void *arg)
+{
+    struct pair *p = arg;
+    long total = cfg.warmup + cfg.msgs;
+
+    bc_pin_cpu(p->sender_cpu);
+    pthread_barrier_wait(&hx.start);
+    for (long i = 0; i < total; i++) {
+        while (atomic_load_explicit(&hx.consumed, memory_order_acquire) < i) wait_relax();
+        double until = bc_now_ns() + cfg.gap_ns;
+        while (bc_now_ns() < until) wait_relax();
+        int ret = method_send((uint64_t)bc_now_ns());
+        if (ret < 0) {
+            /* Setup probed the method; a failure now is fatal, not skippable */
+            fprintf(stderr, "%s: send failed: %s\n", method_names[hx.method], strerror(-ret));
+            exit(1);
+        }
+    }
+    return NULL;
+}
+
+static void *receiver_main(void *arg)
+{
+    struct pair *p = arg;
+    long total = cfg.warmup + cfg.msgs;
+
+    bc_pin_cpu(p->receiver_cpu);
+    pthread_barrier_wait(&hx.start);
+    for (long i = 0; i < total; i++) {
+        uint64_t ts = method_recv();
+        double now = bc_now_ns();
+        if (i >= cfg.warmup) hx.lat[i - cfg.warmup] = now - (double)ts;
+        atomic_store_explicit(&hx.consumed, i + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+/* ── Topology ──────────────────────────────────────────────────────── */
+
+/* First CPU pair at the given distance; 0 or -1 if the machine has none */
+static int find_pair(int dist, struct pair *out)
+{
+    int n = bc_nr_cpus();
+    if (n > BC_MAX_CPUS) n = BC_MAX_CPUS;
+
+    for (int a = 0; a < n; a++) {
+        int pa, ca;
+        if (bc_cpu_topology(a, &pa, &ca) < 0) continue;
+        for (int b = a + 1; b < n; b++) {
+            int pb, cb;
+            if (bc_cpu_topology(b, &pb, &cb) < 0) continue;
+            int match = (dist == D_SMT && pa == pb && ca == cb) ||
+                        (dist == D_SOCKET && pa == pb && ca != cb) ||
+                        (dist == D_CROSS && pa != pb);
+            if (match) {
+                out->sender_cpu = a;
+                out->receiver_cpu = b;
+                return 0;
+            }
+        }
+    }
+    return -1;
+}
+
+static void run_method(int dist, struct pair *p, int m)
+{
+    pthread_t tx, rx;
+    int ret = method_setup(m);
+
+    if (ret < 0) {
+        printf("  %-16s not supported (%s)\n", method_names[m], strerror(-ret));
+        return;
+    }
+    hx.same_cpu = (p->sender_cpu == p->receiver_cpu);
+    pthread_barrier_init(&hx.start, NULL, 2);
+    if (pthread_create(&rx, NULL, receiver_main, p) != 0 ||
+        pthread_create(&tx, NULL, sender_main, p) != 0) {
+        fprintf(stderr, "pthread_create failed\n");
+        exit(1);
+    }
+    pthread_join(tx, NULL);
+    pthread_join(rx, NULL);
+    pthread_barrier_destroy(&hx.start);
+    method_teardown(m);
+
+    bc_pct_t pc;
+    bc_percentiles(hx.lat, (size_t)cfg.msgs, &pc);
+    printf("  %-16s %9.0f %9.0f %9.0f %9.0f %9.0f %9.0f\n", method_names[m],
+           pc.min, pc.p50, pc.p90, pc.p99, pc.p999, pc.max);
+
+    if (cfg.bench) {
+        char metric[96];
+        snprintf(metric, sizeof(metric), "%s.%s%s.p50_ns", dist_names[dist], method_names[m], cfg.spin ? "-spin" : "");
+        bc_bench_line("handoff", metric, pc.p50, "ns", "lower");
+        snprintf(metric, sizeof(metric), "%s.%s%s.p99_ns", dist_names[dist], method_names[m], cfg.spin ? "-spin" : "");
+        bc_bench_line("handoff", metric, pc.p99, "ns", "lower");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:w:g:m:d:c:pJh")) != -1) {
+        switch (opt) {
+        case 'n': cfg.msgs = atol(optarg); break;
+        case 'w': cfg.warmup = atol(optarg); break;
+        case 'g': cfg.gap_ns = atof(optarg) * 1000.0; break;
+        case 'p': cfg.spin = 1; break;
+        case 'J': cfg.bench = 1; break;
+        case 'm':
+            if (!(cfg.methods = bc_parse_names(optarg, method_names, M_NUM))) return 2;
+            break;
+        case 'd':
+            if (!(cfg.dists = bc_parse_names(optarg, dist_names, D_CUSTOM))) return 2;
+            break;
+        case 'c':
+            if (sscanf(optarg, "%d,%d", &cfg.custom_a, &cfg.custom_b) != 2 ||
+                cfg.custom_a < 0 || cfg.custom_b < 0) {
+                fprintf(stderr, "-c wants A,B\n");
+                return 2;
+            }
+            cfg.dists = 1u << D_CUSTOM;
+            break;
+        default:
+            print_usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (cfg.msgs < 1 || cfg.warmup < 0 || cfg.gap_ns < 0) {
+        fprintf(stderr, "need MSGS >= 1, WARMUP >= 0 and GAP_US >= 0\n");
+        return 2;
+    }
+
+    hx.lat = malloc(cfg.msgs * sizeof(double));
+    if (!hx.lat) {
+        perror("malloc");
+        return 1;
+    }
+
+    printf("One-way handoff latency (ns): %ld messages, %ld warmup, %.1f us gap, receivers %s\n\n",
+           cfg.msgs, cfg.warmup, cfg.gap_ns / 1000.0, cfg.spin ? "busy-poll" : "sleep");
+
+    for (int d = 0; d < D_NUM; d++) {
+        if (!(cfg.dists & (1u << d))) continue;
+        struct pair p;
+        if (d == D_CUSTOM) {
+            p.sender_cpu = cfg.custom_a;
+            p.receiver_cpu = cfg.custom_b;
+        } else if (find_pair(d, &p) < 0) {
+            printf("%s: no such CPU pair on this machine\n\n", dist_labels[d]);
+            continue;
+        }
+
+        printf("%s (cpu %d -> cpu %d):\n", dist_labels[d], p.sender_cpu, p.receiver_cpu);
+        printf("  %-16s %9s %9s %9s %9s %9s %9s\n", "method", "min", "p50", "p90", "p99", "p99.9", "max");
+        for (int m = 0; m < M_NUM; m++)
+            if (cfg.methods & (1u << m)) run_method(d, &p, m);
+        printf("\n");
+    }
+
+    free(hx.lat);
+    return 0;
+}
@@ -0,0 +1,606 @@
+/*
+ * io_uring vs epoll vs preadv2 Baseline Comparison
+ *
+ * Runs identical workloads through four mechanisms so the pinned memory an
+ * io_uring deployment costs can be weighed against what it buys:
+ *
+ *   uring-fixed   io_uring, registered buffers (READ_FIXED / WRITE_FIXED)
+ *                 and registered files
+ *   uring         io_uring, plain READ / RECV / SEND on normal fds
+ *   epoll         epoll_wait + recvmmsg / sendmmsg (sockets only: regular
+ *                 files cannot be added to an epoll set)
+ *   preadv2       synchronous preadv2(RWF_NOWAIT); on a file, EAGAIN falls
+ *                 back to a blocking preadv2; on sockets the server polls
+ *
+ * Workloads:
+ *
+ *   rand4k        random 4 KiB reads from a page-cached file, QD in flight
+ *                 for io_uring, one at a time for preadv2. Latency is per read.
+ *   echo          QD AF_UNIX datagram socketpairs; a client thread keeps one
+ *                 64-byte message in flight per pair (epoll + send/recv, the
+ *                 same for every mechanism) and the mechanism under test
+ *                 echoes. Latency is the client's round trip.
+ *
+ * CPU/op is the measured thread's user+system time (RUSAGE_THREAD) per op;
+ * cycles/op comes from perf_event_open when available.
+ *
+ * Requires: Linux kernel >= 5.6 (RECV/SEND), liburing
+ *
+ * Usage: ./io_compare_bench [-w all|rand4k|echo] [-m MECHANISMS] [-q QD] [-n OPS]
+ *                           [-f FILE] [-S FILE_MB] [-c SERVER_CPU,CLIENT_CPU] [-J]
+ * Compile: gcc -O2 -o io_compare_bench io_compare_bench.c bench_common.c -luring -lpthread
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <liburing.h>
+
+#include "bench_common.h"
+
+#define READ_SIZE       4096
+#define MSG_SIZE        64
+#define MAX_QD          1024
+#define MMSG_BATCH      16
+#define DEFAULT_FILE    "/tmp/io_compare_bench.dat"
+
+enum { K_URING_FIXED, K_URING, K_EPOLL, K_PREADV2, K_NUM };
+static const char *mech_names[K_NUM] = { "uring-fixed", "uring", "epoll", "preadv2" };
+
+enum { W_RAND4K, W_ECHO, W_NUM };
+static const char *workload_names[W_NUM] = { "rand4k", "echo" };
+
+static struct {
+    unsigned workloads;
+    unsigned mechs;
+    unsigned qd;
+    long ops;
+    const char *file;
+    long file_mb;
+    int server_cpu, client_cpu;
+    int bench;
+} cfg = {
+    .workloads = (1u << W_NUM) - 1,
+    .mechs = (1u << K_NUM) - 1,
+    .qd = 32,
+    .ops = 200000,
+    .file = DEFAULT_FILE,
+    .file_mb = 64,
+    .server_cpu = -1,
+    .client_cpu = -1,
+};
+
+/* What the measured thread reports back */
+struct result {
+    long ops;
+    double elapsed_ns;
+    double cpu_ns;              /* RUSAGE_THREAD user + sys */
+    bc_perf_sample_t perf;
+    int sw_fallback;
+    long fallbacks;             /* preadv2: RWF_NOWAIT returned EAGAIN */
+    double *lat;                /* ops entries */
+    int err;
+};
+
+static void print_usage(const char *prog)
+{
+    printf("Usage: %s [options]\n", prog);
+    printf("  -w WORKLOAD   all, rand4k or echo (default all)\n");
+    printf("  -m LIST       comma list of uring-fixed,uring,epoll,preadv2 (default all)\n");
+    printf("  -q QD         reads in flight / socketpairs (default 32)\n");
+    printf("  -n OPS        reads or echoes per run (default 200000)\n");
+    printf("  -f FILE       rand4k file (default %s, created if missing)\n", DEFAULT_FILE);
+    printf("  -S MB         size when creating FILE (default 64)\n");
+    printf("  -c S,C        pin the measured (server) thread to S and the echo client to C\n");
+    printf("  -J            BENCH lines (for bench_suite.sh)\n");
+}
+
+static double thread_cpu_ns(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e9 +
+           (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e3;
+}
+
+/* Brackets the measured part of a run: wall clock, thread CPU, perf */
+struct meter {
+    bc_perf_t perf;
+    int perf_ok;
+    double t0, cpu0;
+};
+
+static void meter_start(struct meter *m)
+{
+    m->perf_ok = (bc_perf_open(&m->perf) == 0);
+    m->cpu0 = thread_cpu_ns();
+    bc_perf_start(&m->perf);
+    m->t0 = bc_now_ns();
+}
+
+static void meter_stop(struct meter *m, struct result *res)
+{
+    res->elapsed_ns = bc_now_ns() - m->t0;
+    bc_perf_stop(&m->perf, &res->perf);
+    res->cpu_ns = thread_cpu_ns() - m->cpu0;
+    res->sw_fallback = m->perf.sw_fallback;
+    if (!m->perf_ok) res->perf.mask = 0;
+    bc_perf_close(&m->perf);
+}
+
+/* ── rand4k ────────────────────────────────────────────────────────── */
+
+static int rand4k_uring(int fd, off_t blocks, char *bufs, int fixed, struct result *res)
+{
+    struct io_uring ring;
+    struct meter m;
+    double *slot_ts = calloc(cfg.qd, sizeof(double));
+    unsigned *free_slots = malloc(cfg.qd * sizeof(unsigned));
+    unsigned nfree = cfg.qd;
+    uint64_t rng = 0x9e3779b97f4a7c15ull;
+    long queued = 0, done = 0;
+    int ret = io_uring_queue_init(cfg.qd, &ring, 0);
+
+    for (unsigned i = 0; i < cfg.qd; i++) free_slots[i] = i;
+    if (ret < 0) { free(slot_ts); free(free_slots); return ret; }
+    if (fixed) {
+        struct iovec *iov = calloc(cfg.qd, sizeof(*iov));
+        for (unsigned i = 0; i < cfg.qd; i++) {
+            iov[i].iov_base = bufs + (size_t)i * READ_SIZE;
+            iov[i].iov_len = READ_SIZE;
+        }
+        ret = io_uring_register_buffers(&ring, iov, cfg.qd);
+        free(iov);
+        if (ret == 0) ret = io_uring_register_files(&ring, &fd, 1);
+        if (ret < 0) {
+            io_uring_queue_exit(&ring);
+            free(slot_ts);
+            free(free_slots);
+            return ret;
+        }
+    }
+
+    meter_start(&m);
+    for (;;) {
+        while (queued < cfg.ops && nfree > 0) {
+            unsigned slot = free_slots[--nfree];
+            off_t off = (off_t)(bc_rand(&rng) % (uint64_t)blocks) * READ_SIZE;
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+            char *buf = bufs + (size_t)slot * READ_SIZE;
+            if (fixed) {
+                io_uring_prep_read_fixed(sqe, 0, buf, READ_SIZE, off, (int)slot);
+                io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+            } else {
+                io_uring_prep_read(sqe, fd, buf, READ_SIZE, off);
+            }
+            io_uring_sqe_set_data64(sqe, slot);
+            slot_ts[slot] = bc_now_ns();
+            queued++;
+        }
+        if (done >= cfg.ops) break;
+
+        ret = io_uring_submit_and_wait(&ring, 1);
+        if (ret < 0) { res->err = ret; break; }
+        struct io_uring_cqe *cqe;
+        unsigned head, seen = 0;
+        double now = bc_now_ns();
+        io_uring_for_each_cqe(&ring, head, cqe) {
+            if (cqe->res < 0 && !res->err) res->err = cqe->res;
+            res->lat[done++] = now - slot_ts[cqe->user_data];
+            free_slots[nfree++] = (unsigned)cqe->user_data;
+            seen++;
+        }
+        io_uring_cq_advance(&ring, seen);
+        if (res->err) break;
+    }
+    meter_stop(&m, res);
+    res->ops = done;
+
+    io_uring_queue_exit(&ring);
+    free(slot_ts);
+    free(free_slots);
+    return 0;
+}
+
+static int rand4k_preadv2(int fd, off_t blocks, char *buf, struct result *res)
+{
+    struct meter m;
+    uint64_t rng = 0x9e3779b97f4a7c15ull;
+    struct iovec iov = { .iov_base = buf, .iov_len = READ_SIZE };
+
+    meter_start(&m);
+    for (long i = 0; i < cfg.ops; i++) {
+        off_t off = (off_t)(bc_rand(&rng) % (uint64_t)blocks) * READ_SIZE;
+        double t0 = bc_now_ns();
+        ssize_t r = preadv2(fd, &iov, 1, off, RWF_NOWAIT);
+        if (r < 0 && errno == EAGAIN) {
+            res->fallbacks++;
+            r = preadv2(fd, &iov, 1, off, 0);
+        }
+        if (r < 0) { res->err = -errno; break; }
+        res->lat[i] = bc_now_ns() - t0;
+        res->ops = i + 1;
+    }
+    meter_stop(&m, res);
+    return 0;
+}
+
+static int run_rand4k(int mech, struct result *res)
+{
+    if (mech == K_EPOLL) return -EPERM;     /* regular files are not pollable */
+
+    int ret = bc_ensure_file(cfg.file, READ_SIZE, cfg.file_mb);
+    if (ret < 0) return ret;
+    int fd = open(cfg.file, O_RDONLY);
+    if (fd < 0) return -errno;
+    struct stat st;
+    fstat(fd, &st);
+    off_t blocks = st.st_size / READ_SIZE;
+
+    /* Warm the page cache so every mechanism reads the same cached data */
+    static char chunk[1 << 20];
+    while (read(fd, chunk, sizeof(chunk)) > 0)
+        ;
+
+    char *bufs = aligned_alloc(4096, (size_t)cfg.qd * READ_SIZE);
+    if (!bufs) { close(fd); return -ENOMEM; }
+    memset(bufs, 0, (size_t)cfg.qd * READ_SIZE);
+
+    if (mech == K_PREADV2) ret = rand4k_preadv2(fd, blocks, bufs, res);
+    else ret = rand4k_uring(fd, blocks, bufs, mech == K_URING_FIXED, res);
+
+    free(bufs);
+    close(fd);
+    return ret;
+}
+
+/* ── echo ──────────────────────────────────────────────────────────── */
+
+struct echo {
+    int (*pairs)[2];            /* [i][0] client end, [i][1] server end */
+    char *bufs;                 /* server buffer per pair */
+    struct result *res;
+    _Atomic int stop;
+    _Atomic int client_err;     /* set when the client gives up; the server stops */
+};
+
+/* Load generator: one message in flight per pair, RTT per echo */
+static void *echo_client(void *arg)
+{
+    struct echo *e = arg;
+    struct epoll_event evs[64];
+    double *sent = calloc(cfg.qd, sizeof(double));
+    char msg[MSG_SIZE];
+    long queued = 0, done = 0;
+    int ep = epoll_create1(0);
+
+    if (!sent || ep < 0) {
+        e->client_err = ep < 0 ? -errno : -ENOMEM;
+        goto out;
+    }
+    if (cfg.client_cpu >= 0) bc_pin_cpu(cfg.client_cpu);
+    memset(msg, 0x42, sizeof(msg));
+    for (unsigned i = 0; i < cfg.qd; i++) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = i };
+        epoll_ctl(ep, EPOLL_CTL_ADD, e->pairs[i][0], &ev);
+    }
+    for (unsigned i = 0; i < cfg.qd && queued < cfg.ops; i++, queued++) {
+        sent[i] = bc_now_ns();
+        if (send(e->pairs[i][0], msg, sizeof(msg), 0) < 0) { e->client_err = -errno; goto out; }
+    }
+
+    while (done < cfg.ops && !atomic_load(&e->stop)) {
+        int n = epoll_wait(ep, evs, 64, 100);
+        for (int k = 0; k < n; k++) {
+            unsigned i = evs[k].data.u32;
+            while (recv(e->pairs[i][0], msg, sizeof(msg), MSG_DONTWAIT) > 0) {
+                double now = bc_now_ns();
+                if (done < cfg.ops) e->res->lat[done] = now - sent[i];
+                done++;
+                if (queued < cfg.ops) {
+                    sent[i] = bc_now_ns();
+                    queued++;
+                    if (send(e->pairs[i][0], msg, sizeof(msg), 0) < 0) { e->client_err = -errno; goto out; }
+                }
+            }
+        }
+    }
+out:
+    if (ep >= 0) close(ep);
+    free(sent);
+    return NULL;
+}
+
+static long echo_uring(struct echo *e, int fixed, struct result *res)
+{
+    struct io_uring ring;
+    long echoed = 0;
+    int ret = io_uring_queue_init(cfg.qd * 2, &ring, 0);
+
+    if (ret < 0) { res->err = ret; return 0; }
+    if (fixed) {
+        struct iovec iov = { .iov_base = e->bufs, .iov_len = (size_t)cfg.qd * READ_SIZE };
+        int *fds = malloc(cfg.qd * sizeof(int));
+        for (unsigned i = 0; i < cfg.qd; i++) fds[i] = e->pairs[i][1];
+        ret = io_uring_register_buffers(&ring, &iov, 1);
+        if (ret == 0) ret = io_uring_register_files(&ring, fds, cfg.qd);
+        free(fds);
+        if (ret < 0) { res->err = ret; io_uring_queue_exit(&ring); return 0; }
+    }
+
+    /* user_data: pair index << 1 | 1 for the echo write */
+    for (unsigned i = 0; i < cfg.qd; i++) {
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+        char *buf = e->bufs + (size_t)i * READ_SIZE;
+        if (fixed) {
+            io_uring_prep_read_fixed(sqe, (int)i, buf, MSG_SIZE, 0, 0);
+            io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+        } else {
+            io_uring_prep_recv(sqe, e->pairs[i][1], buf, MSG_SIZE, 0);
+        }
+        io_uring_sqe_set_data64(sqe, (uint64_t)i << 1);
+    }
+
+    /* Bounded wait so a failed client cannot leave the server blocked */
+    while (echoed < cfg.ops && !res->err && !e->client_err) {
+        struct __kernel_timespec ts = { .tv_sec = 0, .tv_nsec = 100 * 1000 * 1000 };
+        struct io_uring_cqe *cqe;
+        ret = io_uring_submit_and_wait_timeout(&ring, &cqe, 1, &ts, NULL);
+        if (ret < 0 && ret != -EINTR && ret != -ETIME) { res->err = ret; break; }
+        unsigned head, seen = 0;
+        io_uring_for_each_cqe(&ring, head, cqe) {
+            unsigned i = (unsigned)(cqe->user_data >> 1);
+            int is_write = (int)(cqe->user_data & 1);
+            char *buf = e->bufs + (size_t)i * READ_SIZE;
+            seen++;
+            if (cqe->res < 0) {
+                if (!res->err) res->err = cqe->res;
+                continue;
+            }
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+            if (is_write) {
+                echoed++;
+                if (fixed) {
+                    io_uring_prep_read_fixed(sqe, (int)i, buf, MSG_SIZE, 0, 0);
+                    io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+                } else {
+                    io_uring_prep_recv(sqe, e->pairs[i][1], buf, MSG_SIZE, 0);
+                }
+                io_uring_sqe_set_data64(sqe, (uint64_t)i << 1);
+            } else {
+                if (fixed) {
+                    io_uring_prep_write_fixed(sqe, (int)i, buf, (unsigned)cqe->res, 0, 0);
+                    io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+                } else {
+                    io_uring_prep_send(sqe, e->pairs[i][1], buf, (size_t)cqe->res, 0);
+                }
+                io_uring_sqe_set_data64(sqe, ((uint64_t)i << 1) | 1);
+            }
+        }
+        io_uring_cq_advance(&ring, seen);
+    }
+    io_uring_queue_exit(&ring);
+    return echoed;
+}
+
+static long echo_epoll(struct echo *e, struct result *res)
+{
+    struct epoll_event evs[64];
+    struct mmsghdr msgs[MMSG_BATCH];
+    struct iovec iovs[MMSG_BATCH];
+    long echoed = 0;
+    int ep = epoll_create1(0);
+
+    if (ep < 0) { res->err = -errno; return 0; }
+    for (unsigned i = 0; i < cfg.qd; i++) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = i };
+        epoll_ctl(ep, EPOLL_CTL_ADD, e->pairs[i][1], &ev);
+    }
+
+    while (echoed < cfg.ops && !e->client_err) {
+        int n = epoll_wait(ep, evs, 64, 100);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            res->err = -errno;
+            break;
+        }
+        for (int k = 0; k < n; k++) {
+            unsigned i = evs[k].data.u32;
+            int fd = e->pairs[i][1];
+            char *base = e->bufs + (size_t)i * READ_SIZE;
+            memset(msgs, 0, sizeof(msgs));
+            for (int j = 0; j < MMSG_BATCH; j++) {
+                iovs[j].iov_base = base + j * MSG_SIZE;
+                iovs[j].iov_len = MSG_SIZE;
+                msgs[j].msg_hdr.msg_iov = &iovs[j];
+                msgs[j].msg_hdr.msg_iovlen = 1;
+            }
+            int got = recvmmsg(fd, msgs, MMSG_BATCH, MSG_DONTWAIT, NULL);
+            if (got <= 0) continue;
+            for (int j = 0; j < got; j++) iovs[j].iov_len = msgs[j].msg_len;
+            int sent = sendmmsg(fd, msgs, (unsigned)got, 0);
+            if (sent < 0) { res->err = -errno; break; }
+            echoed += sent;
+        }
+        if (res->err) break;
+    }
+    close(ep);
+    return echoed;
+}
+
+/* Synchronous server: poll every socket with RWF_NOWAIT, echo what arrives */
+static long echo_preadv2(struct echo *e, struct result *res)
+{
+    long echoed = 0;
+
+    while (echoed < cfg.ops && !e->client_err) {
+        for (unsigned i = 0; i < cfg.qd && echoed < cfg.ops; i++) {
+            struct iovec iov = { .iov_base = e->bufs + (size_t)i * READ_SIZE, .iov_len = MSG_SIZE };
+            ssize_t r = preadv2(e->pairs[i][1], &iov, 1, -1, RWF_NOWAIT);
+            if (r < 0) {
+                if (errno == EAGAIN) continue;
+                res->err = -errno;
+                return echoed;
+            }
+            iov.iov_len = (size_t)r;
+            if (pwritev2(e->pairs[i][1], &iov, 1, -1, 0) < 0) {
+                res->err = -errno;
+                return echoed;
+            }
+            echoed++;
+        }
+    }
+    return echoed;
+}
+
+static int run_echo(int mech, struct result *res)
+{
+    struct echo e;
+    struct meter m;
+    pthread_t client;
+    int ret = 0;
+
+    memset(&e, 0, sizeof(e));
+    e.res = res;
+    e.pairs = calloc(cfg.qd, sizeof(*e.pairs));
+    e.bufs = aligned_alloc(4096, (size_t)cfg.qd * READ_SIZE);
+    if (!e.pairs || !e.bufs) return -ENOMEM;
+    unsigned made = 0;
+    for (; made < cfg.qd; made++) {
+        if (socketpair(AF_UNIX, SOCK_DGRAM, 0, e.pairs[made]) < 0) { ret = -errno; goto out; }
+    }
+
+    meter_start(&m);
+    if (pthread_create(&client, NULL, echo_client, &e) != 0) {
+        ret = -EAGAIN;
+        bc_perf_close(&m.perf);
+        goto out;
+    }
+    long echoed;
+    if (mech == K_EPOLL) echoed = echo_epoll(&e, res);
+    else if (mech == K_PREADV2) echoed = echo_preadv2(&e, res);
+    else echoed = echo_uring(&e, mech == K_URING_FIXED, res);
+    meter_stop(&m, res);
+
+    atomic_store(&e.stop, 1);
+    pthread_join(client, NULL);
+    if (!res->err && e.client_err) res->err = e.client_err;
+    res->ops = echoed;
+
+out:
+    while (made-- > 0) { close(e.pairs[made][0]); close(e.pairs[made][1]); }
+    free(e.pairs);
+    free(e.bufs);
+    return ret;
+}
+
+/* ── Driver ────────────────────────────────────────────────────────── */
+
+static int run_one(int workload, int mech)
+{
+    struct result res;
+    memset(&res, 0, sizeof(res));
+    res.lat = calloc(cfg.ops, sizeof(double));
+    if (!res.lat) return 1;
+
+    int ret = workload == W_RAND4K ? run_rand4k(mech, &res) : run_echo(mech, &res);
+    int rc = 0;
+    if (ret == -EPERM && workload == W_RAND4K && mech == K_EPOLL) {
+        printf("  %-12s n/a (regular files cannot be polled)\n", mech_names[mech]);
+    } else if (ret < 0 || res.err) {
+        printf("  %-12s failed: %s\n", mech_names[mech], strerror(-(ret < 0 ? ret : res.err)));
+        rc = 1;
+    } else if (res.ops > 0) {
+        bc_pct_t pc;
+        size_t n = (size_t)(res.ops < cfg.ops ? res.ops : cfg.ops);
+        bc_percentiles(res.lat, n, &pc);
+        double kops = res.ops / (res.elapsed_ns / 1e9) / 1e3;
+        double cpu_op = res.cpu_ns / res.ops;
+        char cyc[24] = "-";
+        if (res.perf.mask & (1u << BC_PC_CYCLES))
+            snprintf(cyc, sizeof(cyc), "%.0f%s", (double)res.perf.v[BC_PC_CYCLES] / res.ops,
+                     res.sw_fallback ? "ns" : "");
+        printf("  %-12s %9.1f %10.0f %10s %9.0f %9.0f %9.0f", mech_names[mech],
+               kops, cpu_op, cyc, pc.p50, pc.p99, pc.p999);
+        if (mech == K_PREADV2 && workload == W_RAND4K)
+            printf("  (%ld EAGAIN fallbacks)", res.fallbacks);
+        printf("\n");
+
+        if (cfg.bench) {
+            char metric[96];
+            snprintf(metric, sizeof(metric), "%s.%s.kops", workload_names[workload], mech_names[mech]);
+            bc_bench_line("io_compare", metric, kops, "Kops/s", "higher");
+            snprintf(metric, sizeof(metric), "%s.%s.cpu_ns_per_op", workload_names[workload], mech_names[mech]);
+            bc_bench_line("io_compare", metric, cpu_op, "ns", "lower");
+            snprintf(metric, sizeof(metric), "%s.%s.p99_ns", workload_names[workload], mech_names[mech]);
+            bc_bench_line("io_compare", metric, pc.p99, "ns", "lower");
+        }
+    }
+    free(res.lat);
+    return rc;
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:m:q:n:f:S:c:Jh")) != -1) {
+        switch (opt) {
+        case 'w':
+            if (strcmp(optarg, "all") == 0) cfg.workloads = (1u << W_NUM) - 1;
+            else if (!(cfg.workloads = bc_parse_names(optarg, workload_names, W_NUM))) return 2;
+            break;
+        case 'm':
+            if (!(cfg.mechs = bc_parse_names(optarg, mech_names, K_NUM))) return 2;
+            break;
+        case 'q': cfg.qd = (unsigned)atoi(optarg); break;
+        case 'n': cfg.ops = atol(optarg); break;
+        case 'f': cfg.file = optarg; break;
+        case 'S': cfg.file_mb = atol(optarg); break;
+        case 'c':
+            if (sscanf(optarg, "%d,%d", &cfg.server_cpu, &cfg.client_cpu) != 2) {
+                fprintf(stderr, "-c wants SERVER_CPU,CLIENT_CPU\n");
+                return 2;
+            }
+            break;
+        case 'J': cfg.bench = 1; break;
+        default:
+            print_usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (cfg.qd < 1 || cfg.qd > MAX_QD || cfg.ops < 1 || cfg.file_mb < 1) {
+        fprintf(stderr, "need 1 <= QD <= %d, OPS >= 1 and FILE_MB >= 1\n", MAX_QD);
+        return 2;
+    }
+    if (cfg.server_cpu >= 0) bc_pin_cpu(cfg.server_cpu);
+
+    printf("Mechanism comparison: QD %u, %ld ops per run\n\n", cfg.qd, cfg.ops);
+
+    int rc = 0;
+    for (int w = 0; w < W_NUM; w++) {
+        if (!(cfg.workloads & (1u << w))) continue;
+        printf("%s:\n", w == W_RAND4K ? "rand4k (random 4 KiB page-cache reads)"
+                                      : "echo (64-byte datagrams, client RTT)");
+        printf("  %-12s %9s %10s %10s %9s %9s %9s\n",
+               "mechanism", "Kops/s", "CPU ns/op", "cyc/op", "p50 ns", "p99 ns", "p99.9 ns");
+        for (int k = 0; k < K_NUM; k++)
+            if (cfg.mechs & (1u << k)) rc |= run_one(w, k);
+        printf("\n");
+    }
+    printf("CPU ns/op and cyc/op cover the measured thread only (for echo, the\n");
+    printf("server); the echo client is identical for every mechanism.\n");
+    return rc;
+}
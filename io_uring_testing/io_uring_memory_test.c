@@ -7,7 +7,11 @@
  * 3. Maximum ring sizes and their memory implications
  * 
  * Requires: Linux kernel >= 5.1, liburing
- * Compile: gcc -o io_uring_memory_test io_uring_memory_test.c -luring -lpthread
+ *
+ * Usage: ./io_uring_memory_test                full report
+ *        ./io_uring_memory_test --bench        BENCH lines only (setup cost, NOP latency)
+ *        ./io_uring_memory_test --nop-matrix   NOP round trip across QD, batch and setup mode
+ * Compile: gcc -o io_uring_memory_test io_uring_memory_test.c ../ring_model/ring_model.c -luring -lpthread
  */
 
 #define _GNU_SOURCE
@@ -23,6 +27,19 @@
 #include <time.h>
 #include <liburing.h>
 
+#include "../ring_model/ring_model.h"
+
+/* Setup flags newer than some distro headers */
+#ifndef IORING_SETUP_COOP_TASKRUN
+#define IORING_SETUP_COOP_TASKRUN   (1U << 8)   /* 5.19 */
+#endif
+#ifndef IORING_SETUP_SINGLE_ISSUER
+#define IORING_SETUP_SINGLE_ISSUER  (1U << 12)  /* 6.0 */
+#endif
+#ifndef IORING_SETUP_DEFER_TASKRUN
+#define IORING_SETUP_DEFER_TASKRUN  (1U << 13)  /* 6.1 */
+#endif
+
 /* Structure to hold test results */
 struct memory_test_result {
     unsigned int sq_entries;
@@ -78,14 +95,10 @@ static struct io_uring_tunable tunables[] = {
 
 /*
  * Calculate expected memory sizes for io_uring structures
- * 
- * SQ Ring memory layout:
- *   - Header: struct io_sq_ring (~40 bytes)
- *   - sq_array: unsigned int[sq_entries] (4 * sq_entries bytes)
- *   
- * CQ Ring memory layout:
- *   - Header: struct io_cq_ring (~40 bytes)  
- *   - cqes: struct io_uring_cqe[cq_entries] (16 * cq_entries bytes)
+ *
+ * Delegates to the shared ring model (../ring_model). With
+ * IORING_FEAT_SINGLE_MMAP the SQ index array lives in the CQ ring mapping,
+ * so *sq_ring is 0 and *cq_ring covers both rings.
  *
  * SQE Array:
  *   - struct io_uring_sqe[sq_entries] (64 * sq_entries bytes)
@@ -93,30 +106,35 @@ static struct io_uring_tunable tunables[] = {
 void calculate_expected_memory(unsigned int sq_entries, unsigned int cq_entries,
                                size_t *sq_ring, size_t *cq_ring, size_t *sqe_array)
 {
-    /* io_uring_sqe is 64 bytes */
-    const size_t SQE_SIZE = 64;
-    
-    /* io_uring_cqe is 16 bytes (or 32 bytes with CQE32 flag) */
-    const size_t CQE_SIZE = 16;
-    
-    /* Ring header overhead (approximate) */
-    const size_t SQ_RING_HEADER = 128;
-    const size_t CQ_RING_HEADER = 128;
-    
-    /* SQ ring: header + array of indices */
-    *sq_ring = SQ_RING_HEADER + (sq_entries * sizeof(unsigned int));
-    
-    /* CQ ring: header + array of CQEs */
-    *cq_ring = CQ_RING_HEADER + (cq_entries * CQE_SIZE);
-    
-    /* SQE array: array of SQEs */
-    *sqe_array = sq_entries * SQE_SIZE;
-    
-    /* Round up to page size */
-    long page_size = sysconf(_SC_PAGESIZE);
-    *sq_ring = ((*sq_ring + page_size - 1) / page_size) * page_size;
-    *cq_ring = ((*cq_ring + page_size - 1) / page_size) * page_size;
-    *sqe_array = ((*sqe_array + page_size - 1) / page_size) * page_size;
+    rm_ring_config_t cfg = {
+        .sq_entries = sq_entries,
+        .cq_entries = cq_entries,
+    };
+    rm_ring_memory_t m;
+    rm_calc(rm_params(), &cfg, &m);
+
+    *sq_ring = m.sq_ring_bytes;
+    *cq_ring = m.cq_ring_bytes;
+    *sqe_array = m.sqe_array_bytes;
+}
+
+/*
+ * Bytes a ring actually maps, comparable with the model
+ *
+ * liburing reports unaligned ring sizes and, with IORING_FEAT_SINGLE_MMAP,
+ * the same mapping in both sq.ring_sz and cq.ring_sz. The kernel maps whole
+ * pages, so align each mapping and count the shared one once.
+ */
+size_t mapped_ring_bytes(const struct io_uring *ring, size_t sqe_size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t sq_sz = ring->sq.ring_sz, cq_sz = ring->cq.ring_sz;
+    size_t rings = (ring->features & IORING_FEAT_SINGLE_MMAP)
+                 ? (sq_sz > cq_sz ? sq_sz : cq_sz)
+                 : (sq_sz + page - 1) / page * page + cq_sz;
+    size_t sqes = (size_t)ring->sq.ring_entries * sqe_size;
+
+    return (rings + page - 1) / page * page + (sqes + page - 1) / page * page;
 }
 
 /*
@@ -157,9 +175,8 @@ int test_io_uring_memory(unsigned int entries, unsigned int flags,
     /* Calculate SQE array size */
     result->sqe_array_size = params.sq_entries * sizeof(struct io_uring_sqe);
     
-    /* Total memory (excluding kernel-side structures) */
-    result->total_memory = result->sq_ring_size + result->cq_ring_size + 
-                          result->sqe_array_size;
+    /* Total mapped memory (excluding kernel-side structures) */
+    result->total_memory = mapped_ring_bytes(&ring, sizeof(struct io_uring_sqe));
     
     io_uring_queue_exit(&ring);
     return 0;
@@ -271,13 +288,13 @@ void run_entry_count_tests(void)
                                   1024, 2048, 4096, 8192, 16384, 32768};
     int num_tests = sizeof(test_sizes) / sizeof(test_sizes[0]);
     
-    printf("%-10s %-10s %-10s %-12s %-12s %-12s %-12s\n",
+    printf("%-10s %-10s %-10s %-12s %-12s %-12s %-12s %-12s\n",
            "Requested", "SQ Actual", "CQ Actual", "SQ Ring", "CQ Ring", 
-           "SQE Array", "Total");
-    printf("%-10s %-10s %-10s %-12s %-12s %-12s %-12s\n",
+           "SQE Array", "Total", "Model");
+    printf("%-10s %-10s %-10s %-12s %-12s %-12s %-12s %-12s\n",
            "Entries", "Entries", "Entries", "(bytes)", "(bytes)", 
-           "(bytes)", "(bytes)");
-    printf("--------------------------------------------------------------------------\n");
+           "(bytes)", "(bytes)", "(bytes)");
+    printf("---------------------------------------------------------------------------------------\n");
     
     for (int i = 0; i < num_tests; i++) {
         struct memory_test_result result;
@@ -286,10 +303,13 @@ void run_entry_count_tests(void)
         int ret = test_io_uring_memory(test_sizes[i], 0, &result);
         
         if (ret == 0 && result.setup_success) {
-            printf("%-10u %-10u %-10u %-12zu %-12zu %-12zu %-12zu\n",
+            size_t exp_sq, exp_cq, exp_sqe;
+            calculate_expected_memory(test_sizes[i], 0, &exp_sq, &exp_cq, &exp_sqe);
+            printf("%-10u %-10u %-10u %-12zu %-12zu %-12zu %-12zu %-12zu\n",
                    test_sizes[i], result.sq_entries, result.cq_entries,
                    result.sq_ring_size, result.cq_ring_size,
-                   result.sqe_array_size, result.total_memory);
+                   result.sqe_array_size, result.total_memory,
+                   exp_sq + exp_cq + exp_sqe);
         } else {
             printf("%-10u FAILED: %s\n", test_sizes[i], result.error_msg);
         }
@@ -317,10 +337,9 @@ void run_cqsize_tests(void)
         int ret = io_uring_queue_init(1024, &ring, 0);
         if (ret == 0) {
             printf("%-15s %-10u %-10u %-12zu %-12zu\n",
-                   "Default (2x)", ring.sq.ring_sz, ring.cq.ring_entries,
+                   "Default (2x)", ring.sq.ring_entries, ring.cq.ring_entries,
                    ring.cq.ring_sz,
-                   ring.sq.ring_sz + ring.cq.ring_sz + 
-                   ring.sq.ring_entries * sizeof(struct io_uring_sqe));
+                   mapped_ring_bytes(&ring, sizeof(struct io_uring_sqe)));
             io_uring_queue_exit(&ring);
         }
     }
@@ -342,8 +361,7 @@ void run_cqsize_tests(void)
             printf("%-15s %-10u %-10u %-12zu %-12zu\n",
                    mult_str, params.sq_entries, params.cq_entries,
                    ring.cq.ring_sz,
-                   ring.sq.ring_sz + ring.cq.ring_sz +
-                   params.sq_entries * sizeof(struct io_uring_sqe));
+                   mapped_ring_bytes(&ring, sizeof(struct io_uring_sqe)));
             io_uring_queue_exit(&ring);
         } else {
             printf("%-15s FAILED: %s\n", "custom", strerror(-ret));
@@ -374,8 +392,7 @@ void run_extended_entry_tests(void)
         if (ret == 0) {
             printf("%-20s %-15s %-15s %-12zu\n",
                    "Standard", "64 bytes", "16 bytes",
-                   ring.sq.ring_sz + ring.cq.ring_sz +
-                   entries * sizeof(struct io_uring_sqe));
+                   mapped_ring_bytes(&ring, sizeof(struct io_uring_sqe)));
             io_uring_queue_exit(&ring);
         }
     }
@@ -392,8 +409,7 @@ void run_extended_entry_tests(void)
         if (ret == 0) {
             printf("%-20s %-15s %-15s %-12zu\n",
                    "SQE128", "128 bytes", "16 bytes",
-                   ring.sq.ring_sz + ring.cq.ring_sz +
-                   entries * 128);  /* 128-byte SQEs */
+                   mapped_ring_bytes(&ring, 128));
             io_uring_queue_exit(&ring);
         } else {
             printf("%-20s Not supported\n", "SQE128");
@@ -415,8 +431,7 @@ void run_extended_entry_tests(void)
         if (ret == 0) {
             printf("%-20s %-15s %-15s %-12zu\n",
                    "CQE32", "64 bytes", "32 bytes",
-                   ring.sq.ring_sz + ring.cq.ring_sz +
-                   entries * sizeof(struct io_uring_sqe));
+                   mapped_ring_bytes(&ring, sizeof(struct io_uring_sqe)));
             io_uring_queue_exit(&ring);
         } else {
             printf("%-20s Not supported\n", "CQE32");
@@ -438,8 +453,7 @@ void run_extended_entry_tests(void)
         if (ret == 0) {
             printf("%-20s %-15s %-15s %-12zu\n",
                    "SQE128 + CQE32", "128 bytes", "32 bytes",
-                   ring.sq.ring_sz + ring.cq.ring_sz +
-                   entries * 128);
+                   mapped_ring_bytes(&ring, 128));
             io_uring_queue_exit(&ring);
         } else {
             printf("%-20s Not supported\n", "SQE128 + CQE32");
@@ -490,8 +504,7 @@ void run_memlock_tests(void)
         struct io_uring ring;
         int ret = io_uring_queue_init(max_working, &ring, 0);
         if (ret == 0) {
-            size_t total = ring.sq.ring_sz + ring.cq.ring_sz + 
-                          ring.sq.ring_entries * sizeof(struct io_uring_sqe);
+            size_t total = mapped_ring_bytes(&ring, sizeof(struct io_uring_sqe));
             printf("Maximum working ring size: %u entries\n", max_working);
             printf("Memory required: %zu bytes (%zu KB)\n", total, total / 1024);
             io_uring_queue_exit(&ring);
@@ -580,16 +593,279 @@ void print_summary_and_recommendations(void)
     printf("   - Use IORING_SETUP_CQSIZE for bursty workloads\n");
     printf("   - Set CQ 4-8x SQ for producer-consumer patterns\n\n");
     
-    printf("4. Memory Formula (approximate):\n");
-    printf("   Total = SQ_ring + CQ_ring + SQE_array\n");
+    printf("4. Memory Formula (shared ring model):\n");
+    printf("   Total = Rings + SQE_Array\n");
     printf("   Where:\n");
-    printf("   - SQ_ring ≈ page_align(128 + 4*sq_entries)\n");
-    printf("   - CQ_ring ≈ page_align(128 + 16*cq_entries)\n");
-    printf("   - SQE_array ≈ page_align(64*sq_entries)\n\n");
+    rm_print_formula(stdout, rm_params(), "   - ");
+    printf("\n");
+}
+
+/*
+ * Benchmark mode: one "BENCH <metric> <value> <unit> <lower|higher>" line per
+ * metric, collected across runs and kernels by bench_suite.sh
+ */
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+#define BENCH_SETUP_ITERS   200
+#define BENCH_NOP_ITERS     20000
+#define BENCH_NOP_BATCH     32
+#define BENCH_RINGS         64
+
+/*
+ * NOP round-trip matrix: submit -> reap latency of every NOP and overall
+ * throughput, keeping qd NOPs in flight and submitting batch at a time.
+ * The cheapest io_uring round trip a kernel can do, per setup mode.
+ */
+#define MATRIX_NOPS         20000
+
+struct nop_mode {
+    const char *name;
+    unsigned int flags;
+    int register_ring_fd;
+};
+
+static const struct nop_mode nop_modes[] = {
+    {"default",       0,                                                        0},
+    {"sqpoll",        IORING_SETUP_SQPOLL,                                      0},
+    {"coop_taskrun",  IORING_SETUP_COOP_TASKRUN,                                0},
+    {"defer_taskrun", IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN,  0},
+    {"regfd",         0,                                                        1},
+};
+#define NUM_NOP_MODES (sizeof(nop_modes) / sizeof(nop_modes[0]))
+
+static const unsigned int matrix_qds[] = {1, 8, 32, 128};
+static const unsigned int matrix_batches[] = {1, 8, 32};
+
+struct nop_cell {
+    double p50_ns;
+    double p99_ns;
+    double p999_ns;
+    double mops;
+};
+
+int run_nop_cell(const struct nop_mode *mode, unsigned int qd, unsigned int batch,
+                 struct nop_cell *out)
+{
+    static double lat[MATRIX_NOPS];
+    struct io_uring ring;
+    struct io_uring_params params;
+    long submitted = 0, reaped = 0;
+    unsigned int inflight = 0;
+    int ret;
+
+    memset(&params, 0, sizeof(params));
+    params.flags = mode->flags;
+    if (mode->flags & IORING_SETUP_SQPOLL)
+        params.sq_thread_idle = 1000;   /* ms; stays awake for the whole cell */
+
+    ret = io_uring_queue_init_params(qd, &ring, &params);
+    if (ret < 0)
+        return ret;
+    if (mode->register_ring_fd) {
+        ret = io_uring_register_ring_fd(&ring);
+        if (ret != 1) {
+            io_uring_queue_exit(&ring);
+            return ret < 0 ? ret : -EINVAL;
+        }
+    }
+
+    double t0 = now_ns();
+    while (reaped < MATRIX_NOPS) {
+        /* Top up in whole batches while there is room; wait once full */
+        if (submitted < MATRIX_NOPS && inflight + batch <= qd) {
+            unsigned int k = MATRIX_NOPS - submitted < batch ? (unsigned int)(MATRIX_NOPS - submitted) : batch;
+            uint64_t ts = (uint64_t)now_ns();
+            for (unsigned int i = 0; i < k; i++) {
+                struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+                if (!sqe) {
+                    fprintf(stderr, "io_uring_get_sqe: submission queue full\n");
+                    io_uring_queue_exit(&ring);
+                    return -EBUSY;
+                }
+                io_uring_prep_nop(sqe);
+                io_uring_sqe_set_data64(sqe, ts);
+            }
+            submitted += k;
+            inflight += k;
+            if (submitted < MATRIX_NOPS && inflight + batch <= qd) {
+                ret = io_uring_submit(&ring);
+                if (ret < 0) break;
+                continue;
+            }
+        }
+
+        ret = io_uring_submit_and_wait(&ring, inflight < batch ? inflight : batch);
+        if (ret < 0) break;
+
+        struct io_uring_cqe *cqe;
+        unsigned int head, seen = 0;
+        double now = now_ns();
+        io_uring_for_each_cqe(&ring, head, cqe) {
+            if (reaped < MATRIX_NOPS)
+                lat[reaped++] = now - (double)cqe->user_data;
+            seen++;
+        }
+        io_uring_cq_advance(&ring, seen);
+        inflight -= seen;
+    }
+    double elapsed = now_ns() - t0;
+    io_uring_queue_exit(&ring);
+    if (ret < 0)
+        return ret;
+
+    qsort(lat, MATRIX_NOPS, sizeof(double), cmp_double);
+    out->p50_ns = lat[MATRIX_NOPS / 2];
+    out->p99_ns = lat[MATRIX_NOPS * 99 / 100];
+    out->p999_ns = lat[MATRIX_NOPS * 999 / 1000];
+    out->mops = MATRIX_NOPS / (elapsed / 1e3);
+    return 0;
+}
+
+int run_nop_matrix(void)
+{
+    struct nop_cell cell;
+
+    printf("NOP round trip (submit -> reap), %d NOPs per cell\n\n", MATRIX_NOPS);
+    printf("%-14s %5s %6s %10s %10s %10s %10s\n",
+           "Mode", "QD", "Batch", "p50 ns", "p99 ns", "p99.9 ns", "Mops/s");
+    printf("--------------------------------------------------------------------------\n");
+
+    for (size_t m = 0; m < NUM_NOP_MODES; m++) {
+        for (size_t q = 0; q < sizeof(matrix_qds) / sizeof(matrix_qds[0]); q++) {
+            for (size_t b = 0; b < sizeof(matrix_batches) / sizeof(matrix_batches[0]); b++) {
+                if (matrix_batches[b] > matrix_qds[q])
+                    continue;
+                int ret = run_nop_cell(&nop_modes[m], matrix_qds[q], matrix_batches[b], &cell);
+                if (ret < 0) {
+                    printf("%-14s not supported: %s\n", nop_modes[m].name, strerror(-ret));
+                    goto next_mode;
+                }
+                printf("%-14s %5u %6u %10.0f %10.0f %10.0f %10.2f\n", nop_modes[m].name,
+                       matrix_qds[q], matrix_batches[b],
+                       cell.p50_ns, cell.p99_ns, cell.p999_ns, cell.mops);
+            }
+        }
+next_mode:
+        printf("\n");
+    }
+
+    printf("QD = NOPs kept in flight, Batch = SQEs per io_uring_submit; latency is\n");
+    printf("per NOP from just before its batch is queued to the reap loop seeing it.\n");
+    return 0;
+}
+
+int run_bench(void)
+{
+    static const unsigned int sizes[] = {64, 256, 1024, 4096};
+    static double samples[BENCH_SETUP_ITERS];
+    struct io_uring ring;
+    int ret;
+
+    /* Ring setup + teardown cost, median per size */
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        int n = 0;
+        for (int it = 0; it < BENCH_SETUP_ITERS; it++) {
+            double t0 = now_ns();
+            ret = io_uring_queue_init(sizes[i], &ring, 0);
+            double t1 = now_ns();
+            if (ret < 0) {
+                fprintf(stderr, "io_uring_queue_init(%u): %s\n", sizes[i], strerror(-ret));
+                return 1;
+            }
+            io_uring_queue_exit(&ring);
+            samples[n++] = (t1 - t0) / 1e3;
+        }
+        qsort(samples, n, sizeof(double), cmp_double);
+        printf("BENCH io_uring_memory_test.setup_us.%u %.3f us lower\n", sizes[i], samples[n / 2]);
+    }
+
+    ret = io_uring_queue_init(256, &ring, 0);
+    if (ret < 0) return 1;
+
+    /* NOP round trip: submit one, wait for it */
+    double t0 = now_ns();
+    for (int it = 0; it < BENCH_NOP_ITERS; it++) {
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+        struct io_uring_cqe *cqe;
+        if (!sqe) {
+            fprintf(stderr, "io_uring_get_sqe: submission queue full\n");
+            io_uring_queue_exit(&ring);
+            return 1;
+        }
+        io_uring_prep_nop(sqe);
+        io_uring_submit_and_wait(&ring, 1);
+        if (io_uring_peek_cqe(&ring, &cqe) == 0) io_uring_cqe_seen(&ring, cqe);
+    }
+    printf("BENCH io_uring_memory_test.nop_rtt_ns %.1f ns lower\n", (now_ns() - t0) / BENCH_NOP_ITERS);
+
+    /* Batched NOP throughput */
+    t0 = now_ns();
+    for (int it = 0; it < BENCH_NOP_ITERS / BENCH_NOP_BATCH; it++) {
+        for (int b = 0; b < BENCH_NOP_BATCH; b++) {
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+            if (!sqe) {
+                fprintf(stderr, "io_uring_get_sqe: submission queue full\n");
+                io_uring_queue_exit(&ring);
+                return 1;
+            }
+            io_uring_prep_nop(sqe);
+        }
+        io_uring_submit_and_wait(&ring, BENCH_NOP_BATCH);
+        io_uring_cq_advance(&ring, BENCH_NOP_BATCH);
+    }
+    double el = now_ns() - t0;
+    int done = (BENCH_NOP_ITERS / BENCH_NOP_BATCH) * BENCH_NOP_BATCH;
+    printf("BENCH io_uring_memory_test.nop_batch%d_mops %.3f Mops/s higher\n",
+           BENCH_NOP_BATCH, done / (el / 1e3));
+    io_uring_queue_exit(&ring);
+
+    /* Round trip per setup mode: QD1 latency and QD32/batch 8 throughput */
+    for (size_t m = 0; m < NUM_NOP_MODES; m++) {
+        struct nop_cell cell;
+        if (run_nop_cell(&nop_modes[m], 1, 1, &cell) < 0)
+            continue;
+        printf("BENCH io_uring_memory_test.nop_matrix.%s.qd1.p50_ns %.1f ns lower\n",
+               nop_modes[m].name, cell.p50_ns);
+        printf("BENCH io_uring_memory_test.nop_matrix.%s.qd1.p99_ns %.1f ns lower\n",
+               nop_modes[m].name, cell.p99_ns);
+        if (run_nop_cell(&nop_modes[m], 32, 8, &cell) == 0)
+            printf("BENCH io_uring_memory_test.nop_matrix.%s.qd32_b8_mops %.3f Mops/s higher\n",
+                   nop_modes[m].name, cell.mops);
+    }
+
+    /* Resident memory per 1024-entry ring */
+    struct io_uring rings[BENCH_RINGS];
+    int made = 0;
+    size_t before = get_process_memory_usage();
+    for (; made < BENCH_RINGS; made++) {
+        if (io_uring_queue_init(1024, &rings[made], 0) < 0) break;
+    }
+    size_t after = get_process_memory_usage();
+    for (int i = 0; i < made; i++) io_uring_queue_exit(&rings[i]);
+    if (made > 0)
+        printf("BENCH io_uring_memory_test.rss_kib_per_ring.1024 %.1f KiB lower\n",
+               (double)(after - before) / made / 1024.0);
+    return 0;
 }
 
 int main(int argc, char *argv[])
 {
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+        return run_bench();
+    if (argc > 1 && strcmp(argv[1], "--nop-matrix") == 0)
+        return run_nop_matrix();
+
     print_header();
     print_system_info();
     print_structure_sizes();
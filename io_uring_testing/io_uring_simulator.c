@@ -7,54 +7,37 @@
  * - Planning capacity
  * - Educational purposes
  * 
- * Compile: gcc -o io_uring_simulator io_uring_simulator.c -lm
+ * Compile: gcc -o io_uring_simulator io_uring_simulator.c ../ring_model/ring_model.c -lm
+ *
+ * With -r (Poisson arrivals) or -t (trace file) it runs the depth planner
+ * instead of the report: a discrete-event simulation of the SQ, the device
+ * and the CQ that picks the smallest depth meeting a CQ overflow and a
+ * queueing delay target. -h lists the options.
+ *
+ * Sizes come from the shared ring model (../ring_model); export
+ * RING_MODEL_PARAMS=<file> to use constants calibrated on the target kernel.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <stdint.h>
 #include <unistd.h>
 
+#include "../ring_model/ring_model.h"
+
 /*
  * io_uring constants (from Linux kernel headers)
  */
-#define IORING_MAX_ENTRIES      32768
-#define IORING_MAX_CQ_ENTRIES   (2 * IORING_MAX_ENTRIES)
+#define IORING_MAX_ENTRIES      RM_MAX_SQ_ENTRIES
+#define IORING_MAX_CQ_ENTRIES   RM_MAX_CQ_ENTRIES
 
 /* Standard structure sizes */
-#define SQE_SIZE_STANDARD       64
-#define SQE_SIZE_EXTENDED       128
-#define CQE_SIZE_STANDARD       16
-#define CQE_SIZE_EXTENDED       32
-
-/* Ring header overhead (approximate) */
-#define SQ_RING_HEADER_SIZE     128
-#define CQ_RING_HEADER_SIZE     128
-
-/*
- * Round up to nearest power of 2
- */
-unsigned int roundup_pow2(unsigned int x)
-{
-    if (x == 0) return 1;
-    x--;
-    x |= x >> 1;
-    x |= x >> 2;
-    x |= x >> 4;
-    x |= x >> 8;
-    x |= x >> 16;
-    return x + 1;
-}
-
-/*
- * Round up to page size
- */
-size_t page_align(size_t size)
-{
-    long page_size = sysconf(_SC_PAGESIZE);
-    return ((size + page_size - 1) / page_size) * page_size;
-}
+#define SQE_SIZE_STANDARD       RM_SQE_SIZE
+#define SQE_SIZE_EXTENDED       RM_SQE128_SIZE
+#define CQE_SIZE_STANDARD       RM_CQE_SIZE
+#define CQE_SIZE_EXTENDED       RM_CQE32_SIZE
 
 /*
  * Calculate memory for a specific configuration
@@ -75,44 +58,29 @@ void calculate_ring_memory(unsigned int requested_sq_entries,
                            int use_sqe128, int use_cqe32,
                            struct ring_memory *mem)
 {
-    /* Actual entries after rounding */
-    mem->sq_entries = roundup_pow2(requested_sq_entries);
-    if (mem->sq_entries > IORING_MAX_ENTRIES) {
-        mem->sq_entries = IORING_MAX_ENTRIES;
-    }
-    
-    /* CQ defaults to 2x SQ if not specified */
-    if (requested_cq_entries == 0) {
-        mem->cq_entries = mem->sq_entries * 2;
-    } else {
-        mem->cq_entries = roundup_pow2(requested_cq_entries);
-    }
-    if (mem->cq_entries > IORING_MAX_CQ_ENTRIES) {
-        mem->cq_entries = IORING_MAX_CQ_ENTRIES;
-    }
-    
-    /* Entry sizes */
-    size_t sqe_size = use_sqe128 ? SQE_SIZE_EXTENDED : SQE_SIZE_STANDARD;
-    size_t cqe_size = use_cqe32 ? CQE_SIZE_EXTENDED : CQE_SIZE_STANDARD;
-    
-    /* SQ ring: header + array of indices (unsigned int) */
-    mem->sq_ring_bytes = page_align(SQ_RING_HEADER_SIZE + 
-                                     mem->sq_entries * sizeof(unsigned int));
-    
-    /* CQ ring: header + array of CQEs */
-    mem->cq_ring_bytes = page_align(CQ_RING_HEADER_SIZE + 
-                                     mem->cq_entries * cqe_size);
-    
-    /* SQE array */
-    mem->sqe_array_bytes = page_align(mem->sq_entries * sqe_size);
-    
+    rm_ring_config_t cfg = {
+        .sq_entries = requested_sq_entries,
+        .cq_entries = requested_cq_entries,   /* 0 = 2x SQ */
+        .sqe128     = use_sqe128,
+        .cqe32      = use_cqe32,
+    };
+    rm_ring_memory_t m;
+    rm_calc(rm_params(), &cfg, &m);
+
+    mem->sq_entries = m.sq_actual;
+    mem->cq_entries = m.cq_actual;
+
+    /* SQ ring is 0 when it shares the CQ ring mapping (IORING_FEAT_SINGLE_MMAP) */
+    mem->sq_ring_bytes = m.sq_ring_bytes;
+    mem->cq_ring_bytes = m.cq_ring_bytes;
+    mem->sqe_array_bytes = m.sqe_array_bytes;
+
     /* Total user-space visible memory */
-    mem->total_user_bytes = mem->sq_ring_bytes + mem->cq_ring_bytes + 
-                            mem->sqe_array_bytes;
-    
-    /* Kernel-side overhead estimate (per-request context, etc.) */
-    mem->kernel_overhead_est = mem->sq_entries * 256;  /* ~256 bytes per in-flight */
-    
+    mem->total_user_bytes = m.ring_bytes;
+
+    /* Kernel-side overhead estimate: ring context slab + io_kiocb at full depth */
+    mem->kernel_overhead_est = m.kernel_bytes + m.kernel_inflight_bytes;
+
     mem->total_estimated = mem->total_user_bytes + mem->kernel_overhead_est;
 }
 
@@ -123,8 +91,11 @@ void print_memory_breakdown(struct ring_memory *mem)
 {
     printf("  SQ Entries:       %u\n", mem->sq_entries);
     printf("  CQ Entries:       %u\n", mem->cq_entries);
-    printf("  SQ Ring Memory:   %zu bytes (%zu KB)\n", 
-           mem->sq_ring_bytes, mem->sq_ring_bytes / 1024);
+    if (mem->sq_ring_bytes)
+        printf("  SQ Ring Memory:   %zu bytes (%zu KB)\n",
+               mem->sq_ring_bytes, mem->sq_ring_bytes / 1024);
+    else
+        printf("  SQ Ring Memory:   shared with CQ ring (single mmap)\n");
     printf("  CQ Ring Memory:   %zu bytes (%zu KB)\n",
            mem->cq_ring_bytes, mem->cq_ring_bytes / 1024);
     printf("  SQE Array:        %zu bytes (%zu KB)\n",
@@ -235,6 +206,411 @@ void simulate_tunables(void)
     }
 }
 
+/*
+ * Depth planner: discrete-event queueing model
+ *
+ * Requests arrive (Poisson at a rate, or replayed from a trace). The
+ * application prepares one SQE per request, and runs an event loop: once per
+ * tick it reaps every CQE and submits the SQ (one io_uring_enter). Requests
+ * that find the SQ full wait in the application until a later tick. The
+ * device runs up to `parallel` requests at once with i.i.d. service times;
+ * a completion that finds the CQ full overflows (the kernel's overflow list,
+ * or a dropped CQE before IORING_FEAT_NODROP).
+ *
+ * SQ depth bounds how many requests one tick can submit, and the CQ (a
+ * multiple of it) how many completions one tick can absorb, so too shallow
+ * a ring shows up as queueing delay and as CQ overflow. Queueing delay runs
+ * from arrival to the device starting the request, so it includes the wait
+ * behind the device's other requests as well as the wait for the SQ.
+ */
+
+#define DELAY_BUCKETS   2048
+#define DELAY_BASE      1.01            /* 1% wide histogram buckets */
+
+enum service_kind { SVC_EXP, SVC_CONST, SVC_LOGNORMAL };
+
+struct depth_workload {
+    double rate;                        /* Poisson arrivals per second, 0 = trace */
+    double *trace_us;                   /* trace: arrival times, sorted */
+    size_t trace_n;
+    enum service_kind svc;
+    double svc_mean_us;
+    double svc_cv;                      /* lognormal only */
+    unsigned parallel;                  /* requests the device serves at once */
+    double tick_us;                     /* event loop period */
+    unsigned cq_factor;
+    double duration_s;                  /* Poisson only; a trace runs to its end */
+    double overflow_target;             /* max CQEs overflowed / CQEs posted */
+    double delay_target_us;
+    double delay_pct;
+    unsigned max_depth;
+    uint64_t seed;
+};
+
+struct depth_result {
+    unsigned depth, cq_entries;
+    uint64_t requests, completions, overflows;
+    double sq_mean, cq_mean, inflight_mean;
+    unsigned long sq_max, cq_max, inflight_max;
+    double delay_mean_us, delay_pct_us;
+    double iops;
+};
+
+/* xorshift64*: reproducible per seed and cheap enough for millions of events */
+static uint64_t rng_state;
+
+static double rng_uniform(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return ((rng_state * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double rng_exp(double mean)
+{
+    return -mean * log(1.0 - rng_uniform());
+}
+
+double service_time_us(const struct depth_workload *w)
+{
+    switch (w->svc) {
+    case SVC_CONST:
+        return w->svc_mean_us;
+    case SVC_LOGNORMAL: {
+        double s2 = log(1.0 + w->svc_cv * w->svc_cv);
+        double z = sqrt(-2.0 * log(1.0 - rng_uniform())) * cos(2.0 * M_PI * rng_uniform());
+        return exp(log(w->svc_mean_us) - s2 / 2.0 + sqrt(s2) * z);
+    }
+    default:
+        return rng_exp(w->svc_mean_us);
+    }
+}
+
+/* Min-heap of completion times of the requests on the device */
+struct heap {
+    double *v;
+    size_t n, cap;
+};
+
+static int heap_push(struct heap *h, double t)
+{
+    if (h->n == h->cap) {
+        size_t cap = h->cap ? h->cap * 2 : 256;
+        double *v = realloc(h->v, cap * sizeof(*v));
+        if (!v) return -1;
+        h->v = v;
+        h->cap = cap;
+    }
+    size_t i = h->n++;
+    while (i > 0 && h->v[(i - 1) / 2] > t) {
+        h->v[i] = h->v[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    h->v[i] = t;
+    return 0;
+}
+
+static void heap_pop(struct heap *h)
+{
+    double last = h->v[--h->n];
+    size_t i = 0;
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= h->n) break;
+        if (c + 1 < h->n && h->v[c + 1] < h->v[c]) c++;
+        if (h->v[c] >= last) break;
+        h->v[i] = h->v[c];
+        i = c;
+    }
+    if (h->n) h->v[i] = last;
+}
+
+/* FIFO of arrival times for requests not yet submitted (SQ, then backlog) */
+struct fifo {
+    double *v;
+    size_t head, n, cap;
+};
+
+static int fifo_push(struct fifo *f, double t)
+{
+    if (f->n == f->cap) {
+        size_t cap = f->cap ? f->cap * 2 : 1024;
+        double *v = malloc(cap * sizeof(*v));
+        if (!v) return -1;
+        for (size_t i = 0; i < f->n; i++) v[i] = f->v[(f->head + i) % f->cap];
+        free(f->v);
+        f->v = v;
+        f->head = 0;
+        f->cap = cap;
+    }
+    f->v[(f->head + f->n++) % f->cap] = t;
+    return 0;
+}
+
+static double fifo_pop(struct fifo *f)
+{
+    double t = f->v[f->head];
+    f->head = (f->head + 1) % f->cap;
+    f->n--;
+    return t;
+}
+
+static int delay_bucket(double us)
+{
+    int b = (int)(log1p(us) / log(DELAY_BASE));
+    return b < 0 ? 0 : b >= DELAY_BUCKETS ? DELAY_BUCKETS - 1 : b;
+}
+
+int simulate_depth(const struct depth_workload *w, unsigned depth, struct depth_result *r)
+{
+    static uint64_t hist[DELAY_BUCKETS];
+    struct heap dev = {0};
+    struct fifo waiting = {0};
+    struct fifo dev_queue = {0};        /* submitted, waiting for a device slot */
+    const unsigned long cq_cap = (unsigned long)depth * w->cq_factor;
+    unsigned long sq = 0, cq = 0, overflowed = 0;
+    unsigned long inflight = 0;         /* submitted, CQE not yet reaped */
+    double area_sq = 0, area_cq = 0, area_in = 0, delay_sum = 0;
+    double now = 0, next_tick = w->tick_us;
+    double end = w->rate > 0 ? w->duration_s * 1e6 : 0;
+    size_t ti = 0;
+    double next_arrival;
+
+    memset(r, 0, sizeof(*r));
+    memset(hist, 0, sizeof(hist));
+    r->depth = depth;
+    r->cq_entries = (unsigned)cq_cap;
+    rng_state = w->seed ? w->seed : 1;
+
+    if (w->rate > 0) {
+        next_arrival = rng_exp(1e6 / w->rate);
+    } else {
+        next_arrival = w->trace_n ? w->trace_us[0] : INFINITY;
+        end = w->trace_n ? w->trace_us[w->trace_n - 1] : 0;
+    }
+
+    for (;;) {
+        double next_done = dev.n ? dev.v[0] : INFINITY;
+        double t = next_arrival;
+        if (next_done < t) t = next_done;
+        if (next_tick < t) t = next_tick;
+        /* Past the end: keep ticking until everything is reaped */
+        if (t > end && waiting.n == 0 && inflight == 0) break;
+
+        area_sq += sq * (t - now);
+        area_cq += (cq + overflowed) * (t - now);
+        area_in += inflight * (t - now);
+        now = t;
+
+        if (t == next_arrival) {
+            r->requests++;
+            if (fifo_push(&waiting, now)) goto oom;
+            if (sq < depth) sq++;
+            if (w->rate > 0) {
+                next_arrival = now + rng_exp(1e6 / w->rate);
+                if (next_arrival > end) next_arrival = INFINITY;
+            } else {
+                next_arrival = ++ti < w->trace_n ? w->trace_us[ti] : INFINITY;
+            }
+        } else if (t == next_done) {
+            heap_pop(&dev);
+            r->completions++;
+            if (cq < cq_cap) cq++;
+            else { overflowed++; r->overflows++; }
+            if (cq + overflowed > r->cq_max) r->cq_max = cq + overflowed;
+            if (dev_queue.n) {
+                double d = now - fifo_pop(&dev_queue);
+                delay_sum += d;
+                hist[delay_bucket(d)]++;
+                if (heap_push(&dev, now + service_time_us(w))) goto oom;
+            }
+        } else {
+            /* Tick: reap everything (overflowed CQEs are flushed as the CQ drains), then submit */
+            inflight -= cq + overflowed;
+            cq = overflowed = 0;
+            for (unsigned long i = 0; i < sq; i++) {
+                double arrival = fifo_pop(&waiting);
+                inflight++;
+                if (dev.n < w->parallel) {
+                    delay_sum += now - arrival;
+                    hist[delay_bucket(now - arrival)]++;
+                    if (heap_push(&dev, now + service_time_us(w))) goto oom;
+                } else if (fifo_push(&dev_queue, arrival)) {
+                    goto oom;
+                }
+            }
+            /* Requests held back by a full SQ take the slots just freed */
+            sq = waiting.n < depth ? waiting.n : depth;
+            next_tick = now + w->tick_us;
+        }
+        if (sq > r->sq_max) r->sq_max = sq;
+        if (inflight > r->inflight_max) r->inflight_max = inflight;
+    }
+
+    if (now > 0) {
+        r->sq_mean = area_sq / now;
+        r->cq_mean = area_cq / now;
+        r->inflight_mean = area_in / now;
+        r->iops = r->completions / (now / 1e6);
+    }
+    if (r->requests) {
+        uint64_t want = (uint64_t)ceil(r->requests * w->delay_pct / 100.0), seen = 0;
+        r->delay_mean_us = delay_sum / r->requests;
+        for (int b = 0; b < DELAY_BUCKETS; b++) {
+            seen += hist[b];
+            if (seen >= want) {
+                r->delay_pct_us = expm1((b + 1) * log(DELAY_BASE));
+                break;
+            }
+        }
+    }
+    free(dev.v);
+    free(waiting.v);
+    free(dev_queue.v);
+    return 0;
+
+oom:
+    free(dev.v);
+    free(waiting.v);
+    free(dev_queue.v);
+    return -1;
+}
+
+/* "t_us [count]" per line, '#' comments; returns 0 or -1 */
+int load_trace(const char *path, struct depth_workload *w)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+    size_t cap = 0;
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    w->trace_n = 0;
+    while (fgets(line, sizeof(line), f)) {
+        double t;
+        long count = 1;
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '#' || *p == '\n' || *p == '\0') continue;
+        if (sscanf(p, "%lf %ld", &t, &count) < 1 || t < 0 || count < 1 ||
+            (w->trace_n && t < w->trace_us[w->trace_n - 1])) {
+            fprintf(stderr, "%s: bad or out-of-order line: %s", path, line);
+            fclose(f);
+            return -1;
+        }
+        while (count--) {
+            if (w->trace_n == cap) {
+                size_t ncap = cap ? cap * 2 : 4096;
+                double *v = realloc(w->trace_us, ncap * sizeof(*v));
+                if (!v) {
+                    fclose(f);
+                    return -1;
+                }
+                w->trace_us = v;
+                cap = ncap;
+            }
+            w->trace_us[w->trace_n++] = t;
+        }
+    }
+    fclose(f);
+    if (w->trace_n < 2) {
+        fprintf(stderr, "%s: need at least two arrivals\n", path);
+        return -1;
+    }
+    /* The planner derives the average rate from the span */
+    if (w->trace_us[w->trace_n - 1] == w->trace_us[0]) {
+        fprintf(stderr, "%s: every arrival has the same timestamp, need a span > 0\n", path);
+        return -1;
+    }
+    /* Replay relative to the first arrival */
+    double t0 = w->trace_us[0];
+    for (size_t i = 0; i < w->trace_n; i++) w->trace_us[i] -= t0;
+    return 0;
+}
+
+/* "exp:100", "const:100", "lognormal:100,2" (mean us, coefficient of variation) */
+int parse_service(const char *s, struct depth_workload *w)
+{
+    w->svc_cv = 1.0;
+    if (sscanf(s, "exp:%lf", &w->svc_mean_us) == 1)
+        w->svc = SVC_EXP;
+    else if (sscanf(s, "const:%lf", &w->svc_mean_us) == 1)
+        w->svc = SVC_CONST;
+    else if (sscanf(s, "lognormal:%lf,%lf", &w->svc_mean_us, &w->svc_cv) >= 1)
+        w->svc = SVC_LOGNORMAL;
+    else
+        return -1;
+    return w->svc_mean_us > 0 && w->svc_cv > 0 ? 0 : -1;
+}
+
+/*
+ * Sweeps power-of-two depths and returns the smallest that meets both
+ * targets, or 0 if none up to max_depth does
+ */
+unsigned depth_planner(const struct depth_workload *w)
+{
+    static const char *svc_names[] = { "exponential", "constant", "lognormal" };
+    double rate = w->rate > 0 ? w->rate
+                : (w->trace_n - 1) / (w->trace_us[w->trace_n - 1] / 1e6);
+    double load = rate * w->svc_mean_us / 1e6 / w->parallel;
+    unsigned pick = 0;
+
+    if (w->rate > 0)
+        printf("  Arrivals:   Poisson, %.0f req/s for %.1f s\n", w->rate, w->duration_s);
+    else
+        printf("  Arrivals:   trace, %zu requests over %.3f s (avg %.0f req/s)\n",
+               w->trace_n, w->trace_us[w->trace_n - 1] / 1e6, rate);
+    printf("  Service:    %s, mean %.1f us", svc_names[w->svc], w->svc_mean_us);
+    if (w->svc == SVC_LOGNORMAL) printf(", cv %.2f", w->svc_cv);
+    printf(", %u in parallel (utilisation %.0f%%)\n", w->parallel, load * 100.0);
+    printf("  Event loop: reap + submit every %.0f us, CQ = %ux SQ\n", w->tick_us, w->cq_factor);
+    printf("  Targets:    CQ overflow <= %g per CQE, p%g queueing delay <= %.0f us\n\n",
+           w->overflow_target, w->delay_pct, w->delay_target_us);
+    if (load >= 1.0) {
+        printf("  The device is saturated (utilisation >= 100%%): the backlog grows without\n"
+               "  bound at any depth, so no depth can meet the delay target. Add parallelism\n"
+               "  or cut the service time.\n");
+        return 0;
+    }
+
+    printf("  %-7s %-7s %-8s %-8s %-8s %-8s %-10s %-10s %-11s %-10s %s\n",
+           "SQ", "CQ", "SQ avg", "CQ max", "InFl avg", "InFl max", "Overflow", "Delay avg",
+           "Delay pXX", "Memory", "");
+    printf("  ------- ------- -------- -------- -------- -------- ---------- ---------- "
+           "----------- ----------\n");
+
+    for (unsigned d = 1; d <= w->max_depth; d *= 2) {
+        struct depth_result r;
+        struct ring_memory mem;
+        if (simulate_depth(w, d, &r) != 0) {
+            fprintf(stderr, "out of memory at depth %u\n", d);
+            return 0;
+        }
+        calculate_ring_memory(d, d * w->cq_factor, 0, 0, &mem);
+        double ovf = r.completions ? (double)r.overflows / r.completions : 0.0;
+        int ok = ovf <= w->overflow_target && r.delay_pct_us <= w->delay_target_us;
+        printf("  %-7u %-7u %-8.1f %-8lu %-8.1f %-8lu %-10.2e %-10.1f %-11.1f %-10zu %s\n",
+               r.depth, r.cq_entries, r.sq_mean, r.cq_max, r.inflight_mean, r.inflight_max,
+               ovf, r.delay_mean_us, r.delay_pct_us, mem.total_estimated,
+               ok && !pick ? "<- smallest meeting both targets" : ok ? "ok" : "");
+        if (ok && !pick) pick = d;
+        /* Deeper rings only add memory once both targets hold with room to spare */
+        if (pick && d >= pick * 4) break;
+    }
+
+    printf("\n  Delay is arrival -> device start (SQ and device queue); Overflow is CQEs that\n"
+           "  found the CQ full.\n");
+    if (pick)
+        printf("  Recommended depth: SQ %u, CQ %u (IORING_SETUP_CQSIZE)\n", pick, pick * w->cq_factor);
+    else
+        printf("  No depth up to %u meets both targets: shorten the tick, raise the CQ factor\n"
+               "  or add device parallelism.\n", w->max_depth);
+    return pick;
+}
+
 /*
  * Interactive capacity planner
  */
@@ -284,8 +660,24 @@ void capacity_planner(void)
     struct ring_memory mem4;
     calculate_ring_memory(4096, 0, 1, 0, &mem4);
     print_memory_breakdown(&mem4);
+
+    printf("\n\nScenario 5: Depth for a Latency Target (queueing model)\n");
+    printf("-------------------------------------------------------\n");
+    printf("  Requirements: 200k req/s NVMe reads, p99 queueing delay <= 200 us\n");
+    printf("  Configuration: smallest SQ depth meeting the targets\n\n");
+
+    struct depth_workload w5 = {
+        .rate = 200000, .svc = SVC_EXP, .svc_mean_us = 80, .parallel = 32,
+        .tick_us = 100, .cq_factor = 2, .duration_s = 0.5, .overflow_target = 1e-4,
+        .delay_target_us = 200, .delay_pct = 99, .max_depth = 4096, .seed = 1,
+    };
+    depth_planner(&w5);
 }
 
+/* Accounting profile for the recommendations: -K, or the running kernel */
+static const rm_acct_profile_t *kernel_profile;
+static char kernel_source[96];
+
 /*
  * Print tuning recommendations
  */
@@ -296,17 +688,40 @@ void print_recommendations(void)
     printf("                      Tuning Recommendations                              \n");
     printf("==========================================================================\n\n");
     
-    printf("1. RLIMIT_MEMLOCK Configuration:\n");
+    /*
+     * What RLIMIT_MEMLOCK (per user, summed over the user's processes) is
+     * charged with depends on the kernel's accounting profile (ring_model.h)
+     */
+    const rm_acct_profile_t *prof = kernel_profile;
+    int rings_charged = prof->rings_memlock;
+    size_t default_kb = (size_t)(prof->default_memlock / 1024);
+
+    /* Example: 64 rings of 1024 entries, each with 64 x 64 KiB registered buffers */
+    struct ring_memory ex;
+    calculate_ring_memory(1024, 0, 0, 0, &ex);
+    size_t charged = 64 * (64 * 65536 + (rings_charged ? ex.total_user_bytes : 0));
+    size_t limit_kb = (size_t)(charged * 1.2) / 1024;
+    if (limit_kb < default_kb) limit_kb = default_kb;
+
+    printf("1. RLIMIT_MEMLOCK Configuration (%s profile, %s):\n", prof->name, kernel_source);
     printf("   -----------------------------\n");
-    printf("   io_uring rings are allocated as locked memory.\n");
-    printf("   Increase the limit if ring creation fails with ENOMEM:\n");
+    if (rings_charged)
+        printf("   Before 5.12 ring and SQE pages and registered buffers are charged to\n"
+               "   RLIMIT_MEMLOCK.\n");
+    else
+        printf("   Since 5.12 rings and SQEs are charged to the memory cgroup; only\n"
+               "   registered buffers count against RLIMIT_MEMLOCK.\n");
+    printf("   The charge is per user, summed over all of the user's processes.\n");
+    printf("   Default limit: %zu KB. Raise it if setup or buffer registration fails\n"
+           "   with ENOMEM:\n", default_kb);
     printf("\n");
     printf("   # View current limit\n");
     printf("   ulimit -l\n");
     printf("\n");
-    printf("   # Set to 1GB (in /etc/security/limits.conf)\n");
-    printf("   * soft memlock 1048576\n");
-    printf("   * hard memlock 1048576\n\n");
+    printf("   # Example: 64 rings x 1024 entries, 4 MB of registered buffers each\n");
+    printf("   # (charged x 1.2, in /etc/security/limits.conf)\n");
+    printf("   * soft memlock %zu\n", limit_kb);
+    printf("   * hard memlock %zu\n\n", limit_kb);
     
     printf("2. Entry Count Selection:\n");
     printf("   -----------------------\n");
@@ -332,10 +747,9 @@ void print_recommendations(void)
     
     printf("5. Memory Budget Formula:\n");
     printf("   -----------------------\n");
-    printf("   Total_per_ring ≈ page_align(128 + 4*SQ) +     # SQ ring\n");
-    printf("                    page_align(128 + 16*CQ) +    # CQ ring\n");
-    printf("                    page_align(64*SQ) +          # SQE array\n");
-    printf("                    ~256*SQ                      # kernel overhead\n\n");
+    printf("   Total_per_ring ≈ Rings + SQE_Array + Kernel + Inflight\n");
+    rm_print_formula(stdout, rm_params(), "   ");
+    printf("\n");
     
     printf("6. sysctl Tunables:\n");
     printf("   -----------------\n");
@@ -359,8 +773,99 @@ void generate_report(void)
     printf("==========================================================================\n");
 }
 
+void print_usage(const char *prog)
+{
+    printf("Usage: %s [depth planner options]\n\n", prog);
+    printf("Without options prints the memory report. -r or -t runs the depth planner:\n");
+    printf("  -r RATE      Poisson arrivals, requests per second\n");
+    printf("  -t FILE      trace of arrivals, one \"<time_us> [count]\" per line ('#' comments)\n");
+    printf("  -s DIST      service time: exp:MEAN_US, const:US or lognormal:MEAN_US,CV (default exp:100)\n");
+    printf("  -p N         requests the device serves in parallel (default 32)\n");
+    printf("  -k US        event loop tick: reap + submit period (default 100)\n");
+    printf("  -c N         CQ entries per SQ entry (default 2)\n");
+    printf("  -d SEC       simulated time for -r (default 2)\n");
+    printf("  -o P         CQ overflow target, overflowed CQEs per CQE (default 1e-4)\n");
+    printf("  -l US        queueing delay target (default 1000)\n");
+    printf("  -P PCT       percentile the delay target applies to (default 99)\n");
+    printf("  -m N         deepest SQ to try (default %d)\n", IORING_MAX_ENTRIES);
+    printf("  -S SEED      random seed (default 1)\n");
+    printf("The memory report takes:\n");
+    printf("  -K KERNEL    accounting profile for the memlock advice: auto (uname -r),\n"
+           "               a release such as 5.10, or " RM_ACCT_PROFILE_NAMES " (default auto)\n");
+    printf("Exit status 1 when no depth meets the targets.\n");
+}
+
 int main(int argc, char *argv[])
 {
+    struct depth_workload w = {
+        .svc = SVC_EXP, .svc_mean_us = 100, .svc_cv = 1.0, .parallel = 32, .tick_us = 100,
+        .cq_factor = 2, .duration_s = 2, .overflow_target = 1e-4, .delay_target_us = 1000,
+        .delay_pct = 99, .max_depth = IORING_MAX_ENTRIES, .seed = 1,
+    };
+    const char *trace = NULL, *kernel = NULL;
+    int opt, fallback;
+
+    while ((opt = getopt(argc, argv, "r:t:s:p:k:c:d:o:l:P:m:S:K:h")) != -1) {
+        switch (opt) {
+        case 'r': {
+            char *end;
+            w.rate = strtod(optarg, &end);
+            if (end == optarg || *end || !(w.rate > 0)) {
+                fprintf(stderr, "bad arrival rate '%s': need req/s > 0\n", optarg);
+                return 2;
+            }
+            break;
+        }
+        case 't': trace = optarg; break;
+        case 's':
+            if (parse_service(optarg, &w) != 0) {
+                fprintf(stderr, "bad service time '%s'\n", optarg);
+                return 2;
+            }
+            break;
+        case 'p': w.parallel = (unsigned)atoi(optarg); break;
+        case 'k': w.tick_us = atof(optarg); break;
+        case 'c': w.cq_factor = (unsigned)atoi(optarg); break;
+        case 'd': w.duration_s = atof(optarg); break;
+        case 'o': w.overflow_target = atof(optarg); break;
+        case 'l': w.delay_target_us = atof(optarg); break;
+        case 'P': w.delay_pct = atof(optarg); break;
+        case 'm': w.max_depth = (unsigned)atoi(optarg); break;
+        case 'S': w.seed = strtoull(optarg, NULL, 10); break;
+        case 'K': kernel = optarg; break;
+        default:
+            print_usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    kernel_profile = rm_acct_profile_select(kernel, kernel_source, sizeof(kernel_source), &fallback);
+    if (!kernel_profile) {
+        fprintf(stderr, "unknown kernel '%s': auto, a release >= 5.1, or " RM_ACCT_PROFILE_NAMES "\n",
+                kernel);
+        return 2;
+    }
+    if (fallback)
+        fprintf(stderr, "kernel release not detected or older than io_uring (5.1) (%s); "
+                        "using the %s accounting profile (pick one with -K)\n",
+                kernel_source, kernel_profile->name);
+
+    if (w.rate > 0 || trace) {
+        if ((w.rate > 0) == (trace != NULL) || w.parallel < 1 || w.tick_us <= 0 ||
+            w.cq_factor < 1 || w.duration_s <= 0 || w.delay_pct <= 0 || w.delay_pct > 100 ||
+            w.max_depth < 1 || w.max_depth > IORING_MAX_ENTRIES) {
+            fprintf(stderr, "need exactly one of -r/-t, -p/-c/-m >= 1, -k/-d > 0, 0 < -P <= 100, "
+                            "-m <= %d\n", IORING_MAX_ENTRIES);
+            return 2;
+        }
+        if (trace && load_trace(trace, &w) != 0) return 2;
+        printf("\nio_uring Depth Planner\n");
+        printf("======================\n\n");
+        unsigned pick = depth_planner(&w);
+        free(w.trace_us);
+        return pick ? 0 : 1;
+    }
+
     printf("\n");
     printf("io_uring Memory Structure Simulator\n");
     printf("===================================\n");
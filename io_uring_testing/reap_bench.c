@@ -0,0 +1,392 @@
+/*
+ * CQE Reaping Strategy Benchmark
+ *
+ * Same workload, same queue depth, four ways to drain the CQ:
+ *
+ *   wait-seen       io_uring_submit + io_uring_wait_cqe + io_uring_cqe_seen,
+ *                   one completion per call
+ *   peek-batch      io_uring_submit_and_wait(1) + io_uring_peek_batch_cqe
+ *                   into an array + io_uring_cq_advance
+ *   for-each        io_uring_submit_and_wait(1) + io_uring_for_each_cqe +
+ *                   io_uring_cq_advance
+ *   wait-timeout    io_uring_submit_and_wait_timeout(WAIT_NR, TIMEOUT) +
+ *                   io_uring_for_each_cqe + io_uring_cq_advance
+ *
+ * Workloads keep QD operations in flight and requeue each one as it
+ * completes:
+ *
+ *   pagecache       random 4 KiB READs from a file that is already cached
+ *   socketpair      64-byte SEND on one end of a socketpair and RECV on the
+ *                   other, one pair per slot; an op is one RECV
+ *
+ * Prints throughput, p50/p99 latency (submit -> reaped) and the average
+ * CQEs handled per reap call.
+ *
+ * Requires: Linux kernel >= 5.11 (wait-timeout needs IORING_FEAT_EXT_ARG), liburing >= 2.1
+ *
+ * Usage: ./reap_bench [-w all|pagecache|socketpair] [-s STRATEGIES] [-q QD] [-n OPS]
+ *                     [-b WAIT_NR] [-t TIMEOUT_US] [-f FILE] [-S FILE_MB] [-J]
+ * Compile: gcc -O2 -o reap_bench reap_bench.c bench_common.c -luring -lpthread
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <liburing.h>
+
+#include "bench_common.h"
+
+#define SLOT_BUF_SIZE      4096
+#define MSG_SIZE        64
+#define MAX_QD          4096
+#define PEEK_BATCH      256
+#define DEFAULT_FILE    "/tmp/reap_bench.dat"
+
+enum { S_WAIT_SEEN, S_PEEK_BATCH, S_FOR_EACH, S_WAIT_TIMEOUT, S_NUM };
+static const char *strategy_names[S_NUM] = { "wait-seen", "peek-batch", "for-each", "wait-timeout" };
+
+enum { W_PAGECACHE, W_SOCKETPAIR, W_NUM };
+static const char *workload_names[W_NUM] = { "pagecache", "socketpair" };
+
+static struct {
+    unsigned workloads;
+    unsigned strategies;
+    unsigned qd;
+    long ops;
+    unsigned wait_nr;
+    long timeout_us;
+    const char *file;
+    long file_mb;
+    int bench;
+} cfg = {
+    .workloads = (1u << W_NUM) - 1,
+    .strategies = (1u << S_NUM) - 1,
+    .qd = 64,
+    .ops = 200000,
+    .wait_nr = 16,
+    .timeout_us = 50,
+    .file = DEFAULT_FILE,
+    .file_mb = 64,
+};
+
+/* One benchmark run: the ring plus per-slot state for requeueing */
+struct run {
+    struct io_uring ring;
+    int workload;
+    int fd;                     /* pagecache */
+    off_t file_blocks;
+    int (*pairs)[2];            /* socketpair: [slot][0] sends, [slot][1] receives */
+    char *bufs;                 /* one SLOT_BUF_SIZE buffer per slot */
+    double *slot_ts;            /* submit time per slot */
+    double *lat;
+    long queued, done;
+    long reap_calls, cqes_reaped;
+    uint64_t rng;
+    int err;
+};
+
+static void print_usage(const char *prog)
+{
+    printf("Usage: %s [options]\n", prog);
+    printf("  -w WORKLOAD   all, pagecache or socketpair (default all)\n");
+    printf("  -s LIST       comma list of wait-seen,peek-batch,for-each,wait-timeout (default all)\n");
+    printf("  -q QD         operations in flight (default 64)\n");
+    printf("  -n OPS        completed operations per run (default 200000)\n");
+    printf("  -b WAIT_NR    completions wait-timeout waits for (default 16)\n");
+    printf("  -t USEC       wait-timeout timeout (default 50)\n");
+    printf("  -f FILE       pagecache file (default %s, created if missing)\n", DEFAULT_FILE);
+    printf("  -S MB         size when creating FILE (default 64)\n");
+    printf("  -J            BENCH lines (for bench_suite.sh)\n");
+}
+
+/* ── Workloads ─────────────────────────────────────────────────────── */
+
+/* Queue the op for one slot; user_data is the slot (and the pair end) */
+static void queue_slot(struct run *r, unsigned slot)
+{
+    struct io_uring_sqe *sqe;
+    char *buf = r->bufs + (size_t)slot * SLOT_BUF_SIZE;
+
+    r->slot_ts[slot] = bc_now_ns();
+    r->queued++;
+    if (r->workload == W_PAGECACHE) {
+        off_t off = (off_t)(bc_rand(&r->rng) % (uint64_t)r->file_blocks) * SLOT_BUF_SIZE;
+        sqe = io_uring_get_sqe(&r->ring);
+        io_uring_prep_read(sqe, r->fd, buf, SLOT_BUF_SIZE, off);
+        io_uring_sqe_set_data64(sqe, (uint64_t)slot << 1);
+        return;
+    }
+    sqe = io_uring_get_sqe(&r->ring);
+    io_uring_prep_send(sqe, r->pairs[slot][0], buf, MSG_SIZE, 0);
+    io_uring_sqe_set_data64(sqe, ((uint64_t)slot << 1) | 1);
+    sqe = io_uring_get_sqe(&r->ring);
+    io_uring_prep_recv(sqe, r->pairs[slot][1], buf + MSG_SIZE, MSG_SIZE, 0);
+    io_uring_sqe_set_data64(sqe, (uint64_t)slot << 1);
+}
+
+/* Handle one CQE; SEND completions only report errors */
+static void complete(struct run *r, const struct io_uring_cqe *cqe, double now)
+{
+    uint64_t data = cqe->user_data;
+    unsigned slot = (unsigned)(data >> 1);
+
+    r->cqes_reaped++;
+    if (cqe->res < 0) {
+        if (!r->err) r->err = cqe->res;
+        return;
+    }
+    if (data & 1) return;
+    if (r->done < cfg.ops) r->lat[r->done] = now - r->slot_ts[slot];
+    r->done++;
+    if (r->queued < cfg.ops) queue_slot(r, slot);
+}
+
+static int workload_setup(struct run *r)
+{
+    if (r->workload == W_PAGECACHE) {
+        int ret = bc_ensure_file(cfg.file, SLOT_BUF_SIZE, cfg.file_mb);
+        if (ret < 0) return ret;
+        r->fd = open(cfg.file, O_RDONLY);
+        if (r->fd < 0) return -errno;
+        struct stat st;
+        fstat(r->fd, &st);
+        r->file_blocks = st.st_size / SLOT_BUF_SIZE;
+        /* Warm the page cache so every READ is a cache hit */
+        static char chunk[1 << 20];
+        while (read(r->fd, chunk, sizeof(chunk)) > 0)
+            ;
+        return 0;
+    }
+
+    r->pairs = calloc(cfg.qd, sizeof(*r->pairs));
+    if (!r->pairs) return -ENOMEM;
+    for (unsigned i = 0; i < cfg.qd; i++) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, r->pairs[i]) < 0) {
+            int e = -errno;
+            while (i-- > 0) { close(r->pairs[i][0]); close(r->pairs[i][1]); }
+            free(r->pairs);
+            r->pairs = NULL;
+            return e;
+        }
+    }
+    return 0;
+}
+
+static void workload_teardown(struct run *r)
+{
+    if (r->fd >= 0) close(r->fd);
+    if (r->pairs) {
+        for (unsigned i = 0; i < cfg.qd; i++) { close(r->pairs[i][0]); close(r->pairs[i][1]); }
+        free(r->pairs);
+    }
+}
+
+/* ── Strategies ────────────────────────────────────────────────────── */
+
+static int reap_wait_seen(struct run *r)
+{
+    struct io_uring_cqe *cqe;
+    int ret = io_uring_submit(&r->ring);
+    if (ret < 0) return ret;
+    ret = io_uring_wait_cqe(&r->ring, &cqe);
+    if (ret < 0) return ret;
+    r->reap_calls++;
+    complete(r, cqe, bc_now_ns());
+    io_uring_cqe_seen(&r->ring, cqe);
+    return 0;
+}
+
+static int reap_peek_batch(struct run *r)
+{
+    struct io_uring_cqe *cqes[PEEK_BATCH];
+    int ret = io_uring_submit_and_wait(&r->ring, 1);
+    if (ret < 0) return ret;
+    unsigned n = io_uring_peek_batch_cqe(&r->ring, cqes, PEEK_BATCH);
+    double now = bc_now_ns();
+    r->reap_calls++;
+    for (unsigned i = 0; i < n; i++) complete(r, cqes[i], now);
+    io_uring_cq_advance(&r->ring, n);
+    return 0;
+}
+
+static int reap_for_each(struct run *r)
+{
+    struct io_uring_cqe *cqe;
+    unsigned head, n = 0;
+    int ret = io_uring_submit_and_wait(&r->ring, 1);
+    if (ret < 0) return ret;
+    double now = bc_now_ns();
+    r->reap_calls++;
+    io_uring_for_each_cqe(&r->ring, head, cqe) {
+        complete(r, cqe, now);
+        n++;
+    }
+    io_uring_cq_advance(&r->ring, n);
+    return 0;
+}
+
+static int reap_wait_timeout(struct run *r)
+{
+    struct io_uring_cqe *cqe;
+    struct __kernel_timespec ts = {
+        .tv_sec = cfg.timeout_us / 1000000,
+        .tv_nsec = (cfg.timeout_us % 1000000) * 1000,
+    };
+    unsigned head, n = 0;
+    /* Never wait for more ops than are in flight */
+    long inflight = r->queued - r->done;
+    unsigned wait_nr = inflight < (long)cfg.wait_nr ? (unsigned)inflight : cfg.wait_nr;
+
+    int ret = io_uring_submit_and_wait_timeout(&r->ring, &cqe, wait_nr, &ts, NULL);
+    if (ret < 0 && ret != -ETIME) return ret;
+    double now = bc_now_ns();
+    r->reap_calls++;
+    io_uring_for_each_cqe(&r->ring, head, cqe) {
+        complete(r, cqe, now);
+        n++;
+    }
+    io_uring_cq_advance(&r->ring, n);
+    return 0;
+}
+
+static int (*const reapers[S_NUM])(struct run *) = {
+    reap_wait_seen, reap_peek_batch, reap_for_each, reap_wait_timeout
+};
+
+/* ── Driver ────────────────────────────────────────────────────────── */
+
+static int run_one(int workload, int strategy)
+{
+    struct run r;
+    int ret;
+
+    memset(&r, 0, sizeof(r));
+    r.workload = workload;
+    r.fd = -1;
+    r.rng = 0x9e3779b97f4a7c15ull;
+
+    ret = workload_setup(&r);
+    if (ret < 0) {
+        printf("  %-14s setup failed: %s\n", strategy_names[strategy], strerror(-ret));
+        return 1;
+    }
+
+    /* socketpair queues two SQEs per slot */
+    unsigned entries = workload == W_SOCKETPAIR ? 2 * cfg.qd : cfg.qd;
+    ret = io_uring_queue_init(entries, &r.ring, 0);
+    if (ret < 0) {
+        printf("  %-14s io_uring_queue_init: %s\n", strategy_names[strategy], strerror(-ret));
+        workload_teardown(&r);
+        return 1;
+    }
+    if (strategy == S_WAIT_TIMEOUT && !(r.ring.features & IORING_FEAT_EXT_ARG)) {
+        printf("  %-14s not supported (no IORING_FEAT_EXT_ARG)\n", strategy_names[strategy]);
+        io_uring_queue_exit(&r.ring);
+        workload_teardown(&r);
+        return 0;
+    }
+
+    r.bufs = aligned_alloc(SLOT_BUF_SIZE, (size_t)cfg.qd * SLOT_BUF_SIZE);
+    r.slot_ts = calloc(cfg.qd, sizeof(double));
+    r.lat = malloc(cfg.ops * sizeof(double));
+    if (!r.bufs || !r.slot_ts || !r.lat) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    memset(r.bufs, 0x5a, (size_t)cfg.qd * SLOT_BUF_SIZE);
+
+    unsigned initial = cfg.ops < (long)cfg.qd ? (unsigned)cfg.ops : cfg.qd;
+    for (unsigned i = 0; i < initial; i++) queue_slot(&r, i);
+
+    double t0 = bc_now_ns();
+    while (r.done < cfg.ops && !r.err) {
+        ret = reapers[strategy](&r);
+        if (ret < 0) { r.err = ret; break; }
+    }
+    double elapsed = bc_now_ns() - t0;
+
+    int rc = 0;
+    if (r.err) {
+        printf("  %-14s failed: %s\n", strategy_names[strategy], strerror(-r.err));
+        rc = 1;
+    } else {
+        bc_pct_t pc;
+        bc_percentiles(r.lat, (size_t)cfg.ops, &pc);
+        double kops = cfg.ops / (elapsed / 1e9) / 1e3;
+        double per_call = r.reap_calls ? (double)r.cqes_reaped / r.reap_calls : 0;
+        printf("  %-14s %10.1f %10.0f %10.0f %10.0f %12.1f\n", strategy_names[strategy],
+               kops, pc.p50, pc.p99, pc.p999, per_call);
+        if (cfg.bench) {
+            char metric[96];
+            snprintf(metric, sizeof(metric), "%s.%s.qd%u.kops", workload_names[workload],
+                     strategy_names[strategy], cfg.qd);
+            bc_bench_line("reap", metric, kops, "Kops/s", "higher");
+            snprintf(metric, sizeof(metric), "%s.%s.qd%u.p99_ns", workload_names[workload],
+                     strategy_names[strategy], cfg.qd);
+            bc_bench_line("reap", metric, pc.p99, "ns", "lower");
+        }
+    }
+
+    io_uring_queue_exit(&r.ring);
+    workload_teardown(&r);
+    free(r.bufs);
+    free(r.slot_ts);
+    free(r.lat);
+    return rc;
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:s:q:n:b:t:f:S:Jh")) != -1) {
+        switch (opt) {
+        case 'w':
+            if (strcmp(optarg, "all") == 0) cfg.workloads = (1u << W_NUM) - 1;
+            else if (!(cfg.workloads = bc_parse_names(optarg, workload_names, W_NUM))) return 2;
+            break;
+        case 's':
+            if (!(cfg.strategies = bc_parse_names(optarg, strategy_names, S_NUM))) return 2;
+            break;
+        case 'q': cfg.qd = (unsigned)atoi(optarg); break;
+        case 'n': cfg.ops = atol(optarg); break;
+        case 'b': cfg.wait_nr = (unsigned)atoi(optarg); break;
+        case 't': cfg.timeout_us = atol(optarg); break;
+        case 'f': cfg.file = optarg; break;
+        case 'S': cfg.file_mb = atol(optarg); break;
+        case 'J': cfg.bench = 1; break;
+        default:
+            print_usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (cfg.qd < 1 || cfg.qd > MAX_QD || cfg.ops < 1 || cfg.wait_nr < 1 ||
+        cfg.timeout_us < 0 || cfg.file_mb < 1) {
+        fprintf(stderr, "need 1 <= QD <= %d, OPS >= 1, WAIT_NR >= 1, TIMEOUT >= 0, FILE_MB >= 1\n", MAX_QD);
+        return 2;
+    }
+
+    printf("CQE reaping: QD %u, %ld ops per run, wait-timeout %u CQEs / %ld us\n\n",
+           cfg.qd, cfg.ops, cfg.wait_nr, cfg.timeout_us);
+
+    int rc = 0;
+    for (int w = 0; w < W_NUM; w++) {
+        if (!(cfg.workloads & (1u << w))) continue;
+        printf("%s:\n", workload_names[w]);
+        printf("  %-14s %10s %10s %10s %10s %12s\n",
+               "strategy", "Kops/s", "p50 ns", "p99 ns", "p99.9 ns", "CQEs/call");
+        for (int s = 0; s < S_NUM; s++)
+            if (cfg.strategies & (1u << s)) rc |= run_one(w, s);
+        printf("\n");
+    }
+    printf("Latency is submit -> reaped. CQEs/call counts every CQE a reap call\n");
+    printf("handled (socketpair SEND completions included).\n");
+    return rc;
+}
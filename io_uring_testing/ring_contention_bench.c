@@ -0,0 +1,417 @@
+/*
+ * Ring-per-core vs Shared-Ring Contention Benchmark
+ *
+ * Three ways for N pinned threads to push NOPs through io_uring:
+ *
+ *   per-thread   every thread owns its ring; nothing is shared
+ *   shared       one ring behind a mutex; a thread locks, queues a batch,
+ *                submits, reaps everything that is ready and unlocks
+ *   msg-ring     every producer owns a small ring and fans its batch into a
+ *                single owner thread's ring with IORING_OP_MSG_RING; the
+ *                owner reaps them (one I/O thread, many clients)
+ *
+ * For each mode it prints total and per-core throughput, and per-op
+ * cycles, cache references, cache misses and L1D load misses summed over
+ * every thread (perf_event_open, per thread). Counters cannot be narrowed
+ * to single cache lines from user space, so the SQ/CQ head and tail
+ * addresses of the contended ring are printed: record with
+ * `perf c2c record -- ./ring_contention_bench -m shared` and match the
+ * HITM lines in `perf c2c report` against them.
+ *
+ * Requires: Linux kernel >= 5.18 for msg-ring, liburing >= 2.2
+ *
+ * Usage: ./ring_contention_bench [-t THREADS] [-n OPS] [-b BATCH] [-q DEPTH]
+ *                                [-m all|per-thread|shared|msg-ring] [-c CPULIST] [-J]
+ * Compile: gcc -O2 -o ring_contention_bench ring_contention_bench.c bench_common.c -luring -lpthread
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <liburing.h>
+
+#include "bench_common.h"
+
+#define MAX_THREADS     256
+#define CACHE_LINE      64
+
+enum { MODE_PER_THREAD, MODE_SHARED, MODE_MSG_RING, MODE_NUM };
+static const char *mode_names[MODE_NUM] = { "per-thread", "shared", "msg-ring" };
+
+static struct {
+    int threads;
+    long ops;                   /* per producer thread */
+    unsigned batch;
+    unsigned depth;
+    unsigned modes;             /* bitmask of MODE_* */
+    int cpus[BC_MAX_CPUS];
+    int ncpus;
+    int bench;
+} cfg = {
+    .threads = 4,
+    .ops = 1000000,
+    .batch = 16,
+    .depth = 256,
+    .modes = (1u << MODE_NUM) - 1,
+};
+
+/* One pinned thread; counters padded so workers do not share lines */
+struct worker {
+    pthread_t thread;
+    int id;
+    int cpu;
+    int mode;
+    struct io_uring ring;       /* per-thread and msg-ring producers */
+    long done;
+    double t0, t1;
+    bc_perf_sample_t perf;
+    int perf_ok;
+    int sw_fallback;
+    int err;
+} __attribute__((aligned(CACHE_LINE)));
+
+struct ack {
+    _Atomic long n;
+} __attribute__((aligned(CACHE_LINE)));
+
+static struct worker workers[MAX_THREADS + 1];   /* + msg-ring owner */
+static struct ack acks[MAX_THREADS];             /* per-producer messages reaped by the owner */
+static struct io_uring shared_ring;              /* shared and msg-ring owner */
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_barrier_t start_barrier;
+static atomic_int aborted;
+
+static void print_usage(const char *prog)
+{
+    printf("Usage: %s [options]\n", prog);
+    printf("  -t THREADS  producer threads (default 4)\n");
+    printf("  -n OPS      NOPs / messages per producer (default 1000000)\n");
+    printf("  -b BATCH    SQEs per submit (default 16)\n");
+    printf("  -q DEPTH    SQ entries per ring (default 256)\n");
+    printf("  -m MODE     all, per-thread, shared or msg-ring (default all)\n");
+    printf("  -c CPULIST  CPUs to pin to in order, e.g. 0-3,8 (default 0..N; the\n");
+    printf("              msg-ring owner takes the CPU after the last producer)\n");
+    printf("  -J          BENCH lines (for bench_suite.sh)\n");
+}
+
+/* ── Workers ───────────────────────────────────────────────────────── */
+
+static void run_per_thread(struct worker *w)
+{
+    while (w->done < cfg.ops && !aborted) {
+        unsigned n = cfg.ops - w->done < cfg.batch ? (unsigned)(cfg.ops - w->done) : cfg.batch;
+        for (unsigned i = 0; i < n; i++)
+            io_uring_prep_nop(io_uring_get_sqe(&w->ring));
+        int ret = io_uring_submit_and_wait(&w->ring, n);
+        if (ret < 0) { w->err = ret; break; }
+        io_uring_cq_advance(&w->ring, n);
+        w->done += n;
+    }
+}
+
+static void run_shared(struct worker *w)
+{
+    while (w->done < cfg.ops && !aborted) {
+        unsigned n = cfg.ops - w->done < cfg.batch ? (unsigned)(cfg.ops - w->done) : cfg.batch;
+        pthread_mutex_lock(&shared_lock);
+        for (unsigned i = 0; i < n; i++) {
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&shared_ring);
+            io_uring_prep_nop(sqe);
+            io_uring_sqe_set_data64(sqe, (uint64_t)w->id);
+        }
+        int ret = io_uring_submit_and_wait(&shared_ring, n);
+        /* The CQ is empty on entry, so everything ready is this batch */
+        if (ret >= 0) io_uring_cq_advance(&shared_ring, io_uring_cq_ready(&shared_ring));
+        pthread_mutex_unlock(&shared_lock);
+        if (ret < 0) { w->err = ret; break; }
+        w->done += n;
+    }
+}
+
+/*
+ * Producers are credit-limited so the owner's CQ never overflows: each may
+ * have at most owner_cq / threads messages the owner has not reaped yet.
+ */
+static void run_msg_producer(struct worker *w, long credit)
+{
+    int owner_fd = shared_ring.ring_fd;
+
+    while (w->done < cfg.ops && !aborted) {
+        unsigned n = cfg.ops - w->done < cfg.batch ? (unsigned)(cfg.ops - w->done) : cfg.batch;
+        while (w->done + n - atomic_load_explicit(&acks[w->id].n, memory_order_acquire) > credit) {
+            if (aborted) return;
+            sched_yield();
+        }
+        for (unsigned i = 0; i < n; i++)
+            io_uring_prep_msg_ring(io_uring_get_sqe(&w->ring), owner_fd, 0, (uint64_t)w->id, 0);
+        int ret = io_uring_submit_and_wait(&w->ring, n);
+        if (ret < 0) { w->err = ret; break; }
+
+        struct io_uring_cqe *cqe;
+        unsigned head, seen = 0;
+        io_uring_for_each_cqe(&w->ring, head, cqe) {
+            if (cqe->res < 0 && !w->err) w->err = cqe->res;
+            seen++;
+        }
+        io_uring_cq_advance(&w->ring, seen);
+        if (w->err) break;
+        w->done += n;
+    }
+}
+
+static void run_msg_owner(struct worker *w, long expected)
+{
+    struct __kernel_timespec ts = { .tv_sec = 0, .tv_nsec = 100 * 1000 * 1000 };
+
+    while (w->done < expected && !aborted) {
+        struct io_uring_cqe *cqe;
+        int ret = io_uring_wait_cqe_timeout(&shared_ring, &cqe, &ts);
+        if (ret == -ETIME || ret == -EINTR) continue;
+        if (ret < 0) { w->err = ret; break; }
+
+        unsigned head, seen = 0;
+        io_uring_for_each_cqe(&shared_ring, head, cqe) {
+            uint64_t id = io_uring_cqe_get_data64(cqe);
+            if (id < MAX_THREADS)
+                atomic_fetch_add_explicit(&acks[id].n, 1, memory_order_release);
+            seen++;
+        }
+        io_uring_cq_advance(&shared_ring, seen);
+        w->done += seen;
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *w = arg;
+    bc_perf_t perf;
+
+    bc_pin_cpu(w->cpu);
+    w->perf_ok = (bc_perf_open(&perf) == 0);
+    w->sw_fallback = perf.sw_fallback;
+    pthread_barrier_wait(&start_barrier);
+
+    bc_perf_start(&perf);
+    w->t0 = bc_now_ns();
+    if (w->mode == MODE_PER_THREAD) {
+        run_per_thread(w);
+    } else if (w->mode == MODE_SHARED) {
+        run_shared(w);
+    } else if (w->id == cfg.threads) {
+        run_msg_owner(w, cfg.ops * cfg.threads);
+    } else {
+        run_msg_producer(w, (long)shared_ring.cq.ring_entries / cfg.threads);
+    }
+    w->t1 = bc_now_ns();
+    bc_perf_stop(&perf, &w->perf);
+    bc_perf_close(&perf);
+
+    if (w->err) atomic_store(&aborted, 1);
+    return NULL;
+}
+
+/* ── Driver ────────────────────────────────────────────────────────── */
+
+static void print_ring_lines(const char *label, const struct io_uring *ring)
+{
+    uintptr_t sh = (uintptr_t)ring->sq.khead, st = (uintptr_t)ring->sq.ktail;
+    uintptr_t ch = (uintptr_t)ring->cq.khead, ct = (uintptr_t)ring->cq.ktail;
+    printf("  %s lines: SQ head %#lx tail %#lx, CQ head %#lx tail %#lx (%s)\n", label,
+           (unsigned long)(sh & ~(uintptr_t)(CACHE_LINE - 1)), (unsigned long)(st & ~(uintptr_t)(CACHE_LINE - 1)),
+           (unsigned long)(ch & ~(uintptr_t)(CACHE_LINE - 1)), (unsigned long)(ct & ~(uintptr_t)(CACHE_LINE - 1)),
+           (sh / CACHE_LINE == ch / CACHE_LINE) ? "SQ and CQ indices share a line" : "SQ and CQ on separate lines");
+}
+
+static int setup_rings(int mode)
+{
+    int ret;
+
+    if (mode == MODE_PER_THREAD || mode == MODE_MSG_RING) {
+        for (int i = 0; i < cfg.threads; i++) {
+            ret = io_uring_queue_init(cfg.depth, &workers[i].ring, 0);
+            if (ret < 0) {
+                fprintf(stderr, "io_uring_queue_init(thread %d): %s\n", i, strerror(-ret));
+                while (--i >= 0) io_uring_queue_exit(&workers[i].ring);
+                return ret;
+            }
+        }
+    }
+    if (mode == MODE_SHARED) {
+        ret = io_uring_queue_init(cfg.depth, &shared_ring, 0);
+    } else if (mode == MODE_MSG_RING) {
+        /* Owner CQ sized so every producer can keep two batches in flight */
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = 2 * cfg.batch * cfg.threads;
+        if (p.cq_entries < 2 * cfg.depth) p.cq_entries = 2 * cfg.depth;
+        ret = io_uring_queue_init_params(cfg.depth, &shared_ring, &p);
+    } else {
+        return 0;
+    }
+    if (ret < 0) {
+        fprintf(stderr, "io_uring_queue_init(%s): %s\n", mode_names[mode], strerror(-ret));
+        if (mode == MODE_MSG_RING)
+            for (int i = 0; i < cfg.threads; i++) io_uring_queue_exit(&workers[i].ring);
+    }
+    return ret;
+}
+
+static void teardown_rings(int mode)
+{
+    if (mode != MODE_SHARED)
+        for (int i = 0; i < cfg.threads; i++) io_uring_queue_exit(&workers[i].ring);
+    if (mode != MODE_PER_THREAD)
+        io_uring_queue_exit(&shared_ring);
+}
+
+static int run_mode(int mode)
+{
+    int nthreads = cfg.threads + (mode == MODE_MSG_RING);
+
+    if (setup_rings(mode) < 0) return 1;
+    atomic_store(&aborted, 0);
+    for (int i = 0; i < cfg.threads; i++) atomic_store(&acks[i].n, 0);
+
+    pthread_barrier_init(&start_barrier, NULL, nthreads);
+    for (int i = 0; i < nthreads; i++) {
+        struct worker *w = &workers[i];
+        w->id = i;
+        w->cpu = cfg.cpus[i % cfg.ncpus];
+        w->mode = mode;
+        w->done = 0;
+        w->err = 0;
+        if (pthread_create(&w->thread, NULL, worker_main, w) != 0) {
+            fprintf(stderr, "pthread_create: %s\n", strerror(errno));
+            exit(1);
+        }
+    }
+    for (int i = 0; i < nthreads; i++) pthread_join(workers[i].thread, NULL);
+    pthread_barrier_destroy(&start_barrier);
+
+    double t0 = workers[0].t0, t1 = workers[0].t1;
+    long ops = 0;
+    int err = 0, perf_ok = 1, sw_fallback = 0;
+    bc_perf_sample_t perf = {0};
+    for (int i = 0; i < nthreads; i++) {
+        struct worker *w = &workers[i];
+        if (w->t0 < t0) t0 = w->t0;
+        if (w->t1 > t1) t1 = w->t1;
+        if (i < cfg.threads) ops += w->done;
+        if (w->err && !err) err = w->err;
+        perf_ok &= w->perf_ok;
+        sw_fallback |= w->sw_fallback;
+        bc_perf_add(&perf, &w->perf);
+    }
+
+    printf("%s (%d thread%s%s):\n", mode_names[mode], cfg.threads, cfg.threads == 1 ? "" : "s",
+           mode == MODE_MSG_RING ? " + owner" : "");
+    if (mode == MODE_SHARED || mode == MODE_MSG_RING)
+        print_ring_lines(mode == MODE_SHARED ? "shared ring" : "owner ring", &shared_ring);
+    teardown_rings(mode);
+
+    if (err) {
+        if (mode == MODE_MSG_RING && (err == -EINVAL || err == -EOPNOTSUPP))
+            printf("  IORING_OP_MSG_RING not supported by this kernel (%s)\n\n", strerror(-err));
+        else
+            printf("  failed: %s\n\n", strerror(-err));
+        return mode == MODE_MSG_RING && (err == -EINVAL || err == -EOPNOTSUPP) ? 0 : 1;
+    }
+
+    double secs = (t1 - t0) / 1e9;
+    double mops = ops / secs / 1e6;
+    /* Per worker core: the MSG_RING owner only forwards, it submits no ops */
+    int cores = cfg.threads < cfg.ncpus ? cfg.threads : cfg.ncpus;
+    double kops_core = ops / secs / 1e3 / cores;
+    printf("  %ld ops in %.3f s: %.2f Mops/s, %.1f Kops/s per core, %.1f ns/op\n",
+           ops, secs, mops, kops_core, (t1 - t0) / ops);
+
+    if (!perf_ok || !perf.mask) {
+        printf("  perf counters unavailable\n\n");
+    } else {
+        printf("  per op:");
+        for (int c = 0; c < BC_PC_NUM; c++) {
+            if (!(perf.mask & (1u << c))) continue;
+            printf(" %s=%.2f", c == BC_PC_CYCLES && sw_fallback ? "task-clock-ns" : bc_perf_names[c],
+                   (double)perf.v[c] / ops);
+        }
+        printf("\n\n");
+    }
+
+    if (cfg.bench) {
+        char metric[64];
+        snprintf(metric, sizeof(metric), "%s.t%d.mops", mode_names[mode], cfg.threads);
+        bc_bench_line("ring_contention", metric, mops, "Mops/s", "higher");
+        snprintf(metric, sizeof(metric), "%s.t%d.kops_per_core", mode_names[mode], cfg.threads);
+        bc_bench_line("ring_contention", metric, kops_core, "Kops/s", "higher");
+        if (perf_ok && (perf.mask & (1u << BC_PC_CACHE_MISSES))) {
+            snprintf(metric, sizeof(metric), "%s.t%d.cache_misses_per_op", mode_names[mode], cfg.threads);
+            bc_bench_line("ring_contention", metric, (double)perf.v[BC_PC_CACHE_MISSES] / ops,
+                          "misses", "lower");
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *cpulist = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:n:b:q:m:c:Jh")) != -1) {
+        switch (opt) {
+        case 't': cfg.threads = atoi(optarg); break;
+        case 'n': cfg.ops = atol(optarg); break;
+        case 'b': cfg.batch = (unsigned)atoi(optarg); break;
+        case 'q': cfg.depth = (unsigned)atoi(optarg); break;
+        case 'c': cpulist = optarg; break;
+        case 'J': cfg.bench = 1; break;
+        case 'm':
+            if (strcmp(optarg, "all") == 0) { cfg.modes = (1u << MODE_NUM) - 1; break; }
+            cfg.modes = 0;
+            for (int m = 0; m < MODE_NUM; m++)
+                if (strcmp(optarg, mode_names[m]) == 0) cfg.modes = 1u << m;
+            if (!cfg.modes) {
+                fprintf(stderr, "unknown mode '%s'\n", optarg);
+                return 2;
+            }
+            break;
+        default:
+            print_usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (cfg.threads < 1 || cfg.threads > MAX_THREADS || cfg.ops < 1 || cfg.batch < 1 ||
+        cfg.depth < cfg.batch) {
+        fprintf(stderr, "need 1 <= THREADS <= %d, OPS >= 1 and 1 <= BATCH <= DEPTH\n", MAX_THREADS);
+        return 2;
+    }
+
+    if (cpulist) {
+        cfg.ncpus = bc_parse_cpulist(cpulist, cfg.cpus, BC_MAX_CPUS);
+        if (cfg.ncpus <= 0) {
+            fprintf(stderr, "bad CPU list '%s'\n", cpulist);
+            return 2;
+        }
+    } else {
+        cfg.ncpus = bc_nr_cpus();
+        if (cfg.ncpus > BC_MAX_CPUS) cfg.ncpus = BC_MAX_CPUS;
+        for (int i = 0; i < cfg.ncpus; i++) cfg.cpus[i] = i;
+    }
+    if (cfg.ncpus < cfg.threads + 1)
+        printf("note: %d CPU(s) for %d threads (+ msg-ring owner); some threads share a CPU\n\n",
+               cfg.ncpus, cfg.threads);
+
+    printf("io_uring contention: %d producer(s), %ld ops each, batch %u, depth %u\n\n",
+           cfg.threads, cfg.ops, cfg.batch, cfg.depth);
+
+    int rc = 0;
+    for (int m = 0; m < MODE_NUM; m++)
+        if (cfg.modes & (1u << m)) rc |= run_mode(m);
+    return rc;
+}
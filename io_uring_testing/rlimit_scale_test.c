@@ -9,7 +9,10 @@
  * 
  * It demonstrates the relationship between OS tunables and io_uring capacity.
  * 
- * Compile: gcc -o rlimit_scale_test rlimit_scale_test.c -lm
+ * Compile: gcc -o rlimit_scale_test rlimit_scale_test.c ../ring_model/ring_model.c -lm
+ *
+ * Per-ring sizes come from the shared ring model (../ring_model); export
+ * RING_MODEL_PARAMS=<file> to use constants calibrated on the target kernel.
  */
 
 #include <stdio.h>
@@ -18,14 +21,12 @@
 #include <unistd.h>
 #include <math.h>
 
+#include "../ring_model/ring_model.h"
+
 /*
  * io_uring constants
  */
-#define IORING_MAX_ENTRIES      32768
-#define SQE_SIZE                64
-#define CQE_SIZE                16
-#define SQ_RING_HEADER          128
-#define CQ_RING_HEADER          128
+#define IORING_MAX_ENTRIES      RM_MAX_SQ_ENTRIES
 
 /*
  * Common RLIMIT_MEMLOCK values in KB
@@ -68,43 +69,17 @@ static ring_config_t ring_configs[] = {
 };
 #define NUM_CONFIGS (sizeof(ring_configs) / sizeof(ring_configs[0]))
 
-/*
- * Round up to power of 2
- */
-static unsigned int roundup_pow2(unsigned int x) {
-    if (x == 0) return 1;
-    x--;
-    x |= x >> 1;
-    x |= x >> 2;
-    x |= x >> 4;
-    x |= x >> 8;
-    x |= x >> 16;
-    return x + 1;
-}
-
-/*
- * Round up to page size
- */
-static size_t page_align(size_t size) {
-    long page_size = sysconf(_SC_PAGESIZE);
-    return ((size + page_size - 1) / page_size) * page_size;
-}
-
 /*
  * Calculate memory for a single ring
  */
 static size_t calculate_ring_memory(unsigned int sq_entries, unsigned int cq_multiplier) {
-    unsigned int actual_sq = roundup_pow2(sq_entries);
-    unsigned int actual_cq = actual_sq * cq_multiplier;
-    
-    if (actual_sq > IORING_MAX_ENTRIES) actual_sq = IORING_MAX_ENTRIES;
-    if (actual_cq > IORING_MAX_ENTRIES * 2) actual_cq = IORING_MAX_ENTRIES * 2;
-    
-    size_t sq_ring = page_align(SQ_RING_HEADER + actual_sq * sizeof(unsigned int));
-    size_t cq_ring = page_align(CQ_RING_HEADER + actual_cq * CQE_SIZE);
-    size_t sqe_array = page_align(actual_sq * SQE_SIZE);
-    
-    return sq_ring + cq_ring + sqe_array;
+    rm_ring_config_t cfg = {
+        .sq_entries = sq_entries,
+        .cq_entries = rm_roundup_pow2(sq_entries) * cq_multiplier,
+    };
+    rm_ring_memory_t m;
+    rm_calc(rm_params(), &cfg, &m);
+    return m.ring_bytes;
 }
 
 /*
@@ -146,8 +121,8 @@ static void print_header(void) {
     
     printf("System Configuration:\n");
     printf("  Page Size: %ld bytes\n", sysconf(_SC_PAGESIZE));
-    printf("  SQE Size:  %d bytes\n", SQE_SIZE);
-    printf("  CQE Size:  %d bytes\n", CQE_SIZE);
+    printf("  SQE Size:  %d bytes\n", RM_SQE_SIZE);
+    printf("  CQE Size:  %d bytes\n", RM_CQE_SIZE);
     printf("  Max Entries: %d\n\n", IORING_MAX_ENTRIES);
 }
 
@@ -163,7 +138,7 @@ static void print_ring_memory_table(void) {
     printf("├─────────────────────────────────────────────────────────────────────────────┤\n");
     
     for (int i = 0; i < NUM_CONFIGS; i++) {
-        unsigned int actual_sq = roundup_pow2(ring_configs[i].sq_entries);
+        unsigned int actual_sq = rm_roundup_pow2(ring_configs[i].sq_entries);
         unsigned int actual_cq = actual_sq * ring_configs[i].cq_multiplier;
         size_t mem = calculate_ring_memory(ring_configs[i].sq_entries, 
                                            ring_configs[i].cq_multiplier);
@@ -413,22 +388,21 @@ static void print_formula(void) {
     printf("║                    Memory Calculation Formula                                ║\n");
     printf("╚══════════════════════════════════════════════════════════════════════════════╝\n\n");
     
-    printf("Per-Ring Memory = SQ_Ring + CQ_Ring + SQE_Array\n\n");
+    printf("Per-Ring Memory = Rings + SQE_Array   (locked; Kernel/Inflight are slab)\n\n");
     printf("Where:\n");
-    printf("  SQ_Ring   = page_align(128 + 4 × SQ_entries)\n");
-    printf("  CQ_Ring   = page_align(128 + 16 × CQ_entries)\n");
-    printf("  SQE_Array = page_align(64 × SQ_entries)\n\n");
-    printf("  page_align(x) = ceil(x / 4096) × 4096\n\n");
+    rm_print_formula(stdout, rm_params(), "  ");
     printf("  CQ_entries = SQ_entries × CQ_multiplier (default: 2)\n\n");
     
     printf("Required RLIMIT_MEMLOCK = Per_Ring_Memory × Number_of_Rings\n\n");
     
     printf("Quick Reference (standard configuration, CQ = 2×SQ):\n");
-    printf("  32 entries:    ~12 KB per ring\n");
-    printf("  256 entries:   ~32 KB per ring\n");
-    printf("  1024 entries:  ~108 KB per ring\n");
-    printf("  4096 entries:  ~408 KB per ring\n");
-    printf("  32768 entries: ~3.2 MB per ring\n\n");
+    static const unsigned int quick[] = {32, 256, 1024, 4096, 32768};
+    for (size_t i = 0; i < sizeof(quick) / sizeof(quick[0]); i++) {
+        char mem_str[32];
+        format_bytes(calculate_ring_memory(quick[i], 2), mem_str, sizeof(mem_str));
+        printf("  %-6u entries: ~%s per ring\n", quick[i], mem_str);
+    }
+    printf("\n");
 }
 
 int main(int argc, char *argv[]) {
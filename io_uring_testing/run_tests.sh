@@ -72,7 +72,7 @@ if [ -f ./io_uring_simulator ]; then
     ./io_uring_simulator
 else
     echo "Simulator not found. Please compile first:"
-    echo "  gcc -o io_uring_simulator io_uring_simulator.c -lm"
+    echo "  gcc -o io_uring_simulator io_uring_simulator.c ../ring_model/ring_model.c -lm"
 fi
 
 # If io_uring is available and liburing is installed, try actual tests
@@ -85,7 +85,7 @@ if [ $IO_URING_AVAILABLE -eq 1 ]; then
     
     if command -v pkg-config &> /dev/null && pkg-config --exists liburing; then
         echo "liburing found, compiling actual tests..."
-        gcc -o io_uring_memory_test io_uring_memory_test.c -luring -lpthread 2>/dev/null && {
+        gcc -o io_uring_memory_test io_uring_memory_test.c ../ring_model/ring_model.c -luring -lpthread 2>/dev/null && {
             ./io_uring_memory_test
         } || {
             echo "Compilation or execution failed"
@@ -0,0 +1,245 @@
+/*
+ * io_uring ring memory model -- see ring_model.h
+ */
+
+#include "ring_model.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/utsname.h>
+
+/* ── Params ────────────────────────────────────────────────────────── */
+
+void rm_params_default(rm_params_t *p)
+{
+    memset(p, 0, sizeof(*p));
+    p->page_size            = 4096;
+    p->sq_header_bytes      = 64;
+    p->cq_header_bytes      = 64;     /* cq_off.cqes on x86_64 6.x */
+    p->sq_array_align       = 64;     /* SMP_CACHE_BYTES */
+    p->single_mmap          = 1;      /* IORING_FEAT_SINGLE_MMAP since 5.4 */
+    p->kernel_ctx_bytes     = 8192;   /* io_ring_ctx + cancel hash + file + tctx */
+    p->kernel_per_sqe_bytes = 0;      /* requests are allocated on demand */
+    p->kernel_req_bytes     = 256;    /* io_kiocb */
+    snprintf(p->source, sizeof(p->source), "builtin");
+}
+
+/*
+ * Params file: one "key = value" per line, '#' starts a comment.
+ * Unknown keys are ignored so older tools can read newer files.
+ */
+int rm_params_load(rm_params_t *p, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    char line[256], kernel[64] = "";
+    while (fgets(line, sizeof(line), f)) {
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char key[64], val[128];
+        if (sscanf(line, " %63[^= ] = %127s", key, val) != 2) continue;
+
+        unsigned long long v = strtoull(val, NULL, 10);
+        if      (!strcmp(key, "page_size"))            p->page_size = (uint32_t)v;
+        else if (!strcmp(key, "sq_header_bytes"))      p->sq_header_bytes = (uint32_t)v;
+        else if (!strcmp(key, "cq_header_bytes"))      p->cq_header_bytes = (uint32_t)v;
+        else if (!strcmp(key, "sq_array_align"))       p->sq_array_align = (uint32_t)v;
+        else if (!strcmp(key, "single_mmap"))          p->single_mmap = (int)v;
+        else if (!strcmp(key, "kernel_ctx_bytes"))     p->kernel_ctx_bytes = v;
+        else if (!strcmp(key, "kernel_per_sqe_bytes")) p->kernel_per_sqe_bytes = v;
+        else if (!strcmp(key, "kernel_req_bytes"))     p->kernel_req_bytes = v;
+        else if (!strcmp(key, "kernel"))               snprintf(kernel, sizeof(kernel), "%.40s", val);
+    }
+    fclose(f);
+
+    if (p->page_size == 0) p->page_size = 4096;
+    if (p->sq_array_align == 0) p->sq_array_align = 1;
+    if (kernel[0])
+        snprintf(p->source, sizeof(p->source), "%.80s (%.40s)", path, kernel);
+    else
+        snprintf(p->source, sizeof(p->source), "%.120s", path);
+    return 0;
+}
+
+int rm_params_save(const rm_params_t *p, const char *path, const char *comment)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    fprintf(f, "# io_uring ring memory model parameters\n");
+    if (comment) fprintf(f, "%s", comment);
+    fprintf(f, "page_size = %u\n", p->page_size);
+    fprintf(f, "sq_header_bytes = %u\n", p->sq_header_bytes);
+    fprintf(f, "cq_header_bytes = %u\n", p->cq_header_bytes);
+    fprintf(f, "sq_array_align = %u\n", p->sq_array_align);
+    fprintf(f, "single_mmap = %d\n", p->single_mmap);
+    fprintf(f, "kernel_ctx_bytes = %llu\n", (unsigned long long)p->kernel_ctx_bytes);
+    fprintf(f, "kernel_per_sqe_bytes = %llu\n", (unsigned long long)p->kernel_per_sqe_bytes);
+    fprintf(f, "kernel_req_bytes = %llu\n", (unsigned long long)p->kernel_req_bytes);
+    return fclose(f);
+}
+
+void rm_params_print(FILE *out, const rm_params_t *p, const char *indent)
+{
+    fprintf(out, "%sModel params     : %s\n", indent, p->source);
+    fprintf(out, "%s  page=%u  cq_header=%u  sq_array_align=%u  single_mmap=%d\n",
+            indent, p->page_size, p->cq_header_bytes, p->sq_array_align, p->single_mmap);
+    fprintf(out, "%s  kernel ctx=%llu B  per-SQE=%llu B  per-request=%llu B\n",
+            indent, (unsigned long long)p->kernel_ctx_bytes,
+            (unsigned long long)p->kernel_per_sqe_bytes,
+            (unsigned long long)p->kernel_req_bytes);
+}
+
+const rm_params_t *rm_params(void)
+{
+    static rm_params_t params;
+    static int loaded;
+    if (!loaded) {
+        rm_params_default(&params);
+        const char *path = getenv(RM_PARAMS_ENV);
+        if (path && *path && rm_params_load(&params, path) != 0) {
+            fprintf(stderr, "Warning: cannot read %s=%s, using builtin model\n", RM_PARAMS_ENV, path);
+            rm_params_default(&params);
+        }
+        loaded = 1;
+    }
+    return &params;
+}
+
+/* ── Calculation ───────────────────────────────────────────────────── */
+
+uint32_t rm_roundup_pow2(uint32_t v)
+{
+    if (v == 0) return 1;
+    v--;
+    v |= v >> 1;  v |= v >> 2;  v |= v >> 4;
+    v |= v >> 8;  v |= v >> 16;
+    return v + 1;
+}
+
+static uint64_t align_up(uint64_t v, uint64_t a)
+{
+    return (v + a - 1) / a * a;
+}
+
+uint64_t rm_page_align(const rm_params_t *p, uint64_t bytes)
+{
+    return align_up(bytes, p->page_size);
+}
+
+void rm_calc(const rm_params_t *p, const rm_ring_config_t *cfg, rm_ring_memory_t *m)
+{
+    memset(m, 0, sizeof(*m));
+
+    /* Same clamping as io_uring_create(): SQ rounded up, CQ at least 2x SQ */
+    uint32_t sq = rm_roundup_pow2(cfg->sq_entries ? cfg->sq_entries : 1);
+    if (sq > RM_MAX_SQ_ENTRIES) sq = RM_MAX_SQ_ENTRIES;
+    uint32_t cq = cfg->cq_entries ? rm_roundup_pow2(cfg->cq_entries) : sq * RM_DEFAULT_CQ_FACTOR;
+    if (cq < sq) cq = sq;
+    if (cq > RM_MAX_CQ_ENTRIES) cq = RM_MAX_CQ_ENTRIES;
+    m->sq_actual = sq;
+    m->cq_actual = cq;
+
+    const uint64_t sqe_sz = cfg->sqe128 ? RM_SQE128_SIZE : RM_SQE_SIZE;
+    const uint64_t cqe_sz = cfg->cqe32 ? RM_CQE32_SIZE : RM_CQE_SIZE;
+
+    if (p->single_mmap) {
+        uint64_t off = align_up(p->cq_header_bytes + (uint64_t)cq * cqe_sz, p->sq_array_align);
+        m->sq_ring_bytes = 0;
+        m->cq_ring_bytes = rm_page_align(p, off + (uint64_t)sq * sizeof(uint32_t));
+        m->mmap_regions  = 2;
+    } else {
+        m->sq_ring_bytes = rm_page_align(p, p->sq_header_bytes + (uint64_t)sq * sizeof(uint32_t));
+        m->cq_ring_bytes = rm_page_align(p, p->cq_header_bytes + (uint64_t)cq * cqe_sz);
+        m->mmap_regions  = 3;
+    }
+    m->sqe_array_bytes = rm_page_align(p, (uint64_t)sq * sqe_sz);
+    m->ring_bytes = m->sq_ring_bytes + m->cq_ring_bytes + m->sqe_array_bytes;
+
+    /* Pinned accounting charges whole compound pages, not just the bytes used */
+    m->buf_page_size  = cfg->buf_page_size > p->page_size ? cfg->buf_page_size : p->page_size;
+    m->reg_buf_bytes  = align_up(cfg->registered_bufs, m->buf_page_size);
+    m->reg_buf_pages  = m->reg_buf_bytes / m->buf_page_size;
+    m->reg_file_bytes = (uint64_t)cfg->registered_files * 8;
+    if (cfg->registered_bufs > 0) m->mmap_regions += 1;
+
+    m->kernel_bytes          = p->kernel_ctx_bytes + p->kernel_per_sqe_bytes * sq;
+    m->kernel_inflight_bytes = p->kernel_req_bytes * sq;
+
+    m->total_bytes = m->ring_bytes + m->reg_buf_bytes + m->reg_file_bytes;
+}
+
+void rm_print_formula(FILE *out, const rm_params_t *p, const char *indent)
+{
+    if (p->single_mmap) {
+        fprintf(out, "%sRings     = page_align(align(%u + CQE_size x CQ, %u) + 4 x SQ)\n",
+                indent, p->cq_header_bytes, p->sq_array_align);
+    } else {
+        fprintf(out, "%sSQ_Ring   = page_align(%u + 4 x SQ)\n", indent, p->sq_header_bytes);
+        fprintf(out, "%sCQ_Ring   = page_align(%u + CQE_size x CQ)\n", indent, p->cq_header_bytes);
+    }
+    fprintf(out, "%sSQE_Array = page_align(SQE_size x SQ)\n", indent);
+    fprintf(out, "%sBufs      = align(registered_bufs, buf_page_size)   (whole huge pages when hugetlb)\n", indent);
+    fprintf(out, "%sKernel    = %llu + %llu x SQ   (slab at setup)\n", indent,
+            (unsigned long long)p->kernel_ctx_bytes, (unsigned long long)p->kernel_per_sqe_bytes);
+    fprintf(out, "%sInflight  = %llu x SQ          (io_kiocb, SQ full)\n", indent,
+            (unsigned long long)p->kernel_req_bytes);
+    fprintf(out, "%s  page_align(x) = ceil(x / %u) x %u, SQE_size 64|128, CQE_size 16|32\n",
+            indent, p->page_size, p->page_size);
+    fprintf(out, "%s  CQ = 2 x SQ unless IORING_SETUP_CQSIZE; both rounded to a power of 2\n", indent);
+    fprintf(out, "%s  constants: %s\n", indent, p->source);
+}
+
+/* ── Kernel accounting profiles ────────────────────────────────────── */
+
+static const rm_acct_profile_t acct_profiles[] = {
+    { "5.1",  5, 1,  1, 1, 64ULL << 10,
+      "rings + buffers on RLIMIT_MEMLOCK (per user), separate SQ/CQ mappings" },
+    { "5.4",  5, 4,  1, 0, 64ULL << 10,
+      "rings + buffers on RLIMIT_MEMLOCK (per user)" },
+    { "5.12", 5, 12, 0, 0, 64ULL << 10,
+      "rings on memcg, buffers on RLIMIT_MEMLOCK (per user)" },
+    { "5.16", 5, 16, 0, 0, 8ULL << 20,
+      "rings on memcg, buffers on RLIMIT_MEMLOCK (per user), 8 MiB default" },
+};
+#define NUM_ACCT_PROFILES (sizeof(acct_profiles) / sizeof(acct_profiles[0]))
+
+const rm_acct_profile_t *rm_acct_profile_for_release(const char *release)
+{
+    int major, minor;
+    if (sscanf(release, "%d.%d", &major, &minor) != 2) return NULL;
+    const rm_acct_profile_t *best = NULL;
+    for (size_t i = 0; i < NUM_ACCT_PROFILES; i++) {
+        const rm_acct_profile_t *p = &acct_profiles[i];
+        if (major > p->major || (major == p->major && minor >= p->minor)) best = p;
+    }
+    return best;
+}
+
+const rm_acct_profile_t *rm_acct_profile_select(const char *arg, char *source, size_t sourcesz,
+                                                int *fallback)
+{
+    const rm_acct_profile_t *p;
+    *fallback = 0;
+    if (!arg || !strcmp(arg, "auto")) {
+        struct utsname u;
+        int have = uname(&u) == 0;
+        if (have && (p = rm_acct_profile_for_release(u.release))) {
+            snprintf(source, sourcesz, "auto, uname %.64s", u.release);
+            return p;
+        }
+        /* Planning for another host is fine, but the caller should say so */
+        *fallback = 1;
+        snprintf(source, sourcesz, "auto, %.48s not supported", have ? u.release : "release unknown");
+        return &acct_profiles[NUM_ACCT_PROFILES - 1];
+    }
+    for (size_t i = 0; i < NUM_ACCT_PROFILES; i++) {
+        if (!strcmp(arg, acct_profiles[i].name)) {
+            snprintf(source, sourcesz, "selected %.64s", arg);
+            return &acct_profiles[i];
+        }
+    }
+    if (!(p = rm_acct_profile_for_release(arg))) return NULL;
+    snprintf(source, sourcesz, "selected %.64s", arg);
+    return p;
+}
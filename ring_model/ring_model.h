@@ -0,0 +1,145 @@
+/*
+ * io_uring ring memory model
+ *
+ * One calibrated formula for how much memory an io_uring instance maps and
+ * how much kernel memory sits behind it. Shared by uring_sim.c,
+ * io_uring_testing/{io_uring_simulator,rlimit_scale_test,io_uring_memory_test}.c
+ * and io_uring_refactor/uring_mem_sim.c so capacity plans do not depend on
+ * which tool produced them.
+ *
+ * Layout modelled (Linux >= 5.4, IORING_FEAT_SINGLE_MMAP):
+ *
+ *   rings  = page_align(align(cq_header + CQ * cqe_size, sq_array_align) + 4 * SQ)
+ *   sqes   = page_align(SQ * sqe_size)
+ *   kernel = kernel_ctx_bytes + kernel_per_sqe_bytes * SQ        (slab at setup)
+ *   inflight = kernel_req_bytes * SQ                             (io_kiocb at full depth)
+ *   bufs   = align(registered_bufs, buf_page_size)
+ *
+ * Pinning a registered buffer charges every page it touches in full; for a
+ * hugetlb-backed pool the kernel accounts the whole compound page, so the
+ * pool is rounded up to the huge page size rather than to page_size.
+ *
+ * Without single_mmap the SQ and CQ rings are separate mappings with their
+ * own header. Constants come from builtin defaults (x86_64, 6.x) or from a
+ * params file written by ring_model_calibrate on the target kernel; set
+ * RING_MODEL_PARAMS=<file> to make every tool use it.
+ *
+ * Build: add ring_model/ring_model.c to the tool's gcc line (no extra libs).
+ */
+
+#ifndef RING_MODEL_H
+#define RING_MODEL_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* ── Kernel constants ──────────────────────────────────────────────── */
+
+#define RM_SQE_SIZE           64      /* sizeof(struct io_uring_sqe) */
+#define RM_SQE128_SIZE        128     /* with IORING_SETUP_SQE128 */
+#define RM_CQE_SIZE           16      /* sizeof(struct io_uring_cqe) */
+#define RM_CQE32_SIZE         32      /* with IORING_SETUP_CQE32 */
+#define RM_MAX_SQ_ENTRIES     32768   /* IORING_MAX_ENTRIES */
+#define RM_MAX_CQ_ENTRIES     (2 * RM_MAX_SQ_ENTRIES)
+#define RM_DEFAULT_CQ_FACTOR  2       /* CQ = 2 x SQ unless IORING_SETUP_CQSIZE */
+
+#define RM_PARAMS_ENV         "RING_MODEL_PARAMS"
+
+/* ── Model constants (calibratable) ────────────────────────────────── */
+
+typedef struct {
+    uint32_t page_size;             /* mapping granularity */
+    uint32_t sq_header_bytes;       /* SQ ring header when not single_mmap */
+    uint32_t cq_header_bytes;       /* struct io_rings before the CQEs (cq_off.cqes) */
+    uint32_t sq_array_align;        /* SQ index array alignment after the CQEs */
+    int      single_mmap;           /* SQ and CQ rings share one mapping */
+    uint64_t kernel_ctx_bytes;      /* per-ring slab: io_ring_ctx, file, tctx */
+    uint64_t kernel_per_sqe_bytes;  /* per-SQ-entry slab at setup */
+    uint64_t kernel_req_bytes;      /* io_kiocb per in-flight request */
+    char     source[128];           /* "builtin" or "<file> (<kernel release>)" */
+} rm_params_t;
+
+/* ── Per-ring config and result ────────────────────────────────────── */
+
+typedef struct {
+    uint32_t sq_entries;            /* requested */
+    uint32_t cq_entries;            /* requested, 0 = RM_DEFAULT_CQ_FACTOR x SQ */
+    int      sqe128;
+    int      cqe32;
+    uint64_t registered_bufs;       /* bytes per ring */
+    uint32_t registered_files;
+    uint64_t buf_page_size;         /* page backing the buffers (2M/1G hugetlb), 0 = page_size */
+} rm_ring_config_t;
+
+typedef struct {
+    uint32_t sq_actual;
+    uint32_t cq_actual;
+    uint64_t sq_ring_bytes;         /* 0 when shared with the CQ ring */
+    uint64_t cq_ring_bytes;         /* CQ ring, or both rings with single_mmap */
+    uint64_t sqe_array_bytes;
+    uint64_t ring_bytes;            /* sq + cq + sqe mappings */
+    uint64_t reg_buf_bytes;         /* pinned: whole backing pages */
+    uint64_t reg_buf_pages;         /* backing pages pinned for the buffers */
+    uint64_t buf_page_size;         /* effective backing page size */
+    uint64_t reg_file_bytes;        /* kernel file table, 8 bytes per slot */
+    uint64_t kernel_bytes;          /* slab behind the ring at setup */
+    uint64_t kernel_inflight_bytes; /* io_kiocb with the SQ full */
+    uint64_t total_bytes;           /* ring + registered buffers + file table */
+    uint32_t mmap_regions;          /* VMAs: ring mapping(s) + SQEs + buffer pool */
+} rm_ring_memory_t;
+
+/* ── Kernel accounting profiles ────────────────────────────────────── */
+
+/*
+ * Where the kernel charges ring memory has moved between releases:
+ *   5.1   rings and registered buffers count against RLIMIT_MEMLOCK via the
+ *         owning user's locked_vm, so every ring the user opens shares one limit;
+ *         SQ and CQ rings are separate mappings
+ *   5.4   IORING_FEAT_SINGLE_MMAP: one ring mapping fewer per instance
+ *   5.12  ring and SQE pages move to the memory cgroup (GFP_KERNEL_ACCOUNT);
+ *         only registered buffers still count against RLIMIT_MEMLOCK
+ *   5.16  default RLIMIT_MEMLOCK raised from 64 KiB to 8 MiB
+ * A release uses the newest profile at or below its version.
+ */
+
+typedef struct {
+    const char *name;
+    int         major, minor;           /* first release with this policy */
+    int         rings_memlock;          /* ring + SQE pages charged to RLIMIT_MEMLOCK */
+    int         separate_sq_ring;       /* no single mmap: one more VMA per ring */
+    uint64_t    default_memlock;        /* RLIMIT_MEMLOCK before any tuning */
+    const char *summary;
+} rm_acct_profile_t;
+
+#define RM_ACCT_PROFILE_NAMES "5.1|5.4|5.12|5.16"
+
+/* ── API ───────────────────────────────────────────────────────────── */
+
+void rm_params_default(rm_params_t *p);
+int  rm_params_load(rm_params_t *p, const char *path);
+int  rm_params_save(const rm_params_t *p, const char *path, const char *comment);
+void rm_params_print(FILE *out, const rm_params_t *p, const char *indent);
+
+/* Process-wide params: builtin defaults, overridden by $RING_MODEL_PARAMS. */
+const rm_params_t *rm_params(void);
+
+uint32_t rm_roundup_pow2(uint32_t v);
+uint64_t rm_page_align(const rm_params_t *p, uint64_t bytes);
+
+void rm_calc(const rm_params_t *p, const rm_ring_config_t *cfg, rm_ring_memory_t *m);
+
+/* Prints the formula with the active constants, for the tools' help/report text. */
+void rm_print_formula(FILE *out, const rm_params_t *p, const char *indent);
+
+/* Newest profile at or below "major.minor[...]", NULL if unparsable or < 5.1 */
+const rm_acct_profile_t *rm_acct_profile_for_release(const char *release);
+
+/*
+ * "auto" or NULL (uname -r), a profile name or a release. Describes the
+ * choice in source. When auto cannot match the running kernel it falls back
+ * to the newest profile and sets *fallback; NULL for an unknown argument.
+ */
+const rm_acct_profile_t *rm_acct_profile_select(const char *arg, char *source, size_t sourcesz,
+                                                int *fallback);
+
+#endif /* RING_MODEL_H */
@@ -0,0 +1,274 @@
+/*
+ * ring_model_calibrate -- fit ring_model constants on the running kernel
+ *
+ * Creates real io_uring instances across SQ sizes and SQE128/CQE32 combos,
+ * reads the offsets the kernel reports (cq_off.cqes, sq_off.array,
+ * IORING_FEAT_SINGLE_MMAP) and checks the model's ring mapping size against
+ * liburing's ring_sz. Kernel-side slab is fitted by least squares on
+ * /proc/meminfo Slab deltas while holding K rings per size.
+ *
+ * Build:
+ *   gcc -O2 -Wall -o ring_model_calibrate ring_model_calibrate.c ring_model.c -luring
+ *
+ * Run:
+ *   ./ring_model_calibrate                    # print fitted params
+ *   ./ring_model_calibrate -o params.conf     # write a params file
+ *   RING_MODEL_PARAMS=params.conf ./uring_sim --sweep
+ */
+
+#include "ring_model.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <liburing.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#ifndef IORING_SETUP_SQE128
+#define IORING_SETUP_SQE128 (1U << 10)
+#endif
+#ifndef IORING_SETUP_CQE32
+#define IORING_SETUP_CQE32  (1U << 11)
+#endif
+
+#define MAX_SAMPLES     64
+
+static const uint32_t sizes[] = { 64, 256, 1024, 4096, 16384 };
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+/* ── Helpers ───────────────────────────────────────────────────────── */
+
+static long read_meminfo_kb(const char *key)
+{
+    FILE *f = fopen("/proc/meminfo", "r");
+    if (!f) return -1;
+    char line[256];
+    size_t klen = strlen(key);
+    long val = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, key, klen) == 0 && line[klen] == ':') {
+            sscanf(line + klen + 1, "%ld", &val);
+            break;
+        }
+    }
+    fclose(f);
+    return val;
+}
+
+static uint64_t actual_ring_bytes(const struct io_uring *ring, unsigned flags, unsigned sq_entries)
+{
+    size_t sqe_sz = (flags & IORING_SETUP_SQE128) ? RM_SQE128_SIZE : RM_SQE_SIZE;
+    size_t sq_sz = ring->sq.ring_sz, cq_sz = ring->cq.ring_sz;
+    uint64_t rings = (ring->features & IORING_FEAT_SINGLE_MMAP)
+                   ? (sq_sz > cq_sz ? sq_sz : cq_sz)
+                   : sq_sz + cq_sz;
+    long page = sysconf(_SC_PAGESIZE);
+    uint64_t sqes = ((uint64_t)sq_entries * sqe_sz + page - 1) / page * page;
+    /* liburing reports the unaligned size; the kernel maps whole pages */
+    rings = (rings + page - 1) / page * page;
+    return rings + sqes;
+}
+
+static const char *combo_name(unsigned flags)
+{
+    if (flags == 0) return "-";
+    if (flags == IORING_SETUP_SQE128) return "sqe128";
+    if (flags == IORING_SETUP_CQE32) return "cqe32";
+    return "both";
+}
+
+/* ── Layout fit ────────────────────────────────────────────────────── */
+
+static int fit_layout(rm_params_t *p, int verbose)
+{
+    static const unsigned combos[] = {
+        0, IORING_SETUP_SQE128, IORING_SETUP_CQE32,
+        IORING_SETUP_SQE128 | IORING_SETUP_CQE32,
+    };
+    int checked = 0, mismatched = 0, have_offsets = 0;
+    uint32_t align_fit = 1;
+
+    if (verbose)
+        printf("  %-8s %-10s %12s %12s  %s\n", "SQ", "flags", "model", "kernel", "");
+
+    for (size_t c = 0; c < sizeof(combos) / sizeof(combos[0]); c++) {
+        for (size_t s = 0; s < NUM_SIZES; s++) {
+            struct io_uring ring;
+            struct io_uring_params params;
+            memset(&params, 0, sizeof(params));
+            params.flags = combos[c];
+
+            int ret = io_uring_queue_init_params(sizes[s], &ring, &params);
+            if (ret < 0) {
+                if (verbose && ret != -EINVAL)
+                    printf("  %-8u %-10s  setup failed: %s\n", sizes[s],
+                           combo_name(combos[c]), strerror(-ret));
+                continue;
+            }
+
+            if (!have_offsets) {
+                p->cq_header_bytes = params.cq_off.cqes;
+                p->single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+                if (!p->single_mmap)
+                    p->sq_header_bytes = params.sq_off.array;
+                have_offsets = 1;
+            }
+            /* Smallest power of two that puts the SQ array where the kernel did */
+            if (p->single_mmap && params.sq_off.array) {
+                size_t cqe_sz = (combos[c] & IORING_SETUP_CQE32) ? RM_CQE32_SIZE : RM_CQE_SIZE;
+                uint64_t end = params.cq_off.cqes + (uint64_t)params.cq_entries * cqe_sz;
+                uint32_t align = 1;
+                while (align < p->page_size && (end + align - 1) / align * align != params.sq_off.array)
+                    align *= 2;
+                if (align > align_fit) align_fit = align;
+                p->sq_array_align = align_fit;
+            }
+
+            rm_ring_config_t cfg = {
+                .sq_entries = sizes[s],
+                .sqe128 = !!(combos[c] & IORING_SETUP_SQE128),
+                .cqe32  = !!(combos[c] & IORING_SETUP_CQE32),
+            };
+            rm_ring_memory_t m;
+            rm_calc(p, &cfg, &m);
+            uint64_t actual = actual_ring_bytes(&ring, combos[c], params.sq_entries);
+            checked++;
+            if (actual != m.ring_bytes) mismatched++;
+
+            if (verbose)
+                printf("  %-8u %-10s %10llu B %10llu B  %s\n", sizes[s], combo_name(combos[c]),
+                       (unsigned long long)m.ring_bytes, (unsigned long long)actual,
+                       actual == m.ring_bytes ? "ok" : "MISMATCH");
+
+            io_uring_queue_exit(&ring);
+        }
+    }
+
+    if (checked == 0) return -1;
+    return mismatched;
+}
+
+/* ── Slab fit ──────────────────────────────────────────────────────── */
+
+/*
+ * Slab = a + b * SQ, fitted by ordinary least squares over
+ * (SQ, per-ring Slab delta) samples. Meminfo is in KiB and other tasks
+ * allocate concurrently, so each sample holds `per_size` rings at once.
+ */
+static int fit_slab(rm_params_t *p, int per_size, int verbose)
+{
+    double xs[MAX_SAMPLES], ys[MAX_SAMPLES];
+    int n = 0;
+    struct io_uring *rings = calloc(per_size, sizeof(*rings));
+    if (!rings) return -1;
+
+    for (size_t s = 0; s < NUM_SIZES && n < MAX_SAMPLES; s++) {
+        long before = read_meminfo_kb("Slab");
+        int made = 0;
+        for (int i = 0; i < per_size; i++) {
+            if (io_uring_queue_init(sizes[s], &rings[made], 0) < 0) break;
+            made++;
+        }
+        long after = read_meminfo_kb("Slab");
+        for (int i = 0; i < made; i++) io_uring_queue_exit(&rings[i]);
+
+        if (made == 0 || before < 0 || after < 0) continue;
+        double per_ring = (double)(after - before) * 1024.0 / made;
+        xs[n] = sizes[s];
+        ys[n] = per_ring;
+        n++;
+        if (verbose)
+            printf("  SQ=%-6u rings=%-5d slab/ring=%8.0f B\n", sizes[s], made, per_ring);
+    }
+    free(rings);
+
+    if (n < 2) return -1;
+
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (int i = 0; i < n; i++) {
+        sx += xs[i]; sy += ys[i];
+        sxx += xs[i] * xs[i]; sxy += xs[i] * ys[i];
+    }
+    double den = n * sxx - sx * sx;
+    if (den == 0) return -1;
+    double b = (n * sxy - sx * sy) / den;
+    double a = (sy - b * sx) / n;
+
+    p->kernel_ctx_bytes     = a > 0 ? (uint64_t)(a + 0.5) : 0;
+    p->kernel_per_sqe_bytes = b > 0 ? (uint64_t)(b + 0.5) : 0;
+    return 0;
+}
+
+/* ── Main ──────────────────────────────────────────────────────────── */
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-o FILE] [-k RINGS] [-q]\n", prog);
+    printf("  -o FILE   write fitted params to FILE (for RING_MODEL_PARAMS)\n");
+    printf("  -k RINGS  rings held per size for the slab fit (default 256)\n");
+    printf("  -q        quiet, print only the fitted params\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_path = NULL;
+    int per_size = 256, verbose = 1, opt;
+
+    while ((opt = getopt(argc, argv, "o:k:qh")) != -1) {
+        switch (opt) {
+        case 'o': out_path = optarg; break;
+        case 'k': per_size = atoi(optarg); break;
+        case 'q': verbose = 0; break;
+        case 'h': usage(argv[0]); return 0;
+        default:  usage(argv[0]); return 1;
+        }
+    }
+    if (per_size < 1) per_size = 1;
+
+    /* Holding K rings pins K x ring_bytes; lift the soft limit if we can */
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_MEMLOCK, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_MEMLOCK, &rl);
+    }
+
+    struct utsname un;
+    uname(&un);
+
+    rm_params_t p;
+    rm_params_default(&p);
+    p.page_size = (uint32_t)sysconf(_SC_PAGESIZE);
+
+    if (verbose) printf("Ring layout (kernel %s):\n", un.release);
+    int mism = fit_layout(&p, verbose);
+    if (mism < 0) {
+        fprintf(stderr, "io_uring setup failed for every size; is io_uring enabled?\n");
+        return 1;
+    }
+
+    if (verbose) printf("\nKernel slab (%d rings per size):\n", per_size);
+    if (fit_slab(&p, per_size, verbose) != 0 && verbose)
+        printf("  slab fit unavailable, keeping builtin kernel constants\n");
+
+    snprintf(p.source, sizeof(p.source), "calibrated (%s)", un.release);
+
+    printf("\n");
+    rm_params_print(stdout, &p, "");
+    if (mism > 0)
+        printf("Warning: %d ring sizes did not match the model layout\n", mism);
+
+    if (out_path) {
+        char comment[256];
+        snprintf(comment, sizeof(comment), "kernel = %s\n# machine = %s\n",
+                 un.release, un.machine);
+        if (rm_params_save(&p, out_path, comment) != 0) {
+            fprintf(stderr, "Cannot write %s: %s\n", out_path, strerror(errno));
+            return 1;
+        }
+        printf("Wrote %s\n", out_path);
+    }
+    return mism > 0 ? 2 : 0;
+}
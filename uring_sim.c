@@ -11,35 +11,69 @@
  *   - Per-ring instance creation when running multiple rings
  *
  * Build:
- *   gcc -o io_uring_sim io_uring_sim.c -lm
+ *   gcc -o io_uring_sim uring_sim.c ring_model/ring_model.c -lm -lpthread
+ *
+ * Ring sizes come from the shared model in ring_model/; set
+ * RING_MODEL_PARAMS=<file> to use constants calibrated on the target kernel.
  *
  * Usage:
  *   ./io_uring_sim [--interactive | --batch <args...>]
- *   Add --no-anim to skip the animation.
+ *   Add --no-anim to skip the animation (it only runs when stdout is a terminal).
+ *   ./io_uring_sim --ram 64G --grid [--grid-sq 64,256,1024 --grid-bufs 0,1M ...]
+ *   evaluates the full config grid on all cores and prints the Pareto frontier.
+ *   ./io_uring_sim --ram 64G --solve --services 12 --rings 64 --memlock-max 2G
+ *   solves for the deepest SQ and largest buffer pool that fit the ceilings.
+ *   --kernel <release> picks how that kernel charges ring memory (default: uname -r).
+ *   ./io_uring_sim --audit --rings 64 --unit nginx.service --pid 1234
+ *   diffs the live host and services against the model and flags tight limits.
+ *   ./io_uring_sim --ram 512G --manifest fleet.csv --instance 256Gx2
+ *   evaluates a service manifest, bin-packs it and prints LimitMEMLOCK drop-ins.
+ *   --prom <file> also writes those results in node_exporter textfile format.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdarg.h>
 #include <string.h>
+#include <ctype.h>
 #include <stdint.h>
 #include <math.h>
 #include <getopt.h>
 #include <errno.h>
 #include <unistd.h>
 #include <time.h>
+#include <dirent.h>
 #include <sys/ioctl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "ring_model/ring_model.h"
 
 /* ── io_uring constants (Linux 6.x) ────────────────────────────────── */
 
-#define SQE_SIZE            64      /* sizeof(struct io_uring_sqe) */
-#define CQE_SIZE_NORMAL     16      /* sizeof(struct io_uring_cqe) */
-#define CQE_SIZE_CQE32      32      /* with IORING_SETUP_CQE32 */
-#define RING_HEADER_BYTES    40      /* rough overhead per ring (params, padding) */
+#define SQE_SIZE            RM_SQE_SIZE
+#define SQE_SIZE_SQE128     RM_SQE128_SIZE
+#define CQE_SIZE_NORMAL     RM_CQE_SIZE
+#define CQE_SIZE_CQE32      RM_CQE32_SIZE
 #define PAGE_SIZE           4096
-#define DEFAULT_CQ_FACTOR    2      /* kernel default: CQ entries = 2 * SQ entries */
+#define DEFAULT_CQ_FACTOR   RM_DEFAULT_CQ_FACTOR
 
-#define KERN_MAX_SQ_ENTRIES  32768
-#define KERN_MAX_CQ_ENTRIES  (2 * KERN_MAX_SQ_ENTRIES)
+#define KERN_MAX_SQ_ENTRIES  RM_MAX_SQ_ENTRIES
+#define KERN_MAX_CQ_ENTRIES  RM_MAX_CQ_ENTRIES
+
+/* Kernel threads behind the rings (x86_64, 6.x) */
+#define KTHREAD_STACK_BYTES  16384   /* THREAD_SIZE */
+#define TASK_STRUCT_BYTES    10240   /* task_struct + thread_info, config dependent */
+#define IO_WORKER_BYTES      256     /* struct io_worker */
+#define SQ_DATA_BYTES        512     /* struct io_sq_data */
+#define IOWQ_BOUNDED_PER_CPU 4       /* default bounded cap: min(SQ, 4 x CPUs) */
+#define DEFAULT_PID_MAX      32768
+#define PID_MAX_LIMIT        4194304 /* ceiling for kernel.pid_max on 64-bit */
 
 /* ── ANSI escape helpers ───────────────────────────────────────────── */
 
@@ -64,21 +98,11 @@
 #define FG_BCYAN    ESC "96m"
 #define FG_BWHITE   ESC "97m"
 
-#define CURSOR_UP(n)    printf(ESC "%dA", (n))
 #define CURSOR_HIDE     printf(ESC "?25l")
 #define CURSOR_SHOW     printf(ESC "?25h")
 
 /* ── Helpers ───────────────────────────────────────────────────────── */
 
-static uint64_t next_power_of_2(uint64_t v)
-{
-    if (v == 0) return 1;
-    v--;
-    v |= v >> 1;  v |= v >> 2;  v |= v >> 4;
-    v |= v >> 8;  v |= v >> 16; v |= v >> 32;
-    return v + 1;
-}
-
 static uint64_t page_align(uint64_t bytes)
 {
     return (bytes + PAGE_SIZE - 1) & ~((uint64_t)PAGE_SIZE - 1);
@@ -94,6 +118,17 @@ static const char *human_bytes(uint64_t bytes, char *buf, size_t bufsz)
     return buf;
 }
 
+/* 1073741824 -> "1G", 2097152 -> "2M": the spelling kernel parameters expect */
+static const char *size_suffix(uint64_t bytes, char *buf, size_t bufsz)
+{
+    const char *sfx = "KMGT";
+    int u = -1;
+    while (u < 3 && bytes >= 1024 && bytes % 1024 == 0) { bytes /= 1024; u++; }
+    if (u < 0) snprintf(buf, bufsz, "%lu", (unsigned long)bytes);
+    else       snprintf(buf, bufsz, "%lu%c", (unsigned long)bytes, sfx[u]);
+    return buf;
+}
+
 static uint64_t parse_ram(const char *str)
 {
     char *end;
@@ -149,56 +184,95 @@ static const char *cqe_results[] = {
 
 /* ── Per-ring memory calculation ───────────────────────────────────── */
 
-typedef struct {
-    uint32_t sq_entries;
-    uint32_t cq_entries;
-    int      cqe32;
-    uint64_t registered_bufs;
-    uint32_t registered_files;
-} ring_config_t;
-
-typedef struct {
-    uint64_t sq_ring_bytes;
-    uint64_t cq_ring_bytes;
-    uint64_t sqe_array_bytes;
-    uint64_t reg_buf_bytes;
-    uint64_t reg_file_bytes;
-    uint64_t total_bytes;
-    uint32_t mmap_regions;
-    uint32_t sq_actual;
-    uint32_t cq_actual;
-} ring_memory_t;
+typedef rm_ring_config_t ring_config_t;
+typedef rm_ring_memory_t ring_memory_t;
 
 static ring_memory_t calc_ring_memory(const ring_config_t *cfg)
 {
-    ring_memory_t m = {0};
-    uint32_t sq = (uint32_t)next_power_of_2(cfg->sq_entries);
-    uint32_t cq = (uint32_t)next_power_of_2(cfg->cq_entries);
-    if (sq > KERN_MAX_SQ_ENTRIES) sq = KERN_MAX_SQ_ENTRIES;
-    if (cq < sq * DEFAULT_CQ_FACTOR) cq = (uint32_t)next_power_of_2(sq * DEFAULT_CQ_FACTOR);
-    if (cq > KERN_MAX_CQ_ENTRIES) cq = KERN_MAX_CQ_ENTRIES;
-    m.sq_actual = sq;
-    m.cq_actual = cq;
-    uint32_t cqe_sz = cfg->cqe32 ? CQE_SIZE_CQE32 : CQE_SIZE_NORMAL;
-    m.sq_ring_bytes   = page_align((uint64_t)sq * sizeof(uint32_t) + RING_HEADER_BYTES);
-    m.cq_ring_bytes   = page_align((uint64_t)cq * cqe_sz + RING_HEADER_BYTES);
-    m.sqe_array_bytes = page_align((uint64_t)sq * SQE_SIZE);
-    m.reg_buf_bytes   = page_align(cfg->registered_bufs);
-    m.reg_file_bytes  = page_align((uint64_t)cfg->registered_files * 8);
-    m.total_bytes = m.sq_ring_bytes + m.cq_ring_bytes + m.sqe_array_bytes
-                  + m.reg_buf_bytes + m.reg_file_bytes;
-    m.mmap_regions = 2;
-    if (cfg->registered_bufs > 0) m.mmap_regions += 1;
-    if (cfg->registered_files > 0) m.mmap_regions += 1;
+    ring_memory_t m;
+    rm_calc(rm_params(), cfg, &m);
     return m;
 }
 
+/* ── Kernel accounting profiles ────────────────────────────────────── */
+
+/* Where each release charges ring memory: see ring_model.h */
+typedef rm_acct_profile_t acct_profile_t;
+
+#define MEMLOCK_HEADROOM 1.2
+
+/* ── Kernel thread model ───────────────────────────────────────────── */
+
+/*
+ * SQPOLL threads and io-wq workers are full kernel tasks: a stack, a
+ * task_struct and a PID charged to the owning user's RLIMIT_NPROC. Since 5.12
+ * io-wq is per task, not per ring: the submitting task's, or the SQ thread's
+ * under SQPOLL, since that is where requests are issued. Workers are created
+ * on demand, one per blocking request in flight up to the bounded cap, so
+ * the model only counts them for --iowq-busy, or for the caps themselves
+ * when --iowq-max is given (worst case, opt-in). The unbounded cap defaults
+ * to RLIMIT_NPROC in the kernel, so it is only counted when set.
+ */
+
+typedef struct {
+    uint32_t sqpoll_share;          /* rings per SQPOLL thread, 0 = no SQPOLL */
+    uint32_t tasks;                 /* submitting tasks, 0 = one per CPU */
+    int32_t  iowq_bounded;          /* per io-wq, -1 = min(SQ, 4 x CPUs) */
+    uint32_t iowq_unbounded;        /* per io-wq, counted in full when set */
+    int32_t  iowq_busy;             /* blocking requests in flight per io-wq, -1 = none,
+                                       or the caps when --iowq-max is given */
+    uint32_t cpus;                  /* target CPUs for the defaults */
+} kthread_model_t;
+
+static kthread_model_t kmodel = { .iowq_bounded = -1, .iowq_busy = -1, .cpus = 1 };
+
+static const acct_profile_t *active_profile;
+static char profile_source[96];
+
+/* "auto", a profile name or a kernel release; 0 or -1 */
+static int acct_profile_select(const char *arg)
+{
+    int fallback;
+    const acct_profile_t *p = rm_acct_profile_select(arg, profile_source, sizeof(profile_source),
+                                                     &fallback);
+    if (!p) return -1;
+    active_profile = p;
+    if (fallback)
+        fprintf(stderr, "Warning: kernel release not detected or older than io_uring (5.1) "
+                        "(%s); using the %s accounting profile (pick one with --kernel)\n",
+                profile_source, p->name);
+    return 0;
+}
+
+static const acct_profile_t *acct_profile(void)
+{
+    if (!active_profile) acct_profile_select("auto");
+    return active_profile;
+}
+
 /* ── Tuning ────────────────────────────────────────────────────────── */
 
 typedef struct {
-    uint64_t total_locked_mem;
+    uint64_t total_locked_mem;          /* pinned in RAM, whoever is charged */
+    uint64_t memlock_charged;           /* counted against RLIMIT_MEMLOCK */
+    uint64_t memcg_charged;             /* counted against the memory cgroup */
+    uint64_t kernel_mem;                /* slab + io_kiocb + kernel threads, not locked */
+    uint64_t slab_bytes;                /* ring contexts at setup */
+    uint64_t kiocb_bytes;               /* io_kiocb with every SQ full */
+    uint64_t kthread_bytes;             /* stacks + task structs of the threads below */
+    uint64_t sqpoll_threads;
+    uint64_t iowq_workers;
+    uint64_t tasks;                     /* submitters owning the rings */
+    uint64_t iowqs;                     /* io-wq instances: tasks, or SQ threads */
+    uint64_t threads;                   /* tasks + kernel threads: RLIMIT_NPROC usage */
+    int      pid_infeasible;            /* threads exceed PID_MAX_LIMIT */
+    uint64_t nproc_limit;
+    uint64_t footprint;                 /* locked + kernel_mem */
     uint64_t memlock_limit;
     uint64_t max_map_count;
+    uint64_t map_count_needed;          /* VMAs before the 65530 floor */
+    uint64_t nr_hugepages;              /* hugetlb pages the buffer pools pin */
+    uint64_t huge_page_size;            /* 0 when buffers sit on base pages */
     uint32_t total_mmap_regions;
     double   ram_usage_pct;
 } tuning_t;
@@ -206,18 +280,208 @@ typedef struct {
 static tuning_t calc_tuning(const ring_memory_t *per_ring, uint32_t num_rings,
                              uint64_t total_ram)
 {
+    const acct_profile_t *prof = acct_profile();
     tuning_t t = {0};
     t.total_locked_mem   = (uint64_t)per_ring->total_bytes * num_rings;
-    t.total_mmap_regions = per_ring->mmap_regions * num_rings;
-    t.memlock_limit      = page_align((uint64_t)((double)t.total_locked_mem * 1.2));
+
+    /* The file table is kernel memory; rings go to memlock or memcg per profile */
+    uint64_t rings = per_ring->ring_bytes * num_rings;
+    t.memlock_charged = per_ring->reg_buf_bytes * num_rings + (prof->rings_memlock ? rings : 0);
+    t.memcg_charged   = prof->rings_memlock ? 0 : rings;
+    t.memlock_limit   = page_align((uint64_t)((double)t.memlock_charged * MEMLOCK_HEADROOM));
+    if (t.memlock_limit < prof->default_memlock) t.memlock_limit = prof->default_memlock;
+
+    uint32_t regions = per_ring->mmap_regions;
+    if (prof->separate_sq_ring && per_ring->sq_ring_bytes == 0) regions++;
+    t.total_mmap_regions = regions * num_rings;
     uint64_t base_vmas = 1024;
-    uint64_t vmas_per_ring = (uint64_t)per_ring->mmap_regions + 2;
-    t.max_map_count = base_vmas + vmas_per_ring * num_rings;
+    uint64_t vmas_per_ring = (uint64_t)regions + 2;
+    t.map_count_needed = base_vmas + vmas_per_ring * num_rings;
+    t.max_map_count = t.map_count_needed;
     if (t.max_map_count < 65530) t.max_map_count = 65530;
-    t.ram_usage_pct = (double)t.total_locked_mem / (double)total_ram * 100.0;
+    if (per_ring->buf_page_size > PAGE_SIZE && per_ring->reg_buf_pages) {
+        t.huge_page_size = per_ring->buf_page_size;
+        t.nr_hugepages   = per_ring->reg_buf_pages * num_rings;
+    }
+
+    uint64_t bounded = kmodel.iowq_bounded >= 0 ? (uint64_t)kmodel.iowq_bounded
+                     : (uint64_t)IOWQ_BOUNDED_PER_CPU * kmodel.cpus;
+    if (kmodel.iowq_bounded < 0 && bounded > per_ring->sq_actual) bounded = per_ring->sq_actual;
+    uint64_t busy    = kmodel.iowq_busy >= 0 ? (uint64_t)kmodel.iowq_busy
+                     : kmodel.iowq_bounded >= 0 ? bounded : 0;
+    uint64_t tasks   = kmodel.tasks ? kmodel.tasks : kmodel.cpus;
+    t.tasks          = tasks < num_rings ? tasks : num_rings;
+    t.sqpoll_threads = kmodel.sqpoll_share
+                     ? ((uint64_t)num_rings + kmodel.sqpoll_share - 1) / kmodel.sqpoll_share : 0;
+    t.iowqs          = kmodel.sqpoll_share ? t.sqpoll_threads : t.tasks;
+    t.iowq_workers   = t.iowqs * ((busy < bounded ? busy : bounded) + kmodel.iowq_unbounded);
+    t.threads        = t.tasks + t.sqpoll_threads + t.iowq_workers;
+    t.nproc_limit    = (uint64_t)((double)t.threads * MEMLOCK_HEADROOM) + 1024;
+    t.pid_infeasible = t.threads > PID_MAX_LIMIT;
+
+    uint64_t kthreads = t.sqpoll_threads + t.iowq_workers;
+    t.kthread_bytes = kthreads * (KTHREAD_STACK_BYTES + TASK_STRUCT_BYTES)
+                    + t.iowq_workers * IO_WORKER_BYTES + t.sqpoll_threads * SQ_DATA_BYTES;
+    t.slab_bytes    = per_ring->kernel_bytes * num_rings;
+    t.kiocb_bytes   = per_ring->kernel_inflight_bytes * num_rings;
+    t.kernel_mem    = t.slab_bytes + t.kiocb_bytes + t.kthread_bytes;
+    t.footprint     = t.total_locked_mem + t.kernel_mem;
+
+    t.ram_usage_pct = (double)t.footprint / (double)total_ram * 100.0;
     return t;
 }
 
+/* ── Prometheus textfile ───────────────────────────────────────────── */
+
+/*
+ * --prom <file> writes the run as gauges for node_exporter's textfile
+ * collector. Run the batch, audit or manifest mode from a timer with the file
+ * inside --collector.textfile.directory; the file is written beside the
+ * target and renamed over it, so a scrape never sees half a run.
+ */
+
+#define PROM_PREFIX "iouring_sim_"
+
+static const char *prom_path;
+
+typedef struct {
+    FILE *f;
+    char  tmp[4096];
+} prom_t;
+
+typedef struct {
+    const char *name;
+    const char *help;
+    size_t      off;                    /* uint64_t field of tuning_t */
+} prom_field_t;
+
+static const prom_field_t prom_tuning_fields[] = {
+    { "locked_bytes",          "Pinned by rings, SQEs and registered buffers",
+      offsetof(tuning_t, total_locked_mem) },
+    { "memlock_charged_bytes", "Charged to RLIMIT_MEMLOCK (predicted VmPin)",
+      offsetof(tuning_t, memlock_charged) },
+    { "memcg_charged_bytes",   "Charged to the memory cgroup instead of memlock",
+      offsetof(tuning_t, memcg_charged) },
+    { "kernel_bytes",          "Slab, io_kiocb and kernel thread memory, not locked",
+      offsetof(tuning_t, kernel_mem) },
+    { "footprint_bytes",       "Locked plus kernel memory",
+      offsetof(tuning_t, footprint) },
+    { "vmas",                  "VMAs of one process before the 65530 floor",
+      offsetof(tuning_t, map_count_needed) },
+    { "threads",               "Tasks plus SQPOLL and io-wq threads",
+      offsetof(tuning_t, threads) },
+    { "hugepages",             "hugetlb pages pinned by the buffer pools",
+      offsetof(tuning_t, nr_hugepages) },
+    { "memlock_limit_bytes",   "Recommended LimitMEMLOCK",
+      offsetof(tuning_t, memlock_limit) },
+    { "max_map_count",         "Recommended vm.max_map_count",
+      offsetof(tuning_t, max_map_count) },
+};
+
+#define NUM_PROM_TUNING_FIELDS (sizeof(prom_tuning_fields) / sizeof(prom_tuning_fields[0]))
+
+/* Label values escape backslash, quote and newline */
+static const char *prom_escape(const char *s, char *buf, size_t bufsz)
+{
+    size_t o = 0;
+    for (; *s && o + 3 < bufsz; s++) {
+        if (*s == '\\' || *s == '"') buf[o++] = '\\';
+        if (*s == '\n') { buf[o++] = '\\'; buf[o++] = 'n'; continue; }
+        buf[o++] = *s;
+    }
+    buf[o] = '\0';
+    return buf;
+}
+
+static void prom_family(FILE *f, const char *name, const char *help)
+{
+    fprintf(f, "# HELP " PROM_PREFIX "%s %s\n", name, help);
+    fprintf(f, "# TYPE " PROM_PREFIX "%s gauge\n", name);
+}
+
+static void prom_sample(FILE *f, const char *name, const char *labels, double v)
+{
+    fprintf(f, PROM_PREFIX "%s%s%s%s ", name, *labels ? "{" : "", labels, *labels ? "}" : "");
+    if (isinf(v)) fprintf(f, "+Inf\n");
+    else          fprintf(f, "%.15g\n", v);
+}
+
+/* Opens <file>.<pid>.tmp; p->f stays NULL without --prom */
+static int prom_open(prom_t *p)
+{
+    p->f = NULL;
+    if (!prom_path) return 0;
+    snprintf(p->tmp, sizeof(p->tmp), "%s.%d.tmp", prom_path, (int)getpid());
+    p->f = fopen(p->tmp, "w");
+    if (!p->f) {
+        fprintf(stderr, "Error: cannot write %s: %s\n", p->tmp, strerror(errno));
+        return -1;
+    }
+
+    char prof[64], src[256];
+    const char *params = rm_params()->source;
+    prom_family(p->f, "info", "Accounting profile and ring model parameters in use");
+    fprintf(p->f, PROM_PREFIX "info{profile=\"%s\",params=\"%s\"} 1\n",
+            prom_escape(acct_profile()->name, prof, sizeof(prof)),
+            prom_escape(params, src, sizeof(src)));
+    prom_family(p->f, "last_run_timestamp_seconds", "When this file was written");
+    prom_sample(p->f, "last_run_timestamp_seconds", "", (double)time(NULL));
+    return 0;
+}
+
+static int prom_close(prom_t *p)
+{
+    if (!p->f) return 0;
+    int bad = ferror(p->f);
+    if (fclose(p->f) != 0) bad = 1;
+    p->f = NULL;
+    if (bad || rename(p->tmp, prom_path) != 0) {
+        fprintf(stderr, "Error: cannot write %s: %s\n", prom_path, strerror(errno));
+        unlink(p->tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/* One family per tuning_t field, named <scope>_<field>, one sample per entry */
+static void prom_tuning(FILE *f, const char *scope, const char *what,
+                        const char *const *labels, const tuning_t *const *t, int n)
+{
+    char name[96], help[160];
+    for (size_t i = 0; i < NUM_PROM_TUNING_FIELDS; i++) {
+        const prom_field_t *pf = &prom_tuning_fields[i];
+        snprintf(name, sizeof(name), "%s_%s", scope, pf->name);
+        snprintf(help, sizeof(help), "%s, %s", pf->help, what);
+        prom_family(f, name, help);
+        for (int k = 0; k < n; k++)
+            prom_sample(f, name, labels[k],
+                        (double)*(const uint64_t *)((const char *)t[k] + pf->off));
+    }
+}
+
+/* Model of one ring: mapped and pinned bytes by part, VMAs, actual sizes */
+static void prom_rings(FILE *f, const char *const *labels, const ring_memory_t *const *m, int n)
+{
+    static const char *parts[] = { "rings", "buffers", "files", "kernel", "kiocb" };
+    char l[512];
+
+    prom_family(f, "ring_bytes", "Memory of one ring by part (rings = SQ/CQ rings + SQEs)");
+    for (int k = 0; k < n; k++) {
+        const uint64_t v[] = { m[k]->ring_bytes, m[k]->reg_buf_bytes, m[k]->reg_file_bytes,
+                               m[k]->kernel_bytes, m[k]->kernel_inflight_bytes };
+        for (int i = 0; i < 5; i++) {
+            snprintf(l, sizeof(l), "%s%spart=\"%s\"", labels[k], *labels[k] ? "," : "", parts[i]);
+            prom_sample(f, "ring_bytes", l, (double)v[i]);
+        }
+    }
+    prom_family(f, "ring_vmas", "Mappings of one ring, buffer pool included");
+    for (int k = 0; k < n; k++) prom_sample(f, "ring_vmas", labels[k], m[k]->mmap_regions);
+    prom_family(f, "ring_sq_entries", "SQ entries after the kernel's power-of-two rounding");
+    for (int k = 0; k < n; k++) prom_sample(f, "ring_sq_entries", labels[k], m[k]->sq_actual);
+    prom_family(f, "ring_cq_entries", "CQ entries after the kernel's power-of-two rounding");
+    for (int k = 0; k < n; k++) prom_sample(f, "ring_cq_entries", labels[k], m[k]->cq_actual);
+}
+
 /* ══════════════════════════════════════════════════════════════════════
  *  REAL-TIME RING VISUALIZATION
  * ══════════════════════════════════════════════════════════════════════ */
@@ -231,10 +495,284 @@ typedef struct {
 } mem_region_t;
 
 /*
- * Draws one complete animation frame (all elements), returns how many
- * lines were printed so we can CURSOR_UP to overwrite on next frame.
+ * Off-screen frame buffer. Frames are drawn into cells (one glyph plus its
+ * SGR colour/attributes each), diffed against what is on screen, and only
+ * the changed cells go out, with cursor moves relative to the frame, in a
+ * single write(). A ring animation is a few hundred frames that differ in a
+ * handful of cells, so this keeps slow SSH links from paying for the
+ * unchanged rest of every frame.
  */
-static int draw_frame(
+
+#define FB_ROWS      24
+#define FB_COLS      256
+#define FB_OUT_BYTES 65536
+
+typedef struct {
+    char    ch[4];                      /* UTF-8 glyph, NUL padded; "" is blank */
+    uint8_t fg;                         /* SGR foreground 30-37 / 90-97, 0 default */
+    uint8_t attr;                       /* FB_BOLD | FB_DIM */
+} fb_cell_t;
+
+#define FB_BOLD 1
+#define FB_DIM  2
+
+typedef struct {
+    fb_cell_t cur[FB_ROWS][FB_COLS];
+    fb_cell_t shown[FB_ROWS][FB_COLS];  /* what the terminal holds */
+    int       rows, shown_rows, cols;
+    int       have_shown;
+    int       row, col;                 /* pen */
+    uint8_t   fg, attr;                 /* pen style */
+    int       crow, ccol;               /* terminal cursor, relative to the frame */
+    int       out_fg, out_attr;         /* style last sent, -1 unknown */
+    char      out[FB_OUT_BYTES];
+    size_t    len;
+} frame_t;
+
+static void fb_write_out(frame_t *fb)
+{
+    size_t off = 0;
+    while (off < fb->len) {
+        ssize_t n = write(STDOUT_FILENO, fb->out + off, fb->len - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        off += (size_t)n;
+    }
+    fb->len = 0;
+}
+
+static void fb_emit(frame_t *fb, const char *s, size_t n)
+{
+    if (fb->len + n > sizeof(fb->out)) fb_write_out(fb);
+    memcpy(fb->out + fb->len, s, n);
+    fb->len += n;
+}
+
+static void fb_emitf(frame_t *fb, const char *fmt, int v)
+{
+    char tmp[32];
+    int n = snprintf(tmp, sizeof(tmp), fmt, v);
+    fb_emit(fb, tmp, (size_t)n);
+}
+
+/* Forgets the screen: the next flush prints the whole frame below the cursor */
+static void fb_reset(frame_t *fb)
+{
+    fb->have_shown = 0;
+    fb->shown_rows = 0;
+    fb->crow = fb->ccol = 0;
+    fb->len = 0;
+}
+
+static void fb_begin(frame_t *fb)
+{
+    int tw = get_term_width();
+    memset(fb->cur, 0, sizeof(fb->cur));
+    /* One column spare so a full row never leaves the cursor in the wrap state */
+    fb->cols = tw - 1 < FB_COLS ? tw - 1 : FB_COLS;
+    fb->rows = 0;
+    fb->row = fb->col = 0;
+    fb->fg = 0;
+    fb->attr = 0;
+}
+
+static void fb_sgr(frame_t *fb, const char *params, size_t n)
+{
+    if (n == 0) { fb->fg = 0; fb->attr = 0; return; }
+    char tmp[32];
+    if (n >= sizeof(tmp)) n = sizeof(tmp) - 1;
+    memcpy(tmp, params, n);
+    tmp[n] = '\0';
+    for (char *p = strtok(tmp, ";"); p; p = strtok(NULL, ";")) {
+        int v = atoi(p);
+        if (v == 0)                             { fb->fg = 0; fb->attr = 0; }
+        else if (v == 1)                        fb->attr |= FB_BOLD;
+        else if (v == 2)                        fb->attr |= FB_DIM;
+        else if (v == 22)                       fb->attr = 0;
+        else if (v == 39)                       fb->fg = 0;
+        else if ((v >= 30 && v <= 37) || (v >= 90 && v <= 97)) fb->fg = (uint8_t)v;
+    }
+}
+
+/* Text with embedded SGR sequences and newlines; the rest of a row past
+ * fb->cols is clipped rather than wrapped */
+static void fb_puts(frame_t *fb, const char *s)
+{
+    while (*s) {
+        if (s[0] == '\033' && s[1] == '[') {
+            const char *p = s + 2;
+            while (*p && (*p < 0x40 || *p > 0x7e)) p++;
+            if (*p == 'm') fb_sgr(fb, s + 2, (size_t)(p - s - 2));
+            s = *p ? p + 1 : p;
+            continue;
+        }
+        if (*s == '\n') {
+            if (fb->row < FB_ROWS && fb->row + 1 > fb->rows) fb->rows = fb->row + 1;
+            fb->row++;
+            fb->col = 0;
+            s++;
+            continue;
+        }
+        unsigned char c = (unsigned char)*s;
+        int n = c < 0x80 ? 1 : c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : c >= 0xc0 ? 2 : 1;
+        if (fb->row < FB_ROWS && fb->col < fb->cols) {
+            fb_cell_t *cell = &fb->cur[fb->row][fb->col];
+            memset(cell->ch, 0, sizeof(cell->ch));
+            for (int i = 0; i < n && s[i]; i++) cell->ch[i] = s[i];
+            cell->fg = fb->fg;
+            cell->attr = fb->attr;
+            if (fb->row + 1 > fb->rows) fb->rows = fb->row + 1;
+        }
+        fb->col++;
+        for (int i = 0; i < n && *s; i++) s++;
+    }
+}
+
+static void fb_printf(frame_t *fb, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void fb_printf(frame_t *fb, const char *fmt, ...)
+{
+    char tmp[1024];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    fb_puts(fb, tmp);
+}
+
+static int fb_cell_eq(const fb_cell_t *a, const fb_cell_t *b)
+{
+    return !memcmp(a->ch, b->ch, sizeof(a->ch)) && (a->ch[0] == '\0' ||
+           (a->fg == b->fg && a->attr == b->attr));
+}
+
+static void fb_put_cell(frame_t *fb, const fb_cell_t *c)
+{
+    if (c->ch[0] == '\0') {
+        /* Blank: background only, any style will do */
+        fb_emit(fb, " ", 1);
+    } else {
+        if (c->fg != fb->out_fg || c->attr != fb->out_attr) {
+            fb_emit(fb, ESC "0", 3);
+            if (c->attr & FB_BOLD) fb_emit(fb, ";1", 2);
+            if (c->attr & FB_DIM)  fb_emit(fb, ";2", 2);
+            if (c->fg) fb_emitf(fb, ";%d", c->fg);
+            fb_emit(fb, "m", 1);
+            fb->out_fg = c->fg;
+            fb->out_attr = c->attr;
+        }
+        fb_emit(fb, c->ch, strnlen(c->ch, sizeof(c->ch)));
+    }
+    fb->ccol++;
+}
+
+static void fb_move(frame_t *fb, int row, int col)
+{
+    if (row < fb->crow) fb_emitf(fb, ESC "%dA", fb->crow - row);
+    if (row > fb->crow) fb_emitf(fb, ESC "%dB", row - fb->crow);
+    if (col != fb->ccol) {
+        if (col == 0) fb_emit(fb, "\r", 1);
+        else          fb_emitf(fb, ESC "%dG", col + 1);
+    }
+    fb->crow = row;
+    fb->ccol = col;
+}
+
+/* Sends the frame and leaves the cursor on the line below it */
+static void fb_flush(frame_t *fb)
+{
+    fflush(stdout);                     /* anything printf'd above the frame */
+    fb->out_fg = fb->out_attr = -1;
+
+    if (!fb->have_shown || fb->rows != fb->shown_rows) {
+        /* First frame or the shape changed: print every row */
+        fb_move(fb, 0, 0);
+        for (int r = 0; r < fb->rows; r++) {
+            int last = fb->cols;
+            while (last > 0 && fb->cur[r][last - 1].ch[0] == '\0') last--;
+            for (int c = 0; c < last; c++) fb_put_cell(fb, &fb->cur[r][c]);
+            fb_emit(fb, RESET ESC "K\n", sizeof(RESET ESC "K\n") - 1);
+            fb->out_fg = fb->out_attr = 0;
+        }
+        if (fb->have_shown && fb->shown_rows > fb->rows) fb_emit(fb, ESC "J", 2);
+    } else {
+        for (int r = 0; r < fb->rows; r++)
+            for (int c = 0; c < fb->cols; c++) {
+                if (fb_cell_eq(&fb->cur[r][c], &fb->shown[r][c])) continue;
+                fb_move(fb, r, c);
+                fb_put_cell(fb, &fb->cur[r][c]);
+            }
+        if (fb->out_fg > 0 || fb->out_attr > 0) fb_emit(fb, RESET, sizeof(RESET) - 1);
+        fb_move(fb, fb->rows, 0);
+    }
+    fb->crow = fb->rows;
+    fb->ccol = 0;
+
+    memcpy(fb->shown, fb->cur, sizeof(fb->cur));
+    fb->shown_rows = fb->rows;
+    fb->have_shown = 1;
+    fb_write_out(fb);
+}
+
+/* Set once a key is pressed during the animation; the rest runs unpaced and undrawn */
+static int anim_skip;
+
+/* stdin is switched to unechoed single keys while animating, so a keypress
+ * neither waits for Enter nor moves the cursor under the frame */
+static struct termios anim_tty;
+static int anim_tty_saved;
+
+static void anim_restore_tty(void)
+{
+    if (anim_tty_saved) tcsetattr(STDIN_FILENO, TCSANOW, &anim_tty);
+    anim_tty_saved = 0;
+}
+
+static void anim_on_signal(int sig)
+{
+    static const char show[] = RESET ESC "?25h\n";
+    anim_restore_tty();
+    (void)!write(STDOUT_FILENO, show, sizeof(show) - 1);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+static void anim_grab_tty(void)
+{
+    struct termios raw;
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &anim_tty) != 0) return;
+    raw = anim_tty;
+    raw.c_lflag &= ~(tcflag_t)(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) != 0) return;
+    anim_tty_saved = 1;
+    signal(SIGINT, anim_on_signal);
+    signal(SIGTERM, anim_on_signal);
+}
+
+static void anim_release_tty(void)
+{
+    if (!anim_tty_saved) return;
+    anim_restore_tty();
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+}
+
+/* Frame pacing: waits ms, or less if a key arrives on a terminal stdin */
+static void anim_sleep(int ms)
+{
+    if (anim_skip || ms <= 0) return;
+    if (!anim_tty_saved) { msleep(ms); return; }
+    struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+    if (poll(&pfd, 1, ms) > 0) {
+        char drain[256];
+        if (pfd.revents & POLLIN) (void)!read(STDIN_FILENO, drain, sizeof(drain));
+        anim_skip = 1;
+    }
+}
+
+/* Draws one complete animation frame (all elements) into fb */
+static void draw_frame(frame_t *fb,
     /* SQ state */
     uint32_t sq_total, uint32_t sq_filled, int sq_pending,
     const char *sq_detail,
@@ -246,10 +784,9 @@ static int draw_frame(
     uint64_t cumulative_locked, uint64_t total_ram,
     int ring_idx, int total_rings,
     /* Visual config */
-    int vis_slots, int cqe_sz,
+    int vis_slots, int sqe_sz, int cqe_sz,
     uint64_t sq_addr, uint64_t cq_addr)
 {
-    int lines = 0;
     char buf[64], buf2[64];
     int tw = get_term_width();
     int map_bar_w = tw - 30;
@@ -257,94 +794,82 @@ static int draw_frame(
     if (map_bar_w > 80) map_bar_w = 80;
 
     /* ── SQ Ring Bar ── */
-    printf("  " BOLD FG_BCYAN "SQ " RESET DIM "0x%012lx " RESET DIM "|" RESET,
+    fb_printf(fb, "  " BOLD FG_BCYAN "SQ " RESET DIM "0x%012lx " RESET DIM "|" RESET,
            (unsigned long)sq_addr);
     for (int i = 0; i < vis_slots; i++) {
         uint32_t idx = (uint32_t)((uint64_t)i * sq_total / vis_slots);
         if ((int)idx == sq_pending)
-            printf(FG_BCYAN "\xe2\x96\x93" RESET);   /* ▓ */
+            fb_puts(fb, FG_BCYAN "\xe2\x96\x93" RESET);   /* ▓ */
         else if (idx < sq_filled)
-            printf(FG_BCYAN "\xe2\x96\x88" RESET);   /* █ */
+            fb_puts(fb, FG_BCYAN "\xe2\x96\x88" RESET);   /* █ */
         else
-            printf(FG_GRAY "\xe2\x96\x91" RESET);    /* ░ */
+            fb_puts(fb, FG_GRAY "\xe2\x96\x91" RESET);    /* ░ */
     }
-    printf(DIM "|" RESET);
-    human_bytes((uint64_t)sq_filled * SQE_SIZE, buf, sizeof(buf));
-    printf(" " FG_BCYAN "%u/%u" RESET " (%s)" ESC "K\n", sq_filled, sq_total, buf);
-    lines++;
+    fb_puts(fb, DIM "|" RESET);
+    human_bytes((uint64_t)sq_filled * sqe_sz, buf, sizeof(buf));
+    fb_printf(fb, " " FG_BCYAN "%u/%u" RESET " (%s)\n", sq_filled, sq_total, buf);
 
     /* SQ detail line */
-    printf("  %s" ESC "K\n", sq_detail);
-    lines++;
+    fb_printf(fb, "  %s\n", sq_detail);
 
-    printf("\n");
-    lines++;
+    fb_puts(fb, "\n");
 
     /* ── CQ Ring Bar ── */
-    printf("  " BOLD FG_BGREEN "CQ " RESET DIM "0x%012lx " RESET DIM "|" RESET,
+    fb_printf(fb, "  " BOLD FG_BGREEN "CQ " RESET DIM "0x%012lx " RESET DIM "|" RESET,
            (unsigned long)cq_addr);
     for (int i = 0; i < vis_slots; i++) {
         uint32_t idx = (uint32_t)((uint64_t)i * cq_total / vis_slots);
         if ((int)idx == cq_pending)
-            printf(FG_BGREEN "\xe2\x96\x93" RESET);
+            fb_puts(fb, FG_BGREEN "\xe2\x96\x93" RESET);
         else if (idx < cq_filled)
-            printf(FG_BGREEN "\xe2\x96\x88" RESET);
+            fb_puts(fb, FG_BGREEN "\xe2\x96\x88" RESET);
         else
-            printf(FG_GRAY "\xe2\x96\x91" RESET);
+            fb_puts(fb, FG_GRAY "\xe2\x96\x91" RESET);
     }
-    printf(DIM "|" RESET);
+    fb_puts(fb, DIM "|" RESET);
     human_bytes((uint64_t)cq_filled * cqe_sz, buf, sizeof(buf));
-    printf(" " FG_BGREEN "%u/%u" RESET " (%s)" ESC "K\n", cq_filled, cq_total, buf);
-    lines++;
+    fb_printf(fb, " " FG_BGREEN "%u/%u" RESET " (%s)\n", cq_filled, cq_total, buf);
 
     /* CQ detail line */
-    printf("  %s" ESC "K\n", cq_detail);
-    lines++;
+    fb_printf(fb, "  %s\n", cq_detail);
 
-    printf("\n");
-    lines++;
+    fb_puts(fb, "\n");
 
     /* ── Memory Map ── */
-    printf("  " BOLD FG_BWHITE "MEMORY MAP" RESET DIM "  (ring %d/%d)" RESET ESC "K\n",
+    fb_printf(fb, "  " BOLD FG_BWHITE "MEMORY MAP" RESET DIM "  (ring %d/%d)" RESET "\n",
            ring_idx, total_rings);
-    lines++;
 
     double pct = (double)cumulative_locked / (double)total_ram;
     if (pct > 1.0) pct = 1.0;
     int filled_chars = (int)(pct * map_bar_w);
-    printf("  RAM " DIM "[" RESET);
+    fb_puts(fb, "  RAM " DIM "[" RESET);
     for (int i = 0; i < map_bar_w; i++) {
         if (i < filled_chars)
-            printf(FG_CYAN "\xe2\x96\x88" RESET);
+            fb_puts(fb, FG_CYAN "\xe2\x96\x88" RESET);
         else
-            printf(FG_GRAY "\xe2\x96\x91" RESET);
+            fb_puts(fb, FG_GRAY "\xe2\x96\x91" RESET);
     }
-    printf(DIM "]" RESET " %s%.1f%%" RESET ESC "K\n",
+    fb_printf(fb, DIM "]" RESET " %s%.1f%%" RESET "\n",
            (pct > 0.75) ? FG_RED : (pct > 0.5) ? FG_YELLOW : FG_GREEN, pct * 100.0);
-    lines++;
 
     for (int i = 0; i < nregions; i++) {
         if (regions[i].size == 0) continue;
         if (regions[i].allocated) {
             human_bytes(regions[i].size, buf, sizeof(buf));
-            printf("  %s\xe2\x97\x8f %-18s" RESET " @ " DIM "0x%012lx" RESET "  %s",
+            fb_printf(fb, "  %s\xe2\x97\x8f %-18s" RESET " @ " DIM "0x%012lx" RESET "  %s",
                    regions[i].color, regions[i].name, (unsigned long)regions[i].addr, buf);
         } else {
-            printf("  " FG_GRAY "\xe2\x97\x8b %-18s   " DIM "\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80" RESET
+            fb_printf(fb, "  " FG_GRAY "\xe2\x97\x8b %-18s   " DIM "\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80" RESET
                    "  " FG_GRAY "pending" RESET, regions[i].name);
         }
-        printf(ESC "K\n");
-        lines++;
+        fb_puts(fb, "\n");
     }
 
-    printf("  " DIM "\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80" RESET ESC "K\n");
-    lines++;
+    fb_puts(fb, "  " DIM "\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80" RESET "\n");
     human_bytes(cumulative_locked, buf, sizeof(buf));
     human_bytes(total_ram, buf2, sizeof(buf2));
-    printf("  Total locked: " BOLD "%s" RESET " / %s" ESC "K\n", buf, buf2);
-    lines++;
+    fb_printf(fb, "  Total locked: " BOLD "%s" RESET " / %s\n", buf, buf2);
 
-    return lines;
 }
 
 static void animate_ring_instance(const ring_config_t *cfg, const ring_memory_t *m,
@@ -354,6 +879,7 @@ static void animate_ring_instance(const ring_config_t *cfg, const ring_memory_t
 {
     uint32_t sq = m->sq_actual;
     uint32_t cq = m->cq_actual;
+    int sqe_sz = cfg->sqe128 ? SQE_SIZE_SQE128 : SQE_SIZE;
     int cqe_sz = cfg->cqe32 ? CQE_SIZE_CQE32 : CQE_SIZE_NORMAL;
 
     int tw = get_term_width();
@@ -370,9 +896,17 @@ static void animate_ring_instance(const ring_config_t *cfg, const ring_memory_t
     mem_region_t regions[5];
     int nregions = 0;
 
-    regions[nregions++] = (mem_region_t){"SQ Ring (indices)", addr, m->sq_ring_bytes, FG_BCYAN, 0};
-    addr += m->sq_ring_bytes;
-    regions[nregions++] = (mem_region_t){"CQ Ring (CQEs)", addr, m->cq_ring_bytes, FG_BGREEN, 0};
+    /* With a single mmap the SQ index array sits at the tail of the CQ ring */
+    uint64_t cq_addr = addr + m->sq_ring_bytes;
+    uint64_t sq_addr = m->sq_ring_bytes ? addr
+                     : cq_addr + m->cq_ring_bytes - (uint64_t)sq * sizeof(uint32_t);
+
+    if (m->sq_ring_bytes > 0) {
+        regions[nregions++] = (mem_region_t){"SQ Ring (indices)", addr, m->sq_ring_bytes, FG_BCYAN, 0};
+        addr += m->sq_ring_bytes;
+    }
+    regions[nregions++] = (mem_region_t){m->sq_ring_bytes ? "CQ Ring (CQEs)" : "SQ+CQ Rings",
+                                         addr, m->cq_ring_bytes, FG_BGREEN, 0};
     addr += m->cq_ring_bytes;
     regions[nregions++] = (mem_region_t){"SQE Array", addr, m->sqe_array_bytes, FG_BYELLOW, 0};
     addr += m->sqe_array_bytes;
@@ -396,19 +930,20 @@ static void animate_ring_instance(const ring_config_t *cfg, const ring_memory_t
 
     srand((unsigned)(time(NULL) ^ (ring_idx * 31)));
     uint64_t cum = cumulative_before;
-    int prev_lines = 0;
     char sq_detail[256], cq_detail[256];
+    static frame_t fb;
+    fb_reset(&fb);
 
-    /* Helper macro for redraw */
+    /* Helper macro for redraw; skipped frames still advance the state */
     #define REDRAW(sq_f, sq_p, sq_d, cq_f, cq_p, cq_d) do {           \
-        if (prev_lines > 0) CURSOR_UP(prev_lines);                     \
-        prev_lines = draw_frame(sq, (sq_f), (sq_p), (sq_d),            \
-                                cq, (cq_f), (cq_p), (cq_d),           \
-                                regions, nregions, cum, total_ram,      \
-                                ring_idx, total_rings, vis_slots,       \
-                                cqe_sz, regions[0].addr,                \
-                                regions[1].addr);                       \
-        fflush(stdout);                                                 \
+        if (anim_skip) break;                                           \
+        fb_begin(&fb);                                                  \
+        draw_frame(&fb, sq, (sq_f), (sq_p), (sq_d),                    \
+                   cq, (cq_f), (cq_p), (cq_d),                         \
+                   regions, nregions, cum, total_ram,                   \
+                   ring_idx, total_rings, vis_slots,                    \
+                   sqe_sz, cqe_sz, sq_addr, cq_addr);                   \
+        fb_flush(&fb);                                                  \
     } while(0)
 
     /* ── Phase 1: Allocate mmap regions ─────────────────────────── */
@@ -419,13 +954,13 @@ static void animate_ring_instance(const ring_config_t *cfg, const ring_memory_t
         snprintf(cq_detail, sizeof(cq_detail), DIM "  Waiting..." RESET);
 
         REDRAW(0, -1, sq_detail, 0, -1, cq_detail);
-        msleep(speed_ms * 3);
+        anim_sleep(speed_ms * 3);
 
         regions[r].allocated = 1;
         cum += regions[r].size;
 
         REDRAW(0, -1, sq_detail, 0, -1, cq_detail);
-        msleep(speed_ms * 2);
+        anim_sleep(speed_ms * 2);
     }
 
     /* ── Phase 2: Populate SQ ring with SQEs ────────────────────── */
@@ -446,7 +981,7 @@ static void animate_ring_instance(const ring_config_t *cfg, const ring_memory_t
             snprintf(sq_detail, sizeof(sq_detail),
                      FG_BCYAN "  -> SQE[%u]" RESET " opcode=" BOLD "%s" RESET
                      " fd=%d off=0x%lx sz=%d",
-                     display_i, op, fd, (unsigned long)off, SQE_SIZE);
+                     display_i, op, fd, (unsigned long)off, sqe_sz);
         } else {
             snprintf(sq_detail, sizeof(sq_detail),
                      FG_BGREEN "  * Submission ring full -- %u SQEs queued" RESET, sq);
@@ -454,11 +989,11 @@ static void animate_ring_instance(const ring_config_t *cfg, const ring_memory_t
         snprintf(cq_detail, sizeof(cq_detail), DIM "  Waiting for kernel..." RESET);
 
         REDRAW(display_i, pend, sq_detail, 0, -1, cq_detail);
-        msleep(speed_ms);
+        anim_sleep(speed_ms);
 
         if (i + step > anim_sq && i < anim_sq) i = anim_sq - step;
     }
-    msleep(speed_ms * 2);
+    anim_sleep(speed_ms * 2);
 
     /* ── Phase 3: io_uring_enter() flash ────────────────────────── */
     snprintf(sq_detail, sizeof(sq_detail),
@@ -466,7 +1001,7 @@ static void animate_ring_instance(const ring_config_t *cfg, const ring_memory_t
     snprintf(cq_detail, sizeof(cq_detail),
              FG_BYELLOW "  ** Kernel dispatching I/O..." RESET);
     REDRAW(sq, -1, sq_detail, 0, -1, cq_detail);
-    msleep(speed_ms * 5);
+    anim_sleep(speed_ms * 5);
 
     /* ── Phase 4: CQ ring fills, SQ drains ──────────────────────── */
     uint32_t cq_step = anim_cq / 32;
@@ -506,19 +1041,26 @@ static void animate_ring_instance(const ring_config_t *cfg, const ring_memory_t
         }
 
         REDRAW(sq_remaining, -1, sq_detail, cq_display, cq_pend, cq_detail);
-        msleep(speed_ms);
+        anim_sleep(speed_ms);
 
         if (i + cq_step > anim_cq && i < anim_cq) i = anim_cq - cq_step;
     }
-    msleep(speed_ms * 2);
+    anim_sleep(speed_ms * 2);
 
     /* ── Final state: rings idle ────────────────────────────────── */
     snprintf(sq_detail, sizeof(sq_detail),
              FG_BGREEN "  * Ring #%d ready -- all I/O complete" RESET, ring_idx);
     snprintf(cq_detail, sizeof(cq_detail),
              FG_BGREEN "  * All completions consumed" RESET);
+    if (anim_skip && fb.have_shown) {
+        /* Key pressed mid-ring: settle on the final frame */
+        fb_begin(&fb);
+        draw_frame(&fb, sq, 0, -1, sq_detail, cq, 0, -1, cq_detail, regions, nregions, cum,
+                   total_ram, ring_idx, total_rings, vis_slots, sqe_sz, cqe_sz, sq_addr, cq_addr);
+        fb_flush(&fb);
+    }
     REDRAW(0, -1, sq_detail, 0, -1, cq_detail);
-    msleep(speed_ms);
+    anim_sleep(speed_ms);
 
     printf("\n");
     #undef REDRAW
@@ -528,6 +1070,10 @@ static void run_animation(const ring_config_t *cfg, const ring_memory_t *m,
                            uint32_t num_rings, uint64_t total_ram, int speed_ms)
 {
     char buf[64];
+    /* Redirected output gets the numbers only, without waiting on frames */
+    if (!isatty(STDOUT_FILENO)) return;
+    anim_skip = 0;
+    anim_grab_tty();
     CURSOR_HIDE;
 
     printf("\n");
@@ -536,9 +1082,11 @@ static void run_animation(const ring_config_t *cfg, const ring_memory_t *m,
     printf("  " DIM "  Placing %u ring instance%s into %s of physical RAM" RESET "\n",
            num_rings, num_rings == 1 ? "" : "s",
            human_bytes(total_ram, buf, sizeof(buf)));
+    if (anim_tty_saved)
+        printf("  " DIM "  Press any key to skip to the results" RESET "\n");
     printf("  " BOLD FG_BWHITE "====================================================================" RESET "\n");
     fflush(stdout);
-    msleep(speed_ms * 4);
+    anim_sleep(speed_ms * 4);
 
     uint64_t base_addr = 0x7f0000000000ULL;
     uint64_t cumulative = 0;
@@ -547,12 +1095,15 @@ static void run_animation(const ring_config_t *cfg, const ring_memory_t *m,
     uint32_t full_anim = num_rings;
     if (full_anim > 5) full_anim = 5;
 
-    for (uint32_t i = 1; i <= full_anim; i++) {
-        animate_ring_instance(cfg, m, (int)i, (int)num_rings,
+    uint32_t animated = 0;
+    while (animated < full_anim && !anim_skip) {
+        animated++;
+        animate_ring_instance(cfg, m, (int)animated, (int)num_rings,
                                base_addr + cumulative,
                                cumulative, total_ram, speed_ms);
         cumulative += m->total_bytes;
     }
+    full_anim = animated;
 
     /* Fast-forward remaining rings */
     if (num_rings > full_anim) {
@@ -562,7 +1113,7 @@ static void run_animation(const ring_config_t *cfg, const ring_memory_t *m,
 
         uint32_t ff_step = remaining / 20;
         if (ff_step < 1) ff_step = 1;
-        for (uint32_t r = 0; r < remaining; r += ff_step) {
+        for (uint32_t r = 0; r < remaining && !anim_skip; r += ff_step) {
             uint32_t current = full_anim + r + ff_step;
             if (current > num_rings) current = num_rings;
             uint64_t cum_now = (uint64_t)current * m->total_bytes;
@@ -572,7 +1123,7 @@ static void run_animation(const ring_config_t *cfg, const ring_memory_t *m,
                    human_bytes(cum_now, buf, sizeof(buf)),
                    (double)cum_now / (double)total_ram * 100.0);
             fflush(stdout);
-            msleep(speed_ms / 2);
+            anim_sleep(speed_ms / 2);
         }
         cumulative = (uint64_t)num_rings * m->total_bytes;
         printf("\r  " FG_BGREEN "  * All %u rings allocated" RESET
@@ -585,6 +1136,7 @@ static void run_animation(const ring_config_t *cfg, const ring_memory_t *m,
     printf("\n");
     CURSOR_SHOW;
     fflush(stdout);
+    anim_release_tty();
 }
 
 /* ══════════════════════════════════════════════════════════════════════
@@ -602,70 +1154,65 @@ static void print_ring_config(const ring_config_t *cfg)
     print_separator();
     printf("  RING CONFIGURATION\n");
     print_separator();
+    ring_memory_t m = calc_ring_memory(cfg);
     printf("  SQ entries       : %u (rounded to power of 2: %u)\n",
-           cfg->sq_entries, (uint32_t)next_power_of_2(cfg->sq_entries));
-    uint32_t cq = (uint32_t)next_power_of_2(cfg->cq_entries);
-    uint32_t sq = (uint32_t)next_power_of_2(cfg->sq_entries);
-    if (cq < sq * DEFAULT_CQ_FACTOR) cq = (uint32_t)next_power_of_2(sq * DEFAULT_CQ_FACTOR);
+           cfg->sq_entries, m.sq_actual);
     printf("  CQ entries       : %u (rounded to power of 2: %u)\n",
-           cfg->cq_entries, cq);
+           cfg->cq_entries, m.cq_actual);
+    printf("  SQE size         : %d bytes%s\n",
+           cfg->sqe128 ? SQE_SIZE_SQE128 : SQE_SIZE,
+           cfg->sqe128 ? " (SQE128 mode)" : "");
     printf("  CQE size         : %d bytes%s\n",
            cfg->cqe32 ? CQE_SIZE_CQE32 : CQE_SIZE_NORMAL,
            cfg->cqe32 ? " (CQE32 mode)" : "");
     char buf[64];
     printf("  Registered bufs  : %s\n", human_bytes(cfg->registered_bufs, buf, sizeof(buf)));
+    if (m.buf_page_size > PAGE_SIZE && cfg->registered_bufs) {
+        char buf2[64], buf3[64];
+        printf("  Buffer backing   : %lu x %s huge pages, pinned as %s\n",
+               (unsigned long)m.reg_buf_pages,
+               human_bytes(m.buf_page_size, buf2, sizeof(buf2)),
+               human_bytes(m.reg_buf_bytes, buf3, sizeof(buf3)));
+    }
     printf("  Registered files : %u\n", cfg->registered_files);
 }
 
 static void print_memory_breakdown(const ring_memory_t *m)
 {
-    char buf[64];
+    char buf[64], buf2[64];
     printf("\n");
     print_separator();
     printf("  PER-RING MEMORY BREAKDOWN\n");
     print_separator();
-    printf("  SQ ring region   : %s\n", human_bytes(m->sq_ring_bytes, buf, sizeof(buf)));
+    if (m->sq_ring_bytes)
+        printf("  SQ ring region   : %s\n", human_bytes(m->sq_ring_bytes, buf, sizeof(buf)));
+    else
+        printf("  SQ ring region   : shared with CQ ring (single mmap)\n");
     printf("  CQ ring region   : %s\n", human_bytes(m->cq_ring_bytes, buf, sizeof(buf)));
     printf("  SQE array        : %s\n", human_bytes(m->sqe_array_bytes, buf, sizeof(buf)));
-    if (m->reg_buf_bytes)
+    if (m->reg_buf_bytes && m->buf_page_size > PAGE_SIZE)
+        printf("  Registered bufs  : %s (hugetlb, %lu x %s)\n",
+               human_bytes(m->reg_buf_bytes, buf, sizeof(buf)), (unsigned long)m->reg_buf_pages,
+               human_bytes(m->buf_page_size, buf2, sizeof(buf2)));
+    else if (m->reg_buf_bytes)
         printf("  Registered bufs  : %s\n", human_bytes(m->reg_buf_bytes, buf, sizeof(buf)));
     if (m->reg_file_bytes)
         printf("  Registered files : %s\n", human_bytes(m->reg_file_bytes, buf, sizeof(buf)));
     printf("  --------------------------------\n");
     printf("  Total per ring   : %s\n", human_bytes(m->total_bytes, buf, sizeof(buf)));
     printf("  mmap regions     : %u\n", m->mmap_regions);
+    printf("  Kernel slab      : %s at setup, +%s with SQ full (not locked)\n",
+           human_bytes(m->kernel_bytes, buf, sizeof(buf)),
+           human_bytes(m->kernel_inflight_bytes, buf2, sizeof(buf2)));
+    rm_params_print(stdout, rm_params(), "  ");
+    printf("  Accounting       : %s profile (%s)\n", acct_profile()->name, profile_source);
+    printf("    %s\n", acct_profile()->summary);
 }
 
-static void print_simulation(const ring_memory_t *m, uint32_t num_rings,
-                              uint64_t total_ram)
+static void print_tuning_blocks(const tuning_t *t)
 {
-    tuning_t t = calc_tuning(m, num_rings, total_ram);
     char buf[64], buf2[64];
 
-    printf("\n");
-    print_separator();
-    printf("  SIMULATION RESULTS (%u ring instances)\n", num_rings);
-    print_separator();
-    printf("  Total physical RAM       : %s\n", human_bytes(total_ram, buf, sizeof(buf)));
-    printf("  Total locked memory      : %s\n", human_bytes(t.total_locked_mem, buf, sizeof(buf)));
-    printf("  RAM usage by io_uring    : %.2f%%\n", t.ram_usage_pct);
-    printf("  Total mmap regions       : %u\n", t.total_mmap_regions);
-
-    if (t.ram_usage_pct > 75.0)
-        printf("\n  WARNING: io_uring would consume >75%% of total RAM!\n");
-    else if (t.ram_usage_pct > 50.0)
-        printf("\n  CAUTION: io_uring would consume >50%% of total RAM.\n");
-
-    uint64_t max_rings = 0;
-    if (m->total_bytes > 0)
-        max_rings = (uint64_t)((double)total_ram * 0.80) / m->total_bytes;
-
-    printf("\n");
-    print_separator();
-    printf("  CAPACITY ESTIMATE\n");
-    print_separator();
-    printf("  Max rings in 80%% RAM    : %lu\n", (unsigned long)max_rings);
-
     printf("\n");
     print_separator();
     printf("  TUNING RECOMMENDATIONS\n");
@@ -674,44 +1221,199 @@ static void print_simulation(const ring_memory_t *m, uint32_t num_rings,
     printf("\n  +-- /etc/security/limits.conf ----------------------------+\n");
     printf("  |                                                         |\n");
     printf("  |  *  soft  memlock  %-10lu                           |\n",
-           (unsigned long)(t.memlock_limit / 1024));
+           (unsigned long)(t->memlock_limit / 1024));
     printf("  |  *  hard  memlock  %-10lu                           |\n",
-           (unsigned long)(t.memlock_limit / 1024));
+           (unsigned long)(t->memlock_limit / 1024));
+    if (t->threads > 4096) {
+        printf("  |  *  soft  nproc    %-10lu                           |\n",
+               (unsigned long)t->nproc_limit);
+        printf("  |  *  hard  nproc    %-10lu                           |\n",
+               (unsigned long)t->nproc_limit);
+    }
     printf("  |                                                         |\n");
     printf("  |  (values in KiB -- limit = %s)%*s|\n",
-           human_bytes(t.memlock_limit, buf, sizeof(buf)),
-           (int)(20 - strlen(human_bytes(t.memlock_limit, buf2, sizeof(buf2)))), "");
+           human_bytes(t->memlock_limit, buf, sizeof(buf)),
+           (int)(20 - strlen(human_bytes(t->memlock_limit, buf2, sizeof(buf2)))), "");
     printf("  +---------------------------------------------------------+\n");
+    printf("  io_uring charges the owning user, so the limit must cover every\n"
+           "  ring that user opens across all of its processes.\n");
+    if ((double)t->memlock_charged * MEMLOCK_HEADROOM <= (double)acct_profile()->default_memlock)
+        printf("  The %s kernel default (%s) already covers this.\n",
+               acct_profile()->name, human_bytes(acct_profile()->default_memlock, buf, sizeof(buf)));
 
     printf("\n  +-- /etc/sysctl.conf -------------------------------------+\n");
     printf("  |                                                         |\n");
     printf("  |  vm.max_map_count = %-10lu                          |\n",
-           (unsigned long)t.max_map_count);
+           (unsigned long)t->max_map_count);
+    if (t->nr_hugepages && t->huge_page_size == 2ULL << 20)
+        printf("  |  vm.nr_hugepages = %-10lu                           |\n",
+               (unsigned long)t->nr_hugepages);
+    if (t->pid_infeasible)
+        printf("  |  kernel.pid_max: INFEASIBLE, %lu threads > %d         \n",
+               (unsigned long)t->threads, PID_MAX_LIMIT);
+    else if (t->threads > DEFAULT_PID_MAX)
+        printf("  |  kernel.pid_max = %-10lu                            |\n",
+               (unsigned long)(t->nproc_limit > PID_MAX_LIMIT ? PID_MAX_LIMIT
+                               : rm_roundup_pow2((uint32_t)t->nproc_limit)));
     printf("  |                                                         |\n");
     printf("  +---------------------------------------------------------+\n");
 
+    /* vm.nr_hugepages only sizes the default (2M) pool; others need the cmdline */
+    if (t->nr_hugepages && t->huge_page_size != 2ULL << 20) {
+        printf("\n  +-- kernel command line ----------------------------------+\n");
+        printf("  |                                                         |\n");
+        printf("  |  hugepagesz=%s hugepages=%lu\n",
+               size_suffix(t->huge_page_size, buf, sizeof(buf)), (unsigned long)t->nr_hugepages);
+        printf("  |                                                         |\n");
+        printf("  +---------------------------------------------------------+\n");
+    }
+
     printf("\n  +-- systemd override (per-service) -----------------------+\n");
     printf("  |                                                         |\n");
     printf("  |  [Service]                                              |\n");
-    printf("  |  LimitMEMLOCK=%lu\n", (unsigned long)t.memlock_limit);
+    printf("  |  LimitMEMLOCK=%lu\n", (unsigned long)t->memlock_limit);
+    if (t->threads > 4096)
+        printf("  |  LimitNPROC=%lu\n", (unsigned long)t->nproc_limit);
+    if (t->memcg_charged)
+        printf("  |  # rings are charged to the unit's cgroup: MemoryMax > %s\n",
+               human_bytes(t->memcg_charged + t->memlock_charged, buf, sizeof(buf)));
     printf("  |                                                         |\n");
     printf("  +---------------------------------------------------------+\n");
 
     printf("\n  +-- Apply at runtime -------------------------------------+\n");
     printf("  |                                                         |\n");
-    printf("  |  ulimit -l %lu\n", (unsigned long)(t.memlock_limit / 1024));
-    printf("  |  sysctl -w vm.max_map_count=%lu\n", (unsigned long)t.max_map_count);
+    printf("  |  ulimit -l %lu\n", (unsigned long)(t->memlock_limit / 1024));
+    printf("  |  sysctl -w vm.max_map_count=%lu\n", (unsigned long)t->max_map_count);
+    if (t->nr_hugepages)
+        printf("  |  echo %lu > /sys/kernel/mm/hugepages/hugepages-%lukB/nr_hugepages\n",
+               (unsigned long)t->nr_hugepages, (unsigned long)(t->huge_page_size >> 10));
     printf("  |                                                         |\n");
     printf("  +---------------------------------------------------------+\n");
 }
 
+static void print_simulation(const ring_memory_t *m, uint32_t num_rings,
+                              uint64_t total_ram)
+{
+    tuning_t t = calc_tuning(m, num_rings, total_ram);
+    char buf[64];
+
+    printf("\n");
+    print_separator();
+    printf("  SIMULATION RESULTS (%u ring instances)\n", num_rings);
+    print_separator();
+    printf("  Total physical RAM       : %s\n", human_bytes(total_ram, buf, sizeof(buf)));
+    printf("  Total locked memory      : %s\n", human_bytes(t.total_locked_mem, buf, sizeof(buf)));
+    printf("  Charged to memlock       : %s\n", human_bytes(t.memlock_charged, buf, sizeof(buf)));
+    if (t.memcg_charged)
+        printf("  Charged to memcg         : %s (rings + SQEs)\n",
+               human_bytes(t.memcg_charged, buf, sizeof(buf)));
+    printf("  Kernel memory (unlocked) : %s\n", human_bytes(t.kernel_mem, buf, sizeof(buf)));
+    printf("  RAM usage by io_uring    : %.2f%%\n", t.ram_usage_pct);
+    printf("  Total mmap regions       : %u\n", t.total_mmap_regions);
+
+    if (t.ram_usage_pct > 75.0)
+        printf("\n  WARNING: io_uring would consume >75%% of total RAM!\n");
+    else if (t.ram_usage_pct > 50.0)
+        printf("\n  CAUTION: io_uring would consume >50%% of total RAM.\n");
+
+    printf("\n");
+    print_separator();
+    printf("  KERNEL THREADS AND SLAB\n");
+    print_separator();
+    printf("  Submitting tasks         : %lu%s\n", (unsigned long)t.tasks,
+           kmodel.sqpoll_share ? "" : " (one io-wq each)");
+    printf("  SQPOLL threads           : %lu%s\n", (unsigned long)t.sqpoll_threads,
+           kmodel.sqpoll_share ? " (one io-wq each)" : "");
+    printf("  io-wq workers            : %lu%s\n", (unsigned long)t.iowq_workers,
+           kmodel.iowq_busy < 0 && kmodel.iowq_bounded < 0
+               ? " (created on demand; see --iowq-busy)" : "");
+    printf("  Stacks + task structs    : %s\n", human_bytes(t.kthread_bytes, buf, sizeof(buf)));
+    printf("  io_kiocb (SQs full)      : %s\n", human_bytes(t.kiocb_bytes, buf, sizeof(buf)));
+    printf("  Ring context slab        : %s\n", human_bytes(t.slab_bytes, buf, sizeof(buf)));
+    printf("  Threads vs RLIMIT_NPROC  : %lu (tasks + kernel threads, per user)\n",
+           (unsigned long)t.threads);
+    if (t.pid_infeasible)
+        printf("\n  INFEASIBLE: %lu threads exceed PID_MAX_LIMIT (%d); no kernel.pid_max fits\n",
+               (unsigned long)t.threads, PID_MAX_LIMIT);
+    else if (t.threads > DEFAULT_PID_MAX)
+        printf("\n  WARNING: %lu threads exceed the default kernel.pid_max (%d)\n",
+               (unsigned long)t.threads, DEFAULT_PID_MAX);
+
+    /* Capacity counts what each ring really costs, threads included */
+    uint64_t max_rings = 0;
+    uint64_t per_ring_cost = num_rings ? t.footprint / num_rings : m->total_bytes;
+    if (per_ring_cost > 0)
+        max_rings = (uint64_t)((double)total_ram * 0.80) / per_ring_cost;
+
+    printf("\n");
+    print_separator();
+    printf("  CAPACITY ESTIMATE\n");
+    print_separator();
+    printf("  Max rings in 80%% RAM    : %lu\n", (unsigned long)max_rings);
+
+    if (t.nr_hugepages) {
+        uint64_t pool = t.nr_hugepages * t.huge_page_size;
+        printf("\n");
+        print_separator();
+        printf("  HUGE PAGES (registered buffers on %s pages)\n", human_bytes(t.huge_page_size, buf, sizeof(buf)));
+        print_separator();
+        printf("  Huge pages per ring      : %lu\n", (unsigned long)m->reg_buf_pages);
+        printf("  hugetlb pool to reserve  : %lu pages (%s)\n", (unsigned long)t.nr_hugepages,
+               human_bytes(pool, buf, sizeof(buf)));
+        printf("  Locked: rings + SQEs     : %s\n",
+               human_bytes((uint64_t)m->ring_bytes * num_rings, buf, sizeof(buf)));
+        printf("  Locked: buffers          : %s (whole compound pages)\n",
+               human_bytes(m->reg_buf_bytes * num_rings, buf, sizeof(buf)));
+        printf("  VMAs: ring mappings      : %lu\n",
+               (unsigned long)(m->mmap_regions - 1) * num_rings);
+        printf("  VMAs: hugetlb buffers    : %u (one per pool)\n", num_rings);
+        if (pool > total_ram)
+            printf("\n  WARNING: the hugetlb pool is larger than physical RAM!\n");
+        else if ((double)pool > (double)total_ram * 0.5)
+            printf("\n  CAUTION: the hugetlb pool is carved out of RAM at reservation time;\n"
+                   "  it is unavailable to the page cache even while rings are idle.\n");
+    }
+
+    print_tuning_blocks(&t);
+}
+
+/* --prom for the batch mode: the ring, then num_rings of them as the host */
+static int prom_simulation(const ring_memory_t *m, uint32_t num_rings, uint64_t total_ram)
+{
+    prom_t p;
+    if (prom_open(&p) != 0) return -1;
+    if (!p.f) return 0;
+
+    tuning_t t = calc_tuning(m, num_rings, total_ram);
+    const char *none[1] = { "" };
+    const tuning_t *tp[1] = { &t };
+    const ring_memory_t *mp[1] = { m };
+    uint64_t per_ring_cost = num_rings ? t.footprint / num_rings : m->total_bytes;
+
+    prom_rings(p.f, none, mp, 1);
+    prom_tuning(p.f, "host", "all rings", none, tp, 1);
+    prom_family(p.f, "host_rings", "Ring instances simulated");
+    prom_sample(p.f, "host_rings", "", num_rings);
+    prom_family(p.f, "host_ram_bytes", "Physical RAM of the host (--ram)");
+    prom_sample(p.f, "host_ram_bytes", "", (double)total_ram);
+    prom_family(p.f, "host_ram_usage_ratio", "Footprint of all rings over RAM");
+    prom_sample(p.f, "host_ram_usage_ratio", "", t.ram_usage_pct / 100.0);
+    prom_family(p.f, "host_max_rings", "Rings of this config that fit in 80% of RAM");
+    prom_sample(p.f, "host_max_rings", "",
+                per_ring_cost ? (double)((uint64_t)((double)total_ram * 0.80) / per_ring_cost) : 0.0);
+    return prom_close(&p);
+}
+
 /* ── Sweep mode ────────────────────────────────────────────────────── */
 
+static const uint32_t sweep_counts[] = {1, 2, 4, 8, 16, 32, 64, 128, 256, 512,
+                                        1024, 2048, 4096, 8192, 16384, 32768, 65536};
+#define NUM_SWEEP_COUNTS (sizeof(sweep_counts) / sizeof(sweep_counts[0]))
+
 static void sweep_mode(const ring_config_t *cfg, uint64_t total_ram)
 {
-    uint32_t counts[] = {1, 2, 4, 8, 16, 32, 64, 128, 256, 512,
-                          1024, 2048, 4096, 8192, 16384, 32768, 65536};
-    int ncounts = (int)(sizeof(counts) / sizeof(counts[0]));
+    const uint32_t *counts = sweep_counts;
+    int ncounts = (int)NUM_SWEEP_COUNTS;
     ring_memory_t m = calc_ring_memory(cfg);
     char buf[64];
 
@@ -720,40 +1422,1449 @@ static void sweep_mode(const ring_config_t *cfg, uint64_t total_ram)
     printf("  SWEEP: Tuning across ring counts (per-ring = %s)\n",
            human_bytes(m.total_bytes, buf, sizeof(buf)));
     print_separator();
-    printf("\n  %-8s  %-14s  %-6s  %-16s  %-12s\n",
-           "Rings", "Locked Mem", "RAM%", "memlock (KiB)", "max_map_count");
-    printf("  %-8s  %-14s  %-6s  %-16s  %-12s\n",
-           "--------", "--------------", "------", "----------------", "------------");
+    printf("\n  %-8s  %-14s  %-12s  %-8s  %-6s  %-16s  %-12s\n",
+           "Rings", "Locked Mem", "Kernel Mem", "Threads", "RAM%", "memlock (KiB)", "max_map_count");
+    printf("  %-8s  %-14s  %-12s  %-8s  %-6s  %-16s  %-12s\n",
+           "--------", "--------------", "------------", "--------", "------",
+           "----------------", "------------");
 
     for (int i = 0; i < ncounts; i++) {
         tuning_t t = calc_tuning(&m, counts[i], total_ram);
         if (t.ram_usage_pct > 95.0) break;
-        char lock_buf[64];
+        char lock_buf[64], kern_buf[64];
         human_bytes(t.total_locked_mem, lock_buf, sizeof(lock_buf));
-        printf("  %-8u  %-14s  %5.1f%%  %-16lu  %-12lu\n",
-               counts[i], lock_buf, t.ram_usage_pct,
+        human_bytes(t.kernel_mem, kern_buf, sizeof(kern_buf));
+        printf("  %-8u  %-14s  %-12s  %-8lu  %5.1f%%  %-16lu  %-12lu%s\n",
+               counts[i], lock_buf, kern_buf, (unsigned long)t.threads, t.ram_usage_pct,
                (unsigned long)(t.memlock_limit / 1024),
-               (unsigned long)t.max_map_count);
+               (unsigned long)t.max_map_count,
+               t.pid_infeasible ? "  INFEASIBLE: threads > PID_MAX_LIMIT" : "");
     }
     printf("\n");
 }
 
-/* ── Interactive mode ──────────────────────────────────────────────── */
+/* ── Grid sweep ────────────────────────────────────────────────────── */
 
-static uint64_t prompt_uint64(const char *prompt, uint64_t def)
+/*
+ * Evaluates every combination of SQ entries, CQ factor, CQE32, registered
+ * buffer size, registered files and ring count, split across worker threads.
+ * For each (CQ factor, CQE32, files) variant it then prints the Pareto
+ * frontier of configs that fit the budget: no other fitting config has at
+ * least as many rings, as deep an SQ and as large a buffer pool for no more
+ * locked memory.
+ */
+
+#define GRID_MAX_VALUES 64
+
+typedef struct {
+    uint64_t v[GRID_MAX_VALUES];
+    int      n;
+} grid_axis_t;
+
+typedef struct {
+    grid_axis_t sq, cq_factor, cqe32, bufs, files, rings;
+    int         sqe128;
+    uint64_t    buf_page_size;      /* --hugepages, 0 = base pages */
+    uint64_t    total_ram;
+    uint64_t    budget;             /* locked-memory ceiling in bytes */
+    int         threads;
+} grid_spec_t;
+
+typedef struct {
+    uint32_t rings;
+    uint32_t sq_actual;
+    uint32_t cq_actual;
+    uint64_t buf_bytes;             /* page-aligned pool per ring */
+    tuning_t t;
+    int      fits;
+} grid_point_t;
+
+typedef struct {
+    const grid_spec_t *spec;
+    grid_point_t      *pts;
+    size_t             begin, end;
+    int                running;
+} grid_job_t;
+
+/* "64,256,1M" -> axis; sizes accept K/M/G suffixes. Returns 0 or -1. */
+static int parse_axis(const char *str, grid_axis_t *ax, int sizes)
 {
-    char line[256];
-    printf("  %s [%lu]: ", prompt, (unsigned long)def);
-    fflush(stdout);
-    if (!fgets(line, sizeof(line), stdin) || line[0] == '\n')
-        return def;
-    return strtoull(line, NULL, 10);
+    char tmp[1024], *save = NULL;
+    snprintf(tmp, sizeof(tmp), "%s", str);
+    ax->n = 0;
+    for (char *tok = strtok_r(tmp, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (ax->n == GRID_MAX_VALUES) return -1;
+        char *end;
+        if (sizes) {
+            strtod(tok, &end);
+            if (end == tok) return -1;
+            ax->v[ax->n++] = parse_ram(tok);
+        } else {
+            ax->v[ax->n++] = strtoull(tok, &end, 10);
+            if (end == tok || *end) return -1;
+        }
+    }
+    return ax->n > 0 ? 0 : -1;
 }
 
-static void interactive_mode(int no_anim)
+static void axis_set(grid_axis_t *ax, const uint64_t *v, int n)
 {
-    char line[256];
-    printf("\n");
+    ax->n = n > GRID_MAX_VALUES ? GRID_MAX_VALUES : n;
+    for (int i = 0; i < ax->n; i++) ax->v[i] = v[i];
+}
+
+static size_t grid_size(const grid_spec_t *g)
+{
+    return (size_t)g->sq.n * g->cq_factor.n * g->cqe32.n *
+           g->bufs.n * g->files.n * g->rings.n;
+}
+
+/* Index order, outermost first: sq, cq factor, cqe32, bufs, files, rings */
+static size_t grid_index(const grid_spec_t *g, int sq, int cqf, int cqe, int buf,
+                         int file, int ring)
+{
+    return (((((size_t)sq * g->cq_factor.n + cqf) * g->cqe32.n + cqe)
+             * g->bufs.n + buf) * g->files.n + file) * g->rings.n + ring;
+}
+
+static void grid_eval(const grid_spec_t *g, size_t idx, grid_point_t *p)
+{
+    int ring = (int)(idx % g->rings.n);  idx /= g->rings.n;
+    int file = (int)(idx % g->files.n);  idx /= g->files.n;
+    int buf  = (int)(idx % g->bufs.n);   idx /= g->bufs.n;
+    int cqe  = (int)(idx % g->cqe32.n);  idx /= g->cqe32.n;
+    int cqf  = (int)(idx % g->cq_factor.n);
+    int sq   = (int)(idx / g->cq_factor.n);
+
+    ring_config_t cfg = {
+        .sq_entries       = (uint32_t)g->sq.v[sq],
+        .cq_entries       = (uint32_t)(g->sq.v[sq] * g->cq_factor.v[cqf]),
+        .sqe128           = g->sqe128,
+        .cqe32            = g->cqe32.v[cqe] != 0,
+        .registered_bufs  = g->bufs.v[buf],
+        .registered_files = (uint32_t)g->files.v[file],
+        .buf_page_size    = g->buf_page_size,
+    };
+    ring_memory_t m = calc_ring_memory(&cfg);
+
+    p->rings     = (uint32_t)g->rings.v[ring];
+    p->sq_actual = m.sq_actual;
+    p->cq_actual = m.cq_actual;
+    p->buf_bytes = m.reg_buf_bytes;
+    p->t         = calc_tuning(&m, p->rings, g->total_ram);
+    p->fits      = p->t.total_locked_mem <= g->budget && !p->t.pid_infeasible;
+}
+
+static void *grid_worker(void *arg)
+{
+    grid_job_t *job = arg;
+    for (size_t i = job->begin; i < job->end; i++)
+        grid_eval(job->spec, i, &job->pts[i]);
+    return NULL;
+}
+
+static int grid_dominates(const grid_point_t *a, const grid_point_t *b)
+{
+    if (a->rings < b->rings || a->sq_actual < b->sq_actual || a->buf_bytes < b->buf_bytes ||
+        a->t.total_locked_mem > b->t.total_locked_mem)
+        return 0;
+    return a->rings > b->rings || a->sq_actual > b->sq_actual || a->buf_bytes > b->buf_bytes ||
+           a->t.total_locked_mem < b->t.total_locked_mem;
+}
+
+/*
+ * Least locked memory first; ties put the larger config first, so every
+ * point sorts after anything that dominates it
+ */
+static int cmp_locked(const void *a, const void *b)
+{
+    const grid_point_t *x = *(const grid_point_t *const *)a;
+    const grid_point_t *y = *(const grid_point_t *const *)b;
+    if (x->t.total_locked_mem != y->t.total_locked_mem)
+        return x->t.total_locked_mem < y->t.total_locked_mem ? -1 : 1;
+    if (x->rings != y->rings) return x->rings > y->rings ? -1 : 1;
+    if (x->sq_actual != y->sq_actual) return x->sq_actual > y->sq_actual ? -1 : 1;
+    return (x->buf_bytes < y->buf_bytes) - (x->buf_bytes > y->buf_bytes);
+}
+
+static int grid_mode(grid_spec_t *g)
+{
+    size_t n = grid_size(g);
+    grid_point_t *pts = calloc(n, sizeof(*pts));
+    const grid_point_t **cand = calloc((size_t)g->sq.n * g->bufs.n * g->rings.n, sizeof(*cand));
+    if (!pts || !cand) {
+        fprintf(stderr, "Error: cannot allocate %zu grid points\n", n);
+        free(pts); free(cand);
+        return 1;
+    }
+
+    /* rm_params() and the profile load lazily; do it before the workers race on them */
+    (void)rm_params();
+    (void)acct_profile();
+
+    if (g->threads < 1) g->threads = 1;
+    if ((size_t)g->threads > n) g->threads = (int)n;
+    pthread_t  *tids = calloc((size_t)g->threads, sizeof(*tids));
+    grid_job_t *jobs = calloc((size_t)g->threads, sizeof(*jobs));
+    if (!tids || !jobs) {
+        fprintf(stderr, "Error: cannot allocate %d workers\n", g->threads);
+        free(pts); free(cand); free(tids); free(jobs);
+        return 1;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < g->threads; i++) {
+        jobs[i] = (grid_job_t){ g, pts, n * i / g->threads, n * (i + 1) / g->threads, 0 };
+        if (pthread_create(&tids[i], NULL, grid_worker, &jobs[i]) == 0)
+            jobs[i].running = 1;
+        else
+            grid_worker(&jobs[i]);      /* run inline rather than lose the chunk */
+    }
+    for (int i = 0; i < g->threads; i++)
+        if (jobs[i].running) pthread_join(tids[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ms = (double)(t1.tv_sec - t0.tv_sec) * 1e3 + (double)(t1.tv_nsec - t0.tv_nsec) / 1e6;
+
+    char buf[64], buf2[64];
+    printf("\n");
+    print_separator();
+    printf("  GRID SWEEP: %zu configs on %d thread%s in %.1f ms\n",
+           n, g->threads, g->threads == 1 ? "" : "s", ms);
+    printf("  Budget: %s locked (%.0f%% of %s)\n",
+           human_bytes(g->budget, buf, sizeof(buf)),
+           (double)g->budget / (double)g->total_ram * 100.0,
+           human_bytes(g->total_ram, buf2, sizeof(buf2)));
+    printf("  Frontier: max rings x SQ depth x buffer pool per unit of locked memory\n");
+    print_separator();
+
+    size_t total_front = 0;
+    for (int cqf = 0; cqf < g->cq_factor.n; cqf++)
+    for (int cqe = 0; cqe < g->cqe32.n; cqe++)
+    for (int file = 0; file < g->files.n; file++) {
+        int nc = 0;
+        for (int sq = 0; sq < g->sq.n; sq++)
+        for (int b = 0; b < g->bufs.n; b++)
+        for (int r = 0; r < g->rings.n; r++) {
+            const grid_point_t *p = &pts[grid_index(g, sq, cqf, cqe, b, file, r)];
+            if (p->fits) cand[nc++] = p;
+        }
+
+        /*
+         * In locked-memory order a point can only be dominated by one before
+         * it, and dominance is transitive, so checking the frontier kept so
+         * far is enough. Points equal to a kept one are dropped as well.
+         */
+        qsort(cand, (size_t)nc, sizeof(*cand), cmp_locked);
+        int nf = 0;
+        for (int i = 0; i < nc; i++) {
+            int keep = 1;
+            for (int j = 0; j < nf && keep; j++) {
+                if (grid_dominates(cand[j], cand[i]) ||
+                    (cand[j]->rings == cand[i]->rings &&
+                     cand[j]->sq_actual == cand[i]->sq_actual &&
+                     cand[j]->buf_bytes == cand[i]->buf_bytes &&
+                     cand[j]->t.total_locked_mem == cand[i]->t.total_locked_mem))
+                    keep = 0;
+            }
+            if (keep) cand[nf++] = cand[i];
+        }
+        total_front += (size_t)nf;
+
+        printf("\n  CQ = %lu x SQ, %d-byte CQEs, %lu registered files%s",
+               (unsigned long)g->cq_factor.v[cqf],
+               g->cqe32.v[cqe] ? CQE_SIZE_CQE32 : CQE_SIZE_NORMAL,
+               (unsigned long)g->files.v[file],
+               g->sqe128 ? ", 128-byte SQEs" : "");
+        if (g->buf_page_size)
+            printf(", %s huge pages", human_bytes(g->buf_page_size, buf, sizeof(buf)));
+        printf("\n");
+        if (nf == 0) {
+            printf("    (no config in the grid fits the budget)\n");
+            continue;
+        }
+        printf("  %-8s  %-6s  %-6s  %-12s  %-14s  %-6s  %-16s  %-12s\n",
+               "Rings", "SQ", "CQ", "Bufs/ring", "Locked Mem", "RAM%",
+               "memlock (KiB)", "max_map_count");
+        printf("  %-8s  %-6s  %-6s  %-12s  %-14s  %-6s  %-16s  %-12s\n",
+               "--------", "------", "------", "------------", "--------------",
+               "------", "----------------", "------------");
+        for (int i = 0; i < nf; i++) {
+            const grid_point_t *p = cand[i];
+            printf("  %-8u  %-6u  %-6u  %-12s  %-14s  %5.1f%%  %-16lu  %-12lu\n",
+                   p->rings, p->sq_actual, p->cq_actual,
+                   p->buf_bytes ? human_bytes(p->buf_bytes, buf, sizeof(buf)) : "-",
+                   human_bytes(p->t.total_locked_mem, buf2, sizeof(buf2)),
+                   p->t.ram_usage_pct,
+                   (unsigned long)(p->t.memlock_limit / 1024),
+                   (unsigned long)p->t.max_map_count);
+        }
+    }
+    printf("\n  %zu frontier config%s across %d variant%s\n\n", total_front,
+           total_front == 1 ? "" : "s",
+           g->cq_factor.n * g->cqe32.n * g->files.n,
+           g->cq_factor.n * g->cqe32.n * g->files.n == 1 ? "" : "s");
+
+    free(pts); free(cand); free(tids); free(jobs);
+    return 0;
+}
+
+/* ── Capacity solver ───────────────────────────────────────────────── */
+
+/*
+ * The inverse of print_simulation(): given the host and its ceilings, find
+ * the largest registered buffer pool per ring at every SQ depth from --sq up
+ * to the kernel maximum. Each ceiling is reduced by the safety margin first,
+ * so the emitted limits leave that much headroom. io_uring charges memlock
+ * to the user, so unless --separate-users is given the services share one
+ * uid and the memlock ceiling and limit cover all of them.
+ */
+
+typedef struct {
+    uint32_t services;
+    uint32_t rings_per_service;
+    uint64_t total_ram;
+    uint64_t ram_budget;            /* host locked-memory ceiling */
+    uint64_t memlock_max;           /* per-process RLIMIT_MEMLOCK ceiling, 0 = none */
+    int      separate_users;        /* each service runs as its own uid */
+    uint64_t map_count_max;         /* per-service VMA ceiling, 0 = none */
+    double   margin;                /* fraction held back from every ceiling */
+} solve_spec_t;
+
+enum { SOLVE_MEMLOCK = 1, SOLVE_RAM = 2, SOLVE_MAPS = 4, SOLVE_PIDS = 8 };
+
+/* Bitmask of the ceilings cfg exceeds, 0 if it fits */
+static unsigned solve_check(const solve_spec_t *s, const ring_config_t *cfg)
+{
+    ring_memory_t m = calc_ring_memory(cfg);
+    tuning_t t = calc_tuning(&m, s->rings_per_service, s->total_ram);
+    double keep = 1.0 - s->margin;
+    unsigned over = 0;
+
+    /* The limit the uid's charge needs, without calc_tuning's floor at the default */
+    uint32_t per_uid = s->separate_users ? 1 : s->services;
+    uint64_t memlock_need = page_align((uint64_t)((double)t.memlock_charged * per_uid *
+                                                  MEMLOCK_HEADROOM));
+    if (s->memlock_max && (double)memlock_need > (double)s->memlock_max * keep)
+        over |= SOLVE_MEMLOCK;
+    if ((double)t.footprint * s->services > (double)s->ram_budget * keep)
+        over |= SOLVE_RAM;
+    if (s->map_count_max && (double)t.map_count_needed > (double)s->map_count_max * keep)
+        over |= SOLVE_MAPS;
+    if (t.threads * s->services > PID_MAX_LIMIT)
+        over |= SOLVE_PIDS;
+    return over;
+}
+
+static const char *solve_limit_name(unsigned over)
+{
+    if (over & SOLVE_MEMLOCK) return "memlock";
+    if (over & SOLVE_RAM)     return "RAM";
+    if (over & SOLVE_MAPS)    return "max_map_count";
+    if (over & SOLVE_PIDS)    return "PID_MAX_LIMIT";
+    return "-";
+}
+
+/*
+ * Largest page-aligned pool >= min_bufs that fits, left in cfg->registered_bufs.
+ * Returns -1 with *limit set if even min_bufs does not fit.
+ */
+static int solve_max_bufs(const solve_spec_t *s, ring_config_t *cfg, uint64_t min_bufs,
+                          unsigned *limit)
+{
+    /* Search in backing pages; hugetlb pools only grow a whole huge page at a time */
+    uint64_t unit = cfg->buf_page_size > PAGE_SIZE ? cfg->buf_page_size : PAGE_SIZE;
+    uint64_t lo = (min_bufs + unit - 1) / unit;
+    uint64_t hi = s->total_ram / unit + 1;
+
+    cfg->registered_bufs = lo * unit;
+    if ((*limit = solve_check(s, cfg)) != 0) return -1;
+
+    /* Invariant: lo fits, hi does not (locked memory cannot exceed RAM) */
+    while (hi - lo > 1) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        cfg->registered_bufs = mid * unit;
+        if (solve_check(s, cfg) == 0) lo = mid;
+        else                          hi = mid;
+    }
+    cfg->registered_bufs = hi * unit;
+    *limit = solve_check(s, cfg);
+    cfg->registered_bufs = lo * unit;
+    return 0;
+}
+
+static int solve_mode(const solve_spec_t *s, const ring_config_t *base, uint32_t cq_factor)
+{
+    char buf[64], buf2[64];
+    uint64_t min_bufs = base->registered_bufs;
+
+    printf("\n");
+    print_separator();
+    printf("  CAPACITY SOLVER: %u service%s x %u ring%s\n",
+           s->services, s->services == 1 ? "" : "s",
+           s->rings_per_service, s->rings_per_service == 1 ? "" : "s");
+    print_separator();
+    printf("  RAM budget       : %s of %s\n",
+           human_bytes(s->ram_budget, buf, sizeof(buf)),
+           human_bytes(s->total_ram, buf2, sizeof(buf2)));
+    if (s->memlock_max)
+        printf("  memlock ceiling  : %s per process\n", human_bytes(s->memlock_max, buf, sizeof(buf)));
+    else
+        printf("  memlock ceiling  : none\n");
+    if (s->separate_users || s->services == 1)
+        printf("  Users            : one per service, memlock charged per service\n");
+    else
+        printf("  Users            : one shared uid, memlock charged for all %u services\n",
+               s->services);
+    if (s->map_count_max)
+        printf("  map count ceiling: %lu per service\n", (unsigned long)s->map_count_max);
+    else
+        printf("  map count ceiling: none\n");
+    printf("  Safety margin    : %.0f%% held back from each ceiling\n", s->margin * 100.0);
+    if (min_bufs)
+        printf("  Minimum pool     : %s per ring\n", human_bytes(min_bufs, buf, sizeof(buf)));
+
+    typedef struct { ring_config_t cfg; uint32_t sq_actual; unsigned limit; } row_t;
+    row_t rows[32];
+    int nrows = 0;
+    unsigned first_limit = 0;
+
+    uint32_t sq = rm_roundup_pow2(base->sq_entries ? base->sq_entries : 1);
+    for (; sq <= KERN_MAX_SQ_ENTRIES && nrows < 32; sq *= 2) {
+        ring_config_t cfg = *base;
+        cfg.sq_entries = sq;
+        cfg.cq_entries = sq * cq_factor;
+        unsigned limit;
+        if (solve_max_bufs(s, &cfg, min_bufs, &limit) != 0) {
+            if (nrows == 0) first_limit = limit;
+            break;                      /* deeper rings only cost more */
+        }
+        rows[nrows++] = (row_t){ cfg, calc_ring_memory(&cfg).sq_actual, limit };
+    }
+
+    if (nrows == 0) {
+        printf("\n  No configuration fits: SQ %u with a %s pool already exceeds the %s ceiling.\n",
+               rm_roundup_pow2(base->sq_entries ? base->sq_entries : 1),
+               human_bytes(min_bufs, buf, sizeof(buf)), solve_limit_name(first_limit));
+        printf("  Lower --rings/--services or --sq, or raise the ceilings.\n\n");
+        return 1;
+    }
+
+    /* Deepest SQ that gives up no more than 10% of the largest pool */
+    uint64_t best_pool = 0;
+    for (int i = 0; i < nrows; i++)
+        if (rows[i].cfg.registered_bufs > best_pool) best_pool = rows[i].cfg.registered_bufs;
+    int pick = 0;
+    for (int i = 0; i < nrows; i++)
+        if ((double)rows[i].cfg.registered_bufs >= (double)best_pool * 0.9) pick = i;
+
+    printf("\n     %-6s  %-6s  %-12s  %-14s  %-14s  %-14s\n",
+           "SQ", "CQ", "Bufs/ring", "Per service", "Host locked", "Limited by");
+    printf("     %-6s  %-6s  %-12s  %-14s  %-14s  %-14s\n",
+           "------", "------", "------------", "--------------", "--------------",
+           "--------------");
+    for (int i = 0; i < nrows; i++) {
+        ring_memory_t m = calc_ring_memory(&rows[i].cfg);
+        tuning_t t = calc_tuning(&m, s->rings_per_service, s->total_ram);
+        char b3[64];
+        printf("  %s  %-6u  %-6u  %-12s  %-14s  %-14s  %-14s\n",
+               i == pick ? "*" : " ", rows[i].sq_actual, m.cq_actual,
+               human_bytes(m.reg_buf_bytes, buf, sizeof(buf)),
+               human_bytes(t.total_locked_mem, buf2, sizeof(buf2)),
+               human_bytes(t.total_locked_mem * s->services, b3, sizeof(b3)),
+               solve_limit_name(rows[i].limit));
+    }
+    printf("\n  * recommended: deepest SQ within 10%% of the largest pool\n");
+
+    ring_config_t cfg = rows[pick].cfg;
+    ring_memory_t m = calc_ring_memory(&cfg);
+    tuning_t svc = calc_tuning(&m, s->rings_per_service, s->total_ram);
+    tuning_t host = calc_tuning(&m, s->services * s->rings_per_service, s->total_ram);
+
+    print_ring_config(&cfg);
+    print_memory_breakdown(&m);
+
+    printf("\n");
+    print_separator();
+    printf("  SOLVED FLEET\n");
+    print_separator();
+    printf("  Locked per service       : %s (%u rings)\n",
+           human_bytes(svc.total_locked_mem, buf, sizeof(buf)), s->rings_per_service);
+    printf("  Host locked memory       : %s (%.2f%% of RAM)\n",
+           human_bytes(host.total_locked_mem, buf, sizeof(buf)), host.ram_usage_pct);
+    printf("  Memlock charged per uid  : %s (%s)\n",
+           human_bytes(s->separate_users ? svc.memlock_charged : host.memlock_charged,
+                       buf, sizeof(buf)),
+           s->separate_users ? "one service" : "every service");
+    printf("  VMAs per service         : %lu\n", (unsigned long)svc.map_count_needed);
+    if (host.nr_hugepages)
+        printf("  hugetlb pool (host)      : %lu pages\n", (unsigned long)host.nr_hugepages);
+
+    /* max_map_count and nproc are per process, so the blocks are sized for
+     * one service; memlock is charged per uid and the hugetlb pool is host-wide */
+    if (!s->separate_users) {
+        svc.memlock_charged = host.memlock_charged;
+        svc.memlock_limit = host.memlock_limit;
+    }
+    svc.nr_hugepages = host.nr_hugepages;
+    /* The floor at the kernel default must not push the limit past the ceiling */
+    if (s->memlock_max && svc.memlock_limit > s->memlock_max)
+        svc.memlock_limit = s->memlock_max;
+    print_tuning_blocks(&svc);
+    printf("\n");
+    return 0;
+}
+
+/* ── Audit mode ────────────────────────────────────────────────────── */
+
+/*
+ * Reads the live host and the running services, and diffs them against the
+ * model's projection for the declared per-service config (--rings, --sq,
+ * --reg-bufs, ...). io_uring charges pins to the user's locked_vm, shared by
+ * every process of that uid, so memlock is judged on the uid's summed VmPin:
+ * a service is flagged NEAR when its user already uses --warn-pct of the
+ * service's memlock limit (or the service its VMA limit), OVER when the user's
+ * pins with the projection in place do not fit, and DRIFT when the service's
+ * VmPin exceeds the projection by more than the memlock headroom (the model,
+ * or the config, is wrong). VmLck (mlock) is a separate mm counter and is not
+ * part of the io_uring charge.
+ */
+
+#define AUDIT_MAX_TARGETS 64
+#define AUDIT_UNLIMITED   UINT64_MAX
+
+typedef struct {
+    char     name[128];             /* unit name, or "pid <n>" */
+    int      pid;                   /* 0 if the unit is not running */
+    uint64_t unit_limit;            /* LimitMEMLOCK from systemd, 0 if n/a */
+    uint64_t proc_limit;            /* effective soft RLIMIT_MEMLOCK of the process */
+    uint64_t vm_pin, vm_lck;        /* bytes */
+    uint64_t vmas;
+    long     uid;                   /* real uid, -1 if unknown */
+    uint64_t user_pin;              /* VmPin summed over every process of uid */
+    uint64_t user_proj;             /* user_pin with the projection in place */
+    int      have_proc;
+    const char *status;
+} audit_target_t;
+
+/* "Key:   1234 kB" from a /proc status-style file, in bytes; 0 if absent */
+static uint64_t read_proc_kb(const char *path, const char *key)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    char line[256];
+    size_t klen = strlen(key);
+    uint64_t v = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (!strncmp(line, key, klen) && line[klen] == ':') {
+            v = strtoull(line + klen + 1, NULL, 10) * 1024;
+            break;
+        }
+    }
+    fclose(f);
+    return v;
+}
+
+/* Real uid from /proc/<pid>/status, -1 if unreadable */
+static long read_proc_uid(int pid)
+{
+    char path[64], line[256];
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    long uid = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (!strncmp(line, "Uid:", 4)) {
+            uid = strtol(line + 4, NULL, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return uid;
+}
+
+/* VmPin summed over every process of uid, i.e. what its locked_vm carries */
+static uint64_t uid_vmpin(long uid)
+{
+    DIR *d = opendir("/proc");
+    if (!d) return 0;
+    uint64_t sum = 0;
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        if (e->d_name[0] < '1' || e->d_name[0] > '9') continue;
+        int pid = atoi(e->d_name);
+        if (read_proc_uid(pid) != uid) continue;
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/status", pid);
+        sum += read_proc_kb(path, "VmPin");
+    }
+    closedir(d);
+    return sum;
+}
+
+static uint64_t read_u64_file(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    unsigned long long v = 0;
+    if (fscanf(f, "%llu", &v) != 1) v = 0;
+    fclose(f);
+    return v;
+}
+
+/* Soft "Max locked memory" from /proc/<pid>/limits */
+static uint64_t read_proc_memlock(int pid)
+{
+    char path[64], line[256];
+    snprintf(path, sizeof(path), "/proc/%d/limits", pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    uint64_t v = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "Max locked memory", 17)) continue;
+        char soft[32];
+        if (sscanf(line + 17, "%31s", soft) == 1)
+            v = !strcmp(soft, "unlimited") ? AUDIT_UNLIMITED : strtoull(soft, NULL, 10);
+        break;
+    }
+    fclose(f);
+    return v;
+}
+
+static uint64_t count_maps(int pid)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    uint64_t n = 0;
+    int c, prev = '\n';
+    while ((c = getc(f)) != EOF) {
+        if (c == '\n') n++;
+        prev = c;
+    }
+    if (prev != '\n') n++;
+    fclose(f);
+    return n;
+}
+
+/* MainPID and LimitMEMLOCK via systemctl show; 0 or -1 if unavailable */
+static int unit_show(const char *unit, int *pid, uint64_t *limit)
+{
+    /* Unit names are passed through the shell, so accept only their charset */
+    for (const char *c = unit; *c; c++)
+        if (!strchr("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789@._:-\\", *c))
+            return -1;
+
+    char cmd[256], line[256];
+    snprintf(cmd, sizeof(cmd), "systemctl show -p MainPID -p LimitMEMLOCK -- '%s' 2>/dev/null", unit);
+    FILE *p = popen(cmd, "r");
+    if (!p) return -1;
+    int got = 0;
+    while (fgets(line, sizeof(line), p)) {
+        line[strcspn(line, "\n")] = 0;
+        if (!strncmp(line, "MainPID=", 8)) {
+            *pid = atoi(line + 8);
+            got |= 1;
+        } else if (!strncmp(line, "LimitMEMLOCK=", 13)) {
+            *limit = !strcmp(line + 13, "infinity") ? AUDIT_UNLIMITED
+                                                     : strtoull(line + 13, NULL, 10);
+            got |= 2;
+        }
+    }
+    return pclose(p) == 0 && got == 3 ? 0 : -1;
+}
+
+static const char *limit_str(uint64_t v, char *buf, size_t bufsz)
+{
+    if (v == AUDIT_UNLIMITED) return "unlimited";
+    if (v == 0) return "?";
+    return human_bytes(v, buf, bufsz);
+}
+
+static double pct_of(uint64_t used, uint64_t limit)
+{
+    if (limit == 0 || limit == AUDIT_UNLIMITED) return 0.0;
+    return (double)used / (double)limit * 100.0;
+}
+
+/* --prom for the audit: the model per service next to what each one really holds */
+static int prom_audit(const ring_memory_t *m, const tuning_t *t, const audit_target_t *tg, int nt,
+                      uint64_t mem_total, uint64_t map_max)
+{
+    static const char *statuses[] = { "ok", "NEAR", "DRIFT", "OVER", "DOWN" };
+    char esc[256], l[AUDIT_MAX_TARGETS][300], sl[320];
+    const char *none[1] = { "" };
+    const tuning_t *tp[1] = { t };
+    const ring_memory_t *mp[1] = { m };
+
+    prom_t p;
+    if (prom_open(&p) != 0) return -1;
+    if (!p.f) return 0;
+
+    prom_rings(p.f, none, mp, 1);
+    prom_tuning(p.f, "service_model", "one service of the declared config", none, tp, 1);
+    prom_family(p.f, "host_mem_total_bytes", "MemTotal of the audited host");
+    prom_sample(p.f, "host_mem_total_bytes", "", (double)mem_total);
+    prom_family(p.f, "host_max_map_count_live", "Live vm.max_map_count");
+    prom_sample(p.f, "host_max_map_count_live", "", (double)map_max);
+
+    for (int i = 0; i < nt; i++)
+        snprintf(l[i], sizeof(l[i]), "service=\"%s\"", prom_escape(tg[i].name, esc, sizeof(esc)));
+
+    prom_family(p.f, "service_up", "1 when the service's process could be read");
+    for (int i = 0; i < nt; i++) prom_sample(p.f, "service_up", l[i], tg[i].have_proc);
+    prom_family(p.f, "service_status", "Audit verdict, one series per status");
+    for (int i = 0; i < nt; i++)
+        for (int k = 0; k < 5; k++) {
+            snprintf(sl, sizeof(sl), "%.300s,status=\"%s\"", l[i], statuses[k]);
+            prom_sample(p.f, "service_status", sl, tg[i].status && !strcmp(tg[i].status, statuses[k]));
+        }
+    prom_family(p.f, "service_vmpin_predicted_bytes", "VmPin the model projects for the service");
+    for (int i = 0; i < nt; i++)
+        prom_sample(p.f, "service_vmpin_predicted_bytes", l[i], (double)t->memlock_charged);
+    prom_family(p.f, "service_vmas_predicted", "VMAs the model projects for the service");
+    for (int i = 0; i < nt; i++)
+        prom_sample(p.f, "service_vmas_predicted", l[i], (double)t->map_count_needed);
+
+    /* Live values only for services that are up */
+    prom_family(p.f, "service_vmpin_bytes", "VmPin of the running process");
+    for (int i = 0; i < nt; i++)
+        if (tg[i].have_proc) prom_sample(p.f, "service_vmpin_bytes", l[i], (double)tg[i].vm_pin);
+    prom_family(p.f, "service_vmlck_bytes", "VmLck of the running process");
+    for (int i = 0; i < nt; i++)
+        if (tg[i].have_proc) prom_sample(p.f, "service_vmlck_bytes", l[i], (double)tg[i].vm_lck);
+    prom_family(p.f, "service_vmas", "Mappings of the running process");
+    for (int i = 0; i < nt; i++)
+        if (tg[i].have_proc) prom_sample(p.f, "service_vmas", l[i], (double)tg[i].vmas);
+    prom_family(p.f, "service_user_vmpin_bytes", "VmPin summed over every process of the service's uid");
+    for (int i = 0; i < nt; i++)
+        if (tg[i].have_proc && tg[i].uid >= 0)
+            prom_sample(p.f, "service_user_vmpin_bytes", l[i], (double)tg[i].user_pin);
+    prom_family(p.f, "service_user_vmpin_projected_bytes",
+                "User VmPin with the projection in place for its audited services");
+    for (int i = 0; i < nt; i++)
+        if (tg[i].have_proc && tg[i].uid >= 0)
+            prom_sample(p.f, "service_user_vmpin_projected_bytes", l[i], (double)tg[i].user_proj);
+    prom_family(p.f, "service_memlock_limit_bytes", "Soft RLIMIT_MEMLOCK of the running process");
+    for (int i = 0; i < nt; i++)
+        if (tg[i].have_proc && tg[i].proc_limit)
+            prom_sample(p.f, "service_memlock_limit_bytes", l[i],
+                        tg[i].proc_limit == AUDIT_UNLIMITED ? INFINITY : (double)tg[i].proc_limit);
+    return prom_close(&p);
+}
+
+/* Returns 0 when nothing is flagged, 2 otherwise */
+static int audit_mode(const ring_config_t *cfg, uint32_t rings_per_service, uint64_t declared_ram,
+                      const char **units, int nunits, const int *pids, int npids,
+                      double warn_pct)
+{
+    char buf[64], buf2[64], buf3[64];
+    int flagged = 0;
+
+    uint64_t mem_total = read_proc_kb("/proc/meminfo", "MemTotal");
+    uint64_t map_max   = read_u64_file("/proc/sys/vm/max_map_count");
+    struct rlimit rl;
+    uint64_t shell_memlock = 0;
+    if (getrlimit(RLIMIT_MEMLOCK, &rl) == 0)
+        shell_memlock = rl.rlim_cur == RLIM_INFINITY ? AUDIT_UNLIMITED : (uint64_t)rl.rlim_cur;
+
+    ring_memory_t m = calc_ring_memory(cfg);
+    tuning_t t = calc_tuning(&m, rings_per_service, mem_total ? mem_total : declared_ram);
+
+    printf("\n");
+    print_separator();
+    printf("  AUDIT: live host vs model (%u ring%s per service)\n",
+           rings_per_service, rings_per_service == 1 ? "" : "s");
+    print_separator();
+    printf("  MemTotal                 : %s\n", mem_total ? human_bytes(mem_total, buf, sizeof(buf)) : "?");
+    if (declared_ram && mem_total &&
+        (declared_ram > mem_total * 1.05 || declared_ram < mem_total * 0.95))
+        printf("    --ram %s differs from this host; the audit uses MemTotal\n",
+               human_bytes(declared_ram, buf, sizeof(buf)));
+    printf("  Accounting               : %s profile (%s)\n", acct_profile()->name, profile_source);
+    printf("  Projected per service    : %s memlock, %lu VMAs\n",
+           human_bytes(t.memlock_charged, buf, sizeof(buf)), (unsigned long)t.map_count_needed);
+
+    int shell_low = shell_memlock != AUDIT_UNLIMITED && t.memlock_charged > shell_memlock;
+    printf("  RLIMIT_MEMLOCK (self)    : %-12s %s\n", limit_str(shell_memlock, buf, sizeof(buf)),
+           shell_low ? "LOW  -- new processes from this login cannot fit the config" : "ok");
+    int maps_low = map_max && t.map_count_needed > map_max;
+    printf("  vm.max_map_count         : %-12lu %s\n", (unsigned long)map_max,
+           !map_max ? "?" : maps_low ? "LOW  -- raise to the recommendation below" : "ok");
+    flagged |= shell_low | maps_low;
+
+    audit_target_t tg[AUDIT_MAX_TARGETS];
+    int nt = 0;
+    for (int i = 0; i < nunits && nt < AUDIT_MAX_TARGETS; i++) {
+        audit_target_t *a = &tg[nt++];
+        memset(a, 0, sizeof(*a));
+        snprintf(a->name, sizeof(a->name), "%s", units[i]);
+        if (unit_show(units[i], &a->pid, &a->unit_limit) != 0) {
+            a->pid = 0;
+            a->unit_limit = 0;
+        }
+    }
+    for (int i = 0; i < npids && nt < AUDIT_MAX_TARGETS; i++) {
+        audit_target_t *a = &tg[nt++];
+        memset(a, 0, sizeof(*a));
+        snprintf(a->name, sizeof(a->name), "pid %d", pids[i]);
+        a->pid = pids[i];
+    }
+
+    if (nt == 0) {
+        printf("\n  No --unit or --pid given; host checks only.\n");
+    } else {
+        printf("\n  %-24s  %-7s  %-6s  %-10s  %-10s  %-10s  %-6s  %-6s  %-6s  %s\n",
+               "Service", "PID", "UID", "Memlock", "VmPin", "User pin", "VMAs", "Pin%", "Maps%",
+               "Status");
+        printf("  %-24s  %-7s  %-6s  %-10s  %-10s  %-10s  %-6s  %-6s  %-6s  %s\n",
+               "------------------------", "-------", "------", "----------", "----------",
+               "----------", "------", "------", "------", "------");
+    }
+
+    for (int i = 0; i < nt; i++) {
+        audit_target_t *a = &tg[i];
+        a->uid = -1;
+        if (a->pid > 0) {
+            char path[64];
+            snprintf(path, sizeof(path), "/proc/%d/status", a->pid);
+            a->vm_pin     = read_proc_kb(path, "VmPin");
+            a->vm_lck     = read_proc_kb(path, "VmLck");
+            a->vmas       = count_maps(a->pid);
+            a->proc_limit = read_proc_memlock(a->pid);
+            a->uid        = read_proc_uid(a->pid);
+            a->have_proc  = a->proc_limit != 0 || a->vmas != 0;
+        }
+    }
+
+    /*
+     * The charge is per user: sum VmPin over all of the uid's processes, then
+     * raise each audited service of that uid to at least its projection
+     */
+    for (int i = 0; i < nt; i++) {
+        audit_target_t *a = &tg[i];
+        if (!a->have_proc || a->uid < 0) continue;
+        int seen = -1;
+        for (int j = 0; j < i && seen < 0; j++)
+            if (tg[j].have_proc && tg[j].uid == a->uid) seen = j;
+        if (seen >= 0) {
+            a->user_pin  = tg[seen].user_pin;
+            a->user_proj = tg[seen].user_proj;
+            continue;
+        }
+        a->user_pin = a->user_proj = uid_vmpin(a->uid);
+        for (int j = i; j < nt; j++)
+            if (tg[j].have_proc && tg[j].uid == a->uid && tg[j].vm_pin < t.memlock_charged)
+                a->user_proj += t.memlock_charged - tg[j].vm_pin;
+    }
+
+    for (int i = 0; i < nt; i++) {
+        audit_target_t *a = &tg[i];
+        if (!a->have_proc) {
+            a->status = "DOWN";
+            printf("  %-24.24s  %-7s  %-6s  %-10s  %-10s  %-10s  %-6s  %-6s  %-6s  %s\n",
+                   a->name, "-", "-", limit_str(a->unit_limit, buf, sizeof(buf)), "-", "-", "-",
+                   "-", "-", "DOWN");
+            flagged = 1;
+            continue;
+        }
+        if (a->uid < 0) a->user_pin = a->user_proj = a->vm_pin > t.memlock_charged
+                                                   ? a->vm_pin : t.memlock_charged;
+
+        double   pin_p = pct_of(a->user_pin, a->proc_limit);
+        double   map_p = map_max ? (double)a->vmas / (double)map_max * 100.0 : 0.0;
+        const char *status = "ok";
+        if (a->proc_limit != AUDIT_UNLIMITED && a->user_proj > a->proc_limit)
+            status = "OVER";
+        else if (map_max && t.map_count_needed > map_max)
+            status = "OVER";
+        else if (pin_p >= warn_pct || map_p >= warn_pct)
+            status = "NEAR";
+        else if ((double)a->vm_pin > (double)t.memlock_charged * MEMLOCK_HEADROOM)
+            status = "DRIFT";
+        if (strcmp(status, "ok")) flagged = 1;
+        a->status = status;
+
+        char pid_s[16], uid_s[16];
+        snprintf(pid_s, sizeof(pid_s), "%d", a->pid);
+        snprintf(uid_s, sizeof(uid_s), a->uid >= 0 ? "%ld" : "?", a->uid);
+        printf("  %-24.24s  %-7s  %-6s  %-10s  %-10s  %-10s  %-6lu  %5.1f%%  %5.1f%%  %s\n",
+               a->name, pid_s, uid_s, limit_str(a->proc_limit, buf, sizeof(buf)),
+               human_bytes(a->vm_pin, buf2, sizeof(buf2)),
+               human_bytes(a->user_pin, buf3, sizeof(buf3)),
+               (unsigned long)a->vmas, pin_p, map_p, status);
+        if (a->unit_limit && a->unit_limit != a->proc_limit)
+            printf("  %-24s  unit LimitMEMLOCK=%s differs from the running process: restart pending\n",
+                   "", limit_str(a->unit_limit, buf, sizeof(buf)));
+    }
+
+    if (nt > 0) {
+        printf("\n  Projected VmPin per service: %s (model), statuses:\n",
+               human_bytes(t.memlock_charged, buf, sizeof(buf)));
+        printf("  User pin is VmPin summed over every process of the UID; memlock is per user.\n");
+        printf("    OVER  the user's pins with the declared config do not fit the service's limits\n");
+        printf("    NEAR  the user already pins >= %.0f%% of memlock, or the service uses that\n"
+               "          much of max_map_count\n", warn_pct);
+        printf("    DRIFT VmPin above the projection x %.1f: model or config is off\n", MEMLOCK_HEADROOM);
+        printf("    DOWN  unit not running or /proc not readable\n");
+    }
+
+    if (flagged) print_tuning_blocks(&t);
+    printf("\n");
+    if (prom_audit(&m, &t, tg, nt, mem_total, map_max) != 0) return 1;
+    return flagged ? 2 : 0;
+}
+
+/* ── Fleet manifest ────────────────────────────────────────────────── */
+
+/*
+ * A manifest lists the services of a host, as CSV with a header row
+ *
+ *   name,user,replicas,rings,sq,cq,bufs,files,cqe32,sqe128,hugepages
+ *   api,www,4,64,1024,0,1M,0,0,0,
+ *
+ * (columns in any order, only name and rings required) or as INI:
+ *
+ *   [api]
+ *   user = www
+ *   replicas = 4
+ *   rings = 64
+ *
+ * Every replica is one process. The manifest is evaluated as one host, then
+ * replicas are packed first-fit decreasing onto instances of --instance
+ * shape (RAM x NUMA nodes), each replica kept inside one node. io_uring
+ * charges memlock per user, so a service's LimitMEMLOCK covers every replica
+ * of every service running as the same user on the busiest instance it is
+ * packed onto.
+ */
+
+#define FLEET_MAX_SERVICES 256
+#define FLEET_MAX_REPLICAS 4096
+
+typedef struct {
+    char          name[64];
+    char          user[32];
+    uint32_t      replicas;
+    uint32_t      rings;            /* per replica */
+    ring_config_t cfg;
+    ring_memory_t m;
+    tuning_t      t;                /* one replica */
+    uint64_t      user_memlock;     /* charged to the service's user, one instance */
+} fleet_svc_t;
+
+typedef struct {
+    fleet_svc_t svc[FLEET_MAX_SERVICES];
+    int         n;
+} fleet_t;
+
+static char *trim(char *s)
+{
+    while (*s == ' ' || *s == '\t') s++;
+    char *e = s + strlen(s);
+    while (e > s && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r' || e[-1] == '\n')) *--e = '\0';
+    return s;
+}
+
+static const char *const fleet_keys[] = {
+    "name", "user", "replicas", "rings", "sq", "cq", "bufs", "files", "cqe32", "sqe128",
+    "hugepages", NULL
+};
+
+static int fleet_key_known(const char *key)
+{
+    for (int i = 0; fleet_keys[i]; i++)
+        if (!strcmp(key, fleet_keys[i])) return 1;
+    return 0;
+}
+
+/* Unsigned decimal count; an empty value keeps the default */
+static int fleet_count(const char *val, uint32_t *out)
+{
+    if (!*val) return 0;
+    if (!isdigit((unsigned char)*val)) return -1;
+    char *end;
+    errno = 0;
+    unsigned long v = strtoul(val, &end, 10);
+    if (*end || errno || v > UINT32_MAX) return -1;
+    *out = (uint32_t)v;
+    return 0;
+}
+
+/* Size with an optional K/M/G/T suffix; an empty value means none */
+static int fleet_size(const char *val, uint64_t *out)
+{
+    if (!*val) { *out = 0; return 0; }
+    if (!isdigit((unsigned char)*val)) return -1;
+    char *end;
+    strtod(val, &end);
+    if (*end && (end[1] || !strchr("KkMmGgTt", *end))) return -1;
+    *out = parse_ram(val);
+    return 0;
+}
+
+/* One "key = value" into a service; 0, -1 for an unknown key, -2 for a bad value */
+static int fleet_set(fleet_svc_t *s, const char *key, const char *val)
+{
+    int bad = 0;
+    if      (!strcmp(key, "name"))      snprintf(s->name, sizeof(s->name), "%s", val);
+    else if (!strcmp(key, "user"))      snprintf(s->user, sizeof(s->user), "%s", val);
+    else if (!strcmp(key, "replicas"))  bad = fleet_count(val, &s->replicas);
+    else if (!strcmp(key, "rings"))     bad = fleet_count(val, &s->rings);
+    else if (!strcmp(key, "sq"))        bad = fleet_count(val, &s->cfg.sq_entries);
+    else if (!strcmp(key, "cq"))        bad = fleet_count(val, &s->cfg.cq_entries);
+    else if (!strcmp(key, "bufs"))      bad = fleet_size(val, &s->cfg.registered_bufs);
+    else if (!strcmp(key, "files"))     bad = fleet_count(val, &s->cfg.registered_files);
+    else if (!strcmp(key, "cqe32"))     s->cfg.cqe32 = atoi(val) != 0 || *val == 'y';
+    else if (!strcmp(key, "sqe128"))    s->cfg.sqe128 = atoi(val) != 0 || *val == 'y';
+    else if (!strcmp(key, "hugepages")) bad = fleet_size(val, &s->cfg.buf_page_size);
+    else return -1;
+    return bad ? -2 : 0;
+}
+
+static void fleet_svc_init(fleet_svc_t *s)
+{
+    memset(s, 0, sizeof(*s));
+    s->replicas = 1;
+    s->cfg.sq_entries = 128;
+}
+
+static int fleet_load(const char *path, fleet_t *f)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: cannot open manifest %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    char line[1024], cols[16][32];
+    int ncols = 0, ini = -1, lineno = 0, rc = 0;
+    fleet_svc_t *cur = NULL;
+    f->n = 0;
+
+    while (fgets(line, sizeof(line), fp) && rc == 0) {
+        lineno++;
+        char *l = trim(line);
+        if (!*l || *l == '#' || *l == ';') continue;
+        if (ini < 0) ini = *l == '[';
+
+        if (ini) {
+            if (*l == '[') {
+                char *end = strchr(l, ']');
+                if (!end || f->n == FLEET_MAX_SERVICES) { rc = -1; break; }
+                *end = '\0';
+                cur = &f->svc[f->n++];
+                fleet_svc_init(cur);
+                snprintf(cur->name, sizeof(cur->name), "%s", trim(l + 1));
+                continue;
+            }
+            char *eq = strchr(l, '=');
+            if (!cur || !eq) { rc = -1; break; }
+            *eq = '\0';
+            char *key = trim(l), *val = trim(eq + 1);
+            int set = fleet_set(cur, key, val);
+            if (set == -1) {
+                fprintf(stderr, "Error: %s:%d: unknown key '%s'\n", path, lineno, key);
+                rc = -2;
+            } else if (set == -2) {
+                fprintf(stderr, "Error: %s:%d: bad %s '%s'\n", path, lineno, key, val);
+                rc = -2;
+            }
+            continue;
+        }
+
+        /* CSV: the first row names the columns; strtok_r would merge empty
+         * fields, so split by hand */
+        char *fields[16];
+        int nf = 0;
+        for (char *p = l; p; nf++) {
+            char *comma = strchr(p, ',');
+            if (comma) *comma = '\0';
+            if (nf < 16) fields[nf] = trim(p);
+            p = comma ? comma + 1 : NULL;
+        }
+        if (ncols == 0) {
+            if (nf > 16) {
+                fprintf(stderr, "Error: %s:%d: more than 16 columns\n", path, lineno);
+                rc = -2;
+                break;
+            }
+            for (ncols = 0; ncols < nf; ncols++) {
+                if (!fleet_key_known(fields[ncols])) {
+                    fprintf(stderr, "Error: %s:%d: unknown column '%s'\n", path, lineno,
+                            fields[ncols]);
+                    rc = -2;
+                    break;
+                }
+                snprintf(cols[ncols], sizeof(cols[0]), "%s", fields[ncols]);
+            }
+            continue;
+        }
+        if (nf != ncols) {
+            fprintf(stderr, "Error: %s:%d: %d field%s, the header has %d\n", path, lineno, nf,
+                    nf == 1 ? "" : "s", ncols);
+            rc = -2;
+            break;
+        }
+        if (f->n == FLEET_MAX_SERVICES) { rc = -1; break; }
+        cur = &f->svc[f->n++];
+        fleet_svc_init(cur);
+        for (int c = 0; c < ncols; c++)
+            if (fleet_set(cur, cols[c], fields[c]) != 0) {
+                fprintf(stderr, "Error: %s:%d: bad %s '%s'\n", path, lineno, cols[c], fields[c]);
+                rc = -2;
+            }
+    }
+    fclose(fp);
+
+    if (rc == -2) return -1;
+    if (rc != 0) {
+        fprintf(stderr, "Error: %s:%d: malformed manifest line (or more than %d services)\n",
+                path, lineno, FLEET_MAX_SERVICES);
+        return -1;
+    }
+    for (int i = 0; i < f->n; i++) {
+        fleet_svc_t *s = &f->svc[i];
+        if (!s->name[0] || s->rings == 0 || s->replicas == 0) {
+            fprintf(stderr, "Error: %s: service %d needs a name, rings > 0 and replicas > 0\n",
+                    path, i + 1);
+            return -1;
+        }
+        for (const char *c = s->name; *c; c++)
+            if (!strchr("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789@._-", *c)) {
+                fprintf(stderr, "Error: %s: '%s' is not a valid unit name\n", path, s->name);
+                return -1;
+            }
+        uint64_t hp = s->cfg.buf_page_size;
+        if (hp && (hp <= PAGE_SIZE || (hp & (hp - 1)))) {
+            fprintf(stderr, "Error: %s: %s: hugepages must be a power of two above %d\n",
+                    path, s->name, PAGE_SIZE);
+            return -1;
+        }
+        if (!s->user[0]) snprintf(s->user, sizeof(s->user), "%s", s->name);
+    }
+    if (f->n == 0) {
+        fprintf(stderr, "Error: %s lists no services\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    int      svc;
+    uint64_t cost;                  /* footprint of one replica */
+} fleet_rep_t;
+
+static int cmp_rep_cost(const void *a, const void *b)
+{
+    const fleet_rep_t *x = a, *y = b;
+    return (x->cost < y->cost) - (x->cost > y->cost);
+}
+
+static int write_dropin(const char *dir, const fleet_svc_t *s, FILE *out)
+{
+    char path[512];
+    FILE *f = out;
+    if (dir) {
+        snprintf(path, sizeof(path), "%s/%s.service.d", dir, s->name);
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+            fprintf(stderr, "Error: mkdir %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+        snprintf(path, sizeof(path), "%s/%s.service.d/io_uring.conf", dir, s->name);
+        if (!(f = fopen(path, "w"))) {
+            fprintf(stderr, "Error: cannot write %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+    } else {
+        fprintf(f, "\n  # /etc/systemd/system/%s.service.d/io_uring.conf\n", s->name);
+    }
+
+    const char *ind = dir ? "" : "  ";
+    char buf[64], buf2[64];
+    uint64_t limit = page_align((uint64_t)((double)s->user_memlock * MEMLOCK_HEADROOM));
+    if (limit < acct_profile()->default_memlock) limit = acct_profile()->default_memlock;
+    fprintf(f, "%s# io_uring_sim: %u rings x SQ %u, %s buffers per ring; user %s locks %s\n",
+            ind, s->rings, s->m.sq_actual, human_bytes(s->m.reg_buf_bytes, buf, sizeof(buf)),
+            s->user, human_bytes(s->user_memlock, buf2, sizeof(buf2)));
+    fprintf(f, "%s[Service]\n", ind);
+    fprintf(f, "%sLimitMEMLOCK=%lu\n", ind, (unsigned long)limit);
+    if (s->t.threads > 4096)
+        fprintf(f, "%sLimitNPROC=%lu\n", ind, (unsigned long)s->t.nproc_limit);
+    if (s->t.memcg_charged)
+        fprintf(f, "%s# rings are charged to the cgroup: MemoryMax > %s\n", ind,
+                human_bytes(s->t.memcg_charged + s->t.memlock_charged, buf, sizeof(buf)));
+
+    if (dir) {
+        if (fclose(f) != 0) return -1;
+        printf("  wrote %s\n", path);
+    }
+    return 0;
+}
+
+static int fleet_mode(const char *path, uint64_t host_ram, uint64_t inst_ram, int inst_nodes,
+                      double budget_pct, const char *dropin_dir)
+{
+    static fleet_t fleet;
+    if (fleet_load(path, &fleet) != 0) return 1;
+
+    char buf[64], buf2[64], buf3[64];
+    uint32_t total_reps = 0;
+
+    /* Per replica, then per user */
+    for (int i = 0; i < fleet.n; i++) {
+        fleet_svc_t *s = &fleet.svc[i];
+        if (s->cfg.cq_entries == 0) s->cfg.cq_entries = s->cfg.sq_entries * DEFAULT_CQ_FACTOR;
+        s->m = calc_ring_memory(&s->cfg);
+        s->t = calc_tuning(&s->m, s->rings, host_ram);
+        total_reps += s->replicas;
+    }
+
+    printf("\n");
+    print_separator();
+    printf("  FLEET: %s (%d service%s, %u replica%s)\n", path, fleet.n, fleet.n == 1 ? "" : "s",
+           total_reps, total_reps == 1 ? "" : "s");
+    print_separator();
+    printf("  %-16s  %-10s  %-4s  %-6s  %-6s  %-10s  %-11s  %-11s  %-7s  %-6s\n",
+           "Service", "User", "Reps", "Rings", "SQ", "Bufs/ring", "Locked/rep", "Kernel/rep",
+           "Threads", "VMAs");
+    printf("  %-16s  %-10s  %-4s  %-6s  %-6s  %-10s  %-11s  %-11s  %-7s  %-6s\n",
+           "----------------", "----------", "----", "------", "------", "----------",
+           "-----------", "-----------", "-------", "------");
+
+    uint64_t locked = 0, kernel = 0, threads = 0, vmas_max = 0;
+    struct { uint64_t size, pages; } huge[8];     /* hugetlb pages per page size */
+    int nhuge = 0;
+    for (int i = 0; i < fleet.n; i++) {
+        fleet_svc_t *s = &fleet.svc[i];
+        printf("  %-16.16s  %-10.10s  %-4u  %-6u  %-6u  %-10s  %-11s  %-11s  %-7lu  %-6lu\n",
+               s->name, s->user, s->replicas, s->rings, s->m.sq_actual,
+               s->m.reg_buf_bytes ? human_bytes(s->m.reg_buf_bytes, buf, sizeof(buf)) : "-",
+               human_bytes(s->t.total_locked_mem, buf2, sizeof(buf2)),
+               human_bytes(s->t.kernel_mem, buf3, sizeof(buf3)),
+               (unsigned long)s->t.threads, (unsigned long)s->t.map_count_needed);
+        locked  += s->t.total_locked_mem * s->replicas;
+        kernel  += s->t.kernel_mem * s->replicas;
+        threads += s->t.threads * s->replicas;
+        if (s->t.map_count_needed > vmas_max) vmas_max = s->t.map_count_needed;
+        if (s->t.nr_hugepages) {
+            int h = 0;
+            while (h < nhuge && huge[h].size != s->t.huge_page_size) h++;
+            if (h == (int)(sizeof(huge) / sizeof(huge[0]))) {
+                fprintf(stderr, "Warning: more than %d huge page sizes; %s not reserved\n",
+                        h, s->name);
+                continue;
+            }
+            if (h == nhuge) {
+                huge[h].size = s->t.huge_page_size;
+                huge[h].pages = 0;
+                nhuge++;
+            }
+            huge[h].pages += s->t.nr_hugepages * s->replicas;
+        }
+    }
+
+    /* ── The manifest as one host ── */
+    double pct = (double)(locked + kernel) / (double)host_ram * 100.0;
+    printf("\n  Host (%s): %s locked + %s kernel = %.1f%% of RAM, %lu threads\n",
+           human_bytes(host_ram, buf, sizeof(buf)), human_bytes(locked, buf2, sizeof(buf2)),
+           human_bytes(kernel, buf3, sizeof(buf3)), pct, (unsigned long)threads);
+    if (pct > budget_pct)
+        printf("  WARNING: the manifest does not fit one host within the %.0f%% budget\n", budget_pct);
+
+    /* Host-wide tuning: max_map_count is per process, the pools and PIDs are shared */
+    tuning_t host = {0};
+    host.max_map_count = vmas_max < 65530 ? 65530 : vmas_max;
+    host.threads = threads;
+    host.nproc_limit = (uint64_t)((double)threads * MEMLOCK_HEADROOM) + 1024;
+    printf("\n  +-- /etc/sysctl.conf -------------------------------------+\n");
+    printf("  |  vm.max_map_count = %-10lu                          |\n",
+           (unsigned long)host.max_map_count);
+    for (int h = 0; h < nhuge; h++)
+        if (huge[h].size == 2ULL << 20)
+            printf("  |  vm.nr_hugepages = %-10lu                           |\n",
+                   (unsigned long)huge[h].pages);
+    host.pid_infeasible = threads > PID_MAX_LIMIT;
+    if (host.pid_infeasible)
+        printf("  |  kernel.pid_max: INFEASIBLE, %lu threads > %d         \n",
+               (unsigned long)host.threads, PID_MAX_LIMIT);
+    else if (host.threads > DEFAULT_PID_MAX)
+        printf("  |  kernel.pid_max = %-10lu                            |\n",
+               (unsigned long)(host.nproc_limit > PID_MAX_LIMIT ? PID_MAX_LIMIT
+                               : rm_roundup_pow2((uint32_t)host.nproc_limit)));
+    printf("  +---------------------------------------------------------+\n");
+    /* vm.nr_hugepages only sizes the default (2M) pool; other sizes boot-time */
+    int cmdline = 0;
+    for (int h = 0; h < nhuge; h++) {
+        if (huge[h].size == 2ULL << 20) continue;
+        printf("%s hugepagesz=%s hugepages=%lu", cmdline++ ? "" : "  kernel command line:",
+               size_suffix(huge[h].size, buf, sizeof(buf)), (unsigned long)huge[h].pages);
+    }
+    if (cmdline) printf("\n");
+
+    /* ── Bin-packing ── */
+    uint64_t node_cap = (uint64_t)((double)inst_ram / inst_nodes * budget_pct / 100.0);
+    static fleet_rep_t reps[FLEET_MAX_REPLICAS];
+    int nreps = 0;
+    for (int i = 0; i < fleet.n; i++)
+        for (uint32_t r = 0; r < fleet.svc[i].replicas && nreps < FLEET_MAX_REPLICAS; r++)
+            reps[nreps++] = (fleet_rep_t){ i, fleet.svc[i].t.footprint };
+    if ((uint32_t)nreps < total_reps)
+        fprintf(stderr, "Warning: packing only the first %d replicas\n", FLEET_MAX_REPLICAS);
+    qsort(reps, (size_t)nreps, sizeof(reps[0]), cmp_rep_cost);
+
+    /* used[node] per instance; nodes of instance k are k*inst_nodes .. */
+    uint64_t *used = calloc((size_t)nreps * inst_nodes + 1, sizeof(*used));
+    int      *where = calloc((size_t)nreps + 1, sizeof(*where));
+    if (!used || !where) {
+        fprintf(stderr, "Error: out of memory\n");
+        free(used); free(where);
+        return 1;
+    }
+    int ninst = 0, unplaced = 0;
+    for (int r = 0; r < nreps; r++) {
+        where[r] = -1;
+        if (reps[r].cost > node_cap) { unplaced++; continue; }
+        int n;
+        for (n = 0; n < ninst * inst_nodes; n++)
+            if (used[n] + reps[r].cost <= node_cap) break;
+        if (n == ninst * inst_nodes) ninst++;
+        used[n] += reps[r].cost;
+        where[r] = n;
+    }
+
+    /* Memlock per user on each instance; a service's limit covers the busiest
+     * instance it lands on, an unplaced replica runs alone */
+    int *cnt = calloc((size_t)(ninst ? ninst : 1) * fleet.n, sizeof(*cnt));
+    if (!cnt) {
+        fprintf(stderr, "Error: out of memory\n");
+        free(used); free(where);
+        return 1;
+    }
+    for (int r = 0; r < nreps; r++)
+        if (where[r] >= 0) cnt[where[r] / inst_nodes * fleet.n + reps[r].svc]++;
+    for (int i = 0; i < fleet.n; i++) {
+        fleet_svc_t *s = &fleet.svc[i];
+        s->user_memlock = s->t.memlock_charged;
+        for (int k = 0; k < ninst; k++) {
+            if (!cnt[k * fleet.n + i]) continue;
+            uint64_t sum = 0;
+            for (int j = 0; j < fleet.n; j++)
+                if (!strcmp(s->user, fleet.svc[j].user))
+                    sum += fleet.svc[j].t.memlock_charged * (uint64_t)cnt[k * fleet.n + j];
+            if (sum > s->user_memlock) s->user_memlock = sum;
+        }
+    }
+    free(cnt);
+
+    printf("\n");
+    print_separator();
+    printf("  PACKING onto %s x %d NUMA node%s (%.0f%% budget = %s per node)\n",
+           human_bytes(inst_ram, buf, sizeof(buf)), inst_nodes, inst_nodes == 1 ? "" : "s",
+           budget_pct, human_bytes(node_cap, buf2, sizeof(buf2)));
+    print_separator();
+    for (int n = 0; n < ninst * inst_nodes; n++) {
+        if (n % inst_nodes == 0) printf("  instance %d\n", n / inst_nodes + 1);
+        printf("    node %d  %-11s %5.1f%% ", n % inst_nodes, human_bytes(used[n], buf, sizeof(buf)),
+               node_cap ? (double)used[n] / (double)node_cap * 100.0 : 0.0);
+        /* Replicas per service on this node */
+        for (int i = 0; i < fleet.n; i++) {
+            int on_node = 0;
+            for (int r = 0; r < nreps; r++)
+                if (where[r] == n && reps[r].svc == i) on_node++;
+            if (on_node) printf(" %s x%d", fleet.svc[i].name, on_node);
+        }
+        printf("\n");
+    }
+    printf("\n  Instances needed         : %d\n", ninst);
+    if (unplaced) {
+        printf("  WARNING: %d replica%s larger than one node's budget:", unplaced,
+               unplaced == 1 ? " is" : "s are");
+        for (int i = 0; i < fleet.n; i++)
+            if (fleet.svc[i].t.footprint > node_cap) printf(" %s", fleet.svc[i].name);
+        printf("\n");
+    }
+    free(used);
+    free(where);
+
+    /* ── Drop-ins ── */
+    printf("\n");
+    print_separator();
+    printf("  SYSTEMD DROP-INS%s%s\n", dropin_dir ? " -> " : "", dropin_dir ? dropin_dir : "");
+    print_separator();
+    int rc = 0;
+    for (int i = 0; i < fleet.n; i++)
+        if (write_dropin(dropin_dir, &fleet.svc[i], stdout) != 0) rc = 1;
+    printf("\n");
+
+    prom_t p;
+    if (prom_open(&p) != 0) return 1;
+    if (p.f) {
+        static char labels[FLEET_MAX_SERVICES][200];
+        const char *lp[FLEET_MAX_SERVICES];
+        const tuning_t *tp[FLEET_MAX_SERVICES];
+        const ring_memory_t *mp[FLEET_MAX_SERVICES];
+        char e1[128], e2[64];
+        for (int i = 0; i < fleet.n; i++) {
+            snprintf(labels[i], sizeof(labels[i]), "service=\"%s\",user=\"%s\"",
+                     prom_escape(fleet.svc[i].name, e1, sizeof(e1)),
+                     prom_escape(fleet.svc[i].user, e2, sizeof(e2)));
+            lp[i] = labels[i];
+            tp[i] = &fleet.svc[i].t;
+            mp[i] = &fleet.svc[i].m;
+        }
+        prom_rings(p.f, lp, mp, fleet.n);
+        prom_tuning(p.f, "fleet_service", "one replica", lp, tp, fleet.n);
+        prom_family(p.f, "fleet_service_replicas", "Replicas of the service in the manifest");
+        for (int i = 0; i < fleet.n; i++)
+            prom_sample(p.f, "fleet_service_replicas", lp[i], fleet.svc[i].replicas);
+        prom_family(p.f, "fleet_service_user_memlock_bytes",
+                    "Memlock charged to the service's user on its busiest instance");
+        for (int i = 0; i < fleet.n; i++)
+            prom_sample(p.f, "fleet_service_user_memlock_bytes", lp[i],
+                        (double)fleet.svc[i].user_memlock);
+
+        prom_family(p.f, "fleet_host_locked_bytes", "Locked memory of the whole manifest");
+        prom_sample(p.f, "fleet_host_locked_bytes", "", (double)locked);
+        prom_family(p.f, "fleet_host_kernel_bytes", "Kernel memory of the whole manifest");
+        prom_sample(p.f, "fleet_host_kernel_bytes", "", (double)kernel);
+        prom_family(p.f, "fleet_host_threads", "Tasks plus kernel threads of the whole manifest");
+        prom_sample(p.f, "fleet_host_threads", "", (double)threads);
+        prom_family(p.f, "fleet_host_hugepages", "hugetlb pages of the whole manifest by page size");
+        for (int h = 0; h < nhuge; h++) {
+            char l[64];
+            snprintf(l, sizeof(l), "page_size=\"%s\"", size_suffix(huge[h].size, buf, sizeof(buf)));
+            prom_sample(p.f, "fleet_host_hugepages", l, (double)huge[h].pages);
+        }
+        prom_family(p.f, "fleet_host_ram_bytes", "Physical RAM of the host (--ram)");
+        prom_sample(p.f, "fleet_host_ram_bytes", "", (double)host_ram);
+        prom_family(p.f, "fleet_host_ram_usage_ratio", "Footprint of the manifest over RAM");
+        prom_sample(p.f, "fleet_host_ram_usage_ratio", "", pct / 100.0);
+        prom_family(p.f, "fleet_instances", "Instances of --instance shape the packing needs");
+        prom_sample(p.f, "fleet_instances", "", ninst);
+        prom_family(p.f, "fleet_unplaced_replicas", "Replicas larger than one node's budget");
+        prom_sample(p.f, "fleet_unplaced_replicas", "", unplaced);
+        if (prom_close(&p) != 0) return 1;
+    }
+    return rc || unplaced ? 2 : 0;
+}
+
+/* ── Interactive mode ──────────────────────────────────────────────── */
+
+static uint64_t prompt_uint64(const char *prompt, uint64_t def)
+{
+    char line[256];
+    printf("  %s [%lu]: ", prompt, (unsigned long)def);
+    fflush(stdout);
+    if (!fgets(line, sizeof(line), stdin) || line[0] == '\n')
+        return def;
+    return strtoull(line, NULL, 10);
+}
+
+static void interactive_mode(int no_anim)
+{
+    char line[256];
+    printf("\n");
     print_separator();
     printf("  io_uring MEMORY SIMULATOR -- Interactive Mode\n");
     print_separator();
@@ -773,6 +2884,11 @@ static void interactive_mode(int no_anim)
     cfg.cq_entries = (uint32_t)prompt_uint64("CQ entries per ring (0 = auto 2x SQ)", 0);
     if (cfg.cq_entries == 0) cfg.cq_entries = cfg.sq_entries * DEFAULT_CQ_FACTOR;
 
+    printf("  Use 128-byte SQEs? (y/N): ");
+    fflush(stdout);
+    if (fgets(line, sizeof(line), stdin) && (line[0] == 'y' || line[0] == 'Y'))
+        cfg.sqe128 = 1;
+
     printf("  Use 32-byte CQEs? (y/N): ");
     fflush(stdout);
     if (fgets(line, sizeof(line), stdin) && (line[0] == 'y' || line[0] == 'Y'))
@@ -807,20 +2923,77 @@ static void usage(const char *prog)
         "  --rings <n>          Number of io_uring instances             [default: 1]\n"
         "  --sq <n>             SQ entries per ring                      [default: 128]\n"
         "  --cq <n>             CQ entries per ring (0 = auto 2x SQ)    [default: 0]\n"
+        "  --sqe128             Use 128-byte SQEs\n"
         "  --cqe32              Use 32-byte CQEs\n"
         "  --reg-bufs <size>    Registered buffer size per ring          [default: 0]\n"
         "  --reg-files <n>      Registered file descriptors per ring     [default: 0]\n"
+        "  --kernel <rel|name>  Accounting profile: auto (uname -r), a release such\n"
+        "                       as 5.10, or 5.1|5.4|5.12|5.16   [default: auto]\n"
+        "  --sqpoll[=<k>]       SQPOLL thread per k rings (ATTACH_WQ sharing) [k: 1]\n"
+        "  --tasks <n>          Submitting tasks owning the rings, one io-wq each\n"
+        "                       (under SQPOLL the SQ threads own the io-wqs)\n"
+        "                                          [default: one per CPU, <= rings]\n"
+        "  --iowq-busy <n>      Blocking requests in flight per io-wq; workers are\n"
+        "                       created on demand up to the bounded cap [default: 0]\n"
+        "  --iowq-max <b>[,<u>] io-wq bounded/unbounded worker caps; alone, counts\n"
+        "                       every io-wq at its caps (worst case)\n"
+        "                                            [default: min(SQ, 4 x CPUs),-]\n"
+        "  --cpus <n>           Target host CPUs            [default: online CPUs]\n"
+        "  --hugepages <size>   Back registered buffers with 2M/1G hugetlb pages;\n"
+        "                       pools round up to whole huge pages and the report\n"
+        "                       adds the vm.nr_hugepages reservation\n"
         "  --interactive, -i    Interactive mode (ignores other flags)\n"
         "  --sweep              Show table for varying ring counts\n"
-        "  --no-anim            Skip real-time ring visualization\n"
+        "  --grid               Sweep every combination of the --grid-* axes in\n"
+        "                       parallel and print the Pareto frontier (rings x SQ\n"
+        "                       depth x buffer pool vs locked memory) under budget\n"
+        "  --grid-sq <list>     SQ entries         [default: 32,64,...,4096]\n"
+        "  --grid-cq <list>     CQ factors (CQ = factor x SQ) [default: from --cq or 2]\n"
+        "  --grid-cqe32 <list>  0 and/or 1         [default: from --cqe32]\n"
+        "  --grid-bufs <list>   Registered bufs per ring [default: 0,64K,256K,1M,4M,16M]\n"
+        "  --grid-files <list>  Registered files per ring [default: from --reg-files]\n"
+        "  --grid-rings <list>  Ring counts        [default: 1,2,4,...,65536]\n"
+        "  --budget <pct>       Locked-memory budget as %% of --ram  [default: 80]\n"
+        "  --threads <n>        Grid worker threads [default: online CPUs]\n"
+        "  --solve              Solve for the largest SQ depth and buffer pool per\n"
+        "                       ring that fits (--sq / --reg-bufs are the minimums)\n"
+        "  --services <n>       Services on the host, --rings each   [default: 1]\n"
+        "  --memlock-max <size> RLIMIT_MEMLOCK ceiling, checked against the charge\n"
+        "                       of every service sharing the uid [default: none]\n"
+        "  --separate-users     Each service runs as its own uid  [default: shared]\n"
+        "  --map-count-max <n>  Per-service vm.max_map_count ceiling [default: none]\n"
+        "  --margin <pct>       Headroom held back from each ceiling [default: 10]\n"
+        "  --audit              Compare the live host (MemTotal, RLIMIT_MEMLOCK,\n"
+        "                       vm.max_map_count) and services against the model\n"
+        "                       for the declared per-service config; exit 2 if any\n"
+        "                       service is flagged. --ram is optional here\n"
+        "  --unit <name>        systemd unit to audit (repeatable)\n"
+        "  --pid <n>            Process to audit (repeatable)\n"
+        "  --warn-pct <pct>     Flag services using this much of a limit [default: 80]\n"
+        "  --manifest <file>    Evaluate a CSV/INI list of services as one host, pack\n"
+        "                       replicas onto --instance shapes and print per-service\n"
+        "                       LimitMEMLOCK drop-ins; exit 2 if a replica cannot fit\n"
+        "  --instance <ram>[xN] Instance shape for packing, N NUMA nodes [default: --ram x1]\n"
+        "  --dropin-dir <dir>   Write <dir>/<service>.service.d/io_uring.conf\n"
+        "  --prom <file>        Also write the batch, --audit or --manifest results as\n"
+        "                       gauges for node_exporter's textfile collector\n"
+        "  --no-anim            Skip real-time ring visualization (always skipped\n"
+        "                       when stdout is not a terminal; any key skips it)\n"
         "  --speed <ms>         Animation speed in ms per frame          [default: 40]\n"
         "  --help, -h           Show this help\n\n"
         "Examples:\n"
         "  %s --ram 16G --rings 4 --sq 256\n"
         "  %s --ram 8G --rings 1000 --sq 4096 --reg-bufs 4M --sweep\n"
         "  %s --interactive\n"
-        "  %s --ram 4G --rings 4 --sq 512 --no-anim\n",
-        prog, prog, prog, prog, prog);
+        "  %s --ram 4G --rings 4 --sq 512 --no-anim\n"
+        "  %s --ram 64G --grid --grid-cqe32 0,1 --grid-files 0,4096\n"
+        "  %s --ram 64G --solve --services 12 --rings 64 --memlock-max 2G\n"
+        "  %s --ram 256G --rings 512 --reg-bufs 3M --hugepages 2M --no-anim\n"
+        "  %s --audit --rings 64 --sq 1024 --reg-bufs 1M --unit nginx.service\n"
+        "  %s --ram 512G --manifest fleet.csv --instance 256Gx2 --dropin-dir out/\n"
+        "  %s --audit --rings 64 --unit nginx.service \\\n"
+        "      --prom /var/lib/node_exporter/textfile/io_uring.prom\n",
+        prog, prog, prog, prog, prog, prog, prog, prog, prog, prog, prog);
 }
 
 /* ── Main ──────────────────────────────────────────────────────────── */
@@ -832,22 +3005,67 @@ int main(int argc, char **argv)
         {"rings",       required_argument, 0, 'n'},
         {"sq",          required_argument, 0, 's'},
         {"cq",          required_argument, 0, 'c'},
+        {"sqe128",      no_argument,       0, '7'},
         {"cqe32",       no_argument,       0, '3'},
         {"reg-bufs",    required_argument, 0, 'b'},
         {"reg-files",   required_argument, 0, 'f'},
+        {"hugepages",   required_argument, 0, 'H'},
+        {"kernel",      required_argument, 0, 'k'},
+        {"sqpoll",      optional_argument, 0, 'q'},
+        {"tasks",       required_argument, 0, 't'},
+        {"iowq-max",    required_argument, 0, 'I'},
+        {"iowq-busy",   required_argument, 0, 'J'},
+        {"cpus",        required_argument, 0, 'U'},
+        {"audit",       no_argument,       0, 'a'},
+        {"unit",        required_argument, 0, 'u'},
+        {"pid",         required_argument, 0, 'p'},
+        {"warn-pct",    required_argument, 0, 'W'},
+        {"manifest",    required_argument, 0, 'm'},
+        {"instance",    required_argument, 0, 'x'},
+        {"dropin-dir",  required_argument, 0, 'D'},
+        {"prom",        required_argument, 0, 'O'},
         {"interactive", no_argument,       0, 'i'},
         {"sweep",       no_argument,       0, 'w'},
         {"no-anim",     no_argument,       0, 'A'},
         {"speed",       required_argument, 0, 'S'},
+        {"grid",        no_argument,       0, 'G'},
+        {"grid-sq",     required_argument, 0, 'Q'},
+        {"grid-cq",     required_argument, 0, 'C'},
+        {"grid-cqe32",  required_argument, 0, 'E'},
+        {"grid-bufs",   required_argument, 0, 'B'},
+        {"grid-files",  required_argument, 0, 'F'},
+        {"grid-rings",  required_argument, 0, 'R'},
+        {"budget",      required_argument, 0, 'P'},
+        {"threads",     required_argument, 0, 'T'},
+        {"solve",       no_argument,       0, 'V'},
+        {"services",    required_argument, 0, 'N'},
+        {"memlock-max", required_argument, 0, 'L'},
+        {"separate-users", no_argument,    0, 'Y'},
+        {"map-count-max", required_argument, 0, 'M'},
+        {"margin",      required_argument, 0, 'K'},
         {"help",        no_argument,       0, 'h'},
         {0, 0, 0, 0}
     };
 
-    ring_config_t cfg = { .sq_entries = 128, .cq_entries = 0, .cqe32 = 0,
+    ring_config_t cfg = { .sq_entries = 128, .cq_entries = 0, .sqe128 = 0, .cqe32 = 0,
                            .registered_bufs = 0, .registered_files = 0 };
     uint64_t total_ram = 0;
     uint32_t num_rings = 1;
     int do_interactive = 0, do_sweep = 0, no_anim = 0, speed_ms = 40;
+    int do_grid = 0;
+    double budget_pct = 80.0;
+    grid_spec_t grid = { .threads = (int)sysconf(_SC_NPROCESSORS_ONLN) };
+    kmodel.cpus = grid.threads > 0 ? (uint32_t)grid.threads : 1;
+    const char *axis_arg[6] = {0};      /* sq, cq, cqe32, bufs, files, rings */
+    int do_solve = 0;
+    int do_audit = 0, naudit_units = 0, naudit_pids = 0;
+    const char *audit_units[AUDIT_MAX_TARGETS];
+    int audit_pids[AUDIT_MAX_TARGETS];
+    double warn_pct = 80.0;
+    const char *manifest = NULL, *dropin_dir = NULL;
+    uint64_t inst_ram = 0;
+    int inst_nodes = 1;
+    solve_spec_t solve = { .services = 1, .margin = 0.10 };
 
     if (argc == 1) do_interactive = 1;
 
@@ -858,27 +3076,171 @@ int main(int argc, char **argv)
         case 'n': num_rings = (uint32_t)atoi(optarg); break;
         case 's': cfg.sq_entries = (uint32_t)atoi(optarg); break;
         case 'c': cfg.cq_entries = (uint32_t)atoi(optarg); break;
+        case '7': cfg.sqe128 = 1; break;
         case '3': cfg.cqe32 = 1; break;
         case 'b': cfg.registered_bufs = parse_ram(optarg); break;
         case 'f': cfg.registered_files = (uint32_t)atoi(optarg); break;
+        case 'k':
+            if (acct_profile_select(optarg) != 0) {
+                fprintf(stderr, "Error: unknown --kernel '%s' (auto, a release >= 5.1, "
+                                "or " RM_ACCT_PROFILE_NAMES ")\n", optarg);
+                return 1;
+            }
+            break;
+        case 'H':
+            cfg.buf_page_size = parse_ram(optarg);
+            if (cfg.buf_page_size <= PAGE_SIZE ||
+                (cfg.buf_page_size & (cfg.buf_page_size - 1))) {
+                fprintf(stderr, "Error: --hugepages must be a power of two above %d (e.g. 2M, 1G)\n",
+                        PAGE_SIZE);
+                return 1;
+            }
+            break;
         case 'i': do_interactive = 1; break;
         case 'w': do_sweep = 1; break;
         case 'A': no_anim = 1; break;
         case 'S': speed_ms = atoi(optarg); break;
+        case 'G': do_grid = 1; break;
+        case 'Q': axis_arg[0] = optarg; break;
+        case 'C': axis_arg[1] = optarg; break;
+        case 'E': axis_arg[2] = optarg; break;
+        case 'B': axis_arg[3] = optarg; break;
+        case 'F': axis_arg[4] = optarg; break;
+        case 'R': axis_arg[5] = optarg; break;
+        case 'P': budget_pct = atof(optarg); break;
+        case 'T': grid.threads = atoi(optarg); break;
+        case 'V': do_solve = 1; break;
+        case 'N': solve.services = (uint32_t)atoi(optarg); break;
+        case 'L': solve.memlock_max = parse_ram(optarg); break;
+        case 'Y': solve.separate_users = 1; break;
+        case 'M': solve.map_count_max = strtoull(optarg, NULL, 10); break;
+        case 'K': solve.margin = atof(optarg) / 100.0; break;
+        case 'a': do_audit = 1; break;
+        case 'q': kmodel.sqpoll_share = optarg ? (uint32_t)atoi(optarg) : 1; break;
+        case 't': kmodel.tasks = (uint32_t)atoi(optarg); break;
+        case 'I': {
+            char *end;
+            kmodel.iowq_bounded = (int32_t)strtol(optarg, &end, 10);
+            kmodel.iowq_unbounded = *end == ',' ? (uint32_t)atoi(end + 1) : 0;
+            break;
+        }
+        case 'U': kmodel.cpus = (uint32_t)atoi(optarg); break;
+        case 'J': kmodel.iowq_busy = atoi(optarg) < 0 ? 0 : atoi(optarg); break;
+        case 'u':
+            if (naudit_units < AUDIT_MAX_TARGETS) audit_units[naudit_units++] = optarg;
+            break;
+        case 'p':
+            if (naudit_pids < AUDIT_MAX_TARGETS) audit_pids[naudit_pids++] = atoi(optarg);
+            break;
+        case 'W': warn_pct = atof(optarg); break;
+        case 'm': manifest = optarg; break;
+        case 'x': {
+            inst_ram = parse_ram(optarg);
+            const char *x = strpbrk(optarg, "xX*");
+            inst_nodes = x ? atoi(x + 1) : 1;
+            break;
+        }
+        case 'D': dropin_dir = optarg; break;
+        case 'O': prom_path = optarg; break;
         case 'h': usage(argv[0]); return 0;
         default:  usage(argv[0]); return 1;
         }
     }
 
+    if (prom_path && (do_interactive || do_grid || do_solve))
+        fprintf(stderr, "Warning: --prom covers the batch, --audit and --manifest modes only\n");
+
     if (do_interactive) { interactive_mode(no_anim); return 0; }
 
+    if (do_audit) {
+        if (cfg.cq_entries == 0) cfg.cq_entries = cfg.sq_entries * DEFAULT_CQ_FACTOR;
+        return audit_mode(&cfg, num_rings, total_ram, audit_units, naudit_units,
+                          audit_pids, naudit_pids, warn_pct);
+    }
+
+    if (manifest) {
+        if (total_ram == 0) total_ram = inst_ram;
+        if (inst_ram == 0) inst_ram = total_ram;
+        if (total_ram == 0 || inst_nodes < 1 || budget_pct <= 0 || budget_pct > 100) {
+            fprintf(stderr, "Error: --manifest needs --ram or --instance <ram>[xN], N >= 1\n");
+            return 1;
+        }
+        return fleet_mode(manifest, total_ram, inst_ram, inst_nodes, budget_pct, dropin_dir);
+    }
+
     if (total_ram == 0) {
         fprintf(stderr, "Error: --ram is required in batch mode\n\n");
         usage(argv[0]);
         return 1;
     }
+    uint32_t cq_factor = cfg.cq_entries && cfg.sq_entries ? cfg.cq_entries / cfg.sq_entries
+                                                           : DEFAULT_CQ_FACTOR;
+    if (cq_factor == 0) cq_factor = 1;
     if (cfg.cq_entries == 0) cfg.cq_entries = cfg.sq_entries * DEFAULT_CQ_FACTOR;
 
+    if (do_grid) {
+        static const uint64_t def_sq[]   = {32, 64, 128, 256, 512, 1024, 2048, 4096};
+        static const uint64_t def_bufs[] = {0, 64ULL << 10, 256ULL << 10, 1ULL << 20,
+                                            4ULL << 20, 16ULL << 20};
+        uint64_t def_rings[NUM_SWEEP_COUNTS];
+        for (size_t i = 0; i < NUM_SWEEP_COUNTS; i++) def_rings[i] = sweep_counts[i];
+        uint64_t one_cqf = cq_factor, one_cqe = (uint64_t)cfg.cqe32,
+                 one_files = cfg.registered_files;
+
+        axis_set(&grid.sq, def_sq, (int)(sizeof(def_sq) / sizeof(def_sq[0])));
+        axis_set(&grid.cq_factor, &one_cqf, 1);
+        axis_set(&grid.cqe32, &one_cqe, 1);
+        axis_set(&grid.bufs, def_bufs, (int)(sizeof(def_bufs) / sizeof(def_bufs[0])));
+        axis_set(&grid.files, &one_files, 1);
+        axis_set(&grid.rings, def_rings, (int)NUM_SWEEP_COUNTS);
+
+        grid_axis_t *axes[6] = { &grid.sq, &grid.cq_factor, &grid.cqe32,
+                                 &grid.bufs, &grid.files, &grid.rings };
+        static const char *axis_names[6] = { "sq", "cq", "cqe32", "bufs", "files", "rings" };
+        for (int i = 0; i < 6; i++) {
+            if (axis_arg[i] && parse_axis(axis_arg[i], axes[i], i == 3) != 0) {
+                fprintf(stderr, "Error: bad --grid-%s list '%s' (max %d values)\n",
+                        axis_names[i], axis_arg[i], GRID_MAX_VALUES);
+                return 1;
+            }
+        }
+        /* Bounds per axis; bufs and files may be 0 */
+        static const uint64_t axis_lo[6] = { 1, 1, 0, 0, 0, 1 };
+        static const uint64_t axis_hi[6] = { RM_MAX_SQ_ENTRIES, UINT32_MAX, 1, UINT64_MAX, UINT32_MAX,
+                                             UINT32_MAX };
+        for (int i = 0; i < 6; i++) {
+            for (int k = 0; k < axes[i]->n; k++) {
+                if (axes[i]->v[k] < axis_lo[i] || axes[i]->v[k] > axis_hi[i]) {
+                    fprintf(stderr, "Error: --grid-%s values must be in [%lu, %lu]\n",
+                            axis_names[i], (unsigned long)axis_lo[i], (unsigned long)axis_hi[i]);
+                    return 1;
+                }
+            }
+        }
+        if (budget_pct <= 0 || budget_pct > 100) {
+            fprintf(stderr, "Error: --budget must be in (0, 100]\n");
+            return 1;
+        }
+        grid.sqe128    = cfg.sqe128;
+        grid.buf_page_size = cfg.buf_page_size;
+        grid.total_ram = total_ram;
+        grid.budget    = (uint64_t)((double)total_ram * budget_pct / 100.0);
+        return grid_mode(&grid);
+    }
+
+    if (do_solve) {
+        if (solve.services == 0 || num_rings == 0 || solve.margin < 0 || solve.margin >= 1 ||
+            budget_pct <= 0 || budget_pct > 100) {
+            fprintf(stderr, "Error: --services/--rings must be > 0, --margin in [0, 100), "
+                            "--budget in (0, 100]\n");
+            return 1;
+        }
+        solve.rings_per_service = num_rings;
+        solve.total_ram  = total_ram;
+        solve.ram_budget = (uint64_t)((double)total_ram * budget_pct / 100.0);
+        return solve_mode(&solve, &cfg, cq_factor);
+    }
+
     ring_memory_t m = calc_ring_memory(&cfg);
     if (!no_anim) run_animation(&cfg, &m, num_rings, total_ram, speed_ms);
 
@@ -887,5 +3249,5 @@ int main(int argc, char **argv)
     print_simulation(&m, num_rings, total_ram);
     if (do_sweep) sweep_mode(&cfg, total_ram);
     printf("\n");
-    return 0;
+    return prom_simulation(&m, num_rings, total_ram) ? 1 : 0;
 }
\ No newline at end of file